@@ -0,0 +1,618 @@
+/******************************************************************************
+Filename    : mailbox.c
+Author      : pry
+Date        : 19/10/2013
+Version     : 0.01
+Description : The latest-value mailbox module for the OS. A mailbox keeps the
+              latest values posted to it, each with a sequence number, and a new
+              value always overwrites the oldest one. This suits the state-style
+              data, such as the current setpoint, where the readers only want the
+              newest value and never need to drain the stale ones.
+              The values are copied into and out of the mailbox, so keep them small.
+              When we are waiting for a mailbox, the wait succeeds when a value
+              newer than the last one read by the process is posted.
+******************************************************************************/
+
+/* Includes ******************************************************************/
+#include "Config\MP_config.h"
+#include "Platform\MP_platform.h"
+
+/* Definition includes */
+#define __HDR_DEFS__
+#include "Kernel\scheduler.h"
+#include "Kernel\error.h"
+#include "Memmgr\memory.h"
+#include "ExtIPC\wait.h"
+#include "ExtIPC\mailbox.h"
+#undef __HDR_DEFS__
+
+/* Structure includes */
+#define __HDR_STRUCTS__
+#include "Syslib\syslib.h"
+#include "Kernel\scheduler.h"
+#include "Memmgr\memory.h"
+#include "ExtIPC\wait.h"
+#include "ExtIPC\mailbox.h"
+#undef __HDR_STRUCTS__
+
+/* Private includes */
+#include "ExtIPC\mailbox.h"
+
+/* Public includes */
+#define __HDR_PUBLIC_MEMBERS__
+#include "Kernel\scheduler.h"
+#include "Kernel\interrupt.h"
+#include "Kernel\error.h"
+#include "Syslib\syslib.h"
+#include "Memmgr\memory.h"
+#include "ExtIPC\wait.h"
+#include "ExtIPC\mailbox.h"
+#include "Syssvc\timer.h"
+#undef __HDR_PUBLIC_MEMBERS__
+/* End Includes **************************************************************/
+
+/* Begin Function:_Sys_Mbox_Init **********************************************
+Description : Initialize the mailbox module.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+void _Sys_Mbox_Init(void)
+{
+#if(ENABLE_MBOX==TRUE)
+    cnt_t Mbox_Cnt;
+
+    /* Initialize the lists */
+    Sys_Create_List(&Mbox_List_Head);
+    Sys_Create_List(&Mbox_Empty_List_Head);
+    /* Clear the control block */
+    Sys_Memset((ptr_int_t)Mbox_CB,0,MAX_MBOXES*sizeof(struct Mbox));
+
+    /* Put the blocks into the empty list */
+    for(Mbox_Cnt=0;Mbox_Cnt<MAX_MBOXES;Mbox_Cnt++)
+    {
+        Mbox_CB[Mbox_Cnt].Mbox_ID=Mbox_Cnt;
+        Sys_Create_List(&(Mbox_CB[Mbox_Cnt].Wait_Object_Head));
+        Sys_List_Insert_Node(&(Mbox_CB[Mbox_Cnt].Head),&Mbox_Empty_List_Head,Mbox_Empty_List_Head.Next);
+    }
+
+    /* Clear the statistical variable */
+    Mbox_In_Sys=0;
+#endif
+}
+/* End Function:_Sys_Mbox_Init ***********************************************/
+
+/* Begin Function:Sys_Create_Mbox *********************************************
+Description : Create a mailbox in the system.
+Input       : s8* Mbox_Name - The name of the mailbox.
+              size_t Slot_Size - The biggest value that can be posted.
+              size_t Slot_Number - The number of the latest values kept. If only
+                                   the newest value is needed, 1.
+Output      : None.
+Return      : mboxid_t - The ID of the mailbox. If the function fail, the value
+                         will be -1.
+******************************************************************************/
+#if(ENABLE_MBOX==TRUE)
+mboxid_t Sys_Create_Mbox(s8* Mbox_Name,size_t Slot_Size,size_t Slot_Number)
+{
+    mboxid_t Mbox_ID;
+    void* Mbox_Ptr;
+    size_t Slot_Stride;
+    cnt_t PID_Cnt;
+    struct List_Head* Traverse_List_Ptr;
+
+    /* See if the name is an empty pointer, or the sizes wrong */
+    if((Mbox_Name==0)||(Slot_Size==0)||(Slot_Number==0))
+    {
+        Sys_Set_Errno(EINVMBOX);
+        return -1;
+    }
+
+    /* Each slot is the header followed by the value */
+    Slot_Stride=sizeof(struct Mbox_Slot)+(((Slot_Size+7)>>3)<<3);
+
+    Sys_Lock_Scheduler();
+
+    /* See if there are any empty blocks */
+    if((ptr_int_t)(&Mbox_Empty_List_Head)==(ptr_int_t)(Mbox_Empty_List_Head.Next))
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(ENOEMBOX);
+        return -1;
+    }
+
+    Mbox_ID=((struct Mbox*)Mbox_Empty_List_Head.Next)->Mbox_ID;
+
+    /* Traverse the list to see if the name is unique */
+    Traverse_List_Ptr=Mbox_List_Head.Next;
+    while((ptr_int_t)Traverse_List_Ptr!=(ptr_int_t)(&Mbox_List_Head))
+    {
+        /* If we can find a match, abort */
+        if(Sys_Strcmp(Mbox_Name,((struct Mbox*)Traverse_List_Ptr)->Mbox_Name,MAX_STR_LEN)==0)
+        {
+            Sys_Unlock_Scheduler();
+            Sys_Set_Errno(EMBOXEXIST);
+            return -1;
+        }
+
+        Traverse_List_Ptr=Traverse_List_Ptr->Next;
+    }
+
+    /* The memory allocation is done in the name of "Init" */
+    Mbox_Ptr=_Sys_Malloc(0,Slot_Stride*Slot_Number);
+    if(Mbox_Ptr==0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(ENOEMBOX);
+        return -1;
+    }
+
+    /* A slot of sequence number 0 holds nothing */
+    Sys_Memset((ptr_int_t)Mbox_Ptr,0,Slot_Stride*Slot_Number);
+
+    /* Now we are sure that we have enough resource to set up the mailbox */
+    Sys_List_Delete_Node(Mbox_CB[Mbox_ID].Head.Prev,Mbox_CB[Mbox_ID].Head.Next);
+    Sys_List_Insert_Node(&(Mbox_CB[Mbox_ID].Head),&Mbox_List_Head,Mbox_List_Head.Next);
+
+    /* Register the values. Nothing is posted or read yet */
+    Mbox_CB[Mbox_ID].Mbox_Name=Mbox_Name;
+    Mbox_CB[Mbox_ID].Slot_Size=Slot_Size;
+    Mbox_CB[Mbox_ID].Slot_Number=Slot_Number;
+    Mbox_CB[Mbox_ID].Slot_Stride=Slot_Stride;
+    Mbox_CB[Mbox_ID].Mbox_Seq=0;
+    Mbox_CB[Mbox_ID].Mbox_Addr=(ptr_int_t)Mbox_Ptr;
+    for(PID_Cnt=0;PID_Cnt<MAX_PROC_NUM;PID_Cnt++)
+        Mbox_CB[Mbox_ID].Read_Seq[PID_Cnt]=0;
+
+    /* Update the statistical variable */
+    Mbox_In_Sys++;
+
+    Sys_Unlock_Scheduler();
+    return Mbox_ID;
+}
+#endif
+/* End Function:Sys_Create_Mbox **********************************************/
+
+/* Begin Function:Sys_Destroy_Mbox ********************************************
+Description : Destroy a mailbox in the system. The processes waiting for it are
+              woken up, and they will find that it is gone.
+Input       : mboxid_t Mbox_ID - The ID of the mailbox.
+Output      : None.
+Return      : retval_t - If successful,0; else -1.
+******************************************************************************/
+#if(ENABLE_MBOX==TRUE)
+retval_t Sys_Destroy_Mbox(mboxid_t Mbox_ID)
+{
+    /* See if the mailbox ID is over the boundary */
+    if((Mbox_ID<0)||(Mbox_ID>=MAX_MBOXES))
+    {
+        Sys_Set_Errno(EINVMBOX);
+        return -1;
+    }
+
+    Sys_Lock_Scheduler();
+
+    /* See if the mailbox exists in the system */
+    if(Mbox_CB[Mbox_ID].Slot_Number==0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(ENOMBOX);
+        return -1;
+    }
+
+    _Sys_Mbox_Wake_All(Mbox_ID);
+
+    /* Now we can safely destroy the mailbox */
+    Sys_List_Delete_Node(Mbox_CB[Mbox_ID].Head.Prev,Mbox_CB[Mbox_ID].Head.Next);
+    Sys_List_Insert_Node(&(Mbox_CB[Mbox_ID].Head),&Mbox_Empty_List_Head,Mbox_Empty_List_Head.Next);
+
+    _Sys_Mfree(0,(void*)(Mbox_CB[Mbox_ID].Mbox_Addr));
+
+    /* Clear the values */
+    Mbox_CB[Mbox_ID].Mbox_Name=0;
+    Mbox_CB[Mbox_ID].Slot_Size=0;
+    Mbox_CB[Mbox_ID].Slot_Number=0;
+    Mbox_CB[Mbox_ID].Slot_Stride=0;
+    Mbox_CB[Mbox_ID].Mbox_Seq=0;
+    Mbox_CB[Mbox_ID].Mbox_Addr=0;
+
+    /* Update the statistical variable */
+    Mbox_In_Sys--;
+
+    Sys_Unlock_Scheduler();
+    return 0;
+}
+#endif
+/* End Function:Sys_Destroy_Mbox *********************************************/
+
+/* Begin Function:Sys_Get_Mbox_ID *********************************************
+Description : Get the mailbox's unique identifier through the name of it.
+Input       : s8* Mbox_Name - The name of the mailbox.
+Output      : None.
+Return      : mboxid_t - The identifier of the mailbox. If the mailbox doesn't
+                         exist, then return -1.
+******************************************************************************/
+#if(ENABLE_MBOX==TRUE)
+mboxid_t Sys_Get_Mbox_ID(s8* Mbox_Name)
+{
+    struct List_Head* Traverse_List_Ptr;
+
+    Sys_Lock_Scheduler();
+
+    /* See if the name exists */
+    Traverse_List_Ptr=Mbox_List_Head.Next;
+    while((ptr_int_t)Traverse_List_Ptr!=(ptr_int_t)(&Mbox_List_Head))
+    {
+        if(Sys_Strcmp(Mbox_Name,((struct Mbox*)Traverse_List_Ptr)->Mbox_Name,MAX_STR_LEN)==0)
+        {
+            Sys_Unlock_Scheduler();
+            return ((struct Mbox*)Traverse_List_Ptr)->Mbox_ID;
+        }
+
+        Traverse_List_Ptr=Traverse_List_Ptr->Next;
+    }
+
+    /* If it can get here, then nothing is found */
+    Sys_Unlock_Scheduler();
+    Sys_Set_Errno(ENOMBOX);
+    return -1;
+}
+#endif
+/* End Function:Sys_Get_Mbox_ID **********************************************/
+
+/* Begin Function:_Sys_Mbox_Wake_All ******************************************
+Description : Wake up all the processes waiting for the mailbox. This should be
+              called with the scheduler locked.
+Input       : mboxid_t Mbox_ID - The ID of the mailbox.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MBOX==TRUE)
+void _Sys_Mbox_Wake_All(mboxid_t Mbox_ID)
+{
+    struct Wait_Object_Struct* Wait_Block_Ptr;
+
+    while(Mbox_CB[Mbox_ID].Wait_Object_Head.Next!=&(Mbox_CB[Mbox_ID].Wait_Object_Head))
+    {
+        Wait_Block_Ptr=(struct Wait_Object_Struct*)(Mbox_CB[Mbox_ID].Wait_Object_Head.Next-1);
+        /* Mark that the wait is successful */
+        Wait_Block_Ptr->Succeed_Flag=1;
+        /* Delete the wait block from the mailbox wait list */
+        Sys_List_Delete_Node(Wait_Block_Ptr->Object_Head.Prev,Wait_Block_Ptr->Object_Head.Next);
+        /* Try to stop the timer if possible */
+        Sys_Proc_Delay_Cancel(Wait_Block_Ptr->PID);
+        /* Wake the process up */
+        _Sys_Set_Ready(Wait_Block_Ptr->PID);
+    }
+}
+#endif
+/* End Function:_Sys_Mbox_Wake_All *******************************************/
+
+/* Begin Function:_Sys_Mbox_Get ***********************************************
+Description : Copy the value of a certain sequence number out. The value must be
+              still in the mailbox. This should be called with the scheduler locked.
+Input       : mboxid_t Mbox_ID - The ID of the mailbox.
+              u32 Seq - The sequence number of the value.
+Output      : void* Buffer - The buffer to copy the value to.
+              size_t* Size - The size of the value.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MBOX==TRUE)
+void _Sys_Mbox_Get(mboxid_t Mbox_ID,u32 Seq,void* Buffer,size_t* Size)
+{
+    struct Mbox_Slot* Slot_Ptr;
+
+    Slot_Ptr=MBOX_SLOT_PTR(Mbox_ID,Seq);
+    Sys_Memcpy((ptr_int_t)Buffer,(ptr_int_t)(Slot_Ptr+1),Slot_Ptr->Size);
+    *Size=Slot_Ptr->Size;
+}
+#endif
+/* End Function:_Sys_Mbox_Get ************************************************/
+
+/* Begin Function:Sys_Mbox_Post ***********************************************
+Description : Post a value to the mailbox. The oldest value in the mailbox is
+              overwritten, and all the processes waiting for it are woken up.
+Input       : mboxid_t Mbox_ID - The ID of the mailbox.
+              void* Value - The value to post.
+              size_t Size - The size of the value.
+Output      : None.
+Return      : u32 - The sequence number of the value. If the function fails, 0.
+******************************************************************************/
+#if(ENABLE_MBOX==TRUE)
+u32 Sys_Mbox_Post(mboxid_t Mbox_ID,void* Value,size_t Size)
+{
+    struct Mbox_Slot* Slot_Ptr;
+    u32 Seq;
+
+    /* See if the parameters are over the boundary */
+    if((Mbox_ID<0)||(Mbox_ID>=MAX_MBOXES)||(Value==0))
+    {
+        Sys_Set_Errno(EINVMBOX);
+        return 0;
+    }
+
+    Sys_Lock_Scheduler();
+
+    /* See if the mailbox exists in the system */
+    if(Mbox_CB[Mbox_ID].Slot_Number==0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(ENOMBOX);
+        return 0;
+    }
+
+    /* See if the value fits in a slot */
+    if(Size>Mbox_CB[Mbox_ID].Slot_Size)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EINVMBOX);
+        return 0;
+    }
+
+    /* The sequence number 0 means nothing, so skip it when wrapping around */
+    Seq=Mbox_CB[Mbox_ID].Mbox_Seq+1;
+    if(Seq==0)
+        Seq=1;
+
+    Slot_Ptr=MBOX_SLOT_PTR(Mbox_ID,Seq);
+    Sys_Memcpy((ptr_int_t)(Slot_Ptr+1),(ptr_int_t)Value,Size);
+    Slot_Ptr->Seq=Seq;
+    Slot_Ptr->Size=Size;
+    Mbox_CB[Mbox_ID].Mbox_Seq=Seq;
+
+    _Sys_Mbox_Wake_All(Mbox_ID);
+
+    Sys_Unlock_Scheduler();
+    return Seq;
+}
+#endif
+/* End Function:Sys_Mbox_Post ************************************************/
+
+/* Begin Function:Sys_Mbox_Read ***********************************************
+Description : Read the latest value in the mailbox without blocking. The reader is
+              automatically the "Current_PID".
+Input       : mboxid_t Mbox_ID - The ID of the mailbox.
+Output      : void* Buffer - The buffer to copy the value to. It must be able to hold
+                             the biggest value of the mailbox.
+              size_t* Size - The size of the value.
+Return      : u32 - The sequence number of the value. If nothing is posted yet, 0.
+******************************************************************************/
+#if(ENABLE_MBOX==TRUE)
+u32 Sys_Mbox_Read(mboxid_t Mbox_ID,void* Buffer,size_t* Size)
+{
+    u32 Seq;
+
+    /* See if the mailbox ID is over the boundary */
+    if((Mbox_ID<0)||(Mbox_ID>=MAX_MBOXES))
+    {
+        Sys_Set_Errno(EINVMBOX);
+        return 0;
+    }
+
+    Sys_Lock_Scheduler();
+
+    /* See if the mailbox exists in the system */
+    if(Mbox_CB[Mbox_ID].Slot_Number==0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(ENOMBOX);
+        return 0;
+    }
+
+    Seq=Mbox_CB[Mbox_ID].Mbox_Seq;
+    if(Seq==0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EMBOXEMPTY);
+        return 0;
+    }
+
+    _Sys_Mbox_Get(Mbox_ID,Seq,Buffer,Size);
+    Mbox_CB[Mbox_ID].Read_Seq[Current_PID]=Seq;
+
+    Sys_Unlock_Scheduler();
+    return Seq;
+}
+#endif
+/* End Function:Sys_Mbox_Read ************************************************/
+
+/* Begin Function:Sys_Mbox_Read_Wait ******************************************
+Description : Read the latest value in the mailbox if it is newer than the last one
+              read by us, and if not, wait until a newer one is posted or the time
+              is up. The reader is automatically the "Current_PID".
+Input       : mboxid_t Mbox_ID - The ID of the mailbox.
+              time_t Time - The longest time to wait. If the time is "WAIT_INFINITE",
+                            then the process will wait until it gets a new value.
+Output      : void* Buffer - The buffer to copy the value to. It must be able to hold
+                             the biggest value of the mailbox.
+              size_t* Size - The size of the value.
+Return      : u32 - The sequence number of the value. If no newer value is posted
+                    before the time is up, 0.
+******************************************************************************/
+#if(ENABLE_MBOX==TRUE)
+u32 Sys_Mbox_Read_Wait(mboxid_t Mbox_ID,void* Buffer,size_t* Size,time_t Time)
+{
+    u32 Seq;
+    cnt_t Last_Try;
+    time_t Start_Time;
+    time_t Passed_Time;
+    time_t Wait_Time;
+
+    /* See if the mailbox ID is over the boundary */
+    if((Mbox_ID<0)||(Mbox_ID>=MAX_MBOXES))
+    {
+        Sys_Set_Errno(EINVMBOX);
+        return 0;
+    }
+
+    Start_Time=System_Status.Time.OS_Total_Ticks.Low_Bits;
+    Last_Try=0;
+
+    while(1)
+    {
+        Sys_Lock_Scheduler();
+
+        /* See if the mailbox exists in the system */
+        if(Mbox_CB[Mbox_ID].Slot_Number==0)
+        {
+            Sys_Unlock_Scheduler();
+            Sys_Set_Errno(ENOMBOX);
+            return 0;
+        }
+
+        /* See if there is a value that we haven't read */
+        Seq=Mbox_CB[Mbox_ID].Mbox_Seq;
+        if(Seq!=Mbox_CB[Mbox_ID].Read_Seq[Current_PID])
+        {
+            _Sys_Mbox_Get(Mbox_ID,Seq,Buffer,Size);
+            Mbox_CB[Mbox_ID].Read_Seq[Current_PID]=Seq;
+            Sys_Unlock_Scheduler();
+            return Seq;
+        }
+
+        Sys_Unlock_Scheduler();
+
+        /* See how much time is left */
+        if(Time!=WAIT_INFINITE)
+        {
+            Passed_Time=System_Status.Time.OS_Total_Ticks.Low_Bits-Start_Time;
+            if(Passed_Time>=Time)
+                Last_Try=1;
+
+            Wait_Time=Time-Passed_Time;
+        }
+        else
+            Wait_Time=WAIT_INFINITE;
+
+        if(Last_Try!=0)
+            break;
+
+        /* Wait for a newer value. If the wait failed, we try for the last time */
+        if(Sys_Wait_Object(Mbox_ID,MAILBOX,Wait_Time)==-1)
+            Last_Try=1;
+    }
+
+    Sys_Set_Errno(EMBOXEMPTY);
+    return 0;
+}
+#endif
+/* End Function:Sys_Mbox_Read_Wait *******************************************/
+
+/* Begin Function:Sys_Mbox_Read_Seq *******************************************
+Description : Read the value of a certain sequence number, if it is still kept in
+              the mailbox. This is for the mailboxes that keep more than one value.
+Input       : mboxid_t Mbox_ID - The ID of the mailbox.
+              u32 Seq - The sequence number of the value.
+Output      : void* Buffer - The buffer to copy the value to. It must be able to hold
+                             the biggest value of the mailbox.
+              size_t* Size - The size of the value.
+Return      : retval_t - If successful,0; if the value is not posted yet or already
+                         overwritten, -1.
+******************************************************************************/
+#if(ENABLE_MBOX==TRUE)
+retval_t Sys_Mbox_Read_Seq(mboxid_t Mbox_ID,u32 Seq,void* Buffer,size_t* Size)
+{
+    /* See if the mailbox ID is over the boundary */
+    if((Mbox_ID<0)||(Mbox_ID>=MAX_MBOXES))
+    {
+        Sys_Set_Errno(EINVMBOX);
+        return -1;
+    }
+
+    Sys_Lock_Scheduler();
+
+    /* See if the mailbox exists in the system */
+    if(Mbox_CB[Mbox_ID].Slot_Number==0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(ENOMBOX);
+        return -1;
+    }
+
+    /* The slot tells us whether it still holds the value */
+    if((Seq==0)||(MBOX_SLOT_PTR(Mbox_ID,Seq)->Seq!=Seq))
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EMBOXEMPTY);
+        return -1;
+    }
+
+    _Sys_Mbox_Get(Mbox_ID,Seq,Buffer,Size);
+
+    Sys_Unlock_Scheduler();
+    return 0;
+}
+#endif
+/* End Function:Sys_Mbox_Read_Seq ********************************************/
+
+/* Begin Function:Sys_Query_Mbox_Seq ******************************************
+Description : Query the sequence number of the latest value in the mailbox.
+Input       : mboxid_t Mbox_ID - The ID of the mailbox.
+Output      : None.
+Return      : u32 - The sequence number. If nothing is posted yet, or the mailbox
+                    does not exist, 0.
+******************************************************************************/
+#if(ENABLE_MBOX==TRUE)
+u32 Sys_Query_Mbox_Seq(mboxid_t Mbox_ID)
+{
+    /* See if the mailbox ID is over the boundary */
+    if((Mbox_ID<0)||(Mbox_ID>=MAX_MBOXES))
+        return 0;
+
+    return Mbox_CB[Mbox_ID].Mbox_Seq;
+}
+#endif
+/* End Function:Sys_Query_Mbox_Seq *******************************************/
+
+/* Begin Function:_Sys_Wait_Mbox_Reg ******************************************
+Description : When we decide to wait for a mailbox, this function will be called.
+              Take note that when the wait is successful, the value is not read
+              for the process, and you need to read it by yourself.
+Input       : pid_t PID - The process waiting for the mailbox. We don't check whether
+                          the PID is valid here.
+              mboxid_t Mbox_ID - The ID of the mailbox.
+              struct Wait_Object_Struct* Wait_Block_Ptr - The pointer to the wait block.
+Output      : None.
+Return      : retval_t - If successful,0; if there's no need to wait, "NO_NEED_TO_WAIT(-2)";
+                         if the wait failed, "WAIT_FAILURE(-1)".
+******************************************************************************/
+#if(ENABLE_MBOX==TRUE)
+retval_t _Sys_Wait_Mbox_Reg(pid_t PID,mboxid_t Mbox_ID,struct Wait_Object_Struct* Wait_Block_Ptr)
+{
+    /* See if the mailbox ID is over the boundary */
+    if((Mbox_ID<0)||(Mbox_ID>=MAX_MBOXES))
+        return(WAIT_FAILURE);
+
+    Sys_Lock_Scheduler();
+
+    /* See if the mailbox exists in the system */
+    if(Mbox_CB[Mbox_ID].Slot_Number==0)
+    {
+        Sys_Unlock_Scheduler();
+        return(WAIT_FAILURE);
+    }
+
+    /* See if there is a value that the process haven't read. If yes, return right away. */
+    if(Mbox_CB[Mbox_ID].Mbox_Seq!=Mbox_CB[Mbox_ID].Read_Seq[PID])
+    {
+        Sys_Unlock_Scheduler();
+        return(NO_NEED_TO_WAIT);
+    }
+
+    Sys_List_Insert_Node(&(Wait_Block_Ptr->Object_Head),
+                         Mbox_CB[Mbox_ID].Wait_Object_Head.Prev,
+                         &(Mbox_CB[Mbox_ID].Wait_Object_Head));
+
+    Wait_Block_Ptr->Obj_ID=Mbox_ID;
+    Wait_Block_Ptr->PID=PID;
+    Wait_Block_Ptr->Type=MAILBOX;
+
+    Sys_Unlock_Scheduler();
+    return 0;
+}
+#endif
+/* End Function:_Sys_Wait_Mbox_Reg *******************************************/
+
+/* End Of File ***************************************************************/
+
+/* Copyright (C) 2011-2013 Evo-Devo Instrum. All rights reserved. ************/
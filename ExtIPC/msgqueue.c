@@ -6,6 +6,11 @@ Version     : 0.12
 Description : The queue module for the OS. The queue use a special method so
               that we don't have to copy the message into the message queue
               buffer. Thus, we can save time as well as space.
+              The messages in a queue are kept in one list for each receiver and
+              each priority(and optionally in type buckets), so that receiving, 
+              counting and waiting only look at the messages to the receiver itself.
+              The messages of a higher priority are received first, and the ones of
+              the same priority are received in the order of sending.
               Before enabling the message queue module, you must enable the
               dynamic memory management module first, or it will fail.
               When we are waiting for a certain message queue, the implications are:
@@ -14,9 +19,15 @@ Description : The queue module for the OS. The queue use a special method so
               2>When the message queue have messages for the process, then the
                 wait function will return, and you need to get the message manually;
                 Take note not to let any process that receive all kinds of message get the
-                message before you; This is the user's responsibility.
+                message before you; This is the user's responsibility. To avoid this, use
+                "Sys_Recv_Msg_Wait" instead, and the sender will hand the message to you
+                directly;
               3>When the message queue is empty, the process will wait until a message
                 for it comes.
+              When all the message blocks of a queue are used up, the senders can wait
+              for a spare block with "Sys_Alloc_Msg_Wait". The waiters are served in the
+              order of their process priorities, and one of them is woken up each time
+              a message block is destroyed.
 ******************************************************************************/
 
 /* Includes ******************************************************************/
@@ -66,13 +77,15 @@ void _Sys_Queue_Init(void)
 {
 #if(ENABLE_MSGQ==TRUE)
     cnt_t Msg_Queue_Count;
+    cnt_t PID_Count;
+    cnt_t Prio_Count;
     
     /* Initiailize the queue control block list */
     Sys_Create_List(&Empty_Msg_CB_List_Head);
     Sys_Create_List(&Msg_CB_List_Head);
     
     /* Initialize the message queue control block */
-    Sys_Memset((ptr_int_t)Msg_CB,'0',MAX_MSG_QUEUES*sizeof(struct Msg_Queue));
+    Sys_Memset((ptr_int_t)Msg_CB,0,MAX_MSG_QUEUES*sizeof(struct Msg_Queue));
     
     for(Msg_Queue_Count=0;Msg_Queue_Count<MAX_MSG_QUEUES;Msg_Queue_Count++)
     {
@@ -80,13 +93,26 @@ void _Sys_Queue_Init(void)
                              &Empty_Msg_CB_List_Head,
                              Empty_Msg_CB_List_Head.Next);
         /* Initiate the block list for each possible message queue */
-        Sys_Create_List(&(Msg_CB[Msg_Queue_Count].Msg_Block_Queue_Head));
         Sys_Create_List(&(Msg_CB[Msg_Queue_Count].Msg_Block_Empty_Head));
-        Sys_Create_List(&(Msg_CB[Msg_Queue_Count].Wait_Object_Head));
+        Sys_Create_List(&(Msg_CB[Msg_Queue_Count].Alloc_Wait_Head));
+        /* Initiate the message lists and the wait lists of each receiver */
+        for(PID_Count=0;PID_Count<MAX_PROC_NUM;PID_Count++)
+        {
+            for(Prio_Count=0;Prio_Count<MSGQ_PRIO_NUM;Prio_Count++)
+                Sys_Create_List(&(Msg_CB[Msg_Queue_Count].Msg_Recv_Head[PID_Count][Prio_Count]));
+            Sys_Create_List(&(Msg_CB[Msg_Queue_Count].Wait_Object_Head[PID_Count]));
+        }
         /* Initialize the message queue identifier */
         Msg_CB[Msg_Queue_Count].Msg_Queue_ID=Msg_Queue_Count;
     }
     
+    /* No process is receiving with "Sys_Recv_Msg_Wait" */
+    for(PID_Count=0;PID_Count<MAX_PROC_NUM;PID_Count++)
+    {
+        Msg_Recv_Wait_CB[PID_Count].Msg_Queue_ID=-1;
+        Msg_Recv_Wait_CB[PID_Count].Msg_Block_ID=-1;
+    }
+    
     /* Clear the statisticaal variable */
     Msg_Queue_In_Sys=0;
 #endif    
@@ -94,7 +120,8 @@ void _Sys_Queue_Init(void)
 /* End Function:_Sys_Queue_Init **********************************************/
 
 /* Begin Function:Sys_Create_Queue ********************************************
-Description : Create a queue and return the unique queue ID of it.
+Description : Create a queue and return the unique queue ID of it. All the messages
+              in the queue will be allocated from the heap.
 Input       : s8* Msg_Queue_Name - The name of the message queue.
               size_t Msg_Number - The number of messages in the message queue.
 Output      : None.
@@ -103,12 +130,38 @@ Return      : msgqid_t - The identifier of the message queue. If the function fa
 ******************************************************************************/
 #if(ENABLE_MSGQ==TRUE)
 msgqid_t Sys_Create_Queue(s8* Msg_Queue_Name,size_t Msg_Number)
+{
+    return(Sys_Create_Queue_Inline(Msg_Queue_Name,Msg_Number,0));
+}
+#endif
+/* End Function:Sys_Create_Queue *********************************************/
+
+/* Begin Function:Sys_Create_Queue_Inline *************************************
+Description : Create a queue whose message blocks can hold small messages inside
+              themselves, and return the unique queue ID of it. The messages not 
+              bigger than the inline size are stored in the message block, and
+              only the bigger ones are allocated from the heap.
+Input       : s8* Msg_Queue_Name - The name of the message queue.
+              size_t Msg_Number - The number of messages in the message queue.
+              size_t Inline_Size - The biggest message stored in the message block.
+                                   It will be rounded up to a multiple of 8.
+Output      : None.
+Return      : msgqid_t - The identifier of the message queue. If the function fail,
+                         it will return -1.
+******************************************************************************/
+#if(ENABLE_MSGQ==TRUE)
+msgqid_t Sys_Create_Queue_Inline(s8* Msg_Queue_Name,size_t Msg_Number,size_t Inline_Size)
 {
     msgqid_t Msg_Queue_ID;
     cnt_t Msg_Block_Count;
     struct List_Head* Traverse_Ptr;
     void* Msg_Queue_Start_Addr;
     struct Msg_Block* Msg_Block_Ptr;
+    size_t Msg_Block_Size;
+    
+    /* Each block is followed by its inline message area */
+    Inline_Size=((Inline_Size+7)>>3)<<3;
+    Msg_Block_Size=sizeof(struct Msg_Block)+Inline_Size;
     
     Sys_Lock_Scheduler();
     
@@ -140,7 +193,7 @@ msgqid_t Sys_Create_Queue(s8* Msg_Queue_Name,size_t Msg_Number)
     }
         
     /* The malloc is in the name of the "Init" process */
-    Msg_Queue_Start_Addr=_Sys_Malloc(0,Msg_Number*sizeof(struct Msg_Block));
+    Msg_Queue_Start_Addr=_Sys_Malloc(0,Msg_Number*Msg_Block_Size);
     
     /* If the malloc function failed, return now */
     if(Msg_Queue_Start_Addr==0)
@@ -162,10 +215,18 @@ msgqid_t Sys_Create_Queue(s8* Msg_Queue_Name,size_t Msg_Number)
     Msg_CB[Msg_Queue_ID].Msg_Cur_Number=0;
     Msg_CB[Msg_Queue_ID].Msg_Cur_Use_Number=0;
     Msg_CB[Msg_Queue_ID].Msg_Queue_Start_Addr=(ptr_int_t)Msg_Queue_Start_Addr;
+    Msg_CB[Msg_Queue_ID].Msg_Inline_Size=Inline_Size;
+    Msg_CB[Msg_Queue_ID].Msg_Block_Size=Msg_Block_Size;
+    /* The empty list may still hold the blocks of the queue destroyed before */
+    Sys_Create_List(&(Msg_CB[Msg_Queue_ID].Msg_Block_Empty_Head));
+#if(MSGQ_TYPE_BUCKETS!=0)
+    for(Msg_Block_Count=0;Msg_Block_Count<MAX_PROC_NUM*MSGQ_TYPE_BUCKETS;Msg_Block_Count++)
+        Sys_Create_List(&(Msg_CB[Msg_Queue_ID].Msg_Type_Head[0][Msg_Block_Count]));
+#endif
 
     Msg_Block_Ptr=(struct Msg_Block*)(Msg_Queue_Start_Addr);
     /* Initialize the memory area as the message queue */
-    Sys_Memset((ptr_int_t)Msg_Queue_Start_Addr,0,Msg_Number*sizeof(struct Msg_Block));
+    Sys_Memset((ptr_int_t)Msg_Queue_Start_Addr,0,Msg_Number*Msg_Block_Size);
     
     for(Msg_Block_Count=0;Msg_Block_Count<Msg_Number;Msg_Block_Count++)
     {
@@ -182,7 +243,7 @@ msgqid_t Sys_Create_Queue(s8* Msg_Queue_Name,size_t Msg_Number)
         Msg_Block_Ptr->Msg_Type=0;
         /* Clear the message address */
         Msg_Block_Ptr->Msg_Addr_Ptr=0;
-        Msg_Block_Ptr++;
+        Msg_Block_Ptr=(struct Msg_Block*)(((ptr_int_t)Msg_Block_Ptr)+Msg_Block_Size);
     }
     
     /* Increase the statistical variable */
@@ -192,7 +253,7 @@ msgqid_t Sys_Create_Queue(s8* Msg_Queue_Name,size_t Msg_Number)
     return Msg_Queue_ID;
 }
 #endif
-/* End Function:Sys_Create_Queue *********************************************/
+/* End Function:Sys_Create_Queue_Inline **************************************/
 
 /* Begin Function:Sys_Destroy_Queue *******************************************
 Description : Destroy a message queue given the ID of the queue.
@@ -209,6 +270,9 @@ Return      : retval_t - If successful, it will return 0; else -1.
 retval_t Sys_Destroy_Queue(msgqid_t Msg_Queue_ID)
 {
     struct List_Head* Traverse_Block_Ptr;
+    struct Wait_Object_Struct* Wait_Block_Ptr;
+    cnt_t PID_Count;
+    cnt_t Prio_Count;
     
     /* See if the queue ID is over the boundary */
     if(Msg_Queue_ID>=MAX_MSG_QUEUES)
@@ -239,13 +303,52 @@ retval_t Sys_Destroy_Queue(msgqid_t Msg_Queue_ID)
     /* See if there are still messages in the queue and free the memory each
      * message allocated.
      */
-    Traverse_Block_Ptr=(struct List_Head*)(Msg_CB[Msg_Queue_ID].Msg_Block_Queue_Head.Next);
-    while((ptr_int_t)(Traverse_Block_Ptr)!=(ptr_int_t)(&Msg_CB[Msg_Queue_ID].Msg_Block_Queue_Head))
+    for(PID_Count=0;PID_Count<MAX_PROC_NUM;PID_Count++)
     {
-        _Sys_Mfree(0,(void*)(((struct Msg_Block*)Traverse_Block_Ptr)->Msg_Addr_Ptr));
-        Traverse_Block_Ptr=Traverse_Block_Ptr->Next;
+        for(Prio_Count=0;Prio_Count<MSGQ_PRIO_NUM;Prio_Count++)
+        {
+            Traverse_Block_Ptr=Msg_CB[Msg_Queue_ID].Msg_Recv_Head[PID_Count][Prio_Count].Next;
+            while((ptr_int_t)(Traverse_Block_Ptr)!=(ptr_int_t)(&Msg_CB[Msg_Queue_ID].Msg_Recv_Head[PID_Count][Prio_Count]))
+            {
+                /* The inline messages need not be freed */
+                if(((struct Msg_Block*)Traverse_Block_Ptr)->Msg_Addr_Ptr!=MSG_INLINE_ADDR(Traverse_Block_Ptr))
+                {
+                    _Sys_Mfree(((struct Msg_Block*)Traverse_Block_Ptr)->Msg_Send_PID,
+                               (void*)(((struct Msg_Block*)Traverse_Block_Ptr)->Msg_Addr_Ptr));
+                }
+                Traverse_Block_Ptr=Traverse_Block_Ptr->Next;
+            }
+            
+            /* The list is empty now */
+            Sys_Create_List(&(Msg_CB[Msg_Queue_ID].Msg_Recv_Head[PID_Count][Prio_Count]));
+        }
+        
+        Msg_CB[Msg_Queue_ID].Msg_Prio_Bitmap[PID_Count]=0;
+        Msg_CB[Msg_Queue_ID].Msg_Recv_Number[PID_Count]=0;
+        
+        /* Wake up the process waiting for messages. It will find that the queue is 
+         * gone and return as failed.
+         */
+        while(Msg_CB[Msg_Queue_ID].Wait_Object_Head[PID_Count].Next!=&(Msg_CB[Msg_Queue_ID].Wait_Object_Head[PID_Count]))
+        {
+            Wait_Block_Ptr=(struct Wait_Object_Struct*)(Msg_CB[Msg_Queue_ID].Wait_Object_Head[PID_Count].Next-1);
+            /* Mark that the wait is successful */
+            Wait_Block_Ptr->Succeed_Flag=1;
+            /* Delete the wait block from the message queue wait list */
+            Sys_List_Delete_Node(Wait_Block_Ptr->Object_Head.Prev,Wait_Block_Ptr->Object_Head.Next);
+            /* Try to stop the timer if possible */
+            Sys_Proc_Delay_Cancel(PID_Count);
+            /* Wake the process up */
+            _Sys_Set_Ready(PID_Count);
+        }
     }
     
+    /* Wake up all the processes waiting for spare blocks. They will find that the
+     * queue is gone and return as failed.
+     */
+    while(Msg_CB[Msg_Queue_ID].Alloc_Wait_Head.Next!=&(Msg_CB[Msg_Queue_ID].Alloc_Wait_Head))
+        _Sys_Msg_Wake_Allocer(Msg_Queue_ID);
+    
     /* Free the message block list itself */
     _Sys_Mfree(0,(void*)(Msg_CB[Msg_Queue_ID].Msg_Queue_Start_Addr));
     
@@ -263,6 +366,8 @@ retval_t Sys_Destroy_Queue(msgqid_t Msg_Queue_ID)
     Msg_CB[Msg_Queue_ID].Msg_Cur_Number=0;
     Msg_CB[Msg_Queue_ID].Msg_Cur_Use_Number=0;
     Msg_CB[Msg_Queue_ID].Msg_Queue_Start_Addr=0;
+    Msg_CB[Msg_Queue_ID].Msg_Inline_Size=0;
+    Msg_CB[Msg_Queue_ID].Msg_Block_Size=0;
 
     /* Update the statistical variable */
     Msg_Queue_In_Sys--;
@@ -311,6 +416,325 @@ msgqid_t Sys_Get_Queue_ID(s8* Msg_Queue_Name)
 #endif
 /* End Function:Sys_Get_Queue_ID *********************************************/
 
+/* Begin Function:_Sys_Msg_Ins_Recver ****************************************
+Description : Insert a message block at the tail of the lists of its receiver. The
+              receiver PID, the priority and the type of the block must be filled in
+              before calling this.
+Input       : msgqid_t Msg_Queue_ID - The ID of the message queue.
+              struct Msg_Block* Msg_Block_Ptr - The message block.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MSGQ==TRUE)
+void _Sys_Msg_Ins_Recver(msgqid_t Msg_Queue_ID,struct Msg_Block* Msg_Block_Ptr)
+{
+    pid_t Recver_PID=Msg_Block_Ptr->Msg_Recv_PID;
+    prio_t Msg_Prio=Msg_Block_Ptr->Msg_Prio;
+    
+    Sys_List_Insert_Node(&(Msg_Block_Ptr->Head),
+                         Msg_CB[Msg_Queue_ID].Msg_Recv_Head[Recver_PID][Msg_Prio].Prev,
+                         &(Msg_CB[Msg_Queue_ID].Msg_Recv_Head[Recver_PID][Msg_Prio]));
+    Msg_CB[Msg_Queue_ID].Msg_Prio_Bitmap[Recver_PID]|=((u32)1)<<Msg_Prio;
+#if(MSGQ_TYPE_BUCKETS!=0)
+    Sys_List_Insert_Node(&(Msg_Block_Ptr->Type_Head),
+                         Msg_CB[Msg_Queue_ID].Msg_Type_Head[Recver_PID][Msg_Block_Ptr->Msg_Type&(MSGQ_TYPE_BUCKETS-1)].Prev,
+                         &(Msg_CB[Msg_Queue_ID].Msg_Type_Head[Recver_PID][Msg_Block_Ptr->Msg_Type&(MSGQ_TYPE_BUCKETS-1)]));
+#endif
+    Msg_CB[Msg_Queue_ID].Msg_Recv_Number[Recver_PID]++;
+}
+#endif
+/* End Function:_Sys_Msg_Ins_Recver ******************************************/
+
+/* Begin Function:_Sys_Msg_Del_Recver *****************************************
+Description : Delete a message block from the lists of its receiver.
+Input       : msgqid_t Msg_Queue_ID - The ID of the message queue.
+              struct Msg_Block* Msg_Block_Ptr - The message block.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MSGQ==TRUE)
+void _Sys_Msg_Del_Recver(msgqid_t Msg_Queue_ID,struct Msg_Block* Msg_Block_Ptr)
+{
+    pid_t Recver_PID=Msg_Block_Ptr->Msg_Recv_PID;
+    prio_t Msg_Prio=Msg_Block_Ptr->Msg_Prio;
+    
+    Sys_List_Delete_Node(Msg_Block_Ptr->Head.Prev,Msg_Block_Ptr->Head.Next);
+    /* If this is the last message of the priority, clear the bit */
+    if(Msg_CB[Msg_Queue_ID].Msg_Recv_Head[Recver_PID][Msg_Prio].Next==&(Msg_CB[Msg_Queue_ID].Msg_Recv_Head[Recver_PID][Msg_Prio]))
+        Msg_CB[Msg_Queue_ID].Msg_Prio_Bitmap[Recver_PID]&=~(((u32)1)<<Msg_Prio);
+#if(MSGQ_TYPE_BUCKETS!=0)
+    Sys_List_Delete_Node(Msg_Block_Ptr->Type_Head.Prev,Msg_Block_Ptr->Type_Head.Next);
+#endif
+    Msg_CB[Msg_Queue_ID].Msg_Recv_Number[Recver_PID]--;
+}
+#endif
+/* End Function:_Sys_Msg_Del_Recver ******************************************/
+
+/* Begin Function:_Sys_Msg_Find ***********************************************
+Description : Find the message to a receiver in a message queue that should be
+              received first, that is, the oldest one of the highest priority. 
+              Only the messages to the receiver(and of the type bucket, if there 
+              are buckets) are looked at. The validity of the input is not checked.
+Input       : msgqid_t Msg_Queue_ID - The ID of the message queue.
+              pid_t Recver_PID - The receiver's PID.
+              msgtyp_t Msg_Type - The message type, or "ALL_TYPE_MSG".
+Output      : None.
+Return      : struct Msg_Block* - The message block. If there is none, 0.
+******************************************************************************/
+#if(ENABLE_MSGQ==TRUE)
+struct Msg_Block* _Sys_Msg_Find(msgqid_t Msg_Queue_ID,pid_t Recver_PID,msgtyp_t Msg_Type)
+{
+    struct List_Head* Traverse_List_Ptr;
+    struct List_Head* List_Head_Ptr;
+    prio_t Msg_Prio;
+#if(MSGQ_TYPE_BUCKETS!=0)
+    struct Msg_Block* Msg_Block_Ptr;
+#endif
+    
+    if(Msg_CB[Msg_Queue_ID].Msg_Recv_Number[Recver_PID]==0)
+        return 0;
+    
+    /* Any type will do, so the first one of the highest priority is what we need */
+    Msg_Prio=Sys_Calc_MSB_Pos(Msg_CB[Msg_Queue_ID].Msg_Prio_Bitmap[Recver_PID]);
+    if(Msg_Type==ALL_TYPE_MSG)
+        return (struct Msg_Block*)(Msg_CB[Msg_Queue_ID].Msg_Recv_Head[Recver_PID][Msg_Prio].Next);
+    
+#if(MSGQ_TYPE_BUCKETS!=0)
+    /* The bucket is in the order of sending. Find the first one of the highest priority */
+    Msg_Block_Ptr=0;
+    List_Head_Ptr=&(Msg_CB[Msg_Queue_ID].Msg_Type_Head[Recver_PID][Msg_Type&(MSGQ_TYPE_BUCKETS-1)]);
+    Traverse_List_Ptr=List_Head_Ptr->Next;
+    while(Traverse_List_Ptr!=List_Head_Ptr)
+    {
+        if(((struct Msg_Block*)(Traverse_List_Ptr-1))->Msg_Type==Msg_Type)
+        {
+            if((Msg_Block_Ptr==0)||(((struct Msg_Block*)(Traverse_List_Ptr-1))->Msg_Prio>Msg_Block_Ptr->Msg_Prio))
+                Msg_Block_Ptr=(struct Msg_Block*)(Traverse_List_Ptr-1);
+        }
+        
+        Traverse_List_Ptr=Traverse_List_Ptr->Next;
+    }
+    
+    return Msg_Block_Ptr;
+#else
+    /* Look at the priorities from the highest one */
+    for(;Msg_Prio>=0;Msg_Prio--)
+    {
+        List_Head_Ptr=&(Msg_CB[Msg_Queue_ID].Msg_Recv_Head[Recver_PID][Msg_Prio]);
+        Traverse_List_Ptr=List_Head_Ptr->Next;
+        while(Traverse_List_Ptr!=List_Head_Ptr)
+        {
+            if(((struct Msg_Block*)Traverse_List_Ptr)->Msg_Type==Msg_Type)
+                return (struct Msg_Block*)Traverse_List_Ptr;
+            
+            Traverse_List_Ptr=Traverse_List_Ptr->Next;
+        }
+    }
+    
+    return 0;
+#endif
+}
+#endif
+/* End Function:_Sys_Msg_Find ************************************************/
+
+/* Begin Function:_Sys_Msg_Count **********************************************
+Description : Count the messages of a certain type to a receiver in a message queue.
+              The validity of the input is not checked.
+Input       : msgqid_t Msg_Queue_ID - The ID of the message queue.
+              pid_t Recver_PID - The receiver's PID.
+              msgtyp_t Msg_Type - The message type, or "ALL_TYPE_MSG".
+Output      : None.
+Return      : size_t - The number of messages.
+******************************************************************************/
+#if(ENABLE_MSGQ==TRUE)
+size_t _Sys_Msg_Count(msgqid_t Msg_Queue_ID,pid_t Recver_PID,msgtyp_t Msg_Type)
+{
+    struct List_Head* Traverse_List_Ptr;
+    struct List_Head* List_Head_Ptr;
+    size_t Msg_Count;
+#if(MSGQ_TYPE_BUCKETS==0)
+    prio_t Msg_Prio;
+#endif
+    
+    if((Msg_Type==ALL_TYPE_MSG)||(Msg_CB[Msg_Queue_ID].Msg_Recv_Number[Recver_PID]==0))
+        return Msg_CB[Msg_Queue_ID].Msg_Recv_Number[Recver_PID];
+    
+    Msg_Count=0;
+#if(MSGQ_TYPE_BUCKETS!=0)
+    List_Head_Ptr=&(Msg_CB[Msg_Queue_ID].Msg_Type_Head[Recver_PID][Msg_Type&(MSGQ_TYPE_BUCKETS-1)]);
+    Traverse_List_Ptr=List_Head_Ptr->Next;
+    while(Traverse_List_Ptr!=List_Head_Ptr)
+    {
+        if(((struct Msg_Block*)(Traverse_List_Ptr-1))->Msg_Type==Msg_Type)
+            Msg_Count++;
+        
+        Traverse_List_Ptr=Traverse_List_Ptr->Next;
+    }
+#else
+    for(Msg_Prio=0;Msg_Prio<MSGQ_PRIO_NUM;Msg_Prio++)
+    {
+        List_Head_Ptr=&(Msg_CB[Msg_Queue_ID].Msg_Recv_Head[Recver_PID][Msg_Prio]);
+        Traverse_List_Ptr=List_Head_Ptr->Next;
+        while(Traverse_List_Ptr!=List_Head_Ptr)
+        {
+            if(((struct Msg_Block*)Traverse_List_Ptr)->Msg_Type==Msg_Type)
+                Msg_Count++;
+            
+            Traverse_List_Ptr=Traverse_List_Ptr->Next;
+        }
+    }
+#endif
+
+    return Msg_Count;
+}
+#endif
+/* End Function:_Sys_Msg_Count ***********************************************/
+
+/* Begin Function:_Sys_Msg_Enqueue *******************************************
+Description : Put an allocated message block into the message queue, to a certain
+              receiver. If the receiver is waiting for it in "Sys_Recv_Msg_Wait", the
+              block is handed to the receiver instead. The queue, the receiver and 
+              the priority are not checked here.
+              This should be called with the scheduler locked.
+Input       : pid_t Recver_PID - The receiver's PID.
+              msgqid_t Msg_Queue_ID - The ID of the message queue.
+              msgqbid_t Msg_Block_ID - The ID of the message block.
+              prio_t Msg_Prio - The priority of the message.
+Output      : None.
+Return      : retval_t - If the block cannot be sent, -1; else 0.
+******************************************************************************/
+#if(ENABLE_MSGQ==TRUE)
+retval_t _Sys_Msg_Enqueue(pid_t Recver_PID,msgqid_t Msg_Queue_ID,msgqbid_t Msg_Block_ID,prio_t Msg_Prio)
+{
+    struct Msg_Block* Msg_Block_Ptr;
+    
+    /* See if the message block is over the boundary */
+    if((Msg_Block_ID<0)||(Msg_Block_ID>=Msg_CB[Msg_Queue_ID].Msg_Max_Number))
+        return -1;
+    
+    Msg_Block_Ptr=MSG_BLOCK_PTR(Msg_Queue_ID,Msg_Block_ID);
+    /* See if the message block is already initialized (ready to send) */
+    if((Msg_Block_Ptr->Msg_Addr_Ptr==0)||(Msg_Block_Ptr->Msg_Block_List_ID!=MSG_BLOCK_NO_LIST))
+        return -1;
+    
+    /* Now the block is ready to send, send it. */
+    /* Remember that we have detached the block from the empty-message-block-list,
+     * there's no need to detach it again. We just fill in the information.
+     */
+    Msg_Block_Ptr->Msg_Recv_PID=Recver_PID;
+    Msg_Block_Ptr->Msg_Prio=Msg_Prio;
+    
+    /* If the receiver is blocked in "Sys_Recv_Msg_Wait" for such a message, hand the 
+     * block to it directly. The block is still being used and never enters the queue.
+     */
+    if((Msg_Recv_Wait_CB[Recver_PID].Msg_Queue_ID==Msg_Queue_ID)&&
+       (Msg_Recv_Wait_CB[Recver_PID].Msg_Block_ID==-1)&&
+       ((Msg_Recv_Wait_CB[Recver_PID].Msg_Type==ALL_TYPE_MSG)||
+        (Msg_Recv_Wait_CB[Recver_PID].Msg_Type==Msg_Block_Ptr->Msg_Type)))
+    {
+        Msg_Recv_Wait_CB[Recver_PID].Msg_Block_ID=Msg_Block_ID;
+        return 0;
+    }
+    
+    Msg_Block_Ptr->Msg_Block_List_ID=MSG_BLOCK_IN_QUEUE;
+    _Sys_Msg_Ins_Recver(Msg_Queue_ID,Msg_Block_Ptr);
+    
+    Msg_CB[Msg_Queue_ID].Msg_Cur_Use_Number--;
+    Msg_CB[Msg_Queue_ID].Msg_Cur_Number++;
+    
+    return 0;
+}
+#endif
+/* End Function:_Sys_Msg_Enqueue *********************************************/
+
+/* Begin Function:_Sys_Msg_Dequeue *******************************************
+Description : Take a message block out of the message queue. This should be called
+              with the scheduler locked.
+Input       : msgqid_t Msg_Queue_ID - The ID of the message queue.
+              struct Msg_Block* Msg_Block_Ptr - The message block in the queue.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MSGQ==TRUE)
+void _Sys_Msg_Dequeue(msgqid_t Msg_Queue_ID,struct Msg_Block* Msg_Block_Ptr)
+{
+    /* Delete the message block from the message lists */
+    _Sys_Msg_Del_Recver(Msg_Queue_ID,Msg_Block_Ptr);
+    /* Refresh the list ID(flag) */
+    Msg_Block_Ptr->Msg_Block_List_ID=MSG_BLOCK_NO_LIST;
+    /* Refresh the corresponding statistic variables */
+    Msg_CB[Msg_Queue_ID].Msg_Cur_Use_Number++;
+    Msg_CB[Msg_Queue_ID].Msg_Cur_Number--;
+}
+#endif
+/* End Function:_Sys_Msg_Dequeue *********************************************/
+
+/* Begin Function:_Sys_Msg_Wake_Recver ****************************************
+Description : Wake up the receiver if it is waiting for the message queue. If it is
+              receiving with "Sys_Recv_Msg_Wait", it is woken up only when a message
+              is handed to it. This should be called with the scheduler locked.
+Input       : pid_t Recver_PID - The receiver's PID.
+              msgqid_t Msg_Queue_ID - The ID of the message queue.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MSGQ==TRUE)
+void _Sys_Msg_Wake_Recver(pid_t Recver_PID,msgqid_t Msg_Queue_ID)
+{
+    struct Wait_Object_Struct* Wait_Block_Ptr;
+    
+    /* The other messages can't satisfy a process that is receiving directly */
+    if((Msg_Recv_Wait_CB[Recver_PID].Msg_Queue_ID==Msg_Queue_ID)&&
+       (Msg_Recv_Wait_CB[Recver_PID].Msg_Block_ID==-1))
+        return;
+    
+    /* There will be only one process for the PID */
+    if(Msg_CB[Msg_Queue_ID].Wait_Object_Head[Recver_PID].Next==&(Msg_CB[Msg_Queue_ID].Wait_Object_Head[Recver_PID]))
+        return;
+    
+    Wait_Block_Ptr=(struct Wait_Object_Struct*)(Msg_CB[Msg_Queue_ID].Wait_Object_Head[Recver_PID].Next-1);
+    /* Mark that the wait is successful */
+    Wait_Block_Ptr->Succeed_Flag=1;
+    /* Delete the wait block from the message queue wait list */
+    Sys_List_Delete_Node(Wait_Block_Ptr->Object_Head.Prev,Wait_Block_Ptr->Object_Head.Next);
+    /* Try to stop the timer if possible */
+    Sys_Proc_Delay_Cancel(Recver_PID);
+    /* Wake the process up */
+    _Sys_Set_Ready(Recver_PID);
+}
+#endif
+/* End Function:_Sys_Msg_Wake_Recver *****************************************/
+
+/* Begin Function:_Sys_Msg_Wake_Allocer ***************************************
+Description : Wake up the process of the highest priority that is waiting for a
+              spare message block of the queue. Only one process is woken up for
+              each block. This should be called with the scheduler locked.
+Input       : msgqid_t Msg_Queue_ID - The ID of the message queue.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MSGQ==TRUE)
+void _Sys_Msg_Wake_Allocer(msgqid_t Msg_Queue_ID)
+{
+    struct Wait_Object_Struct* Wait_Block_Ptr;
+    
+    if(Msg_CB[Msg_Queue_ID].Alloc_Wait_Head.Next==&(Msg_CB[Msg_Queue_ID].Alloc_Wait_Head))
+        return;
+    
+    /* The list is in the order of priority, so the first one is what we need */
+    Wait_Block_Ptr=(struct Wait_Object_Struct*)(Msg_CB[Msg_Queue_ID].Alloc_Wait_Head.Next-1);
+    /* Mark that the wait is successful */
+    Wait_Block_Ptr->Succeed_Flag=1;
+    /* Delete the wait block from the allocation wait list */
+    Sys_List_Delete_Node(Wait_Block_Ptr->Object_Head.Prev,Wait_Block_Ptr->Object_Head.Next);
+    /* Try to stop the timer if possible */
+    Sys_Proc_Delay_Cancel(Wait_Block_Ptr->PID);
+    /* Wake the process up */
+    _Sys_Set_Ready(Wait_Block_Ptr->PID);
+}
+#endif
+/* End Function:_Sys_Msg_Wake_Allocer ****************************************/
+
 /* Begin Function:Sys_Alloc_Msg ***********************************************
 Description : Allocate space for the message and prepare to send it. The sender's
               PID is automatically the "Current_PID".
@@ -336,7 +760,9 @@ Input       : pid_t Sender_PID - The PID of the message sender.
               msgqid_t Msg_Queue_ID - The identifier of the message queue.
               msgtyp_t Msg_Type - The type of the message. In fact it is an 32-bit
                              unsigned number.
-              size_t Msg_Size - The name of the message queue.
+              size_t Msg_Size - The size of the message. If it is not bigger than the
+                                inline size of the queue, the message is stored in
+                                the message block and no memory is allocated.
 Output      : void** Msg_Buffer_Ptr - The pointer to the message buffer.
 Return      : msgqbid_t - The identifier of the message block. We use this Msg_Block_ID
                           to specify the message. Should the function fail, it will
@@ -376,20 +802,28 @@ msgqbid_t _Sys_Alloc_Msg(pid_t Sender_PID,msgqid_t Msg_Queue_ID,
         return -1;
     }
     
-    /* See if we can allocate enough memory for the message */
-    Msg_Malloc_Ptr=_Sys_Malloc(Sender_PID,Msg_Size);
-    /* Cannot allocate memory, return now */
-    if(Msg_Malloc_Ptr==0)
+    Msg_Block_Ptr=(struct Msg_Block*)(Msg_CB[Msg_Queue_ID].Msg_Block_Empty_Head.Next);
+    
+    /* If the message fits in the block, store it there. If not, see if we can allocate 
+     * enough memory for the message.
+     */
+    if(Msg_Size<=Msg_CB[Msg_Queue_ID].Msg_Inline_Size)
+        Msg_Malloc_Ptr=(void*)MSG_INLINE_ADDR(Msg_Block_Ptr);
+    else
     {
-        Sys_Unlock_Scheduler();
-        Sys_Set_Errno(ENOMSG);
-        return -1;
+        Msg_Malloc_Ptr=_Sys_Malloc_Caller(Sender_PID,Msg_Size,MEM_TRACE_CALLER_ADDR());
+        /* Cannot allocate memory, return now */
+        if(Msg_Malloc_Ptr==0)
+        {
+            Sys_Unlock_Scheduler();
+            Sys_Set_Errno(ENOMSG);
+            return -1;
+        }
     }
     
     *Msg_Buffer_Ptr=Msg_Malloc_Ptr;
-    /* Now we're sure that there are spare blocks and we have allocated the space */
+    /* Now we're sure that there are spare blocks and we have got the space */
     /* Detach an spare block from the block list */
-    Msg_Block_Ptr=(struct Msg_Block*)(Msg_CB[Msg_Queue_ID].Msg_Block_Empty_Head.Next);
     Sys_List_Delete_Node(Msg_CB[Msg_Queue_ID].Msg_Block_Empty_Head.Next->Prev,
                          Msg_CB[Msg_Queue_ID].Msg_Block_Empty_Head.Next->Next);
     
@@ -398,6 +832,8 @@ msgqbid_t _Sys_Alloc_Msg(pid_t Sender_PID,msgqid_t Msg_Queue_ID,
     Msg_Block_Ptr->Msg_Type=Msg_Type;
     Msg_Block_Ptr->Msg_Addr_Ptr=(ptr_int_t)Msg_Malloc_Ptr;
     Msg_Block_Ptr->Msg_Send_PID=Sender_PID;
+    /* Nobody has received it yet */
+    Msg_Block_Ptr->Msg_Recv_PID=-1;
     
     /* Fill the statistical data */
     Msg_CB[Msg_Queue_ID].Msg_Cur_Use_Number++;
@@ -408,9 +844,88 @@ msgqbid_t _Sys_Alloc_Msg(pid_t Sender_PID,msgqid_t Msg_Queue_ID,
 #endif
 /* End Function:_Sys_Alloc_Msg ***********************************************/
 
+/* Begin Function:Sys_Alloc_Msg_Wait ******************************************
+Description : Allocate space for the message, and if all the message blocks are
+              used up, wait until one is destroyed or the time is up. This keeps 
+              a fast sender from running ahead of a slow receiver. The sender's 
+              PID is automatically the "Current_PID".
+Input       : msgqid_t Msg_Queue_ID - The identifier of the message queue.
+              msgtyp_t Msg_Type - The type of the message.
+              size_t Msg_Size - The size of the message.
+              time_t Time - The longest time to wait. If the time is "WAIT_INFINITE",
+                            then the process will wait until it gets a block.
+Output      : void** Msg_Buffer_Ptr - The pointer to the message buffer.
+Return      : msgqbid_t - The identifier of the message block. If no block can be
+                          allocated before the time is up, or the allocation fails
+                          for other reasons, it will return -1.
+******************************************************************************/
+#if(ENABLE_MSGQ==TRUE)
+msgqbid_t Sys_Alloc_Msg_Wait(msgqid_t Msg_Queue_ID,msgtyp_t Msg_Type,size_t Msg_Size,
+                             void** Msg_Buffer_Ptr,time_t Time)
+{
+    msgqbid_t Msg_Block_ID;
+    time_t Start_Time;
+    time_t Passed_Time;
+    time_t Wait_Time;
+    
+    Start_Time=System_Status.Time.OS_Total_Ticks.Low_Bits;
+    
+    while(1)
+    {
+        Sys_Lock_Scheduler();
+        
+        Msg_Block_ID=_Sys_Alloc_Msg(Current_PID,Msg_Queue_ID,Msg_Type,Msg_Size,Msg_Buffer_Ptr);
+        if(Msg_Block_ID!=-1)
+            break;
+        
+        /* If there are spare blocks, the failure is not about them. Waiting won't help */
+        if((Msg_Queue_ID>=MAX_MSG_QUEUES)||
+           (Msg_CB[Msg_Queue_ID].Msg_Block_Empty_Head.Next!=&(Msg_CB[Msg_Queue_ID].Msg_Block_Empty_Head)))
+        {
+            Sys_Unlock_Scheduler();
+            return -1;
+        }
+        
+        Sys_Unlock_Scheduler();
+        
+        /* See how much time is left */
+        if(Time!=WAIT_INFINITE)
+        {
+            Passed_Time=System_Status.Time.OS_Total_Ticks.Low_Bits-Start_Time;
+            if(Passed_Time>=Time)
+                return -1;
+            
+            Wait_Time=Time-Passed_Time;
+        }
+        else
+            Wait_Time=WAIT_INFINITE;
+        
+        /* Wait for a spare block. Being woken up does not guarantee that the block is 
+         * still there when we get to run, so we try again. If the wait failed, we try
+         * for the last time.
+         */
+        if(Sys_Wait_Object(Msg_Queue_ID,MSGBLOCK,Wait_Time)==-1)
+        {
+            Sys_Lock_Scheduler();
+            Msg_Block_ID=_Sys_Alloc_Msg(Current_PID,Msg_Queue_ID,Msg_Type,Msg_Size,Msg_Buffer_Ptr);
+            break;
+        }
+    }
+    
+    /* If there are still spare blocks, the next waiter can have one too */
+    if((Msg_Block_ID!=-1)&&
+       (Msg_CB[Msg_Queue_ID].Msg_Block_Empty_Head.Next!=&(Msg_CB[Msg_Queue_ID].Msg_Block_Empty_Head)))
+        _Sys_Msg_Wake_Allocer(Msg_Queue_ID);
+    
+    Sys_Unlock_Scheduler();
+    return Msg_Block_ID;
+}
+#endif
+/* End Function:Sys_Alloc_Msg_Wait *******************************************/
+
 /* Begin Function:Sys_Send_Msg ************************************************
-Description : Send the message to a certain destination. The sender ID is already
-              specified when allocating the message area.
+Description : Send the message to a certain destination, with the lowest priority. 
+              The sender ID is already specified when allocating the message area.
 Input       : pid_t Recver_PID - The receiver's PID. 
               msgqid_t Msg_Queue_ID - The ID of the message queue.
               msgqbid_t Msg_Block_ID - The ID of the specific message block.
@@ -420,12 +935,28 @@ Return      : retval_t - If the function fails,-1; else 0.
 #if(ENABLE_MSGQ==TRUE)
 retval_t Sys_Send_Msg(pid_t Recver_PID,msgqid_t Msg_Queue_ID,msgqbid_t Msg_Block_ID)
 {
-    struct Msg_Block* Msg_Block_Ptr;
-    struct List_Head* Traverse_List_Ptr;
-    pid_t Wait_PID;
-    
-    /* See if the queue ID is over the boundary */
-    if(Msg_Queue_ID>=MAX_MSG_QUEUES)
+    return(Sys_Send_Msg_Prio(Recver_PID,Msg_Queue_ID,Msg_Block_ID,MSG_PRIO_LOWEST));
+}
+#endif
+/* End Function:Sys_Send_Msg *************************************************/
+
+/* Begin Function:Sys_Send_Msg_Prio *******************************************
+Description : Send the message to a certain destination with a certain priority. 
+              The receiver gets the messages of higher priorities first, and the 
+              messages of the same priority in the order of sending.
+Input       : pid_t Recver_PID - The receiver's PID. 
+              msgqid_t Msg_Queue_ID - The ID of the message queue.
+              msgqbid_t Msg_Block_ID - The ID of the specific message block.
+              prio_t Msg_Prio - The priority, from "MSG_PRIO_LOWEST" to "MSG_PRIO_URGENT".
+Output      : None.
+Return      : retval_t - If the function fails,-1; else 0.
+******************************************************************************/
+#if(ENABLE_MSGQ==TRUE)
+retval_t Sys_Send_Msg_Prio(pid_t Recver_PID,msgqid_t Msg_Queue_ID,msgqbid_t Msg_Block_ID,prio_t Msg_Prio)
+{
+    /* See if the queue ID, the receiver or the priority is over the boundary */
+    if((Msg_Queue_ID>=MAX_MSG_QUEUES)||(Recver_PID<0)||(Recver_PID>=MAX_PROC_NUM)||
+       (Msg_Prio<MSG_PRIO_LOWEST)||(Msg_Prio>MSG_PRIO_URGENT))
     {
         Sys_Set_Errno(ENOMSGBLK);
         return -1;
@@ -441,66 +972,82 @@ retval_t Sys_Send_Msg(pid_t Recver_PID,msgqid_t Msg_Queue_ID,msgqbid_t Msg_Block
         return -1;
     }
     
-    /* See if the message block is over the boundary */
-    if(Msg_Block_ID>=Msg_CB[Msg_Queue_ID].Msg_Max_Number)
+    /* Put the message into the queue */
+    if(_Sys_Msg_Enqueue(Recver_PID,Msg_Queue_ID,Msg_Block_ID,Msg_Prio)!=0)
     {
         Sys_Unlock_Scheduler();
         Sys_Set_Errno(ENOMSGBLK);
         return -1;
     }
     
-    Msg_Block_Ptr=&(((struct Msg_Block*)Msg_CB[Msg_Queue_ID].Msg_Queue_Start_Addr)[Msg_Block_ID]);
-    /* See if the message block is already initialized (ready to send) */
-    if(Msg_Block_Ptr->Msg_Addr_Ptr==0)
-    {
-        Sys_Unlock_Scheduler();
-        Sys_Set_Errno(ENOMSGBLK);
-        return -1;
-    }
+    /* Now see if the receiver is waiting for it */
+    _Sys_Msg_Wake_Recver(Recver_PID,Msg_Queue_ID);
     
-    /* Now the block is ready to send, send it. */
-    /* Remember that we have detached the block from the empty-message-block-list,
-     * there's no need to detach it again. We just fill in the information.
-     */
-    Msg_Block_Ptr->Msg_Block_List_ID=MSG_BLOCK_IN_QUEUE;
-    Msg_Block_Ptr->Msg_Recv_PID=Recver_PID;
-    Sys_List_Insert_Node(&(Msg_Block_Ptr->Head),
-                         &(Msg_CB[Msg_Queue_ID].Msg_Block_Queue_Head),
-                         Msg_CB[Msg_Queue_ID].Msg_Block_Queue_Head.Next);
+    Sys_Unlock_Scheduler();
+    return 0;
+}
+#endif
+/* End Function:Sys_Send_Msg_Prio ********************************************/
+
+/* Begin Function:Sys_Send_Msg_Batch ******************************************
+Description : Send a batch of messages to a certain destination. All the messages
+              are sent with the scheduler locked only once, and the receiver is
+              woken up only once. The sending stops at the first block that cannot
+              be sent.
+Input       : pid_t Recver_PID - The receiver's PID. 
+              msgqid_t Msg_Queue_ID - The ID of the message queue.
+              msgqbid_t* Msg_Block_ID - The IDs of the message blocks.
+              cnt_t Msg_Number - The number of message blocks.
+              prio_t Msg_Prio - The priority of all the messages.
+Output      : None.
+Return      : cnt_t - The number of messages sent. If the queue or the receiver 
+                      does not exist, -1.
+******************************************************************************/
+#if(ENABLE_MSGQ==TRUE)
+cnt_t Sys_Send_Msg_Batch(pid_t Recver_PID,msgqid_t Msg_Queue_ID,msgqbid_t* Msg_Block_ID,cnt_t Msg_Number,
+                         prio_t Msg_Prio)
+{
+    cnt_t Msg_Count;
     
-    Msg_CB[Msg_Queue_ID].Msg_Cur_Use_Number--;
-    Msg_CB[Msg_Queue_ID].Msg_Cur_Number++;
+    /* See if the queue ID, the receiver or the priority is over the boundary */
+    if((Msg_Queue_ID>=MAX_MSG_QUEUES)||(Recver_PID<0)||(Recver_PID>=MAX_PROC_NUM)||
+       (Msg_Prio<MSG_PRIO_LOWEST)||(Msg_Prio>MSG_PRIO_URGENT))
+    {
+        Sys_Set_Errno(ENOMSGBLK);
+        return -1;
+    }  
     
-    /* Now see if there is any process need notifying */
-    Traverse_List_Ptr=Msg_CB[Msg_Queue_ID].Wait_Object_Head.Next;
-    while(Traverse_List_Ptr!=&Msg_CB[Msg_Queue_ID].Wait_Object_Head)
+    Sys_Lock_Scheduler();
+    
+    /* See if the queue is existent in the system */
+    if(Msg_CB[Msg_Queue_ID].Msg_Max_Number==0)
     {
-        if(Recver_PID==((struct Wait_Object_Struct*)(Traverse_List_Ptr-1))->PID)
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(ENOMSGBLK);
+        return -1;
+    }
+    
+    for(Msg_Count=0;Msg_Count<Msg_Number;Msg_Count++)
+    {
+        if(_Sys_Msg_Enqueue(Recver_PID,Msg_Queue_ID,Msg_Block_ID[Msg_Count],Msg_Prio)!=0)
         {
-            /* Get the correct PID */
-            Wait_PID=((struct Wait_Object_Struct*)(Msg_CB[Msg_Queue_ID].Wait_Object_Head.Next-1))->PID;
-            /* Mark that the wait is successful */
-            ((struct Wait_Object_Struct*)(Msg_CB[Msg_Queue_ID].Wait_Object_Head.Next-1))->Succeed_Flag=1;
-            /* Delete the wait block from the semaphore wait list */
-            Sys_List_Delete_Node(&Msg_CB[Msg_Queue_ID].Wait_Object_Head,Msg_CB[Msg_Queue_ID].Wait_Object_Head.Next->Next);
-            /* Try to stop the timer if possible */
-            Sys_Proc_Delay_Cancel(Wait_PID);
-            /* Wake the process up */
-            _Sys_Set_Ready(Wait_PID);
-            
-            /* Since there will be only one process for the PID */
+            Sys_Set_Errno(ENOMSGBLK);
             break;
         }
     }
     
+    /* Now see if the receiver is waiting for them */
+    if(Msg_Count!=0)
+        _Sys_Msg_Wake_Recver(Recver_PID,Msg_Queue_ID);
+    
     Sys_Unlock_Scheduler();
-    return 0;
+    return Msg_Count;
 }
 #endif
-/* End Function:Sys_Send_Msg *************************************************/
+/* End Function:Sys_Send_Msg_Batch *******************************************/
 
 /* Begin Function:Sys_Recv_Msg ************************************************
-Description : Receive the first message we occur with. The receiver's ID is 
+Description : Receive the oldest message of the highest priority. The receiver's ID is 
               automatically the "Current_PID".
 Input       : msgqid_t Msg_Queue_ID - The identifier of the message queue.
               msgtyp_t Msg_Type - The type of the message.
@@ -518,7 +1065,7 @@ msgqbid_t Sys_Recv_Msg(msgqid_t Msg_Queue_ID,msgtyp_t Msg_Type,void** Msg_Buffer
 /* End Function:Sys_Recv_Msg *************************************************/
 
 /* Begin Function:_Sys_Recv_Msg ***********************************************
-Description : Receive the first message we occur with. The receiver's ID can be
+Description : Receive the oldest message of the highest priority. The receiver's ID can be
               specified, so that we can read the message in the name of others.
               If the queue exists, return the identifier. The receiver 
 Input       : pid_t Recver_PID - The receiver's PID.
@@ -533,10 +1080,10 @@ Return      : msgqbid_t - The identifier of the message block. When we finish "r
 #if(ENABLE_MSGQ==TRUE)
 msgqbid_t _Sys_Recv_Msg(pid_t Recver_PID,msgqid_t Msg_Queue_ID,msgtyp_t Msg_Type,void** Msg_Buffer_Ptr)
 {
-    struct List_Head* Traverse_List_Ptr;
+    struct Msg_Block* Msg_Block_Ptr;
     
-    /* See if the queue ID is over the boundary */
-    if(Msg_Queue_ID>=MAX_MSG_QUEUES)
+    /* See if the queue ID or the receiver is over the boundary */
+    if((Msg_Queue_ID>=MAX_MSG_QUEUES)||(Recver_PID<0)||(Recver_PID>=MAX_PROC_NUM))
     {
         Sys_Set_Errno(ENOMSGBLK);
         return (-1);
@@ -552,67 +1099,190 @@ msgqbid_t _Sys_Recv_Msg(pid_t Recver_PID,msgqid_t Msg_Queue_ID,msgtyp_t Msg_Type
         return (-1);
     }
     
-    /* See if there are any message in the queue */
-    if(Msg_CB[Msg_Queue_ID].Msg_Cur_Number==0)
+    /* See if any message is available. Only the messages to the receiver are looked at */
+    Msg_Block_Ptr=_Sys_Msg_Find(Msg_Queue_ID,Recver_PID,Msg_Type);
+    if(Msg_Block_Ptr==0)
     {
         Sys_Unlock_Scheduler();
         Sys_Set_Errno(ENOMSGBLK);
         return (-1);
     }
     
-    /* See if any message is available */
-    Traverse_List_Ptr=Msg_CB[Msg_Queue_ID].Msg_Block_Queue_Head.Next;
-    while((ptr_int_t)(Traverse_List_Ptr)!=(ptr_int_t)(&(Msg_CB[Msg_Queue_ID].Msg_Block_Queue_Head)))
+    /* Take the message out of the queue */
+    _Sys_Msg_Dequeue(Msg_Queue_ID,Msg_Block_Ptr);
+    /* Output the buffer address */
+    *Msg_Buffer_Ptr=(void*)(Msg_Block_Ptr->Msg_Addr_Ptr);
+    
+    Sys_Unlock_Scheduler();
+    return(Msg_Block_Ptr->Msg_Block_ID);
+}
+#endif
+/* End Function:_Sys_Recv_Msg ************************************************/
+
+/* Begin Function:Sys_Recv_Msg_Wait *******************************************
+Description : Receive the oldest message of the highest priority, and if there is
+              none, wait until one comes or the time is up. While we are waiting, 
+              the sender hands the message to us directly, so no other receiver
+              can take it before we run. The receiver's PID is automatically the
+              "Current_PID".
+Input       : msgqid_t Msg_Queue_ID - The identifier of the message queue.
+              msgtyp_t Msg_Type - The message type. If it equals "ALL_TYPE_MSG"(0xFFFFFFFF)
+                                  then all kinds of message will be received.
+              time_t Time - The longest time to wait. If the time is "WAIT_INFINITE",
+                            then the process will wait until it gets a message.
+Output      : void** Msg_Buffer_Ptr - The pointer to the message buffer.
+Return      : msgqbid_t - The identifier of the message block. If no message comes
+                          before the time is up, it will return -1.
+******************************************************************************/
+#if(ENABLE_MSGQ==TRUE)
+msgqbid_t Sys_Recv_Msg_Wait(msgqid_t Msg_Queue_ID,msgtyp_t Msg_Type,void** Msg_Buffer_Ptr,time_t Time)
+{
+    msgqbid_t Msg_Block_ID;
+    cnt_t Retval;
+    time_t Start_Time;
+    time_t Passed_Time;
+    time_t Wait_Time;
+    
+    Start_Time=System_Status.Time.OS_Total_Ticks.Low_Bits;
+    
+    Sys_Lock_Scheduler();
+    
+    /* See if there is such a message already. If the queue does not exist, return too */
+    Msg_Block_ID=_Sys_Recv_Msg(Current_PID,Msg_Queue_ID,Msg_Type,Msg_Buffer_Ptr);
+    if((Msg_Block_ID!=-1)||(Msg_Queue_ID>=MAX_MSG_QUEUES)||(Msg_CB[Msg_Queue_ID].Msg_Max_Number==0))
+    {
+        Sys_Unlock_Scheduler();
+        return Msg_Block_ID;
+    }
+    
+    /* Register ourself so that the senders will hand the message to us */
+    Msg_Recv_Wait_CB[Current_PID].Msg_Queue_ID=Msg_Queue_ID;
+    Msg_Recv_Wait_CB[Current_PID].Msg_Type=Msg_Type;
+    Msg_Recv_Wait_CB[Current_PID].Msg_Block_ID=-1;
+    
+    Sys_Unlock_Scheduler();
+    
+    while(1)
     {
-        if((((struct Msg_Block*)Traverse_List_Ptr)->Msg_Recv_PID)==Recver_PID)
+        /* See how much time is left */
+        if(Time!=WAIT_INFINITE)
         {
-            if(Msg_Type!=ALL_TYPE_MSG)
-            {
-                /* If the process only want to get some kind of message */
-                if((((struct Msg_Block*)Traverse_List_Ptr)->Msg_Type)==Msg_Type)
-                {
-                    /* Delete the message block from the message list */
-                    Sys_List_Delete_Node(Traverse_List_Ptr->Prev,Traverse_List_Ptr->Next);
-                    /* Refresh the list ID(flag) */
-                    ((struct Msg_Block*)Traverse_List_Ptr)->Msg_Block_List_ID=MSG_BLOCK_NO_LIST;
-                    /* Refresh the corresponding statistic variables */
-                    Msg_CB[Msg_Queue_ID].Msg_Cur_Use_Number++;
-                    Msg_CB[Msg_Queue_ID].Msg_Cur_Number--;
-                    /* Output the buffer address */
-                    *Msg_Buffer_Ptr=(void*)(((struct Msg_Block*)Traverse_List_Ptr)->Msg_Addr_Ptr);
-                    
-                    Sys_Unlock_Scheduler();
-                    return(((struct Msg_Block*)Traverse_List_Ptr)->Msg_Block_ID);
-                }
-            }
-            /* If the process want to get all kinds of messages */
-            else
-            {
-                /* Delete the message block from the message list */
-                Sys_List_Delete_Node(Traverse_List_Ptr->Prev,Traverse_List_Ptr->Next);
-                /* Refresh the corresponding statistic variables */
-                Msg_CB[Msg_Queue_ID].Msg_Cur_Use_Number++;
-                Msg_CB[Msg_Queue_ID].Msg_Cur_Number--;
-                /* Output the buffer address */
-                *Msg_Buffer_Ptr=(void*)(((struct Msg_Block*)Traverse_List_Ptr)->Msg_Addr_Ptr);
-                
-                Sys_Unlock_Scheduler();
-                return(((struct Msg_Block*)Traverse_List_Ptr)->Msg_Block_ID);
-            }
+            Passed_Time=System_Status.Time.OS_Total_Ticks.Low_Bits-Start_Time;
+            if(Passed_Time>=Time)
+                break;
+            
+            Wait_Time=Time-Passed_Time;
         }
+        else
+            Wait_Time=WAIT_INFINITE;
         
-        Traverse_List_Ptr=Traverse_List_Ptr->Next;
+        Retval=Sys_Wait_Object(Msg_Queue_ID,MSGQUEUE,Wait_Time);
+        
+        /* If we got the message, or the queue is gone, stop waiting */
+        if((Msg_Recv_Wait_CB[Current_PID].Msg_Block_ID!=-1)||(Msg_CB[Msg_Queue_ID].Msg_Max_Number==0))
+            break;
+        
+        /* The wait is over time, or there is no wait block */
+        if(Retval==-1)
+            break;
     }
     
-    /* It shouldn't get here; Add a assert. Remember that we have assured that the 
-     * number of messages in the queue is bigger than 0.
-     */
+    Sys_Lock_Scheduler();
+    
+    /* The message may still come before we unregister */
+    Msg_Block_ID=Msg_Recv_Wait_CB[Current_PID].Msg_Block_ID;
+    Msg_Recv_Wait_CB[Current_PID].Msg_Queue_ID=-1;
+    Msg_Recv_Wait_CB[Current_PID].Msg_Block_ID=-1;
+    
+    if(Msg_Block_ID!=-1)
+        *Msg_Buffer_Ptr=(void*)(MSG_BLOCK_PTR(Msg_Queue_ID,Msg_Block_ID)->Msg_Addr_Ptr);
+    else
+        Sys_Set_Errno(ENOMSGBLK);
+    
     Sys_Unlock_Scheduler();
-    Sys_Set_Errno(ENOMSGBLK);
-    return (-1);
+    return Msg_Block_ID;
 }
 #endif
-/* End Function:_Sys_Recv_Msg ************************************************/
+/* End Function:Sys_Recv_Msg_Wait ********************************************/
+
+/* Begin Function:Sys_Recv_Msg_Batch ******************************************
+Description : Receive a batch of messages with the scheduler locked only once. The
+              receiver's ID is automatically the "Current_PID".
+Input       : msgqid_t Msg_Queue_ID - The identifier of the message queue.
+              msgtyp_t Msg_Type - The type of the message.
+              cnt_t Msg_Number - The most messages to receive.
+Output      : msgqbid_t* Msg_Block_ID - The identifiers of the message blocks received.
+              void** Msg_Buffer_Ptr - The pointers to the message buffers.
+Return      : cnt_t - The number of messages received. If the queue does not exist,
+                      -1.
+******************************************************************************/
+#if(ENABLE_MSGQ==TRUE)
+cnt_t Sys_Recv_Msg_Batch(msgqid_t Msg_Queue_ID,msgtyp_t Msg_Type,msgqbid_t* Msg_Block_ID,
+                         void** Msg_Buffer_Ptr,cnt_t Msg_Number)
+{
+    return(_Sys_Recv_Msg_Batch(Current_PID,Msg_Queue_ID,Msg_Type,Msg_Block_ID,Msg_Buffer_Ptr,Msg_Number));
+}
+#endif
+/* End Function:Sys_Recv_Msg_Batch *******************************************/
+
+/* Begin Function:_Sys_Recv_Msg_Batch *****************************************
+Description : Receive a batch of messages with the scheduler locked only once. The 
+              receiver's ID can be specified, so that we can read the messages in 
+              the name of others.
+Input       : pid_t Recver_PID - The receiver's PID.
+              msgqid_t Msg_Queue_ID - The identifier of the message queue.
+              msgtyp_t Msg_Type - The message type. If it equals "ALL_TYPE_MSG"(0xFFFFFFFF)
+                                  then all kinds of message will be received.
+              cnt_t Msg_Number - The most messages to receive.
+Output      : msgqbid_t* Msg_Block_ID - The identifiers of the message blocks received.
+              void** Msg_Buffer_Ptr - The pointers to the message buffers.
+Return      : cnt_t - The number of messages received. If the queue does not exist,
+                      -1.
+******************************************************************************/
+#if(ENABLE_MSGQ==TRUE)
+cnt_t _Sys_Recv_Msg_Batch(pid_t Recver_PID,msgqid_t Msg_Queue_ID,msgtyp_t Msg_Type,
+                          msgqbid_t* Msg_Block_ID,void** Msg_Buffer_Ptr,cnt_t Msg_Number)
+{
+    struct Msg_Block* Msg_Block_Ptr;
+    cnt_t Msg_Count;
+    
+    /* See if the queue ID or the receiver is over the boundary */
+    if((Msg_Queue_ID>=MAX_MSG_QUEUES)||(Recver_PID<0)||(Recver_PID>=MAX_PROC_NUM))
+    {
+        Sys_Set_Errno(ENOMSGBLK);
+        return (-1);
+    }
+    
+    Sys_Lock_Scheduler();
+    
+    /* See if the queue is existent in the system */
+    if(Msg_CB[Msg_Queue_ID].Msg_Max_Number==0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(ENOMSGBLK);
+        return (-1);
+    }
+    
+    for(Msg_Count=0;Msg_Count<Msg_Number;Msg_Count++)
+    {
+        Msg_Block_Ptr=_Sys_Msg_Find(Msg_Queue_ID,Recver_PID,Msg_Type);
+        if(Msg_Block_Ptr==0)
+            break;
+        
+        /* Take the message out of the queue and output it */
+        _Sys_Msg_Dequeue(Msg_Queue_ID,Msg_Block_Ptr);
+        Msg_Block_ID[Msg_Count]=Msg_Block_Ptr->Msg_Block_ID;
+        Msg_Buffer_Ptr[Msg_Count]=(void*)(Msg_Block_Ptr->Msg_Addr_Ptr);
+    }
+    
+    if(Msg_Count==0)
+        Sys_Set_Errno(ENOMSGBLK);
+    
+    Sys_Unlock_Scheduler();
+    return Msg_Count;
+}
+#endif
+/* End Function:_Sys_Recv_Msg_Batch ******************************************/
 
 /* Begin Function:Sys_Destroy_Msg *********************************************
 Description : Destroy a message block, given the message queue ID and the message
@@ -655,7 +1325,7 @@ retval_t Sys_Destroy_Msg(msgqid_t Msg_Queue_ID,msgqbid_t Msg_Block_ID)
     /* See if the message block is already out of list - only under such condition
      * can we destroy it.
      */
-    Msg_Block_Ptr=&(((struct Msg_Block*)Msg_CB[Msg_Queue_ID].Msg_Queue_Start_Addr)[Msg_Block_ID]);
+    Msg_Block_Ptr=MSG_BLOCK_PTR(Msg_Queue_ID,Msg_Block_ID);
     if(Msg_Block_Ptr->Msg_Block_List_ID!=MSG_BLOCK_NO_LIST)
     {
         Sys_Unlock_Scheduler();
@@ -663,11 +1333,35 @@ retval_t Sys_Destroy_Msg(msgqid_t Msg_Queue_ID,msgqbid_t Msg_Block_ID)
         return -1;
     }
     
-    /* Destroy it and return the message block to the empty list */
-    _Sys_Mfree(Msg_Block_Ptr->Msg_Send_PID,(void*)(Msg_Block_Ptr->Msg_Addr_Ptr));
+    /* Destroy it and return the message block to the empty list. The inline messages 
+     * need not be freed.
+     */
+    if(Msg_Block_Ptr->Msg_Addr_Ptr!=MSG_INLINE_ADDR(Msg_Block_Ptr))
+        _Sys_Mfree_Caller(Msg_Block_Ptr->Msg_Send_PID,(void*)(Msg_Block_Ptr->Msg_Addr_Ptr),
+                          MEM_TRACE_CALLER_ADDR());
+    
+    _Sys_Msg_Put_Block(Msg_Queue_ID,Msg_Block_Ptr);
     
+    Sys_Unlock_Scheduler();
+    return 0;
+}
+#endif
+/* End Function:Sys_Destroy_Msg **********************************************/
+
+/* Begin Function:_Sys_Msg_Put_Block ******************************************
+Description : Return a message block being used to the empty list. The message
+              itself is not freed here. This should be called with the scheduler
+              locked.
+Input       : msgqid_t Msg_Queue_ID - The ID of the message queue.
+              struct Msg_Block* Msg_Block_Ptr - The message block.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MSGQ==TRUE)
+void _Sys_Msg_Put_Block(msgqid_t Msg_Queue_ID,struct Msg_Block* Msg_Block_Ptr)
+{
     /* Mark it as in empty list and insert it into the empty list */
-    Msg_Block_Ptr[Msg_Block_ID].Msg_Block_List_ID=MSG_BLOCK_IN_EMPTY;
+    Msg_Block_Ptr->Msg_Block_List_ID=MSG_BLOCK_IN_EMPTY;
     Sys_List_Insert_Node(&(Msg_Block_Ptr->Head),
                          &(Msg_CB[Msg_Queue_ID].Msg_Block_Empty_Head),
                          Msg_CB[Msg_Queue_ID].Msg_Block_Empty_Head.Next);
@@ -681,11 +1375,128 @@ retval_t Sys_Destroy_Msg(msgqid_t Msg_Queue_ID,msgqbid_t Msg_Block_ID)
     /* Clear the statistical variables */
     Msg_CB[Msg_Queue_ID].Msg_Cur_Use_Number--;
     
+    /* Someone may be waiting for the block */
+    _Sys_Msg_Wake_Allocer(Msg_Queue_ID);
+}
+#endif
+/* End Function:_Sys_Msg_Put_Block *******************************************/
+
+/* Begin Function:Sys_Forward_Msg *********************************************
+Description : Forward a received message to another receiver, possibly on another
+              queue, without copying or allocating it again. The message keeps its
+              type and priority, and the forwarding process("Current_PID") becomes
+              the sender and owns the message from now on. If the two queues are 
+              the same, the block itself is sent again; if not, the message is moved
+              to a spare block of the destination queue, and the source block is 
+              returned. An inline message is moved by copying the inline area, so
+              the inline size of the destination queue must not be smaller. Only
+              the receiver of the message can forward it.
+Input       : msgqid_t Src_Queue_ID - The queue that the message is received from.
+              msgqbid_t Src_Block_ID - The message block received.
+              msgqid_t Dst_Queue_ID - The queue to forward the message to.
+              pid_t Recver_PID - The new receiver.
+Output      : None.
+Return      : msgqbid_t - The message block in the destination queue. If the function
+                          fails, -1, and the message is still in the source block.
+******************************************************************************/
+#if(ENABLE_MSGQ==TRUE)
+msgqbid_t Sys_Forward_Msg(msgqid_t Src_Queue_ID,msgqbid_t Src_Block_ID,
+                          msgqid_t Dst_Queue_ID,pid_t Recver_PID)
+{
+    struct Msg_Block* Src_Block_Ptr;
+    struct Msg_Block* Dst_Block_Ptr;
+    
+    /* See if the queue IDs or the receiver is over the boundary */
+    if((Src_Queue_ID>=MAX_MSG_QUEUES)||(Dst_Queue_ID>=MAX_MSG_QUEUES)||
+       (Recver_PID<0)||(Recver_PID>=MAX_PROC_NUM))
+    {
+        Sys_Set_Errno(ENOMSGBLK);
+        return -1;
+    }
+    
+    Sys_Lock_Scheduler();
+    
+    /* See if the queues are existent in the system, and the block is received */
+    if((Msg_CB[Src_Queue_ID].Msg_Max_Number==0)||(Msg_CB[Dst_Queue_ID].Msg_Max_Number==0)||
+       (Src_Block_ID<0)||(Src_Block_ID>=Msg_CB[Src_Queue_ID].Msg_Max_Number))
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(ENOMSGBLK);
+        return -1;
+    }
+    
+    Src_Block_Ptr=MSG_BLOCK_PTR(Src_Queue_ID,Src_Block_ID);
+    /* Only the receiver of the message can forward it */
+    if((Src_Block_Ptr->Msg_Block_List_ID!=MSG_BLOCK_NO_LIST)||(Src_Block_Ptr->Msg_Addr_Ptr==0)||
+       (Src_Block_Ptr->Msg_Recv_PID!=Current_PID))
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(ENOMSGBLK);
+        return -1;
+    }
+    
+    if(Src_Queue_ID==Dst_Queue_ID)
+        Dst_Block_Ptr=Src_Block_Ptr;
+    else
+    {
+        /* See if the destination queue can hold it */
+        if(((ptr_int_t)(&(Msg_CB[Dst_Queue_ID].Msg_Block_Empty_Head))==
+            (ptr_int_t)(Msg_CB[Dst_Queue_ID].Msg_Block_Empty_Head.Next))||
+           ((Src_Block_Ptr->Msg_Addr_Ptr==MSG_INLINE_ADDR(Src_Block_Ptr))&&
+            (Msg_CB[Dst_Queue_ID].Msg_Inline_Size<Msg_CB[Src_Queue_ID].Msg_Inline_Size)))
+        {
+            Sys_Unlock_Scheduler();
+            Sys_Set_Errno(ENOMSG);
+            return -1;
+        }
+        
+        Dst_Block_Ptr=(struct Msg_Block*)(Msg_CB[Dst_Queue_ID].Msg_Block_Empty_Head.Next);
+    }
+    
+    /* The message out of the block is now owned by us */
+    if((Src_Block_Ptr->Msg_Addr_Ptr!=MSG_INLINE_ADDR(Src_Block_Ptr))&&
+       (Src_Block_Ptr->Msg_Send_PID!=Current_PID))
+    {
+        if(_Sys_Mem_Transfer(Src_Block_Ptr->Msg_Send_PID,(void*)(Src_Block_Ptr->Msg_Addr_Ptr),Current_PID)!=0)
+        {
+            Sys_Unlock_Scheduler();
+            Sys_Set_Errno(ENOMSG);
+            return -1;
+        }
+    }
+    
+    /* Move the message to the destination block */
+    if(Dst_Block_Ptr!=Src_Block_Ptr)
+    {
+        Sys_List_Delete_Node(Dst_Block_Ptr->Head.Prev,Dst_Block_Ptr->Head.Next);
+        Dst_Block_Ptr->Msg_Block_List_ID=MSG_BLOCK_NO_LIST;
+        Dst_Block_Ptr->Msg_Type=Src_Block_Ptr->Msg_Type;
+        Msg_CB[Dst_Queue_ID].Msg_Cur_Use_Number++;
+        
+        if(Src_Block_Ptr->Msg_Addr_Ptr==MSG_INLINE_ADDR(Src_Block_Ptr))
+        {
+            Sys_Memcpy(MSG_INLINE_ADDR(Dst_Block_Ptr),MSG_INLINE_ADDR(Src_Block_Ptr),
+                       Msg_CB[Src_Queue_ID].Msg_Inline_Size);
+            Dst_Block_Ptr->Msg_Addr_Ptr=MSG_INLINE_ADDR(Dst_Block_Ptr);
+        }
+        else
+            Dst_Block_Ptr->Msg_Addr_Ptr=Src_Block_Ptr->Msg_Addr_Ptr;
+        
+        Dst_Block_Ptr->Msg_Prio=Src_Block_Ptr->Msg_Prio;
+        _Sys_Msg_Put_Block(Src_Queue_ID,Src_Block_Ptr);
+    }
+    
+    Dst_Block_Ptr->Msg_Send_PID=Current_PID;
+    
+    /* Send it. This can't fail because the block is just prepared */
+    _Sys_Msg_Enqueue(Recver_PID,Dst_Queue_ID,Dst_Block_Ptr->Msg_Block_ID,Dst_Block_Ptr->Msg_Prio);
+    _Sys_Msg_Wake_Recver(Recver_PID,Dst_Queue_ID);
+    
     Sys_Unlock_Scheduler();
-    return 0;
+    return(Dst_Block_Ptr->Msg_Block_ID);
 }
 #endif
-/* End Function:Sys_Destroy_Msg **********************************************/
+/* End Function:Sys_Forward_Msg **********************************************/
 
 /* Begin Function:Sys_Query_Msg_To_Recver *************************************
 Description : Query the number of messages to a certain receiver.
@@ -698,15 +1509,15 @@ Return      : size_t - If the message queue does not exist, it will also return
 #if(ENABLE_MSGQ==TRUE)
 size_t Sys_Query_Msg_To_Recver(pid_t PID,msgqid_t Msg_Queue_ID,msgtyp_t Msg_Type)
 {
-    struct List_Head* Traverse_Block_List_Ptr;
     size_t Msg_Count;
+    pid_t PID_Count;
     
      /* See if the queue ID is over the boundary */
     if(Msg_Queue_ID>=MAX_MSG_QUEUES)
         return 0;
     
     /* See if the PID is over the boundary */
-    if(PID>MAX_PROC_NUM)
+    if((PID<0)||(PID>MAX_PROC_NUM))
         return 0;
     
     Sys_Lock_Scheduler();
@@ -718,57 +1529,22 @@ size_t Sys_Query_Msg_To_Recver(pid_t PID,msgqid_t Msg_Queue_ID,msgtyp_t Msg_Type
         return 0;
     }
     
-    /* See if the queue is empty */
-    if(Msg_CB[Msg_Queue_ID].Msg_Cur_Number==0)
-    {
-        Sys_Unlock_Scheduler();
-        return 0;
-    }
-    
-    /* Now traverse the list and see if there are any message of the
-     * corresponding type to the desired receiver.
+    /* Count the messages of the corresponding type to the desired receiver. 
+     * The number of all messages to a receiver is already there.
      */
-    Traverse_Block_List_Ptr=Msg_CB[Msg_Queue_ID].Msg_Block_Queue_Head.Next;
-    Msg_Count=0;
     if(PID==ALL_PROC_MSG)
     {
         if(Msg_Type==ALL_TYPE_MSG)
-        {
-            Sys_Unlock_Scheduler();
-            return(Msg_CB[Msg_Queue_ID].Msg_Cur_Number);
-        }
+            Msg_Count=Msg_CB[Msg_Queue_ID].Msg_Cur_Number;
         else
         {
-            while((ptr_int_t)Traverse_Block_List_Ptr!=(ptr_int_t)&(Msg_CB[Msg_Queue_ID].Msg_Block_Queue_Head))
-            {
-                if(((struct Msg_Block*)Traverse_Block_List_Ptr)->Msg_Type==Msg_Type)
-                    Msg_Count++;
-                Traverse_Block_List_Ptr=Traverse_Block_List_Ptr->Next;
-            }
+            Msg_Count=0;
+            for(PID_Count=0;PID_Count<MAX_PROC_NUM;PID_Count++)
+                Msg_Count+=_Sys_Msg_Count(Msg_Queue_ID,PID_Count,Msg_Type);
         }
     }
     else
-    {
-        if(Msg_Type==ALL_TYPE_MSG)
-        {
-            while((ptr_int_t)Traverse_Block_List_Ptr!=(ptr_int_t)&(Msg_CB[Msg_Queue_ID].Msg_Block_Queue_Head))
-            {
-                if(((struct Msg_Block*)Traverse_Block_List_Ptr)->Msg_Recv_PID==PID)
-                    Msg_Count++;
-                Traverse_Block_List_Ptr=Traverse_Block_List_Ptr->Next;
-            }
-        }
-        else
-        {
-            while((ptr_int_t)Traverse_Block_List_Ptr!=(ptr_int_t)&(Msg_CB[Msg_Queue_ID].Msg_Block_Queue_Head))
-            {
-                if((((struct Msg_Block*)Traverse_Block_List_Ptr)->Msg_Type==Msg_Type)&&
-                   (((struct Msg_Block*)Traverse_Block_List_Ptr)->Msg_Recv_PID==PID))
-                    Msg_Count++;
-                Traverse_Block_List_Ptr=Traverse_Block_List_Ptr->Next;
-            }
-        }
-    }
+        Msg_Count=_Sys_Msg_Count(Msg_Queue_ID,PID,Msg_Type);
     
     Sys_Unlock_Scheduler();
     return Msg_Count;
@@ -825,8 +1601,6 @@ Return      : retval_t - If successful,0; if there's no need to wait, "NO_NEED_T
 retval_t _Sys_Wait_Msg_Queue_Reg(pid_t PID,msgqid_t Msg_Queue_ID,
                                  struct Wait_Object_Struct* Wait_Block_Ptr)
 {
-    struct List_Head* Traverse_List_Ptr;
-    
     Sys_Lock_Scheduler();
     
     /* See if the operation is over the boundary */
@@ -843,28 +1617,30 @@ retval_t _Sys_Wait_Msg_Queue_Reg(pid_t PID,msgqid_t Msg_Queue_ID,
         return(WAIT_FAILURE);
     }
     
-    /* See if there is a message for the process. If yes, return right away. */
-    Traverse_List_Ptr=Msg_CB[Msg_Queue_ID].Msg_Block_Queue_Head.Next;
-
-    while((ptr_int_t)Traverse_List_Ptr!=(ptr_int_t)&(Msg_CB[Msg_Queue_ID].Msg_Block_Queue_Head))
+    /* See if there is a message for the process. If yes, return right away. If the
+     * process is receiving with "Sys_Recv_Msg_Wait", only the message handed to it counts.
+     */
+    if(Msg_Recv_Wait_CB[PID].Msg_Queue_ID==Msg_Queue_ID)
     {
-        if(((struct Msg_Block*)Traverse_List_Ptr)->Msg_Recv_PID==PID)
+        if(Msg_Recv_Wait_CB[PID].Msg_Block_ID!=-1)
         {
             Sys_Unlock_Scheduler();
             return(NO_NEED_TO_WAIT);
         }
-        
-        Traverse_List_Ptr=Traverse_List_Ptr->Next;
     }
-
+    else if(Msg_CB[Msg_Queue_ID].Msg_Recv_Number[PID]!=0)
+    {
+        Sys_Unlock_Scheduler();
+        return(NO_NEED_TO_WAIT);
+    }
     
     /* Now it is clear that we did not get any message from the message queue. 
      * We would have to wait for the message to come(or the wait expires).
-     * Now register the wait block under the correspoding message queue.
+     * Now register the wait block under the receiver in the message queue.
      */
     Sys_List_Insert_Node(&(Wait_Block_Ptr->Object_Head),
-                         &Msg_CB[Msg_Queue_ID].Wait_Object_Head,
-                         Msg_CB[Msg_Queue_ID].Wait_Object_Head.Next);
+                         &Msg_CB[Msg_Queue_ID].Wait_Object_Head[PID],
+                         Msg_CB[Msg_Queue_ID].Wait_Object_Head[PID].Next);
     
     Wait_Block_Ptr->Obj_ID=Msg_Queue_ID;
     Wait_Block_Ptr->PID=PID;
@@ -873,7 +1649,72 @@ retval_t _Sys_Wait_Msg_Queue_Reg(pid_t PID,msgqid_t Msg_Queue_ID,
     Sys_Unlock_Scheduler();
     return 0;
 }
-/* Begin Function:_Sys_Wait_Sem_Reg ******************************************/
+/* End Function:_Sys_Wait_Msg_Queue_Reg **************************************/
+
+/* Begin Function:_Sys_Wait_Msg_Block_Reg *************************************
+Description : When we decide to wait for a spare message block, this function will
+              be called. The wait blocks are kept in the descending order of the 
+              process priorities. Take note that when the wait is successful, the
+              block is not allocated for the process, and you need to allocate it
+              by yourself.
+Input       : pid_t PID - The process waiting for the block. We don't check whether the PID is
+                          valid here.
+              msgqid_t Msg_Queue_ID - The ID of the message queue(not the message!).
+              struct Wait_Object_Struct* Wait_Block_Ptr - The pointer to the wait block.
+Output      : None.
+Return      : retval_t - If successful,0; if there's no need to wait, "NO_NEED_TO_WAIT(-2)";
+                         if the wait failed, "WAIT_FAILURE(-1)".
+******************************************************************************/
+retval_t _Sys_Wait_Msg_Block_Reg(pid_t PID,msgqid_t Msg_Queue_ID,
+                                 struct Wait_Object_Struct* Wait_Block_Ptr)
+{
+    struct List_Head* Traverse_List_Ptr;
+    
+    Sys_Lock_Scheduler();
+    
+    /* See if the operation is over the boundary */
+    if(Msg_Queue_ID>=MAX_MSG_QUEUES)
+    {
+        Sys_Unlock_Scheduler();
+        return(WAIT_FAILURE);
+    }
+    
+    /* See if the queue is existent in the system */
+    if(Msg_CB[Msg_Queue_ID].Msg_Max_Number==0)
+    {
+        Sys_Unlock_Scheduler();
+        return(WAIT_FAILURE);
+    }
+    
+    /* See if there is a spare block. If yes, return right away. */
+    if(Msg_CB[Msg_Queue_ID].Msg_Block_Empty_Head.Next!=&(Msg_CB[Msg_Queue_ID].Msg_Block_Empty_Head))
+    {
+        Sys_Unlock_Scheduler();
+        return(NO_NEED_TO_WAIT);
+    }
+    
+    /* Find the first waiter of a lower priority, and insert before it. Waiters of
+     * the same priority are thus served first come first served.
+     */
+    Traverse_List_Ptr=Msg_CB[Msg_Queue_ID].Alloc_Wait_Head.Next;
+    while(Traverse_List_Ptr!=&(Msg_CB[Msg_Queue_ID].Alloc_Wait_Head))
+    {
+        if(PCB[((struct Wait_Object_Struct*)(Traverse_List_Ptr-1))->PID].Status.Priority<PCB[PID].Status.Priority)
+            break;
+        
+        Traverse_List_Ptr=Traverse_List_Ptr->Next;
+    }
+    
+    Sys_List_Insert_Node(&(Wait_Block_Ptr->Object_Head),Traverse_List_Ptr->Prev,Traverse_List_Ptr);
+    
+    Wait_Block_Ptr->Obj_ID=Msg_Queue_ID;
+    Wait_Block_Ptr->PID=PID;
+    Wait_Block_Ptr->Type=MSGBLOCK;
+    
+    Sys_Unlock_Scheduler();
+    return 0;
+}
+/* End Function:_Sys_Wait_Msg_Block_Reg **************************************/
 
 /* End Of File ***************************************************************/
 
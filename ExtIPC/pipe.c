@@ -2,16 +2,32 @@
 Filename    : pipe.c
 Author      : pry
 Date        : 25/04/2012
-Version     : 0.12
+Version     : 0.13
 Description : The pipe module for the OS. The pipe is for light-weight IPC and
               is a named one. Different from the other IPCs, the pipe can support
               reciprocal read and write, making it ideal for large data transfer.
               However, the pipe can only support information exchange between two 
               processes. Usually, one process create the (named) pipe and open one
-              port of it, while another process open the other port. As the pipe 
-              itself does not provide any means of synchronization, we can use the
-              signal system to synchronize between the two processes.
-              You cannot wait for a pipe.
+              port of it, while another process open the other port.
+              The pipe is a ring buffer. "Sys_Pipe_Write" puts data at its head and
+              "Sys_Pipe_Read" takes data from its tail; both of them can transfer
+              only a part of the data, and can block until the trigger level of the
+              pipe is reached. The pipe can be waited for with "PIPEREAD" and
+              "PIPEWRITE".
+              For the bulk transfers, the data can also be filled or used in place
+              with the reserve/commit and peek/release functions, which return the
+              spans of the pipe buffer and copy nothing.
+              In "PIPE_MODE_ISR", the writer is an interrupt handler that calls
+              "Sys_Pipe_Write_ISR". It takes no lock and masks no interrupt; the
+              head is only changed by the writer and the tail only by the reader,
+              and the memory barriers order the data against the cursors. The
+              reader is woken up later, when the kernel runs next time.
+              In the broadcast modes, the pipe has one writer and many readers, and
+              each reader has its own read cursor. When the slowest reader is behind,
+              either the writer waits, or the oldest data is dropped for the reader.
+              The raw buffer returned by "Sys_Open_Pipe" is still there for the old
+              users, who synchronize by themselves, for example with the signal
+              system. Do not mix the raw buffer with the ring buffer functions.
 ******************************************************************************/
 
 /* Includes ******************************************************************/
@@ -23,6 +39,7 @@ Description : The pipe module for the OS. The pipe is for light-weight IPC and
 #include "Kernel\scheduler.h"
 #include "Kernel\error.h"
 #include "Memmgr\memory.h"
+#include "ExtIPC\wait.h"
 #include "ExtIPC\pipe.h"
 #undef __HDR_DEFS__
 
@@ -31,6 +48,7 @@ Description : The pipe module for the OS. The pipe is for light-weight IPC and
 #include "Syslib\syslib.h"
 #include "Kernel\scheduler.h"
 #include "Memmgr\memory.h"
+#include "ExtIPC\wait.h"
 #include "ExtIPC\pipe.h"
 #undef __HDR_STRUCTS__
 
@@ -44,7 +62,9 @@ Description : The pipe module for the OS. The pipe is for light-weight IPC and
 #include "Kernel\error.h"
 #include "Syslib\syslib.h"
 #include "Memmgr\memory.h"
+#include "ExtIPC\wait.h"
 #include "ExtIPC\pipe.h"
+#include "Syssvc\timer.h"
 #undef __HDR_PUBLIC_MEMBERS__
 /* End Includes **************************************************************/
 
@@ -72,12 +92,14 @@ void _Sys_Pipe_Init(void)
         Pipe_CB[Pipe_Cnt].Opener_PID[1]=PIPECLOSE;
         
         Pipe_CB[Pipe_Cnt].Pipe_ID=Pipe_Cnt;
+        Sys_Create_List(&(Pipe_CB[Pipe_Cnt].Wait_Object_Head));
         /* Put all of them in the empty list */
         Sys_List_Insert_Node(&(Pipe_CB[Pipe_Cnt].Head),&Pipe_Empty_List_Head,Pipe_Empty_List_Head.Next);
     }
     
     /* Clear the statistical variable */
     Pipe_In_Sys=0;
+    Pipe_ISR_Wake_Pend=0;
 #endif    
 }
 /* End Function:_Sys_Pipe_Init **********************************************/
@@ -133,9 +155,9 @@ pipeid_t Sys_Create_Pipe(s8* Pipe_Name,size_t Pipe_Buffer_Size)
     }
 
     /* See if we can allocate any memory from the system. The memory allocation is
-     * done in the name of "Init".
+     * done in the name of "Init". The ring buffer needs one more byte.
      */
-    Buffer_Ptr=_Sys_Malloc(0,Pipe_Buffer_Size);
+    Buffer_Ptr=_Sys_Malloc(0,Pipe_Buffer_Size+1);
     
     /* Allocation failed */
     if(Buffer_Ptr==0)
@@ -153,6 +175,19 @@ pipeid_t Sys_Create_Pipe(s8* Pipe_Name,size_t Pipe_Buffer_Size)
     Pipe_CB[Pipe_ID].Pipe_Name=Pipe_Name;
     Pipe_CB[Pipe_ID].Pipe_Buffer_Size=Pipe_Buffer_Size;
     Pipe_CB[Pipe_ID].Pipe_Buffer_Addr=(ptr_int_t)Buffer_Ptr;
+    /* The pipe is empty, and any byte will wake the blocked side up */
+    Pipe_CB[Pipe_ID].Pipe_Head=0;
+    Pipe_CB[Pipe_ID].Pipe_Tail=0;
+    Pipe_CB[Pipe_ID].Read_Trigger=1;
+    Pipe_CB[Pipe_ID].Write_Trigger=1;
+    Pipe_CB[Pipe_ID].Write_Reserved=0;
+    Pipe_CB[Pipe_ID].Write_Reserver=PIPECLOSE;
+    Pipe_CB[Pipe_ID].Read_Peeked=0;
+    Pipe_CB[Pipe_ID].Read_Peeker=PIPECLOSE;
+    Pipe_CB[Pipe_ID].Pipe_Mode=PIPE_MODE_NORMAL;
+    Pipe_CB[Pipe_ID].ISR_Wake_Pend=0;
+    Pipe_CB[Pipe_ID].Peer_Closed=0;
+    Pipe_CB[Pipe_ID].Reader_Number=0;
     
     /* Update the statistical variable */
     Pipe_In_Sys++;
@@ -190,19 +225,28 @@ retval_t Sys_Destroy_Pipe(pipeid_t Pipe_ID)
         return (-1);
     }
     
-    /* If either side of the pipe is opened, abort */
+    /* If either side of the pipe is opened, or there are readers, abort */
     if((Pipe_CB[Pipe_ID].Opener_PID[0]!=PIPECLOSE)||
-       (Pipe_CB[Pipe_ID].Opener_PID[1]!=PIPECLOSE))
+       (Pipe_CB[Pipe_ID].Opener_PID[1]!=PIPECLOSE)||
+       (Pipe_CB[Pipe_ID].Reader_Number!=0))
     {
         Sys_Unlock_Scheduler();
         Sys_Set_Errno(EPIPEINUSE);
         return (-1);
     }
     
+    /* If anyone is still waiting for the pipe, let it know that the pipe is gone */
+    _Sys_Pipe_Wake_All(Pipe_ID);
+    
     /* Now we can safely destroy the pipe */
     Sys_List_Delete_Node(Pipe_CB[Pipe_ID].Head.Prev,Pipe_CB[Pipe_ID].Head.Next);
     Sys_List_Insert_Node(&(Pipe_CB[Pipe_ID].Head),&Pipe_Empty_List_Head,Pipe_Empty_List_Head.Next);
     
+    /* Stop the interrupt handler from writing before the buffer is freed */
+    Pipe_CB[Pipe_ID].Pipe_Mode=PIPE_MODE_NORMAL;
+    Pipe_CB[Pipe_ID].ISR_Wake_Pend=0;
+    Pipe_CB[Pipe_ID].Peer_Closed=0;
+    
     /* Free buffer memory */
     _Sys_Mfree(0,(void*)(Pipe_CB[Pipe_ID].Pipe_Buffer_Addr));
     
@@ -301,6 +345,50 @@ retval_t _Sys_Open_Pipe(pid_t Opener_PID,pipeid_t Pipe_ID,size_t* Buffer_Size,vo
         return (-1);
     }
     
+    /* In the broadcast modes, every opener other than the writer is a reader. It
+     * only reads the data written after it opens the pipe */
+    if(PIPE_BCAST(Pipe_ID)!=0)
+    {
+        if((Opener_PID<0)||(Opener_PID>=MAX_PROC_NUM)||(PIPE_OPENED_BY(Pipe_ID,Opener_PID)!=0))
+        {
+            Sys_Unlock_Scheduler();
+            Sys_Set_Errno(EINVPIPE);
+            return (-1);
+        }
+        
+        /* If the writer has closed the pipe, this opener takes its place */
+        if(Pipe_CB[Pipe_ID].Opener_PID[0]==PIPECLOSE)
+        {
+            Pipe_CB[Pipe_ID].Opener_PID[0]=Opener_PID;
+            Pipe_CB[Pipe_ID].Peer_Closed=0;
+            
+            if(Buffer_Size!=0)
+                *Buffer_Size=Pipe_CB[Pipe_ID].Pipe_Buffer_Size;
+            *Pipe_Buffer_Ptr=(void*)(Pipe_CB[Pipe_ID].Pipe_Buffer_Addr);
+            
+            Sys_Unlock_Scheduler();
+            return(0);
+        }
+        
+        /* It has nothing to read. The tail of the pipe is synced in case the
+         * writer wrote past it when there were no readers */
+        Pipe_CB[Pipe_ID].Reader[Opener_PID].Open_Flag=1;
+        Pipe_CB[Pipe_ID].Reader[Opener_PID].Tail=Pipe_CB[Pipe_ID].Pipe_Head;
+        Pipe_CB[Pipe_ID].Reader[Opener_PID].Drop_Number=0;
+        Pipe_CB[Pipe_ID].Reader_Number++;
+        
+        _Sys_Pipe_Bcast_Sync(Pipe_ID);
+        if(PIPE_FREE_SIZE(Pipe_ID)>=Pipe_CB[Pipe_ID].Write_Trigger)
+            _Sys_Pipe_Wake(Pipe_ID,PIPEWRITE);
+        
+        if(Buffer_Size!=0)
+            *Buffer_Size=Pipe_CB[Pipe_ID].Pipe_Buffer_Size;
+        *Pipe_Buffer_Ptr=(void*)(Pipe_CB[Pipe_ID].Pipe_Buffer_Addr);
+        
+        Sys_Unlock_Scheduler();
+        return(0);
+    }
+    
     /* If both sides of the pipe is opened, abort */
     if((Pipe_CB[Pipe_ID].Opener_PID[0]!=PIPECLOSE)&&
        (Pipe_CB[Pipe_ID].Opener_PID[1]!=PIPECLOSE))
@@ -326,6 +414,8 @@ retval_t _Sys_Open_Pipe(pid_t Opener_PID,pipeid_t Pipe_ID,size_t* Buffer_Size,vo
         Pipe_CB[Pipe_ID].Opener_PID[0]=Opener_PID;
     else if(Pipe_CB[Pipe_ID].Opener_PID[1]==PIPECLOSE)
         Pipe_CB[Pipe_ID].Opener_PID[1]=Opener_PID;
+    /* The other side has a peer again */
+    Pipe_CB[Pipe_ID].Peer_Closed=0;
     
     /* Output the size(if needed) and the buffer address. We can use the pipe now */
     if(Buffer_Size!=0)
@@ -363,8 +453,9 @@ Return      : retval_t - If successful,0; else -1.
 #if(ENABLE_PIPE==TRUE)
 retval_t _Sys_Close_Pipe(pid_t Closer_PID,pipeid_t Pipe_ID)
 {
-    /* See if the pipe ID is over the boundary */
-    if(Pipe_ID>=MAX_PIPES)
+    /* See if the pipe ID is over the boundary. "PIPECLOSE" is what the free 
+     * sides hold, so it can't close anything */
+    if((Pipe_ID>=MAX_PIPES)||(Closer_PID==PIPECLOSE))
     {
         Sys_Set_Errno(EINVPIPE);
         return (-1);
@@ -379,6 +470,33 @@ retval_t _Sys_Close_Pipe(pid_t Closer_PID,pipeid_t Pipe_ID)
         return (-1);
     }
     
+    /* Nobody will commit or release for the closer, so give its space up */
+    if((Pipe_CB[Pipe_ID].Write_Reserved!=0)&&(Pipe_CB[Pipe_ID].Write_Reserver==Closer_PID))
+    {
+        Pipe_CB[Pipe_ID].Write_Reserved=0;
+        Pipe_CB[Pipe_ID].Write_Reserver=PIPECLOSE;
+    }
+    if((Pipe_CB[Pipe_ID].Read_Peeked!=0)&&(Pipe_CB[Pipe_ID].Read_Peeker==Closer_PID))
+    {
+        Pipe_CB[Pipe_ID].Read_Peeked=0;
+        Pipe_CB[Pipe_ID].Read_Peeker=PIPECLOSE;
+    }
+    
+    /* Close a reader of a broadcast pipe. Its data is no longer kept for it */
+    if((Closer_PID>=0)&&(Closer_PID<MAX_PROC_NUM)&&
+       (Pipe_CB[Pipe_ID].Reader[Closer_PID].Open_Flag!=0))
+    {
+        Pipe_CB[Pipe_ID].Reader[Closer_PID].Open_Flag=0;
+        Pipe_CB[Pipe_ID].Reader_Number--;
+        
+        _Sys_Pipe_Bcast_Sync(Pipe_ID);
+        if(PIPE_FREE_SIZE(Pipe_ID)>=Pipe_CB[Pipe_ID].Write_Trigger)
+            _Sys_Pipe_Wake(Pipe_ID,PIPEWRITE);
+        
+        Sys_Unlock_Scheduler();
+        return 0;
+    }
+    
     /* Close the pipe */
     if(Pipe_CB[Pipe_ID].Opener_PID[0]==Closer_PID)
         Pipe_CB[Pipe_ID].Opener_PID[0]=PIPECLOSE;
@@ -392,6 +510,11 @@ retval_t _Sys_Close_Pipe(pid_t Closer_PID,pipeid_t Pipe_ID)
         return (-1);
     }
     
+    /* The other side will get no more data or space from us. Wake it up, so that
+     * it reads what is left, and then sees the end of the pipe */
+    Pipe_CB[Pipe_ID].Peer_Closed=1;
+    _Sys_Pipe_Wake_All(Pipe_ID);
+    
     Sys_Unlock_Scheduler();
     return 0;
 }
@@ -429,11 +552,12 @@ void _Sys_Close_All_Pipes(pid_t PID)
     Traverse_List_Ptr=Pipe_List_Head.Next;
     while((ptr_int_t)Traverse_List_Ptr!=(ptr_int_t)(&Pipe_List_Head))
     {
-        /* If we can find a match, abort */
-        if(((struct Pipe*)Traverse_List_Ptr)->Opener_PID[0]==PID)
-            ((struct Pipe*)Traverse_List_Ptr)->Opener_PID[0]=PIPECLOSE;
-        if(((struct Pipe*)Traverse_List_Ptr)->Opener_PID[1]==PID)
-            ((struct Pipe*)Traverse_List_Ptr)->Opener_PID[1]=PIPECLOSE;
+        /* If we can find a match, close it, so that the other side knows */
+        if((((struct Pipe*)Traverse_List_Ptr)->Opener_PID[0]==PID)||
+           (((struct Pipe*)Traverse_List_Ptr)->Opener_PID[1]==PID)||
+           ((PID>=0)&&(PID<MAX_PROC_NUM)&&
+            (((struct Pipe*)Traverse_List_Ptr)->Reader[PID].Open_Flag!=0)))
+            _Sys_Close_Pipe(PID,((struct Pipe*)Traverse_List_Ptr)->Pipe_ID);
         
         Traverse_List_Ptr=Traverse_List_Ptr->Next;
     }
@@ -443,19 +567,1205 @@ void _Sys_Close_All_Pipes(pid_t PID)
 #endif
 /* End Function:_Sys_Close_All_Pipes *****************************************/
 
-/* Begin Function:Sys_Query_Pipe_Number ***************************************
-Description : Query the number of pipes existing in the system.
-Input       : None.
+/* Begin Function:Sys_Pipe_Set_Trigger ****************************************
+Description : Set the trigger levels of the pipe. A blocked reader is only woken
+              when there is at least "Read_Trigger" bytes in the pipe, and a blocked
+              writer is only woken when there is at least "Write_Trigger" free bytes
+              in the pipe. This saves the wake-ups for the data that are too small
+              to be worth handling.
+Input       : pipeid_t Pipe_ID - The identifier of the pipe.
+              size_t Read_Trigger - The read trigger level, 1 to the pipe size.
+              size_t Write_Trigger - The write trigger level, 1 to the pipe size.
 Output      : None.
-Return      : size_t - The number of pipes in the system.
+Return      : retval_t - If successful,0; else -1.
 ******************************************************************************/
 #if(ENABLE_PIPE==TRUE)
-size_t Sys_Query_Pipe_Number(void)
+retval_t Sys_Pipe_Set_Trigger(pipeid_t Pipe_ID,size_t Read_Trigger,size_t Write_Trigger)
 {
-    return Pipe_In_Sys;
+    /* See if the pipe ID is over the boundary */
+    if((Pipe_ID<0)||(Pipe_ID>=MAX_PIPES))
+    {
+        Sys_Set_Errno(EINVPIPE);
+        return (-1);
+    }
+    
+    Sys_Lock_Scheduler();
+    /* See if the pipe exists in the system */
+    if(Pipe_CB[Pipe_ID].Pipe_Buffer_Size==0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EINVPIPE);
+        return (-1);
+    }
+    
+    /* See if the trigger levels can ever be reached */
+    if((Read_Trigger==0)||(Read_Trigger>Pipe_CB[Pipe_ID].Pipe_Buffer_Size)||
+       (Write_Trigger==0)||(Write_Trigger>Pipe_CB[Pipe_ID].Pipe_Buffer_Size))
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EINVPIPE);
+        return (-1);
+    }
+    
+    Pipe_CB[Pipe_ID].Read_Trigger=Read_Trigger;
+    Pipe_CB[Pipe_ID].Write_Trigger=Write_Trigger;
+    
+    /* The levels may be lowered, so see if anyone can go on now */
+    if(PIPE_DATA_SIZE(Pipe_ID)>=Read_Trigger)
+        _Sys_Pipe_Wake(Pipe_ID,PIPEREAD);
+    if(PIPE_FREE_SIZE(Pipe_ID)>=Write_Trigger)
+        _Sys_Pipe_Wake(Pipe_ID,PIPEWRITE);
+    
+    Sys_Unlock_Scheduler();
+    return 0;
 }
 #endif
-/* End Function:Sys_Query_Pipe_Number ****************************************/
+/* End Function:Sys_Pipe_Set_Trigger *****************************************/
+
+/* Begin Function:Sys_Pipe_Set_Mode *******************************************
+Description : Set the mode of the pipe. The mode can only be changed when the pipe
+              is empty and no space is reserved or peeked.
+              In "PIPE_MODE_ISR", only "Sys_Pipe_Write_ISR" can write the pipe, and
+              the reader uses the normal read functions. The reader is woken up only
+              when the data crosses the read trigger level.
+              In the broadcast modes, the caller must have opened the pipe, and it
+              becomes the only writer. All the other openers, including those who
+              open the pipe later, are the readers. The readers cannot peek. If
+              the writer closes the pipe, the next opener becomes the writer.
+              A pipe can only leave the broadcast modes when it has no readers.
+Input       : pipeid_t Pipe_ID - The identifier of the pipe.
+              cnt_t Mode - "PIPE_MODE_NORMAL", "PIPE_MODE_ISR", "PIPE_MODE_BCAST_BLOCK"
+                           or "PIPE_MODE_BCAST_DROP".
+Output      : None.
+Return      : retval_t - If successful,0; else -1.
+******************************************************************************/
+#if(ENABLE_PIPE==TRUE)
+retval_t Sys_Pipe_Set_Mode(pipeid_t Pipe_ID,cnt_t Mode)
+{
+    pid_t Reader_PID;
+    
+    /* See if the parameters are over the boundary */
+    if((Pipe_ID<0)||(Pipe_ID>=MAX_PIPES)||(Mode<PIPE_MODE_NORMAL)||(Mode>PIPE_MODE_BCAST_DROP))
+    {
+        Sys_Set_Errno(EINVPIPE);
+        return (-1);
+    }
+    
+    Sys_Lock_Scheduler();
+    /* See if the pipe exists in the system */
+    if(Pipe_CB[Pipe_ID].Pipe_Buffer_Size==0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EINVPIPE);
+        return (-1);
+    }
+    
+    /* The cursors cannot change hands when they are in use */
+    if((PIPE_DATA_SIZE(Pipe_ID)!=0)||(Pipe_CB[Pipe_ID].Write_Reserved!=0)||
+       (Pipe_CB[Pipe_ID].Read_Peeked!=0))
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EPIPEINUSE);
+        return (-1);
+    }
+    
+    /* Going into the broadcast modes, the caller becomes the writer, and the other
+     * opener becomes a reader */
+    if((PIPE_BCAST(Pipe_ID)==0)&&((Mode==PIPE_MODE_BCAST_BLOCK)||(Mode==PIPE_MODE_BCAST_DROP)))
+    {
+        if(PIPE_OPENED_BY(Pipe_ID,Current_PID)==0)
+        {
+            Sys_Unlock_Scheduler();
+            Sys_Set_Errno(EINVPIPE);
+            return (-1);
+        }
+        
+        if(Pipe_CB[Pipe_ID].Opener_PID[0]==Current_PID)
+            Reader_PID=Pipe_CB[Pipe_ID].Opener_PID[1];
+        else
+            Reader_PID=Pipe_CB[Pipe_ID].Opener_PID[0];
+        
+        /* The other opener was never checked in the normal mode, and it can only
+         * be a reader if it has a reader slot */
+        if((Reader_PID!=PIPECLOSE)&&((Reader_PID<0)||(Reader_PID>=MAX_PROC_NUM)))
+        {
+            Sys_Unlock_Scheduler();
+            Sys_Set_Errno(EINVPIPE);
+            return (-1);
+        }
+        
+        Pipe_CB[Pipe_ID].Opener_PID[0]=Current_PID;
+        Pipe_CB[Pipe_ID].Opener_PID[1]=PIPECLOSE;
+        if(Reader_PID!=PIPECLOSE)
+        {
+            Pipe_CB[Pipe_ID].Reader[Reader_PID].Open_Flag=1;
+            Pipe_CB[Pipe_ID].Reader[Reader_PID].Tail=Pipe_CB[Pipe_ID].Pipe_Tail;
+            Pipe_CB[Pipe_ID].Reader[Reader_PID].Drop_Number=0;
+            Pipe_CB[Pipe_ID].Reader_Number=1;
+        }
+    }
+    /* Leaving the broadcast modes, there must be no readers left */
+    else if((PIPE_BCAST(Pipe_ID)!=0)&&(Mode!=PIPE_MODE_BCAST_BLOCK)&&(Mode!=PIPE_MODE_BCAST_DROP))
+    {
+        if(Pipe_CB[Pipe_ID].Reader_Number!=0)
+        {
+            Sys_Unlock_Scheduler();
+            Sys_Set_Errno(EPIPEINUSE);
+            return (-1);
+        }
+    }
+    
+    Pipe_CB[Pipe_ID].Pipe_Mode=Mode;
+    Pipe_CB[Pipe_ID].ISR_Wake_Pend=0;
+    
+    Sys_Unlock_Scheduler();
+    return 0;
+}
+#endif
+/* End Function:Sys_Pipe_Set_Mode ********************************************/
+
+/* Begin Function:_Sys_Pipe_Wake **********************************************
+Description : Wake up the processes waiting for a certain side of the pipe, whose
+              trigger level is reached. This should be called with the scheduler
+              locked.
+Input       : pipeid_t Pipe_ID - The identifier of the pipe.
+              cnt_t Type - "PIPEREAD" for the readers, "PIPEWRITE" for the writers.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_PIPE==TRUE)
+void _Sys_Pipe_Wake(pipeid_t Pipe_ID,cnt_t Type)
+{
+    struct List_Head* Traverse_List_Ptr;
+    struct Wait_Object_Struct* Wait_Block_Ptr;
+    
+    Traverse_List_Ptr=Pipe_CB[Pipe_ID].Wait_Object_Head.Next;
+    while((ptr_int_t)Traverse_List_Ptr!=(ptr_int_t)(&(Pipe_CB[Pipe_ID].Wait_Object_Head)))
+    {
+        Wait_Block_Ptr=(struct Wait_Object_Struct*)(Traverse_List_Ptr-1);
+        /* Step forward first, because the node may be deleted */
+        Traverse_List_Ptr=Traverse_List_Ptr->Next;
+        
+        if(Wait_Block_Ptr->Type!=Type)
+            continue;
+        
+        /* Each reader of a broadcast pipe has its own data to read */
+        if((Type==PIPEREAD)&&(PIPE_READ_SIZE(Pipe_ID,Wait_Block_Ptr->PID)<Pipe_CB[Pipe_ID].Read_Trigger))
+            continue;
+        if((Type==PIPEWRITE)&&(PIPE_FREE_SIZE(Pipe_ID)<Pipe_CB[Pipe_ID].Write_Trigger))
+            continue;
+        
+        /* Mark that the wait is successful */
+        Wait_Block_Ptr->Succeed_Flag=1;
+        /* Delete the wait block from the pipe wait list */
+        Sys_List_Delete_Node(Wait_Block_Ptr->Object_Head.Prev,Wait_Block_Ptr->Object_Head.Next);
+        /* Try to stop the timer if possible */
+        Sys_Proc_Delay_Cancel(Wait_Block_Ptr->PID);
+        /* Wake the process up */
+        _Sys_Set_Ready(Wait_Block_Ptr->PID);
+    }
+}
+#endif
+/* End Function:_Sys_Pipe_Wake ***********************************************/
+
+/* Begin Function:_Sys_Pipe_Wake_All ******************************************
+Description : Wake up all the processes waiting for the pipe, no matter what they
+              wait for. This should be called with the scheduler locked.
+Input       : pipeid_t Pipe_ID - The identifier of the pipe.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_PIPE==TRUE)
+void _Sys_Pipe_Wake_All(pipeid_t Pipe_ID)
+{
+    struct Wait_Object_Struct* Wait_Block_Ptr;
+    
+    while(Pipe_CB[Pipe_ID].Wait_Object_Head.Next!=&(Pipe_CB[Pipe_ID].Wait_Object_Head))
+    {
+        Wait_Block_Ptr=(struct Wait_Object_Struct*)(Pipe_CB[Pipe_ID].Wait_Object_Head.Next-1);
+        Wait_Block_Ptr->Succeed_Flag=1;
+        Sys_List_Delete_Node(Wait_Block_Ptr->Object_Head.Prev,Wait_Block_Ptr->Object_Head.Next);
+        Sys_Proc_Delay_Cancel(Wait_Block_Ptr->PID);
+        _Sys_Set_Ready(Wait_Block_Ptr->PID);
+    }
+}
+#endif
+/* End Function:_Sys_Pipe_Wake_All *******************************************/
+
+/* Begin Function:_Sys_Pipe_Copy_In *******************************************
+Description : Copy the data into the ring buffer at its head, and move the head
+              forward. The caller should make sure that there is enough space.
+              This should be called with the scheduler locked.
+Input       : pipeid_t Pipe_ID - The identifier of the pipe.
+              void* Buffer - The data to copy in.
+              size_t Size - The size of the data.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_PIPE==TRUE)
+void _Sys_Pipe_Copy_In(pipeid_t Pipe_ID,void* Buffer,size_t Size)
+{
+    size_t Head;
+    size_t First_Size;
+    
+    Head=Pipe_CB[Pipe_ID].Pipe_Head;
+    /* The data may go across the end of the buffer */
+    First_Size=PIPE_RING_SIZE(Pipe_ID)-Head;
+    if(First_Size>Size)
+        First_Size=Size;
+    
+    Sys_Memcpy(Pipe_CB[Pipe_ID].Pipe_Buffer_Addr+Head,(ptr_int_t)Buffer,First_Size);
+    Sys_Memcpy(Pipe_CB[Pipe_ID].Pipe_Buffer_Addr,((ptr_int_t)Buffer)+First_Size,Size-First_Size);
+    
+    Head+=Size;
+    if(Head>=PIPE_RING_SIZE(Pipe_ID))
+        Head-=PIPE_RING_SIZE(Pipe_ID);
+    Pipe_CB[Pipe_ID].Pipe_Head=Head;
+}
+#endif
+/* End Function:_Sys_Pipe_Copy_In ********************************************/
+
+/* Begin Function:_Sys_Pipe_Copy_Out ******************************************
+Description : Copy the data out of the ring buffer from a tail, and move the tail
+              forward. The caller should make sure that there is enough data.
+              This should be called with the scheduler locked.
+Input       : pipeid_t Pipe_ID - The identifier of the pipe.
+              volatile size_t* Tail_Ptr - The tail to read from. This is the tail of
+                                          the pipe, or of a broadcast reader.
+              size_t Size - The size of the data.
+Output      : void* Buffer - The buffer to copy the data to.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_PIPE==TRUE)
+void _Sys_Pipe_Copy_Out(pipeid_t Pipe_ID,volatile size_t* Tail_Ptr,void* Buffer,size_t Size)
+{
+    size_t Tail;
+    size_t First_Size;
+    
+    /* Read the data only after the head that covers it */
+    MEMORY_BARRIER();
+    Tail=*Tail_Ptr;
+    /* The data may go across the end of the buffer */
+    First_Size=PIPE_RING_SIZE(Pipe_ID)-Tail;
+    if(First_Size>Size)
+        First_Size=Size;
+    
+    Sys_Memcpy((ptr_int_t)Buffer,Pipe_CB[Pipe_ID].Pipe_Buffer_Addr+Tail,First_Size);
+    Sys_Memcpy(((ptr_int_t)Buffer)+First_Size,Pipe_CB[Pipe_ID].Pipe_Buffer_Addr,Size-First_Size);
+    
+    /* Give the space back only after the data is read */
+    MEMORY_BARRIER();
+    Tail+=Size;
+    if(Tail>=PIPE_RING_SIZE(Pipe_ID))
+        Tail-=PIPE_RING_SIZE(Pipe_ID);
+    *Tail_Ptr=Tail;
+}
+#endif
+/* End Function:_Sys_Pipe_Copy_Out *******************************************/
+
+/* Begin Function:_Sys_Pipe_Bcast_Sync ****************************************
+Description : Make the tail of a broadcast pipe the tail of its slowest reader. If
+              there are no readers, the pipe is empty. Then the free space of the
+              pipe is what the writer can use without overwriting unread data.
+              This should be called with the scheduler locked.
+Input       : pipeid_t Pipe_ID - The identifier of the pipe.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_PIPE==TRUE)
+void _Sys_Pipe_Bcast_Sync(pipeid_t Pipe_ID)
+{
+    cnt_t PID_Cnt;
+    size_t Max_Size;
+    size_t Data_Size;
+    size_t Tail;
+    
+    Max_Size=0;
+    Tail=Pipe_CB[Pipe_ID].Pipe_Head;
+    for(PID_Cnt=0;PID_Cnt<MAX_PROC_NUM;PID_Cnt++)
+    {
+        if(Pipe_CB[Pipe_ID].Reader[PID_Cnt].Open_Flag==0)
+            continue;
+        
+        Data_Size=PIPE_READER_SIZE(Pipe_ID,PID_Cnt);
+        if(Data_Size>Max_Size)
+        {
+            Max_Size=Data_Size;
+            Tail=Pipe_CB[Pipe_ID].Reader[PID_Cnt].Tail;
+        }
+    }
+    
+    Pipe_CB[Pipe_ID].Pipe_Tail=Tail;
+}
+#endif
+/* End Function:_Sys_Pipe_Bcast_Sync *****************************************/
+
+/* Begin Function:_Sys_Pipe_Bcast_Drop ****************************************
+Description : Drop the oldest data for the slow readers of a broadcast pipe, so that
+              the writer can have a certain amount of free space. The dropped bytes
+              are counted for each reader. This should be called with the scheduler
+              locked.
+Input       : pipeid_t Pipe_ID - The identifier of the pipe.
+              size_t Size - The free space needed. If this is bigger than the buffer,
+                            the whole buffer will be freed.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_PIPE==TRUE)
+void _Sys_Pipe_Bcast_Drop(pipeid_t Pipe_ID,size_t Size)
+{
+    cnt_t PID_Cnt;
+    size_t Data_Size;
+    size_t Keep_Size;
+    size_t Tail;
+    
+    if(Size>Pipe_CB[Pipe_ID].Pipe_Buffer_Size)
+        Size=Pipe_CB[Pipe_ID].Pipe_Buffer_Size;
+    
+    if(PIPE_FREE_SIZE(Pipe_ID)>=Size)
+        return;
+    
+    /* Every reader can keep at most this much data */
+    Keep_Size=Pipe_CB[Pipe_ID].Pipe_Buffer_Size-Size;
+    for(PID_Cnt=0;PID_Cnt<MAX_PROC_NUM;PID_Cnt++)
+    {
+        if(Pipe_CB[Pipe_ID].Reader[PID_Cnt].Open_Flag==0)
+            continue;
+        
+        Data_Size=PIPE_READER_SIZE(Pipe_ID,PID_Cnt);
+        if(Data_Size<=Keep_Size)
+            continue;
+        
+        Tail=Pipe_CB[Pipe_ID].Reader[PID_Cnt].Tail+Data_Size-Keep_Size;
+        if(Tail>=PIPE_RING_SIZE(Pipe_ID))
+            Tail-=PIPE_RING_SIZE(Pipe_ID);
+        Pipe_CB[Pipe_ID].Reader[PID_Cnt].Tail=Tail;
+        Pipe_CB[Pipe_ID].Reader[PID_Cnt].Drop_Number+=Data_Size-Keep_Size;
+    }
+    
+    _Sys_Pipe_Bcast_Sync(Pipe_ID);
+}
+#endif
+/* End Function:_Sys_Pipe_Bcast_Drop *****************************************/
+
+/* Begin Function:Sys_Pipe_Write **********************************************
+Description : Write data to the pipe. When the free space in the pipe reaches the
+              write trigger level, as much data as can be held is written, and
+              the rest is left to the caller. If the free space is below the level,
+              the process will wait until it reaches the level or the time is up.
+              The writer is automatically the "Current_PID", who must have opened
+              the pipe.
+Input       : pipeid_t Pipe_ID - The identifier of the pipe.
+              void* Buffer - The data to write.
+              size_t Size - The size of the data.
+              time_t Time - The longest time to wait. If the time is "WAIT_INFINITE",
+                            then the process will wait until it can write.
+Output      : None.
+Return      : size_t - The number of bytes written. If the function fails or the
+                       time is up, 0.
+******************************************************************************/
+#if(ENABLE_PIPE==TRUE)
+size_t Sys_Pipe_Write(pipeid_t Pipe_ID,void* Buffer,size_t Size,time_t Time)
+{
+    size_t Write_Size;
+    cnt_t Last_Try;
+    time_t Start_Time;
+    time_t Passed_Time;
+    time_t Wait_Time;
+    
+    /* See if the parameters are over the boundary */
+    if((Pipe_ID<0)||(Pipe_ID>=MAX_PIPES)||(Buffer==0)||(Size==0))
+    {
+        Sys_Set_Errno(EINVPIPE);
+        return 0;
+    }
+    
+    Start_Time=System_Status.Time.OS_Total_Ticks.Low_Bits;
+    Last_Try=0;
+    
+    while(1)
+    {
+        Sys_Lock_Scheduler();
+        /* See if the pipe exists in the system, and we have opened it */
+        if((Pipe_CB[Pipe_ID].Pipe_Buffer_Size==0)||(PIPE_OPENED_BY(Pipe_ID,Current_PID)==0))
+        {
+            Sys_Unlock_Scheduler();
+            Sys_Set_Errno(EINVPIPE);
+            return 0;
+        }
+        
+        /* The interrupt handler is the only writer, and so is the first opener in
+         * the broadcast modes */
+        if((Pipe_CB[Pipe_ID].Pipe_Mode==PIPE_MODE_ISR)||
+           ((PIPE_BCAST(Pipe_ID)!=0)&&(Pipe_CB[Pipe_ID].Opener_PID[0]!=Current_PID)))
+        {
+            Sys_Unlock_Scheduler();
+            Sys_Set_Errno(EPIPEMODE);
+            return 0;
+        }
+        
+        /* The reserved space is at the head, so we cannot write now */
+        if(Pipe_CB[Pipe_ID].Write_Reserved!=0)
+        {
+            Sys_Unlock_Scheduler();
+            Sys_Set_Errno(EPIPEINUSE);
+            return 0;
+        }
+        
+        /* Nobody will read what we write */
+        if(Pipe_CB[Pipe_ID].Peer_Closed!=0)
+        {
+            Sys_Unlock_Scheduler();
+            Sys_Set_Errno(EPIPECLOSED);
+            return 0;
+        }
+        
+        /* In the dropping broadcast mode, the slow readers make room for us */
+        if(Pipe_CB[Pipe_ID].Pipe_Mode==PIPE_MODE_BCAST_DROP)
+            _Sys_Pipe_Bcast_Drop(Pipe_ID,(Size>Pipe_CB[Pipe_ID].Write_Trigger)?Size:Pipe_CB[Pipe_ID].Write_Trigger);
+        
+        /* See if the free space reaches the trigger level */
+        Write_Size=PIPE_FREE_SIZE(Pipe_ID);
+        if(Write_Size>=Pipe_CB[Pipe_ID].Write_Trigger)
+        {
+            if(Write_Size>Size)
+                Write_Size=Size;
+            
+            _Sys_Pipe_Copy_In(Pipe_ID,Buffer,Write_Size);
+            /* A broadcast pipe with no readers keeps nothing */
+            if((PIPE_BCAST(Pipe_ID)!=0)&&(Pipe_CB[Pipe_ID].Reader_Number==0))
+                _Sys_Pipe_Bcast_Sync(Pipe_ID);
+            
+            if(PIPE_DATA_SIZE(Pipe_ID)>=Pipe_CB[Pipe_ID].Read_Trigger)
+                _Sys_Pipe_Wake(Pipe_ID,PIPEREAD);
+            
+            Sys_Unlock_Scheduler();
+            return Write_Size;
+        }
+        
+        Sys_Unlock_Scheduler();
+        
+        /* See how much time is left */
+        if(Time!=WAIT_INFINITE)
+        {
+            Passed_Time=System_Status.Time.OS_Total_Ticks.Low_Bits-Start_Time;
+            if(Passed_Time>=Time)
+                Last_Try=1;
+            
+            Wait_Time=Time-Passed_Time;
+        }
+        else
+            Wait_Time=WAIT_INFINITE;
+        
+        if(Last_Try!=0)
+            break;
+        
+        /* Wait for the free space. If the wait failed, we try for the last time */
+        if(Sys_Wait_Object(Pipe_ID,PIPEWRITE,Wait_Time)==-1)
+            Last_Try=1;
+    }
+    
+    Sys_Set_Errno(EPIPEFULL);
+    return 0;
+}
+#endif
+/* End Function:Sys_Pipe_Write ***********************************************/
+
+/* Begin Function:Sys_Pipe_Read ***********************************************
+Description : Read data from the pipe. When the data in the pipe reaches the read
+              trigger level, as much data as the buffer can hold is read. If the
+              data is below the level, the process will wait until it reaches the
+              level or the time is up.
+              The reader is automatically the "Current_PID", who must have opened
+              the pipe.
+Input       : pipeid_t Pipe_ID - The identifier of the pipe.
+              size_t Size - The size of the buffer.
+              time_t Time - The longest time to wait. If the time is "WAIT_INFINITE",
+                            then the process will wait until it can read.
+Output      : void* Buffer - The buffer to read the data to.
+Return      : size_t - The number of bytes read. If the function fails or the
+                       time is up, 0.
+******************************************************************************/
+#if(ENABLE_PIPE==TRUE)
+size_t Sys_Pipe_Read(pipeid_t Pipe_ID,void* Buffer,size_t Size,time_t Time)
+{
+    size_t Read_Size;
+    cnt_t Last_Try;
+    time_t Start_Time;
+    time_t Passed_Time;
+    time_t Wait_Time;
+    
+    /* See if the parameters are over the boundary */
+    if((Pipe_ID<0)||(Pipe_ID>=MAX_PIPES)||(Buffer==0)||(Size==0))
+    {
+        Sys_Set_Errno(EINVPIPE);
+        return 0;
+    }
+    
+    Start_Time=System_Status.Time.OS_Total_Ticks.Low_Bits;
+    Last_Try=0;
+    
+    while(1)
+    {
+        Sys_Lock_Scheduler();
+        /* See if the pipe exists in the system, and we have opened it */
+        if((Pipe_CB[Pipe_ID].Pipe_Buffer_Size==0)||(PIPE_OPENED_BY(Pipe_ID,Current_PID)==0))
+        {
+            Sys_Unlock_Scheduler();
+            Sys_Set_Errno(EINVPIPE);
+            return 0;
+        }
+        
+        /* In the broadcast modes, the writer does not read */
+        if((PIPE_BCAST(Pipe_ID)!=0)&&(Pipe_CB[Pipe_ID].Opener_PID[0]==Current_PID))
+        {
+            Sys_Unlock_Scheduler();
+            Sys_Set_Errno(EPIPEMODE);
+            return 0;
+        }
+        
+        /* The peeked data is at the tail, so we cannot read now */
+        if(Pipe_CB[Pipe_ID].Read_Peeked!=0)
+        {
+            Sys_Unlock_Scheduler();
+            Sys_Set_Errno(EPIPEINUSE);
+            return 0;
+        }
+        
+        /* See if the data reaches the trigger level. If the other side is closed,
+         * what is left is all we can get, so read it anyway */
+        Read_Size=PIPE_READ_SIZE(Pipe_ID,Current_PID);
+        if((Read_Size>=Pipe_CB[Pipe_ID].Read_Trigger)||
+           ((Pipe_CB[Pipe_ID].Peer_Closed!=0)&&(Read_Size!=0)))
+        {
+            if(Read_Size>Size)
+                Read_Size=Size;
+            
+            if(PIPE_BCAST(Pipe_ID)!=0)
+            {
+                _Sys_Pipe_Copy_Out(Pipe_ID,&(Pipe_CB[Pipe_ID].Reader[Current_PID].Tail),Buffer,Read_Size);
+                /* We may have been the slowest reader */
+                _Sys_Pipe_Bcast_Sync(Pipe_ID);
+            }
+            else
+                _Sys_Pipe_Copy_Out(Pipe_ID,&(Pipe_CB[Pipe_ID].Pipe_Tail),Buffer,Read_Size);
+            
+            if(PIPE_FREE_SIZE(Pipe_ID)>=Pipe_CB[Pipe_ID].Write_Trigger)
+                _Sys_Pipe_Wake(Pipe_ID,PIPEWRITE);
+            
+            Sys_Unlock_Scheduler();
+            return Read_Size;
+        }
+        
+        /* The pipe is empty, and no more data will come */
+        if(Pipe_CB[Pipe_ID].Peer_Closed!=0)
+        {
+            Sys_Unlock_Scheduler();
+            Sys_Set_Errno(EPIPECLOSED);
+            return 0;
+        }
+        
+        Sys_Unlock_Scheduler();
+        
+        /* See how much time is left */
+        if(Time!=WAIT_INFINITE)
+        {
+            Passed_Time=System_Status.Time.OS_Total_Ticks.Low_Bits-Start_Time;
+            if(Passed_Time>=Time)
+                Last_Try=1;
+            
+            Wait_Time=Time-Passed_Time;
+        }
+        else
+            Wait_Time=WAIT_INFINITE;
+        
+        if(Last_Try!=0)
+            break;
+        
+        /* Wait for the data. If the wait failed, we try for the last time */
+        if(Sys_Wait_Object(Pipe_ID,PIPEREAD,Wait_Time)==-1)
+            Last_Try=1;
+    }
+    
+    Sys_Set_Errno(EPIPEEMPTY);
+    return 0;
+}
+#endif
+/* End Function:Sys_Pipe_Read ************************************************/
+
+/* Begin Function:_Sys_Pipe_Get_Span ******************************************
+Description : Describe a range of the ring buffer with two contiguous spans. If
+              the range does not go across the end of the buffer, the second span
+              is empty. This should be called with the scheduler locked.
+Input       : pipeid_t Pipe_ID - The identifier of the pipe.
+              size_t Start - The start of the range, as a cursor.
+              size_t Size - The size of the range.
+Output      : struct Pipe_Span* Span - The two spans.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_PIPE==TRUE)
+void _Sys_Pipe_Get_Span(pipeid_t Pipe_ID,size_t Start,size_t Size,struct Pipe_Span* Span)
+{
+    size_t First_Size;
+    
+    First_Size=PIPE_RING_SIZE(Pipe_ID)-Start;
+    if(First_Size>Size)
+        First_Size=Size;
+    
+    Span[0].Addr=(void*)(Pipe_CB[Pipe_ID].Pipe_Buffer_Addr+Start);
+    Span[0].Size=First_Size;
+    Span[1].Addr=(void*)(Pipe_CB[Pipe_ID].Pipe_Buffer_Addr);
+    Span[1].Size=Size-First_Size;
+}
+#endif
+/* End Function:_Sys_Pipe_Get_Span *******************************************/
+
+/* Begin Function:Sys_Pipe_Write_Reserve **************************************
+Description : Reserve the free space at the head of the pipe, so that the writer
+              (or a DMA engine) can fill it in place, without copying. The data
+              is not visible to the reader until it is committed. While there is
+              a reservation, "Sys_Pipe_Write" cannot be used. Reserving again
+              replaces the last reservation. The reservation belongs to the
+              caller, and is given up if the caller closes the pipe.
+              This does not block. To wait for the free space, wait for the pipe
+              with "PIPEWRITE".
+Input       : pipeid_t Pipe_ID - The identifier of the pipe.
+              size_t Size - The most bytes wanted.
+Output      : struct Pipe_Span* Span - The two spans reserved. It must have two
+                                       elements.
+Return      : size_t - The number of bytes reserved. If the function fails, 0.
+******************************************************************************/
+#if(ENABLE_PIPE==TRUE)
+size_t Sys_Pipe_Write_Reserve(pipeid_t Pipe_ID,size_t Size,struct Pipe_Span* Span)
+{
+    size_t Reserve_Size;
+    
+    /* See if the parameters are over the boundary */
+    if((Pipe_ID<0)||(Pipe_ID>=MAX_PIPES)||(Span==0)||(Size==0))
+    {
+        Sys_Set_Errno(EINVPIPE);
+        return 0;
+    }
+    
+    Sys_Lock_Scheduler();
+    /* See if the pipe exists in the system, and we have opened it */
+    if((Pipe_CB[Pipe_ID].Pipe_Buffer_Size==0)||(PIPE_OPENED_BY(Pipe_ID,Current_PID)==0))
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EINVPIPE);
+        return 0;
+    }
+    
+    /* The interrupt handler is the only writer, and so is the first opener in
+     * the broadcast modes */
+    if((Pipe_CB[Pipe_ID].Pipe_Mode==PIPE_MODE_ISR)||
+       ((PIPE_BCAST(Pipe_ID)!=0)&&(Pipe_CB[Pipe_ID].Opener_PID[0]!=Current_PID)))
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EPIPEMODE);
+        return 0;
+    }
+    
+    /* The other side has reserved the space already */
+    if((Pipe_CB[Pipe_ID].Write_Reserved!=0)&&(Pipe_CB[Pipe_ID].Write_Reserver!=Current_PID))
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EPIPEINUSE);
+        return 0;
+    }
+    
+    /* In the dropping broadcast mode, the slow readers make room for us */
+    if(Pipe_CB[Pipe_ID].Pipe_Mode==PIPE_MODE_BCAST_DROP)
+        _Sys_Pipe_Bcast_Drop(Pipe_ID,Size);
+    
+    Reserve_Size=PIPE_FREE_SIZE(Pipe_ID);
+    if(Reserve_Size==0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EPIPEFULL);
+        return 0;
+    }
+    
+    if(Reserve_Size>Size)
+        Reserve_Size=Size;
+    
+    _Sys_Pipe_Get_Span(Pipe_ID,Pipe_CB[Pipe_ID].Pipe_Head,Reserve_Size,Span);
+    Pipe_CB[Pipe_ID].Write_Reserved=Reserve_Size;
+    Pipe_CB[Pipe_ID].Write_Reserver=Current_PID;
+    
+    Sys_Unlock_Scheduler();
+    return Reserve_Size;
+}
+#endif
+/* End Function:Sys_Pipe_Write_Reserve ***************************************/
+
+/* Begin Function:Sys_Pipe_Write_Commit ***************************************
+Description : Commit the data filled in the reserved space, and make it visible to
+              the reader. The rest of the reservation is given up. Only the
+              process that reserved the space can commit it.
+Input       : pipeid_t Pipe_ID - The identifier of the pipe.
+              size_t Size - The number of bytes to commit. It cannot be more than
+                            the reserved bytes. If 0, the reservation is cancelled.
+Output      : None.
+Return      : retval_t - If successful,0; else -1.
+******************************************************************************/
+#if(ENABLE_PIPE==TRUE)
+retval_t Sys_Pipe_Write_Commit(pipeid_t Pipe_ID,size_t Size)
+{
+    size_t Head;
+    
+    /* See if the pipe ID is over the boundary */
+    if((Pipe_ID<0)||(Pipe_ID>=MAX_PIPES))
+    {
+        Sys_Set_Errno(EINVPIPE);
+        return (-1);
+    }
+    
+    Sys_Lock_Scheduler();
+    /* See if the pipe exists in the system, and we have opened it */
+    if((Pipe_CB[Pipe_ID].Pipe_Buffer_Size==0)||(PIPE_OPENED_BY(Pipe_ID,Current_PID)==0))
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EINVPIPE);
+        return (-1);
+    }
+    
+    /* The interrupt handler is the only writer, and so is the first opener in
+     * the broadcast modes */
+    if((Pipe_CB[Pipe_ID].Pipe_Mode==PIPE_MODE_ISR)||
+       ((PIPE_BCAST(Pipe_ID)!=0)&&(Pipe_CB[Pipe_ID].Opener_PID[0]!=Current_PID)))
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EPIPEMODE);
+        return (-1);
+    }
+    
+    /* We cannot commit what is not reserved */
+    if(Size>Pipe_CB[Pipe_ID].Write_Reserved)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EINVPIPE);
+        return (-1);
+    }
+    
+    /* Only the one who reserved the space can commit it */
+    if((Pipe_CB[Pipe_ID].Write_Reserved!=0)&&(Pipe_CB[Pipe_ID].Write_Reserver!=Current_PID))
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EPIPEINUSE);
+        return (-1);
+    }
+    
+    Head=Pipe_CB[Pipe_ID].Pipe_Head+Size;
+    if(Head>=PIPE_RING_SIZE(Pipe_ID))
+        Head-=PIPE_RING_SIZE(Pipe_ID);
+    Pipe_CB[Pipe_ID].Pipe_Head=Head;
+    Pipe_CB[Pipe_ID].Write_Reserved=0;
+    Pipe_CB[Pipe_ID].Write_Reserver=PIPECLOSE;
+    /* A broadcast pipe with no readers keeps nothing */
+    if((PIPE_BCAST(Pipe_ID)!=0)&&(Pipe_CB[Pipe_ID].Reader_Number==0))
+        _Sys_Pipe_Bcast_Sync(Pipe_ID);
+    
+    if((Size!=0)&&(PIPE_DATA_SIZE(Pipe_ID)>=Pipe_CB[Pipe_ID].Read_Trigger))
+        _Sys_Pipe_Wake(Pipe_ID,PIPEREAD);
+    
+    Sys_Unlock_Scheduler();
+    return 0;
+}
+#endif
+/* End Function:Sys_Pipe_Write_Commit ****************************************/
+
+/* Begin Function:Sys_Pipe_Read_Peek ******************************************
+Description : Peek the data at the tail of the pipe, so that the reader (or a DMA
+              engine) can use it in place, without copying. The data stays in the
+              pipe until it is released. While there is peeked data, "Sys_Pipe_Read"
+              cannot be used. Peeking again replaces the last peek. The peek
+              belongs to the caller, and is given up if the caller closes the pipe.
+              This does not block. To wait for the data, wait for the pipe with
+              "PIPEREAD".
+Input       : pipeid_t Pipe_ID - The identifier of the pipe.
+              size_t Size - The most bytes wanted.
+Output      : struct Pipe_Span* Span - The two spans peeked. It must have two
+                                       elements.
+Return      : size_t - The number of bytes peeked. If the function fails, 0.
+******************************************************************************/
+#if(ENABLE_PIPE==TRUE)
+size_t Sys_Pipe_Read_Peek(pipeid_t Pipe_ID,size_t Size,struct Pipe_Span* Span)
+{
+    size_t Peek_Size;
+    
+    /* See if the parameters are over the boundary */
+    if((Pipe_ID<0)||(Pipe_ID>=MAX_PIPES)||(Span==0)||(Size==0))
+    {
+        Sys_Set_Errno(EINVPIPE);
+        return 0;
+    }
+    
+    Sys_Lock_Scheduler();
+    /* See if the pipe exists in the system, and we have opened it */
+    if((Pipe_CB[Pipe_ID].Pipe_Buffer_Size==0)||(PIPE_OPENED_BY(Pipe_ID,Current_PID)==0))
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EINVPIPE);
+        return 0;
+    }
+    
+    /* The broadcast readers do not own the tail, so they cannot peek */
+    if(PIPE_BCAST(Pipe_ID)!=0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EPIPEMODE);
+        return 0;
+    }
+    
+    /* The other side has peeked the data already */
+    if((Pipe_CB[Pipe_ID].Read_Peeked!=0)&&(Pipe_CB[Pipe_ID].Read_Peeker!=Current_PID))
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EPIPEINUSE);
+        return 0;
+    }
+    
+    Peek_Size=PIPE_DATA_SIZE(Pipe_ID);
+    if(Peek_Size==0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EPIPEEMPTY);
+        return 0;
+    }
+    
+    if(Peek_Size>Size)
+        Peek_Size=Size;
+    
+    /* The data is used only after the head that covers it */
+    MEMORY_BARRIER();
+    _Sys_Pipe_Get_Span(Pipe_ID,Pipe_CB[Pipe_ID].Pipe_Tail,Peek_Size,Span);
+    Pipe_CB[Pipe_ID].Read_Peeked=Peek_Size;
+    Pipe_CB[Pipe_ID].Read_Peeker=Current_PID;
+    
+    Sys_Unlock_Scheduler();
+    return Peek_Size;
+}
+#endif
+/* End Function:Sys_Pipe_Read_Peek *******************************************/
+
+/* Begin Function:Sys_Pipe_Read_Release ***************************************
+Description : Release the peeked data that is used up, and give the space back to
+              the writer. The rest of the peeked data stays in the pipe. Only the
+              process that peeked the data can release it.
+Input       : pipeid_t Pipe_ID - The identifier of the pipe.
+              size_t Size - The number of bytes to release. It cannot be more than
+                            the peeked bytes. If 0, the peek is cancelled.
+Output      : None.
+Return      : retval_t - If successful,0; else -1.
+******************************************************************************/
+#if(ENABLE_PIPE==TRUE)
+retval_t Sys_Pipe_Read_Release(pipeid_t Pipe_ID,size_t Size)
+{
+    size_t Tail;
+    
+    /* See if the pipe ID is over the boundary */
+    if((Pipe_ID<0)||(Pipe_ID>=MAX_PIPES))
+    {
+        Sys_Set_Errno(EINVPIPE);
+        return (-1);
+    }
+    
+    Sys_Lock_Scheduler();
+    /* See if the pipe exists in the system, and we have opened it */
+    if((Pipe_CB[Pipe_ID].Pipe_Buffer_Size==0)||(PIPE_OPENED_BY(Pipe_ID,Current_PID)==0))
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EINVPIPE);
+        return (-1);
+    }
+    
+    /* We cannot release what is not peeked */
+    if(Size>Pipe_CB[Pipe_ID].Read_Peeked)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EINVPIPE);
+        return (-1);
+    }
+    
+    /* Only the one who peeked the data can release it */
+    if((Pipe_CB[Pipe_ID].Read_Peeked!=0)&&(Pipe_CB[Pipe_ID].Read_Peeker!=Current_PID))
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EPIPEINUSE);
+        return (-1);
+    }
+    
+    /* Give the space back only after the data is used */
+    MEMORY_BARRIER();
+    Tail=Pipe_CB[Pipe_ID].Pipe_Tail+Size;
+    if(Tail>=PIPE_RING_SIZE(Pipe_ID))
+        Tail-=PIPE_RING_SIZE(Pipe_ID);
+    Pipe_CB[Pipe_ID].Pipe_Tail=Tail;
+    Pipe_CB[Pipe_ID].Read_Peeked=0;
+    Pipe_CB[Pipe_ID].Read_Peeker=PIPECLOSE;
+    
+    if((Size!=0)&&(PIPE_FREE_SIZE(Pipe_ID)>=Pipe_CB[Pipe_ID].Write_Trigger))
+        _Sys_Pipe_Wake(Pipe_ID,PIPEWRITE);
+    
+    Sys_Unlock_Scheduler();
+    return 0;
+}
+#endif
+/* End Function:Sys_Pipe_Read_Release ****************************************/
+
+/* Begin Function:Sys_Pipe_Write_ISR ******************************************
+Description : Write data to a pipe in "PIPE_MODE_ISR" from an interrupt handler.
+              As much data as can be held is written, and this never blocks.
+              No lock is taken and no interrupt is masked: the head is only changed
+              here, and the tail is only changed by the reader. If the data crosses
+              the read trigger level, the reader is woken up when the kernel runs
+              next time. Only one interrupt handler can write the pipe.
+Input       : pipeid_t Pipe_ID - The identifier of the pipe.
+              void* Buffer - The data to write.
+              size_t Size - The size of the data.
+Output      : None.
+Return      : size_t - The number of bytes written. If the pipe is full, or not in
+                       "PIPE_MODE_ISR", 0.
+******************************************************************************/
+#if(ENABLE_PIPE==TRUE)
+size_t Sys_Pipe_Write_ISR(pipeid_t Pipe_ID,void* Buffer,size_t Size)
+{
+    size_t Head;
+    size_t Tail;
+    size_t Ring_Size;
+    size_t Data_Size;
+    size_t Write_Size;
+    size_t First_Size;
+    
+    /* See if the parameters are over the boundary */
+    if((Pipe_ID<0)||(Pipe_ID>=MAX_PIPES)||(Buffer==0))
+        return 0;
+    
+    if(Pipe_CB[Pipe_ID].Pipe_Mode!=PIPE_MODE_ISR)
+        return 0;
+    
+    /* The tail may be changed by the reader at any time, so read it only once */
+    Ring_Size=PIPE_RING_SIZE(Pipe_ID);
+    Head=Pipe_CB[Pipe_ID].Pipe_Head;
+    Tail=Pipe_CB[Pipe_ID].Pipe_Tail;
+    /* Write the space only after the tail that gives it back */
+    MEMORY_BARRIER();
+    
+    Data_Size=(Head+Ring_Size-Tail)%Ring_Size;
+    Write_Size=Pipe_CB[Pipe_ID].Pipe_Buffer_Size-Data_Size;
+    if(Write_Size>Size)
+        Write_Size=Size;
+    if(Write_Size==0)
+        return 0;
+    
+    /* The data may go across the end of the buffer */
+    First_Size=Ring_Size-Head;
+    if(First_Size>Write_Size)
+        First_Size=Write_Size;
+    
+    Sys_Memcpy(Pipe_CB[Pipe_ID].Pipe_Buffer_Addr+Head,(ptr_int_t)Buffer,First_Size);
+    Sys_Memcpy(Pipe_CB[Pipe_ID].Pipe_Buffer_Addr,((ptr_int_t)Buffer)+First_Size,Write_Size-First_Size);
+    
+    /* Publish the head only after the data is written */
+    MEMORY_BARRIER();
+    Head+=Write_Size;
+    if(Head>=Ring_Size)
+        Head-=Ring_Size;
+    Pipe_CB[Pipe_ID].Pipe_Head=Head;
+    
+    /* Only wake the reader up when the trigger level is crossed. A blocked reader
+     * never moves the tail, so the level seen here is exact for it */
+    if((Data_Size<Pipe_CB[Pipe_ID].Read_Trigger)&&
+       ((Data_Size+Write_Size)>=Pipe_CB[Pipe_ID].Read_Trigger))
+    {
+        Pipe_CB[Pipe_ID].ISR_Wake_Pend=1;
+        /* The kernel looks at the pipe only after it sees the global flag */
+        MEMORY_BARRIER();
+        Pipe_ISR_Wake_Pend=1;
+    }
+    
+    return Write_Size;
+}
+#endif
+/* End Function:Sys_Pipe_Write_ISR *******************************************/
+
+/* Begin Function:_Sys_Pipe_Wake_Deferred *************************************
+Description : Wake up the readers that the interrupt handlers asked to wake up.
+              This is called by the kernel when it unlocks the scheduler in the
+              process context, and by the systick routine when the scheduler is not
+              locked. The pipes are only scanned when the global flag is set.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+void _Sys_Pipe_Wake_Deferred(void)
+{
+#if(ENABLE_PIPE==TRUE)
+    cnt_t Pipe_Cnt;
+    
+    if(Pipe_ISR_Wake_Pend==0)
+        return;
+    
+    /* Clear it before looking at the pipes, so that a new request will not be lost */
+    Pipe_ISR_Wake_Pend=0;
+    MEMORY_BARRIER();
+    
+    for(Pipe_Cnt=0;Pipe_Cnt<MAX_PIPES;Pipe_Cnt++)
+    {
+        if(Pipe_CB[Pipe_Cnt].ISR_Wake_Pend==0)
+            continue;
+        
+        /* Clear it before waking, so that a new request will not be lost. The
+         * head is read only after the flag that covers it */
+        Pipe_CB[Pipe_Cnt].ISR_Wake_Pend=0;
+        MEMORY_BARRIER();
+        Sys_Lock_Scheduler();
+        _Sys_Pipe_Wake(Pipe_Cnt,PIPEREAD);
+        Sys_Unlock_Scheduler();
+    }
+#endif
+}
+/* End Function:_Sys_Pipe_Wake_Deferred **************************************/
+
+/* Begin Function:Sys_Query_Pipe_Number ***************************************
+Description : Query the number of pipes existing in the system.
+Input       : None.
+Output      : None.
+Return      : size_t - The number of pipes in the system.
+******************************************************************************/
+#if(ENABLE_PIPE==TRUE)
+size_t Sys_Query_Pipe_Number(void)
+{
+    return Pipe_In_Sys;
+}
+#endif
+/* End Function:Sys_Query_Pipe_Number ****************************************/
+
+/* Begin Function:Sys_Query_Pipe_Data *****************************************
+Description : Query the number of bytes in the pipe.
+Input       : pipeid_t Pipe_ID - The identifier of the pipe.
+Output      : None.
+Return      : size_t - The number of bytes in the pipe. If the pipe does not exist,
+                       0.
+******************************************************************************/
+#if(ENABLE_PIPE==TRUE)
+size_t Sys_Query_Pipe_Data(pipeid_t Pipe_ID)
+{
+    /* See if the pipe ID is over the boundary, or the pipe does not exist */
+    if((Pipe_ID<0)||(Pipe_ID>=MAX_PIPES)||(Pipe_CB[Pipe_ID].Pipe_Buffer_Size==0))
+        return 0;
+    
+    return PIPE_DATA_SIZE(Pipe_ID);
+}
+#endif
+/* End Function:Sys_Query_Pipe_Data ******************************************/
+
+/* Begin Function:Sys_Query_Pipe_Readable *************************************
+Description : Query the number of bytes that the current process can read from the
+              pipe. For a broadcast pipe, this is the data that the reader has not
+              read yet.
+Input       : pipeid_t Pipe_ID - The identifier of the pipe.
+Output      : None.
+Return      : size_t - The number of bytes that can be read. If the pipe does not
+                       exist, or the process is not a reader of the broadcast pipe, 0.
+******************************************************************************/
+#if(ENABLE_PIPE==TRUE)
+size_t Sys_Query_Pipe_Readable(pipeid_t Pipe_ID)
+{
+    /* See if the pipe ID is over the boundary, or the pipe does not exist */
+    if((Pipe_ID<0)||(Pipe_ID>=MAX_PIPES)||(Pipe_CB[Pipe_ID].Pipe_Buffer_Size==0))
+        return 0;
+    
+    if(PIPE_BCAST(Pipe_ID)!=0)
+    {
+        if(Pipe_CB[Pipe_ID].Reader[Current_PID].Open_Flag==0)
+            return 0;
+        
+        return PIPE_READER_SIZE(Pipe_ID,Current_PID);
+    }
+    
+    return PIPE_DATA_SIZE(Pipe_ID);
+}
+#endif
+/* End Function:Sys_Query_Pipe_Readable **************************************/
+
+/* Begin Function:Sys_Query_Pipe_Drop *****************************************
+Description : Query the number of bytes dropped for the current process, because it
+              read too slowly from a "PIPE_MODE_BCAST_DROP" pipe.
+Input       : pipeid_t Pipe_ID - The identifier of the pipe.
+Output      : None.
+Return      : size_t - The number of bytes dropped since the process opened the pipe.
+                       If the pipe does not exist, or the process is not a reader of
+                       the pipe, 0.
+******************************************************************************/
+#if(ENABLE_PIPE==TRUE)
+size_t Sys_Query_Pipe_Drop(pipeid_t Pipe_ID)
+{
+    /* See if the pipe ID is over the boundary, or the pipe does not exist */
+    if((Pipe_ID<0)||(Pipe_ID>=MAX_PIPES)||(Pipe_CB[Pipe_ID].Pipe_Buffer_Size==0))
+        return 0;
+    
+    if(Pipe_CB[Pipe_ID].Reader[Current_PID].Open_Flag==0)
+        return 0;
+    
+    return Pipe_CB[Pipe_ID].Reader[Current_PID].Drop_Number;
+}
+#endif
+/* End Function:Sys_Query_Pipe_Drop ******************************************/
+
+/* Begin Function:_Sys_Wait_Pipe_Reg ******************************************
+Description : When we decide to wait for a pipe, this function will be called.
+              Take note that when the wait is successful, nothing is transferred
+              for the process, and you need to read or write by yourself.
+Input       : pid_t PID - The process waiting for the pipe. It must have opened
+                          the pipe.
+              pipeid_t Pipe_ID - The identifier of the pipe.
+              cnt_t Type - "PIPEREAD" to wait for the data, "PIPEWRITE" to wait
+                           for the free space.
+              struct Wait_Object_Struct* Wait_Block_Ptr - The pointer to the wait block.
+Output      : None.
+Return      : retval_t - If successful,0; if there's no need to wait, "NO_NEED_TO_WAIT(-2)";
+                         if the wait failed, "WAIT_FAILURE(-1)".
+******************************************************************************/
+#if(ENABLE_PIPE==TRUE)
+retval_t _Sys_Wait_Pipe_Reg(pid_t PID,pipeid_t Pipe_ID,cnt_t Type,struct Wait_Object_Struct* Wait_Block_Ptr)
+{
+    /* See if the pipe ID is over the boundary */
+    if((Pipe_ID<0)||(Pipe_ID>=MAX_PIPES))
+        return(WAIT_FAILURE);
+    
+    Sys_Lock_Scheduler();
+    /* See if the pipe exists in the system, and the process have opened it */
+    if((Pipe_CB[Pipe_ID].Pipe_Buffer_Size==0)||(PIPE_OPENED_BY(Pipe_ID,PID)==0))
+    {
+        Sys_Unlock_Scheduler();
+        return(WAIT_FAILURE);
+    }
+    
+    /* See if the trigger level is already reached, or the other side is closed. 
+     * If yes, return right away */
+    if(((Type==PIPEREAD)&&(PIPE_READ_SIZE(Pipe_ID,PID)>=Pipe_CB[Pipe_ID].Read_Trigger))||
+       ((Type==PIPEWRITE)&&(PIPE_FREE_SIZE(Pipe_ID)>=Pipe_CB[Pipe_ID].Write_Trigger))||
+       (Pipe_CB[Pipe_ID].Peer_Closed!=0))
+    {
+        Sys_Unlock_Scheduler();
+        return(NO_NEED_TO_WAIT);
+    }
+    
+    Sys_List_Insert_Node(&(Wait_Block_Ptr->Object_Head),
+                         Pipe_CB[Pipe_ID].Wait_Object_Head.Prev,
+                         &(Pipe_CB[Pipe_ID].Wait_Object_Head));
+    
+    Wait_Block_Ptr->Obj_ID=Pipe_ID;
+    Wait_Block_Ptr->PID=PID;
+    Wait_Block_Ptr->Type=Type;
+    
+    Sys_Unlock_Scheduler();
+    return 0;
+}
+#endif
+/* End Function:_Sys_Wait_Pipe_Reg *******************************************/
 
 /* End Of File ***************************************************************/
 
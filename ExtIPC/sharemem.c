@@ -11,6 +11,13 @@ Description : The shared memory module for the OS. The shared memory module has
               REMEMBER to detach process from the shared memory before it terminates!
               Or a system fault will occur, because the system won't automatically
               detach the process from the shared memory when it terminates!
+              Each region also has a sequence lock. A writer brackets its update
+              with "Sys_Shm_Write_Begin/End", and a reader copies the data between
+              "Sys_Shm_Read_Begin" and "Sys_Shm_Read_Retry", and copies it again if
+              the latter says that the data changed during the copy. The readers
+              never block the writer, and the writers should not race each other.
+              A reader that keeps on failing can wait for the region, and the wait
+              succeeds when a version newer than the one it began to read is written.
 ******************************************************************************/
 
 /* Includes ******************************************************************/
@@ -22,6 +29,7 @@ Description : The shared memory module for the OS. The shared memory module has
 #include "Kernel\scheduler.h"
 #include "Kernel\error.h"
 #include "Memmgr\memory.h"
+#include "ExtIPC\wait.h"
 #include "ExtIPC\sharemem.h"
 #undef __HDR_DEFS__
 
@@ -30,6 +38,7 @@ Description : The shared memory module for the OS. The shared memory module has
 #include "Syslib\syslib.h"
 #include "Kernel\scheduler.h"
 #include "Memmgr\memory.h"
+#include "ExtIPC\wait.h"
 #include "ExtIPC\sharemem.h"
 #undef __HDR_STRUCTS__
 
@@ -43,7 +52,9 @@ Description : The shared memory module for the OS. The shared memory module has
 #include "Kernel\error.h"
 #include "Syslib\syslib.h"
 #include "Memmgr\memory.h"
+#include "ExtIPC\wait.h"
 #include "ExtIPC\sharemem.h"
+#include "Syssvc\timer.h"
 #undef __HDR_PUBLIC_MEMBERS__
 /* End Includes **************************************************************/
 
@@ -68,6 +79,7 @@ void _Sys_Shm_Init(void)
    for(Shm_Cnt=0;Shm_Cnt<MAX_SHMS;Shm_Cnt++)
    {
        Shm_CB[Shm_Cnt].Shm_ID=Shm_Cnt;
+       Sys_Create_List(&(Shm_CB[Shm_Cnt].Wait_Object_Head));
        Sys_List_Insert_Node(&(Shm_CB[Shm_Cnt].Head),&Shm_Empty_List_Head,Shm_Empty_List_Head.Next);
    }
    
@@ -91,6 +103,7 @@ shmid_t Sys_Shm_Create(s8* Shm_Name,size_t Shm_Size)
 {	
     shmid_t Shm_ID;
     void* Shm_Ptr;
+    cnt_t PID_Cnt;
     struct List_Head* Traverse_List_Ptr;
     /* See if the name is an empty pointer, or the buffer size wrong */
     if((Shm_Name==0)||(Shm_Size==0))
@@ -144,10 +157,13 @@ shmid_t Sys_Shm_Create(s8* Shm_Name,size_t Shm_Size)
     Sys_List_Delete_Node(Shm_CB[Shm_ID].Head.Prev,Shm_CB[Shm_ID].Head.Next);
     Sys_List_Insert_Node(&(Shm_CB[Shm_ID].Head),&Shm_List_Head,Shm_List_Head.Next);
     
-    /* Register the values */
+    /* Register the values. Nothing is written or read yet */
     Shm_CB[Shm_ID].Shm_Name=Shm_Name;
     Shm_CB[Shm_ID].Shm_Size=Shm_Size;
     Shm_CB[Shm_ID].Shm_Addr=(ptr_int_t)Shm_Ptr;
+    Shm_CB[Shm_ID].Shm_Seq=0;
+    for(PID_Cnt=0;PID_Cnt<MAX_PROC_NUM;PID_Cnt++)
+        Shm_CB[Shm_ID].Read_Seq[PID_Cnt]=0;
     
     /* Update the statistical variable */
     Shm_In_Sys++;
@@ -192,6 +208,9 @@ retval_t Sys_Shm_Destroy(shmid_t Shm_ID)
         return (-1);
     }
     
+    /* Wake up all the processes waiting for a new version */
+    _Sys_Shm_Wake_All(Shm_ID);
+    
     /* Now we can safely destroy the shared memory block */
     Sys_List_Delete_Node(Shm_CB[Shm_ID].Head.Prev,Shm_CB[Shm_ID].Head.Next);
     Sys_List_Insert_Node(&(Shm_CB[Shm_ID].Head),&Shm_Empty_List_Head,Shm_Empty_List_Head.Next);
@@ -285,6 +304,7 @@ retval_t Sys_Shm_Attach(shmid_t Shm_ID,size_t* Shm_Size,void** Shm_Addr)
     *Shm_Size=Shm_CB[Shm_ID].Shm_Size;
     *Shm_Addr=(void*)Shm_CB[Shm_ID].Shm_Addr;
     
+    Sys_Unlock_Scheduler();
 	return 0;
 }
 #endif
@@ -323,11 +343,242 @@ retval_t Sys_Shm_Detach(shmid_t Shm_ID)
      */
     Shm_CB[Shm_ID].Shm_Attach_Cnt--;
     
+    Sys_Unlock_Scheduler();
     return 0;
 }
 #endif
 /* End Function:Sys_Shm_Detach ***********************************************/
 
+/* Begin Function:_Sys_Shm_Wake_All *******************************************
+Description : Wake up all the processes waiting for the shared memory. This should be
+              called with the scheduler locked.
+Input       : shmid_t Shm_ID - The identifier of the shared memory.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_SHMEM==TRUE)
+void _Sys_Shm_Wake_All(shmid_t Shm_ID)
+{
+    struct Wait_Object_Struct* Wait_Block_Ptr;
+    
+    while(Shm_CB[Shm_ID].Wait_Object_Head.Next!=&(Shm_CB[Shm_ID].Wait_Object_Head))
+    {
+        Wait_Block_Ptr=(struct Wait_Object_Struct*)(Shm_CB[Shm_ID].Wait_Object_Head.Next-1);
+        /* Mark that the wait is successful */
+        Wait_Block_Ptr->Succeed_Flag=1;
+        /* Delete the wait block from the shared memory wait list */
+        Sys_List_Delete_Node(Wait_Block_Ptr->Object_Head.Prev,Wait_Block_Ptr->Object_Head.Next);
+        /* Try to stop the timer if possible */
+        Sys_Proc_Delay_Cancel(Wait_Block_Ptr->PID);
+        /* Wake the process up */
+        _Sys_Set_Ready(Wait_Block_Ptr->PID);
+    }
+}
+#endif
+/* End Function:_Sys_Shm_Wake_All ********************************************/
+
+/* Begin Function:Sys_Shm_Write_Begin *****************************************
+Description : Begin to write a shared memory region. The version of the region
+              becomes odd, so that the readers know that the data may be torn.
+              Only one write can be in progress at a time.
+Input       : shmid_t Shm_ID - The identifier of the shared memory.
+Output      : None.
+Return      : retval_t - If successful,0; else -1.
+******************************************************************************/
+#if(ENABLE_SHMEM==TRUE)
+retval_t Sys_Shm_Write_Begin(shmid_t Shm_ID)
+{
+    /* See if the shared memory ID is over the boundary */
+    if((Shm_ID<0)||(Shm_ID>=MAX_SHMS))
+    {
+        Sys_Set_Errno(EINVSHM);
+        return (-1);
+    }
+    
+    Sys_Lock_Scheduler();
+    /* See if the shared memory exists in the system */
+    if(Shm_CB[Shm_ID].Shm_Size==0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EINVSHM);
+        return (-1);
+    }
+    
+    /* See if some other write is in progress */
+    if((Shm_CB[Shm_ID].Shm_Seq&0x01)!=0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(ESHMWRITE);
+        return (-1);
+    }
+    
+    Shm_CB[Shm_ID].Shm_Seq++;
+    /* The new version must be seen before any of the data is changed */
+    MEMORY_BARRIER();
+    
+    Sys_Unlock_Scheduler();
+    return 0;
+}
+#endif
+/* End Function:Sys_Shm_Write_Begin ******************************************/
+
+/* Begin Function:Sys_Shm_Write_End *******************************************
+Description : End the write of a shared memory region. The version of the region
+              becomes even again, and all the processes waiting for a new version
+              are woken up.
+Input       : shmid_t Shm_ID - The identifier of the shared memory.
+Output      : None.
+Return      : retval_t - If successful,0; else -1.
+******************************************************************************/
+#if(ENABLE_SHMEM==TRUE)
+retval_t Sys_Shm_Write_End(shmid_t Shm_ID)
+{
+    /* See if the shared memory ID is over the boundary */
+    if((Shm_ID<0)||(Shm_ID>=MAX_SHMS))
+    {
+        Sys_Set_Errno(EINVSHM);
+        return (-1);
+    }
+    
+    Sys_Lock_Scheduler();
+    /* See if the shared memory exists in the system */
+    if(Shm_CB[Shm_ID].Shm_Size==0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EINVSHM);
+        return (-1);
+    }
+    
+    /* See if there is a write to end */
+    if((Shm_CB[Shm_ID].Shm_Seq&0x01)==0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(ESHMWRITE);
+        return (-1);
+    }
+    
+    /* All the data must be seen before the new version is */
+    MEMORY_BARRIER();
+    Shm_CB[Shm_ID].Shm_Seq++;
+    
+    _Sys_Shm_Wake_All(Shm_ID);
+    
+    Sys_Unlock_Scheduler();
+    return 0;
+}
+#endif
+/* End Function:Sys_Shm_Write_End ********************************************/
+
+/* Begin Function:Sys_Shm_Read_Begin ******************************************
+Description : Begin to read a shared memory region. This never blocks, and does not
+              lock the scheduler. If a write is in progress, the version returned is
+              the one before it, so that "Sys_Shm_Read_Retry" will always fail. The
+              version is also recorded as the one the process read last time.
+Input       : shmid_t Shm_ID - The identifier of the shared memory.
+Output      : None.
+Return      : u32 - The version of the data. If the shared memory does not exist, 0.
+******************************************************************************/
+#if(ENABLE_SHMEM==TRUE)
+u32 Sys_Shm_Read_Begin(shmid_t Shm_ID)
+{
+    u32 Seq;
+    
+    /* See if the shared memory ID is over the boundary, or it does not exist */
+    if((Shm_ID<0)||(Shm_ID>=MAX_SHMS)||(Shm_CB[Shm_ID].Shm_Size==0))
+    {
+        Sys_Set_Errno(EINVSHM);
+        return 0;
+    }
+    
+    Seq=Shm_CB[Shm_ID].Shm_Seq&(~((u32)0x01));
+    Shm_CB[Shm_ID].Read_Seq[Current_PID]=Seq;
+    /* The version must be read before any of the data is */
+    MEMORY_BARRIER();
+    
+    return Seq;
+}
+#endif
+/* End Function:Sys_Shm_Read_Begin *******************************************/
+
+/* Begin Function:Sys_Shm_Read_Retry ******************************************
+Description : See if the data read since "Sys_Shm_Read_Begin" is consistent. If not,
+              the data should be read again from "Sys_Shm_Read_Begin".
+Input       : shmid_t Shm_ID - The identifier of the shared memory.
+              u32 Seq - The version returned by "Sys_Shm_Read_Begin".
+Output      : None.
+Return      : retval_t - If the data is consistent, 0; if it is changed during the
+                         read, 1; if the shared memory does not exist, -1.
+******************************************************************************/
+#if(ENABLE_SHMEM==TRUE)
+retval_t Sys_Shm_Read_Retry(shmid_t Shm_ID,u32 Seq)
+{
+    /* See if the shared memory ID is over the boundary, or it does not exist */
+    if((Shm_ID<0)||(Shm_ID>=MAX_SHMS)||(Shm_CB[Shm_ID].Shm_Size==0))
+    {
+        Sys_Set_Errno(EINVSHM);
+        return (-1);
+    }
+    
+    /* All the data must be read before the version is read again */
+    MEMORY_BARRIER();
+    if(Shm_CB[Shm_ID].Shm_Seq!=Seq)
+        return 1;
+    
+    return 0;
+}
+#endif
+/* End Function:Sys_Shm_Read_Retry *******************************************/
+
+/* Begin Function:_Sys_Wait_Shm_Reg *******************************************
+Description : When we decide to wait for a shared memory region, this function will
+              be called. The wait succeeds when a version newer than the one the
+              process began to read last time is written.
+Input       : pid_t PID - The process waiting for the shared memory. We don't check
+                          whether the PID is valid here.
+              shmid_t Shm_ID - The identifier of the shared memory.
+              struct Wait_Object_Struct* Wait_Block_Ptr - The pointer to the wait block.
+Output      : None.
+Return      : retval_t - If successful,0; if there's no need to wait, "NO_NEED_TO_WAIT(-2)";
+                         if the wait failed, "WAIT_FAILURE(-1)".
+******************************************************************************/
+#if(ENABLE_SHMEM==TRUE)
+retval_t _Sys_Wait_Shm_Reg(pid_t PID,shmid_t Shm_ID,struct Wait_Object_Struct* Wait_Block_Ptr)
+{
+    /* See if the shared memory ID is over the boundary */
+    if((Shm_ID<0)||(Shm_ID>=MAX_SHMS))
+        return(WAIT_FAILURE);
+    
+    Sys_Lock_Scheduler();
+    
+    /* See if the shared memory exists in the system */
+    if(Shm_CB[Shm_ID].Shm_Size==0)
+    {
+        Sys_Unlock_Scheduler();
+        return(WAIT_FAILURE);
+    }
+    
+    /* See if there is a complete version that the process haven't read. If yes,
+     * return right away */
+    if(((Shm_CB[Shm_ID].Shm_Seq&0x01)==0)&&(Shm_CB[Shm_ID].Shm_Seq!=Shm_CB[Shm_ID].Read_Seq[PID]))
+    {
+        Sys_Unlock_Scheduler();
+        return(NO_NEED_TO_WAIT);
+    }
+    
+    Sys_List_Insert_Node(&(Wait_Block_Ptr->Object_Head),
+                         Shm_CB[Shm_ID].Wait_Object_Head.Prev,
+                         &(Shm_CB[Shm_ID].Wait_Object_Head));
+    
+    Wait_Block_Ptr->Obj_ID=Shm_ID;
+    Wait_Block_Ptr->PID=PID;
+    Wait_Block_Ptr->Type=SHMEM;
+    
+    Sys_Unlock_Scheduler();
+    return 0;
+}
+#endif
+/* End Function:_Sys_Wait_Shm_Reg ********************************************/
+
 /* End Of File ***************************************************************/
 
 /* Copyright (C) 2011-2013 Evo-Devo Instrum. All rights reserved. ************/
@@ -0,0 +1,660 @@
+/******************************************************************************
+Filename    : topic.c
+Author      : pry
+Date        : 19/10/2013
+Version     : 0.01
+Description : The publish/subscribe topic module for the OS. The topics are built
+              on the message queues: each topic has a message queue, and each
+              subscriber receives its samples from the queue as the receiver.
+              A sample is allocated only once by the publisher. What is sent to
+              each subscriber is only a reference to it, stored in the message
+              block, so the sample is never copied. The sample is freed when the
+              last subscriber releases it.
+              Each subscriber can choose the type of samples it wants, and how
+              many samples can wait for it. When its queue is full, either the
+              oldest sample in the queue or the sample being published is dropped
+              for it.
+              Take note that the message queue of a topic takes the name of the
+              topic, so a topic cannot have the same name as a message queue.
+******************************************************************************/
+
+/* Includes ******************************************************************/
+#include "Config\MP_config.h"
+#include "Platform\MP_platform.h"
+
+/* Definition includes */
+#define __HDR_DEFS__
+#include "Kernel\scheduler.h"
+#include "Kernel\error.h"
+#include "Memmgr\memory.h"
+#include "ExtIPC\msgqueue.h"
+#include "ExtIPC\topic.h"
+#undef __HDR_DEFS__
+
+/* Structure includes */
+#define __HDR_STRUCTS__
+#include "Syslib\syslib.h"
+#include "Kernel\scheduler.h"
+#include "Memmgr\memory.h"
+#include "ExtIPC\msgqueue.h"
+#include "ExtIPC\topic.h"
+#undef __HDR_STRUCTS__
+
+/* Private includes */
+#include "ExtIPC\topic.h"
+
+/* Public includes */
+#define __HDR_PUBLIC_MEMBERS__
+#include "Kernel\scheduler.h"
+#include "Kernel\interrupt.h"
+#include "Kernel\error.h"
+#include "Syslib\syslib.h"
+#include "Memmgr\memory.h"
+#include "ExtIPC\msgqueue.h"
+#include "ExtIPC\topic.h"
+#undef __HDR_PUBLIC_MEMBERS__
+/* End Includes **************************************************************/
+
+/* Begin Function:_Sys_Topic_Init *********************************************
+Description : Initialize the topic module.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+void _Sys_Topic_Init(void)
+{
+#if(ENABLE_TOPIC==TRUE)
+    cnt_t Topic_Cnt;
+    
+    /* Initialize the lists */
+    Sys_Create_List(&Topic_List_Head);
+    Sys_Create_List(&Topic_Empty_List_Head);
+    /* Clear the control block */
+    Sys_Memset((ptr_int_t)Topic_CB,0,MAX_TOPICS*sizeof(struct Topic));
+    
+    /* Put the blocks into the empty list */
+    for(Topic_Cnt=0;Topic_Cnt<MAX_TOPICS;Topic_Cnt++)
+    {
+        Topic_CB[Topic_Cnt].Topic_ID=Topic_Cnt;
+        Sys_List_Insert_Node(&(Topic_CB[Topic_Cnt].Head),&Topic_Empty_List_Head,Topic_Empty_List_Head.Next);
+    }
+    
+    /* Clear the statistical variable */
+    Topic_In_Sys=0;
+#endif
+}
+/* End Function:_Sys_Topic_Init **********************************************/
+
+/* Begin Function:Sys_Create_Topic ********************************************
+Description : Create a topic in the system.
+Input       : s8* Topic_Name - The name of the topic.
+              size_t Msg_Number - The most samples that can wait in the queues of
+                                  all the subscribers altogether.
+Output      : None.
+Return      : topicid_t - The ID of the topic. If the function fail, the value
+                          will be -1.
+******************************************************************************/
+#if(ENABLE_TOPIC==TRUE)
+topicid_t Sys_Create_Topic(s8* Topic_Name,size_t Msg_Number)
+{
+    topicid_t Topic_ID;
+    msgqid_t Msg_Queue_ID;
+    struct List_Head* Traverse_List_Ptr;
+    
+    /* See if the name is an empty pointer, or the queue size wrong */
+    if((Topic_Name==0)||(Msg_Number==0))
+    {
+        Sys_Set_Errno(EINVTOPIC);
+        return -1;
+    }
+    
+    Sys_Lock_Scheduler();
+    
+    /* See if there are any empty blocks */
+    if((ptr_int_t)(&Topic_Empty_List_Head)==(ptr_int_t)(Topic_Empty_List_Head.Next))
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(ENOETOPIC);
+        return -1;
+    }
+    
+    Topic_ID=((struct Topic*)Topic_Empty_List_Head.Next)->Topic_ID;
+    
+    /* Traverse the list to see if the name is unique */
+    Traverse_List_Ptr=Topic_List_Head.Next;
+    while((ptr_int_t)Traverse_List_Ptr!=(ptr_int_t)(&Topic_List_Head))
+    {
+        /* If we can find a match, abort */
+        if(Sys_Strcmp(Topic_Name,((struct Topic*)Traverse_List_Ptr)->Topic_Name,MAX_STR_LEN)==0)
+        {
+            Sys_Unlock_Scheduler();
+            Sys_Set_Errno(ETOPICEXIST);
+            return -1;
+        }
+    
+        Traverse_List_Ptr=Traverse_List_Ptr->Next;
+    }
+    
+    /* The message blocks only hold the pointers to the samples */
+    Msg_Queue_ID=Sys_Create_Queue_Inline(Topic_Name,Msg_Number,sizeof(struct Topic_Sample*));
+    if(Msg_Queue_ID==-1)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(ENOETOPIC);
+        return -1;
+    }
+    
+    /* Now we are sure that we have enough resource to set up the topic */
+    Sys_List_Delete_Node(Topic_CB[Topic_ID].Head.Prev,Topic_CB[Topic_ID].Head.Next);
+    Sys_List_Insert_Node(&(Topic_CB[Topic_ID].Head),&Topic_List_Head,Topic_List_Head.Next);
+    
+    /* Register the values. Nobody has subscribed to it yet */
+    Topic_CB[Topic_ID].Topic_Name=Topic_Name;
+    Topic_CB[Topic_ID].Msg_Queue_ID=Msg_Queue_ID;
+    Sys_Memset((ptr_int_t)(Topic_CB[Topic_ID].Sub),0,MAX_PROC_NUM*sizeof(struct Topic_Sub));
+    
+    /* Update the statistical variable */
+    Topic_In_Sys++;
+    
+    Sys_Unlock_Scheduler();
+    return Topic_ID;
+}
+#endif
+/* End Function:Sys_Create_Topic *********************************************/
+
+/* Begin Function:Sys_Destroy_Topic *******************************************
+Description : Destroy a topic in the system. The samples still waiting for the
+              subscribers are released. The samples already received are still
+              valid until they are released. This will fail if some subscriber is
+              just taking a sample out of the topic; try again then.
+Input       : topicid_t Topic_ID - The ID of the topic.
+Output      : None.
+Return      : retval_t - If successful,0; else -1.
+******************************************************************************/
+#if(ENABLE_TOPIC==TRUE)
+retval_t Sys_Destroy_Topic(topicid_t Topic_ID)
+{
+    pid_t PID_Cnt;
+    
+    /* See if the topic ID is over the boundary */
+    if((Topic_ID<0)||(Topic_ID>=MAX_TOPICS))
+    {
+        Sys_Set_Errno(EINVTOPIC);
+        return -1;
+    }
+    
+    Sys_Lock_Scheduler();
+    
+    /* See if the topic exists in the system */
+    if(Topic_CB[Topic_ID].Topic_Name==0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(ENOTOPIC);
+        return -1;
+    }
+    
+    /* Release the samples that are still waiting */
+    for(PID_Cnt=0;PID_Cnt<MAX_PROC_NUM;PID_Cnt++)
+    {
+        while(_Sys_Topic_Drop_Oldest(Topic_ID,PID_Cnt)==0);
+    }
+    
+    /* Destroy the message queue under it */
+    if(Sys_Destroy_Queue(Topic_CB[Topic_ID].Msg_Queue_ID)!=0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EINVTOPIC);
+        return -1;
+    }
+    
+    /* Now we can safely destroy the topic */
+    Sys_List_Delete_Node(Topic_CB[Topic_ID].Head.Prev,Topic_CB[Topic_ID].Head.Next);
+    Sys_List_Insert_Node(&(Topic_CB[Topic_ID].Head),&Topic_Empty_List_Head,Topic_Empty_List_Head.Next);
+    
+    /* Clear the values */
+    Topic_CB[Topic_ID].Topic_Name=0;
+    Topic_CB[Topic_ID].Msg_Queue_ID=-1;
+    Sys_Memset((ptr_int_t)(Topic_CB[Topic_ID].Sub),0,MAX_PROC_NUM*sizeof(struct Topic_Sub));
+    
+    /* Update the statistical variable */
+    Topic_In_Sys--;
+    
+    Sys_Unlock_Scheduler();
+    return 0;
+}
+#endif
+/* End Function:Sys_Destroy_Topic ********************************************/
+
+/* Begin Function:Sys_Get_Topic_ID ********************************************
+Description : Get the topic's unique identifier through the name of it.
+Input       : s8* Topic_Name - The name of the topic.
+Output      : None.
+Return      : topicid_t - The identifier of the topic. If the topic doesn't
+                          exist, then return -1.
+******************************************************************************/
+#if(ENABLE_TOPIC==TRUE)
+topicid_t Sys_Get_Topic_ID(s8* Topic_Name)
+{
+    struct List_Head* Traverse_List_Ptr;
+    
+    Sys_Lock_Scheduler();
+    
+    /* See if the name exists */
+    Traverse_List_Ptr=Topic_List_Head.Next;
+    while((ptr_int_t)Traverse_List_Ptr!=(ptr_int_t)(&Topic_List_Head))
+    {
+        if(Sys_Strcmp(Topic_Name,((struct Topic*)Traverse_List_Ptr)->Topic_Name,MAX_STR_LEN)==0)
+        {
+            Sys_Unlock_Scheduler();
+            return ((struct Topic*)Traverse_List_Ptr)->Topic_ID;
+        }
+    
+        Traverse_List_Ptr=Traverse_List_Ptr->Next;
+    }
+    
+    /* If it can get here, then nothing is found */
+    Sys_Unlock_Scheduler();
+    Sys_Set_Errno(ENOTOPIC);
+    return -1;
+}
+#endif
+/* End Function:Sys_Get_Topic_ID *********************************************/
+
+/* Begin Function:_Sys_Topic_Put_Sample ***************************************
+Description : Drop a reference to a sample, and free it when it is the last one.
+              This should be called with the scheduler locked.
+Input       : struct Topic_Sample* Sample_Ptr - The header of the sample.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_TOPIC==TRUE)
+void _Sys_Topic_Put_Sample(struct Topic_Sample* Sample_Ptr)
+{
+    Sample_Ptr->Ref_Cnt--;
+    
+    /* The sample is freed in the name of the publisher, who allocated it */
+    if(Sample_Ptr->Ref_Cnt==0)
+        _Sys_Mfree(Sample_Ptr->Pub_PID,(void*)Sample_Ptr);
+}
+#endif
+/* End Function:_Sys_Topic_Put_Sample ****************************************/
+
+/* Begin Function:_Sys_Topic_Drop_Oldest **************************************
+Description : Drop the oldest sample waiting for a subscriber. This should be
+              called with the scheduler locked.
+Input       : topicid_t Topic_ID - The ID of the topic.
+              pid_t Sub_PID - The subscriber.
+Output      : None.
+Return      : retval_t - If a sample is dropped, 0; if no sample is waiting, -1.
+******************************************************************************/
+#if(ENABLE_TOPIC==TRUE)
+retval_t _Sys_Topic_Drop_Oldest(topicid_t Topic_ID,pid_t Sub_PID)
+{
+    msgqid_t Msg_Queue_ID;
+    msgqbid_t Msg_Block_ID;
+    void* Msg_Buffer_Ptr;
+    
+    Msg_Queue_ID=Topic_CB[Topic_ID].Msg_Queue_ID;
+    
+    if(Sys_Query_Msg_To_Recver(Sub_PID,Msg_Queue_ID,ALL_TYPE_MSG)==0)
+        return -1;
+    
+    /* Take it out in the name of the subscriber */
+    Msg_Block_ID=_Sys_Recv_Msg(Sub_PID,Msg_Queue_ID,ALL_TYPE_MSG,&Msg_Buffer_Ptr);
+    _Sys_Topic_Put_Sample(*((struct Topic_Sample**)Msg_Buffer_Ptr));
+    Sys_Destroy_Msg(Msg_Queue_ID,Msg_Block_ID);
+    
+    return 0;
+}
+#endif
+/* End Function:_Sys_Topic_Drop_Oldest ***************************************/
+
+/* Begin Function:Sys_Topic_Subscribe *****************************************
+Description : Subscribe to a topic, or change the subscription. The subscriber is
+              automatically the "Current_PID".
+Input       : topicid_t Topic_ID - The ID of the topic.
+              msgtyp_t Msg_Type - The type of the samples wanted. If it equals
+                                  "ALL_TYPE_MSG", all the samples are wanted.
+              size_t Depth - The most samples that can wait for the subscriber.
+              u32 Policy - When the subscriber's queue is full, whether to drop
+                           the oldest sample("TOPIC_DROP_OLDEST") or the newest
+                           one("TOPIC_DROP_NEWEST").
+Output      : None.
+Return      : retval_t - If successful,0; else -1.
+******************************************************************************/
+#if(ENABLE_TOPIC==TRUE)
+retval_t Sys_Topic_Subscribe(topicid_t Topic_ID,msgtyp_t Msg_Type,size_t Depth,u32 Policy)
+{
+    /* See if the parameters are over the boundary */
+    if((Topic_ID<0)||(Topic_ID>=MAX_TOPICS)||(Depth==0)||
+       ((Policy!=TOPIC_DROP_OLDEST)&&(Policy!=TOPIC_DROP_NEWEST)))
+    {
+        Sys_Set_Errno(EINVTOPIC);
+        return -1;
+    }
+    
+    Sys_Lock_Scheduler();
+    
+    /* See if the topic exists in the system */
+    if(Topic_CB[Topic_ID].Topic_Name==0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(ENOTOPIC);
+        return -1;
+    }
+    
+    /* A new subscriber has not dropped anything */
+    if(Topic_CB[Topic_ID].Sub[Current_PID].Sub_Depth==0)
+        Topic_CB[Topic_ID].Sub[Current_PID].Sub_Drop_Number=0;
+    
+    Topic_CB[Topic_ID].Sub[Current_PID].Sub_Depth=Depth;
+    Topic_CB[Topic_ID].Sub[Current_PID].Sub_Type=Msg_Type;
+    Topic_CB[Topic_ID].Sub[Current_PID].Sub_Policy=Policy;
+    
+    Sys_Unlock_Scheduler();
+    return 0;
+}
+#endif
+/* End Function:Sys_Topic_Subscribe ******************************************/
+
+/* Begin Function:Sys_Topic_Unsubscribe ***************************************
+Description : Cancel the subscription to a topic. The samples still waiting for
+              the subscriber are released. The subscriber is automatically the
+              "Current_PID".
+Input       : topicid_t Topic_ID - The ID of the topic.
+Output      : None.
+Return      : retval_t - If successful,0; else -1.
+******************************************************************************/
+#if(ENABLE_TOPIC==TRUE)
+retval_t Sys_Topic_Unsubscribe(topicid_t Topic_ID)
+{
+    /* See if the topic ID is over the boundary */
+    if((Topic_ID<0)||(Topic_ID>=MAX_TOPICS))
+    {
+        Sys_Set_Errno(EINVTOPIC);
+        return -1;
+    }
+    
+    Sys_Lock_Scheduler();
+    
+    /* See if we have subscribed to the topic */
+    if((Topic_CB[Topic_ID].Topic_Name==0)||(Topic_CB[Topic_ID].Sub[Current_PID].Sub_Depth==0))
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(ENOTOPIC);
+        return -1;
+    }
+    
+    Topic_CB[Topic_ID].Sub[Current_PID].Sub_Depth=0;
+    while(_Sys_Topic_Drop_Oldest(Topic_ID,Current_PID)==0);
+    
+    Sys_Unlock_Scheduler();
+    return 0;
+}
+#endif
+/* End Function:Sys_Topic_Unsubscribe ****************************************/
+
+/* Begin Function:Sys_Topic_Alloc *********************************************
+Description : Allocate a sample to be published to a topic. The sample is allocated
+              in the name of the "Current_PID".
+Input       : topicid_t Topic_ID - The ID of the topic.
+              msgtyp_t Msg_Type - The type of the sample.
+              size_t Size - The size of the sample.
+Output      : None.
+Return      : void* - The sample buffer. If the function fails, 0.
+******************************************************************************/
+#if(ENABLE_TOPIC==TRUE)
+void* Sys_Topic_Alloc(topicid_t Topic_ID,msgtyp_t Msg_Type,size_t Size)
+{
+    struct Topic_Sample* Sample_Ptr;
+    
+    /* See if the parameters are over the boundary */
+    if((Topic_ID<0)||(Topic_ID>=MAX_TOPICS)||(Size==0))
+    {
+        Sys_Set_Errno(EINVTOPIC);
+        return 0;
+    }
+    
+    Sys_Lock_Scheduler();
+    
+    /* See if the topic exists in the system */
+    if(Topic_CB[Topic_ID].Topic_Name==0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(ENOTOPIC);
+        return 0;
+    }
+    
+    Sample_Ptr=(struct Topic_Sample*)_Sys_Malloc_Caller(Current_PID,sizeof(struct Topic_Sample)+Size,
+                                                        MEM_TRACE_CALLER_ADDR());
+    if(Sample_Ptr==0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(ENOETOPIC);
+        return 0;
+    }
+    
+    /* Nobody holds the sample before it is published */
+    Sample_Ptr->Ref_Cnt=0;
+    Sample_Ptr->Pub_PID=Current_PID;
+    Sample_Ptr->Msg_Type=Msg_Type;
+    Sample_Ptr->Size=Size;
+    
+    Sys_Unlock_Scheduler();
+    return (void*)(Sample_Ptr+1);
+}
+#endif
+/* End Function:Sys_Topic_Alloc **********************************************/
+
+/* Begin Function:Sys_Topic_Publish *******************************************
+Description : Publish a sample to all the subscribers that want its type. Each of
+              them gets a reference to the sample. If nobody takes the sample, it
+              is freed at once. After this, the publisher shall not touch the
+              sample anymore.
+Input       : topicid_t Topic_ID - The ID of the topic.
+              void* Sample - The sample buffer returned by "Sys_Topic_Alloc".
+Output      : None.
+Return      : cnt_t - The number of subscribers that got the sample. If the topic
+                      does not exist, -1.
+******************************************************************************/
+#if(ENABLE_TOPIC==TRUE)
+cnt_t Sys_Topic_Publish(topicid_t Topic_ID,void* Sample)
+{
+    struct Topic_Sample* Sample_Ptr;
+    struct Topic_Sub* Sub_Ptr;
+    msgqid_t Msg_Queue_ID;
+    msgqbid_t Msg_Block_ID;
+    void* Msg_Buffer_Ptr;
+    pid_t PID_Cnt;
+    cnt_t Sub_Cnt;
+    cnt_t Drop_Flag;
+    
+    /* See if the parameters are over the boundary */
+    if((Topic_ID<0)||(Topic_ID>=MAX_TOPICS)||(Sample==0))
+    {
+        Sys_Set_Errno(EINVTOPIC);
+        return -1;
+    }
+    
+    Sample_Ptr=TOPIC_SAMPLE_PTR(Sample);
+    
+    Sys_Lock_Scheduler();
+    
+    /* See if the topic exists in the system */
+    if(Topic_CB[Topic_ID].Topic_Name==0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(ENOTOPIC);
+        return -1;
+    }
+    
+    Msg_Queue_ID=Topic_CB[Topic_ID].Msg_Queue_ID;
+    Sub_Cnt=0;
+    
+    for(PID_Cnt=0;PID_Cnt<MAX_PROC_NUM;PID_Cnt++)
+    {
+        Sub_Ptr=&(Topic_CB[Topic_ID].Sub[PID_Cnt]);
+    
+        /* See if the process wants the sample */
+        if((Sub_Ptr->Sub_Depth==0)||
+           ((Sub_Ptr->Sub_Type!=ALL_TYPE_MSG)&&(Sub_Ptr->Sub_Type!=Sample_Ptr->Msg_Type)))
+            continue;
+    
+        /* If its queue is full, drop something for it */
+        Drop_Flag=0;
+        if(Sys_Query_Msg_To_Recver(PID_Cnt,Msg_Queue_ID,ALL_TYPE_MSG)>=Sub_Ptr->Sub_Depth)
+        {
+            Sub_Ptr->Sub_Drop_Number++;
+            if(Sub_Ptr->Sub_Policy==TOPIC_DROP_NEWEST)
+                continue;
+    
+            _Sys_Topic_Drop_Oldest(Topic_ID,PID_Cnt);
+            Drop_Flag=1;
+        }
+    
+        /* The message only carries the reference. If the queue has no blocks left,
+         * the sample is dropped for the subscriber. Only one drop is counted for 
+         * each publish, even if the oldest one is already dropped for it.
+         */
+        Msg_Block_ID=_Sys_Alloc_Msg(Sample_Ptr->Pub_PID,Msg_Queue_ID,Sample_Ptr->Msg_Type,
+                                    sizeof(struct Topic_Sample*),&Msg_Buffer_Ptr);
+        if(Msg_Block_ID==-1)
+        {
+            if(Drop_Flag==0)
+                Sub_Ptr->Sub_Drop_Number++;
+            continue;
+        }
+    
+        *((struct Topic_Sample**)Msg_Buffer_Ptr)=Sample_Ptr;
+        Sample_Ptr->Ref_Cnt++;
+        Sys_Send_Msg(PID_Cnt,Msg_Queue_ID,Msg_Block_ID);
+        Sub_Cnt++;
+    }
+    
+    /* If nobody takes it, free it now */
+    if(Sample_Ptr->Ref_Cnt==0)
+        _Sys_Mfree_Caller(Sample_Ptr->Pub_PID,(void*)Sample_Ptr,MEM_TRACE_CALLER_ADDR());
+    
+    Sys_Unlock_Scheduler();
+    return Sub_Cnt;
+}
+#endif
+/* End Function:Sys_Topic_Publish ********************************************/
+
+/* Begin Function:Sys_Topic_Recv **********************************************
+Description : Receive the oldest sample waiting for the subscriber, and if there
+              is none, wait until one comes or the time is up. The subscriber is
+              automatically the "Current_PID". The sample must be released with
+              "Sys_Topic_Release" when it is no longer needed.
+Input       : topicid_t Topic_ID - The ID of the topic.
+              time_t Time - The longest time to wait. If the time is "WAIT_INFINITE",
+                            then the process will wait until it gets a sample.
+Output      : msgtyp_t* Msg_Type - The type of the sample.
+Return      : void* - The sample buffer. If no sample comes before the time is up,
+                      or the parameters are wrong, 0.
+******************************************************************************/
+#if(ENABLE_TOPIC==TRUE)
+void* Sys_Topic_Recv(topicid_t Topic_ID,msgtyp_t* Msg_Type,time_t Time)
+{
+    struct Topic_Sample* Sample_Ptr;
+    msgqid_t Msg_Queue_ID;
+    msgqbid_t Msg_Block_ID;
+    void* Msg_Buffer_Ptr;
+    
+    /* See if the parameters are over the boundary */
+    if((Topic_ID<0)||(Topic_ID>=MAX_TOPICS)||(Msg_Type==0))
+    {
+        Sys_Set_Errno(EINVTOPIC);
+        return 0;
+    }
+    
+    Sys_Lock_Scheduler();
+    
+    /* See if the topic exists in the system */
+    if(Topic_CB[Topic_ID].Topic_Name==0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(ENOTOPIC);
+        return 0;
+    }
+    
+    Msg_Queue_ID=Topic_CB[Topic_ID].Msg_Queue_ID;
+    
+    Sys_Unlock_Scheduler();
+    
+    /* The publisher hands the reference to us directly if we are waiting */
+    Msg_Block_ID=Sys_Recv_Msg_Wait(Msg_Queue_ID,ALL_TYPE_MSG,&Msg_Buffer_Ptr,Time);
+    if(Msg_Block_ID==-1)
+        return 0;
+    
+    /* We hold the reference now, and the message block is no longer needed */
+    Sample_Ptr=*((struct Topic_Sample**)Msg_Buffer_Ptr);
+    Sys_Destroy_Msg(Msg_Queue_ID,Msg_Block_ID);
+    
+    *Msg_Type=Sample_Ptr->Msg_Type;
+    return (void*)(Sample_Ptr+1);
+}
+#endif
+/* End Function:Sys_Topic_Recv ***********************************************/
+
+/* Begin Function:Sys_Topic_Release *******************************************
+Description : Release a sample received from a topic. When all the subscribers
+              that got it have released it, it is freed.
+Input       : void* Sample - The sample buffer returned by "Sys_Topic_Recv".
+Output      : None.
+Return      : retval_t - If successful,0; else -1.
+******************************************************************************/
+#if(ENABLE_TOPIC==TRUE)
+retval_t Sys_Topic_Release(void* Sample)
+{
+    struct Topic_Sample* Sample_Ptr;
+    
+    if(Sample==0)
+    {
+        Sys_Set_Errno(EINVTOPIC);
+        return -1;
+    }
+    
+    Sample_Ptr=TOPIC_SAMPLE_PTR(Sample);
+    
+    Sys_Lock_Scheduler();
+    
+    /* See if the sample is still held by somebody */
+    if(Sample_Ptr->Ref_Cnt<=0)
+    {
+        Sys_Unlock_Scheduler();
+        Sys_Set_Errno(EINVTOPIC);
+        return -1;
+    }
+    
+    _Sys_Topic_Put_Sample(Sample_Ptr);
+    
+    Sys_Unlock_Scheduler();
+    return 0;
+}
+#endif
+/* End Function:Sys_Topic_Release ********************************************/
+
+/* Begin Function:Sys_Query_Topic_Drop ****************************************
+Description : Query the number of samples dropped for the subscriber, because its
+              queue is full. The subscriber is automatically the "Current_PID".
+Input       : topicid_t Topic_ID - The ID of the topic.
+Output      : None.
+Return      : size_t - The number of samples dropped. If the topic does not exist,
+                       it will also return 0.
+******************************************************************************/
+#if(ENABLE_TOPIC==TRUE)
+size_t Sys_Query_Topic_Drop(topicid_t Topic_ID)
+{
+    /* See if the topic ID is over the boundary */
+    if((Topic_ID<0)||(Topic_ID>=MAX_TOPICS))
+        return 0;
+    
+    return Topic_CB[Topic_ID].Sub[Current_PID].Sub_Drop_Number;
+}
+#endif
+/* End Function:Sys_Query_Topic_Drop *****************************************/
+
+/* End Of File ***************************************************************/
+
+/* Copyright (C) 2011-2013 Evo-Devo Instrum. All rights reserved. ************/
@@ -3,14 +3,26 @@ Filename    : wait.c
 Author      : pry
 Date        : 05/07/2013
 Version     : 0.01
-Description : The wait kernel object module for the RMV RTOS. Only the ExtIPCs other
-              than pipes and shared memory can be wait.
+Description : The wait kernel object module for the RMV RTOS. All the ExtIPCs can
+              be wait.
               The implications of "wait":
               1>Once the object is deleted, then the function will return as failed;
               2>For different kernel objects, there are different implications for
-                waiting a kernel object.
-              
-              Take note that you cannot wait for a pipe or a shared memory region.
+                waiting a kernel object;
+              3>The memory can also be waited for. The object ID is then the size
+                needed, and the wait succeeds when a big enough block is freed.
+              4>The spare message blocks of a message queue can also be waited for.
+                The object ID is then the queue ID, and the wait succeeds when a
+                message block of the queue is destroyed.
+              5>When waiting for a mailbox, the wait succeeds when a value newer than
+                the last one read by the process is posted.
+              6>When waiting for a pipe, "PIPEREAD" succeeds when the data in the pipe
+                reaches its read trigger level, and "PIPEWRITE" succeeds when the free
+                space in the pipe reaches its write trigger level.
+              7>When waiting for a shared memory region, the wait succeeds when a
+                version newer than the last one the process began to read is
+                written. This only makes sense for the regions written with the
+                "Sys_Shm_Write_Begin/End" pair.
 ******************************************************************************/
 
 /* Includes ******************************************************************/
@@ -47,7 +59,11 @@ Description : The wait kernel object module for the RMV RTOS. Only the ExtIPCs o
 #include "ExtIPC\mutex.h"
 #include "ExtIPC\semaphore.h"
 #include "ExtIPC\msgqueue.h"
+#include "ExtIPC\mailbox.h"
+#include "ExtIPC\pipe.h"
+#include "ExtIPC\sharemem.h"
 #include "ExtIPC\wait.h"
+#include "Memmgr\memory.h"
 
 #include "Syslib\syslib.h"
 #include "Syssvc\timer.h"
@@ -121,6 +137,20 @@ cnt_t Sys_Wait_Object(cnt_t Object_ID,cnt_t Object_Type,time_t Time)
         case MUTEX:Retval=_Sys_Wait_Mutex_Reg(Current_PID,Object_ID,Wait_Block_Ptr);break;
         case SEMAPHORE:Retval=_Sys_Wait_Sem_Reg(Current_PID,Object_ID,Wait_Block_Ptr);break;
         case MSGQUEUE:Retval=_Sys_Wait_Msg_Queue_Reg(Current_PID,Object_ID,Wait_Block_Ptr);break;
+#if(ENABLE_MEMM==TRUE)
+        case MEMORY:Retval=_Sys_Wait_Mem_Reg(Current_PID,(size_t)Object_ID,Wait_Block_Ptr);break;
+#endif
+        case MSGBLOCK:Retval=_Sys_Wait_Msg_Block_Reg(Current_PID,Object_ID,Wait_Block_Ptr);break;
+#if(ENABLE_MBOX==TRUE)
+        case MAILBOX:Retval=_Sys_Wait_Mbox_Reg(Current_PID,Object_ID,Wait_Block_Ptr);break;
+#endif
+#if(ENABLE_PIPE==TRUE)
+        case PIPEREAD:
+        case PIPEWRITE:Retval=_Sys_Wait_Pipe_Reg(Current_PID,Object_ID,Object_Type,Wait_Block_Ptr);break;
+#endif
+#if(ENABLE_SHMEM==TRUE)
+        case SHMEM:Retval=_Sys_Wait_Shm_Reg(Current_PID,Object_ID,Wait_Block_Ptr);break;
+#endif
         default:Retval=WAIT_FAILURE;break;
     }
     
@@ -239,6 +269,20 @@ cnt_t Sys_Wait_Multi_Objects(cnt_t* Object_ID,cnt_t* Object_Type,cnt_t Object_Nu
             case MUTEX:Retval=_Sys_Wait_Mutex_Reg(Current_PID,Object_ID[Obj_Number_Cnt],Wait_Block_Ptr);break;
             case SEMAPHORE:Retval=_Sys_Wait_Sem_Reg(Current_PID,Object_ID[Obj_Number_Cnt],Wait_Block_Ptr);break;
             case MSGQUEUE:Retval=_Sys_Wait_Msg_Queue_Reg(Current_PID,Object_ID[Obj_Number_Cnt],Wait_Block_Ptr);break;
+#if(ENABLE_MEMM==TRUE)
+            case MEMORY:Retval=_Sys_Wait_Mem_Reg(Current_PID,(size_t)Object_ID[Obj_Number_Cnt],Wait_Block_Ptr);break;
+#endif
+            case MSGBLOCK:Retval=_Sys_Wait_Msg_Block_Reg(Current_PID,Object_ID[Obj_Number_Cnt],Wait_Block_Ptr);break;
+#if(ENABLE_MBOX==TRUE)
+            case MAILBOX:Retval=_Sys_Wait_Mbox_Reg(Current_PID,Object_ID[Obj_Number_Cnt],Wait_Block_Ptr);break;
+#endif
+#if(ENABLE_PIPE==TRUE)
+            case PIPEREAD:
+            case PIPEWRITE:Retval=_Sys_Wait_Pipe_Reg(Current_PID,Object_ID[Obj_Number_Cnt],Object_Type[Obj_Number_Cnt],Wait_Block_Ptr);break;
+#endif
+#if(ENABLE_SHMEM==TRUE)
+            case SHMEM:Retval=_Sys_Wait_Shm_Reg(Current_PID,Object_ID[Obj_Number_Cnt],Wait_Block_Ptr);break;
+#endif
             default:Retval=WAIT_FAILURE;break;
         }
         
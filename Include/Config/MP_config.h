@@ -49,7 +49,9 @@ Description : The RMP system configuration file.
 /* The maximum number of priority levels */
 #define MAX_PRIO_NUM                20
 /* The maximum number of processes running at the same time */ 
+#ifndef MAX_PROC_NUM
 #define MAX_PROC_NUM                7
+#endif
 /* The maximum stack depth in bytes */	                                              
 #define MAX_STACK_DEP               100                                              						
 /* System timer. In CM3, cannot be bigger than 0xFFFFFF */
@@ -69,12 +71,51 @@ Description : The RMP system configuration file.
 /* Memory Management Configuration *******************************************/
 /* Switch */
 #define ENABLE_MEMM 	            TRUE	
+/* The heap layout below can be overridden from the compiler command line, so
+ * that the host benchmark can try other settings.
+ */
 /* Application memory size */
+#ifndef DMEM_SIZE
 #define DMEM_SIZE	                0x2000				                   
+#endif
 /* The first/second level segregation table length and width for the OS. The SLI
- * is fixed to 8.
+ * can be 4, 8, 16 or 32.
  */
+#ifndef MM_FLI
 #define MM_FLI                      10      
+#endif
+#ifndef MM_SLI
+#define MM_SLI                      8
+#endif
+/* The minimum block size is 2^MM_MIN_ORDER(+8) bytes. Must not be smaller than
+ * log2(MM_SLI). Remember to adjust MM_FLI so that 2^(MM_MIN_ORDER+MM_FLI) is 
+ * bigger than DMEM_SIZE.
+ */
+#ifndef MM_MIN_ORDER
+#define MM_MIN_ORDER                6
+#endif
+/* The interrupt reserve for "Sys_Malloc_ISR": the number of blocks and the size
+ * of each block(A multiple of 8 and not smaller than 8). Set the number to 0 to
+ * disable the reserve.
+ */
+#define MEM_ISR_BLOCKS              4
+#define MEM_ISR_BLOCK_SIZE          128
+/* The free memory watermarks in bytes. When the free memory drops below the low
+ * one, or rises back to the high one, the subscribed processes will get a signal.
+ * Set the low one to 0 to disable this.
+ */
+#define MEM_LOW_WATERMARK           0x400
+#define MEM_HIGH_WATERMARK          0x800
+/* Relocatable memory through handles, and the heap compactor run by "Arch" */
+#define ENABLE_MEM_HANDLE           TRUE
+/* The maximum number of handles in the system */
+#define MAX_MEM_HANDLES             16
+/* The most blocks that the compactor moves each time it runs */
+#define MEM_COMPACT_STEPS           1
+/* Record each allocation and free into a trace ring buffer for leak analysis */
+#define ENABLE_MEM_TRACE            FALSE
+/* The number of records in the trace ring buffer. Must be a power of 2 */
+#define MEM_TRACE_DEPTH             64
 /* End Memory Manegement Configuration ***************************************/
 
 /* Semaphore Configuration ***************************************************/
@@ -109,8 +150,33 @@ Description : The RMP system configuration file.
 /* Message Queue Configuration ***********************************************/
 #define ENABLE_MSGQ                 TRUE
 #define MAX_MSG_QUEUES              6
+/* The messages to each receiver can be further segregated by the message type into
+ * this many buckets(the type modulo the number), so that receiving a certain type 
+ * does not need to look at the other types. Must be a power of 2; 0 means no buckets.
+ */
+#ifndef MSGQ_TYPE_BUCKETS
+#define MSGQ_TYPE_BUCKETS           0
+#endif
+/* The number of message priorities, within 1 and 32. The messages of a higher 
+ * priority are received first.
+ */
+#define MSGQ_PRIO_NUM               4
 /* End Message Queue Configuration *******************************************/
 
+/* Publish/Subscribe Topic Configuration *************************************/
+/* Switch. The topics are built on the message queues, so enable them first */
+#define ENABLE_TOPIC                TRUE
+/* The maximum number of topics in the system. Each takes a message queue */
+#define MAX_TOPICS                  2
+/* End Publish/Subscribe Topic Configuration *********************************/
+
+/* Mailbox Configuration *****************************************************/
+/* Switch */
+#define ENABLE_MBOX                 TRUE
+/* The maximum number of latest-value mailboxes in the system */
+#define MAX_MBOXES                  4
+/* End Mailbox Configuration *************************************************/
+
 /* Wait For Object Configuration *********************************************/
 #define MAX_WAIT_BLOCKS             10
 /* End Wait For Object Configuration *****************************************/
@@ -0,0 +1,172 @@
+/******************************************************************************
+Filename    : mailbox.h
+Author      : pry
+Date        : 19/10/2013
+Description : The latest-value mailbox module for the OS.
+******************************************************************************/
+
+/* Config Includes ***********************************************************/
+#include "Config\MP_config.h"
+#include "Platform\MP_platform.h"
+/* End Config Includes *******************************************************/
+
+/* Defines *******************************************************************/
+#ifdef __HDR_DEFS__
+#ifndef __MAILBOX_H_DEFS__
+#define __MAILBOX_H_DEFS__
+/*****************************************************************************/
+/* The slot that holds the value of a certain sequence number */
+#define MBOX_SLOT_PTR(MBOX_ID,SEQ) \
+((struct Mbox_Slot*)(Mbox_CB[(MBOX_ID)].Mbox_Addr+((SEQ)%Mbox_CB[(MBOX_ID)].Slot_Number)*Mbox_CB[(MBOX_ID)].Slot_Stride))
+
+/* Errors */
+/* Such mailbox is not existent in the system */
+#define ENOMBOX             0x00
+/* Invalid mailbox (parameters) */
+#define EINVMBOX            0x01
+/* No empty mailbox control blocks, or no enough memory for the mailbox */
+#define ENOEMBOX            0x02
+/* The mailbox with the same name already exists */
+#define EMBOXEXIST          0x03
+/* The value wanted is not posted yet, or is already overwritten */
+#define EMBOXEMPTY          0x04
+/*****************************************************************************/
+
+/* __MAILBOX_H_DEFS__ */
+#endif
+/* __HDR_DEFS__ */
+#endif
+/* End Defines ***************************************************************/
+
+/* Structs *******************************************************************/
+#ifdef __HDR_STRUCTS__
+#ifndef __MAILBOX_H_STRUCTS__
+#define __MAILBOX_H_STRUCTS__
+/* We used structs in the header */
+#include "Syslib\syslib.h"
+
+/* Use defines in these headers */
+#define __HDR_DEFS__
+#include "Syslib\syslib.h"
+#undef __HDR_DEFS__
+/*****************************************************************************/
+/* The struct of the mailbox */
+struct Mbox
+{
+    struct List_Head Head;
+    s8* Mbox_Name;
+    mboxid_t Mbox_ID;
+    /* The biggest value that a slot can hold */
+    size_t Slot_Size;
+    /* The number of the latest values kept */
+    size_t Slot_Number;
+    /* The size of a slot, including its header */
+    size_t Slot_Stride;
+    /* The sequence number of the latest value. If nothing is posted yet, 0 */
+    u32 Mbox_Seq;
+    /* The sequence number of the value each process read last time */
+    u32 Read_Seq[MAX_PROC_NUM];
+    /* The processes waiting for a newer value */
+    struct List_Head Wait_Object_Head;
+    /* The start address of the slots */
+    ptr_int_t Mbox_Addr;
+};
+
+/* The header of a slot. The value follows it */
+struct Mbox_Slot
+{
+    /* The sequence number of the value in the slot */
+    u32 Seq;
+    /* The size of the value in the slot */
+    size_t Size;
+};
+/*****************************************************************************/
+
+/* __MAILBOX_H_STRUCTS__ */
+#endif
+/* __HDR_STRUCTS__ */
+#endif
+/* End Structs ***************************************************************/
+
+/* Private Global Variables **************************************************/
+#if(!(defined __HDR_DEFS__||defined __HDR_STRUCTS__))
+#ifndef __MAILBOX_MEMBERS__
+#define __MAILBOX_MEMBERS__
+/* In this way we can use the data structures in the headers */
+#define __HDR_DEFS__
+#include "ExtIPC\mailbox.h"
+#undef __HDR_DEFS__
+#define __HDR_STRUCTS__
+#include "ExtIPC\mailbox.h"
+#include "ExtIPC\wait.h"
+#undef __HDR_STRUCTS__
+
+/* If the header is not used in the public mode */
+#ifndef __HDR_PUBLIC_MEMBERS__
+
+/*****************************************************************************/
+/* Mailbox list header */
+struct List_Head Mbox_List_Head;
+/* Empty block list header */
+struct List_Head Mbox_Empty_List_Head;
+/* Mailbox control block */
+struct Mbox Mbox_CB[MAX_MBOXES];
+/* Mailbox number counter */
+size_t Mbox_In_Sys;
+/*****************************************************************************/
+
+/* End Private Global Variables **********************************************/
+
+/* Private C Function Prototypes *********************************************/
+/*****************************************************************************/
+#if(ENABLE_MBOX==TRUE)
+static void _Sys_Mbox_Wake_All(mboxid_t Mbox_ID);
+static void _Sys_Mbox_Get(mboxid_t Mbox_ID,u32 Seq,void* Buffer,size_t* Size);
+#endif
+/*****************************************************************************/
+#define __EXTERN__
+/* End Private C Function Prototypes *****************************************/
+
+/* Public Global Variables ***************************************************/
+/* __HDR_PUBLIC_MEMBERS__ */
+#else
+#define __EXTERN__ EXTERN
+/* __HDR_PUBLIC_MEMBERS__ */
+#endif
+
+#if(ENABLE_MBOX==TRUE)
+/*****************************************************************************/
+
+/*****************************************************************************/
+#endif
+/* End Public Global Variables ***********************************************/
+
+/* Public C Function Prototypes **********************************************/
+__EXTERN__ void _Sys_Mbox_Init(void);
+#if(ENABLE_MBOX==TRUE)
+/*****************************************************************************/
+__EXTERN__ mboxid_t Sys_Create_Mbox(s8* Mbox_Name,size_t Slot_Size,size_t Slot_Number);
+__EXTERN__ retval_t Sys_Destroy_Mbox(mboxid_t Mbox_ID);
+__EXTERN__ mboxid_t Sys_Get_Mbox_ID(s8* Mbox_Name);
+
+__EXTERN__ u32 Sys_Mbox_Post(mboxid_t Mbox_ID,void* Value,size_t Size);
+__EXTERN__ u32 Sys_Mbox_Read(mboxid_t Mbox_ID,void* Buffer,size_t* Size);
+__EXTERN__ u32 Sys_Mbox_Read_Wait(mboxid_t Mbox_ID,void* Buffer,size_t* Size,time_t Time);
+__EXTERN__ retval_t Sys_Mbox_Read_Seq(mboxid_t Mbox_ID,u32 Seq,void* Buffer,size_t* Size);
+__EXTERN__ u32 Sys_Query_Mbox_Seq(mboxid_t Mbox_ID);
+
+__EXTERN__ retval_t _Sys_Wait_Mbox_Reg(pid_t PID,mboxid_t Mbox_ID,struct Wait_Object_Struct* Wait_Block_Ptr);
+/*****************************************************************************/
+#endif
+
+/* Undefine "__EXTERN__" to avoid redefinition */
+#undef __EXTERN__
+/* __MAILBOX_MEMBERS__ */
+#endif
+/* !(defined __HDR_DEFS__||defined __HDR_STRUCTS__) */
+#endif
+/* End Public C Function Prototypes ******************************************/
+
+/*End Of File*****************************************************************/
+
+/*Copyright (C) 2011-2013 pry. All rights reserved.***************************/
@@ -26,6 +26,18 @@ Description : The queue module for the OS.
 #define ALL_TYPE_MSG 0xFFFFFFFF
 /* Query the number of a certain type to all processes */
 #define ALL_PROC_MSG MAX_PROC_NUM
+/* The lowest and the highest message priorities */
+#define MSG_PRIO_LOWEST     0
+#define MSG_PRIO_URGENT     (MSGQ_PRIO_NUM-1)
+#if((MSGQ_PRIO_NUM<1)||(MSGQ_PRIO_NUM>32))
+#error "MSGQ_PRIO_NUM must be within 1 and 32."
+#endif
+
+/* The message block of a certain ID. Each block is followed by its inline message area */
+#define MSG_BLOCK_PTR(QUEUE_ID,BLOCK_ID) \
+((struct Msg_Block*)(Msg_CB[(QUEUE_ID)].Msg_Queue_Start_Addr+(BLOCK_ID)*Msg_CB[(QUEUE_ID)].Msg_Block_Size))
+/* The start address of the inline message area of a message block */
+#define MSG_INLINE_ADDR(BLOCK_PTR)       ((ptr_int_t)(((struct Msg_Block*)(BLOCK_PTR))+1))
 
 /* There's no message to the receiver */
 #define ENOMSG      (-1)
@@ -60,9 +72,21 @@ Description : The queue module for the OS.
 struct Msg_Queue
 {
     struct List_Head Head;
-    struct List_Head Msg_Block_Queue_Head;
     struct List_Head Msg_Block_Empty_Head;
-    struct List_Head Wait_Object_Head;
+    /* The messages in the queue, one list for each receiver and each priority */
+    struct List_Head Msg_Recv_Head[MAX_PROC_NUM][MSGQ_PRIO_NUM];
+    /* The priorities that each receiver has messages of */
+    u32 Msg_Prio_Bitmap[MAX_PROC_NUM];
+#if(MSGQ_TYPE_BUCKETS!=0)
+    /* The messages to each receiver again, segregated by the message type */
+    struct List_Head Msg_Type_Head[MAX_PROC_NUM][MSGQ_TYPE_BUCKETS];
+#endif
+    /* The processes waiting for their messages, one list for each receiver */
+    struct List_Head Wait_Object_Head[MAX_PROC_NUM];
+    /* The processes waiting for spare message blocks, the higher priority ones first */
+    struct List_Head Alloc_Wait_Head;
+    /* The number of messages to each receiver */
+    size_t Msg_Recv_Number[MAX_PROC_NUM];
     
     /* The name of the message queue */
     s8* Msg_Queue_Name;
@@ -78,21 +102,42 @@ struct Msg_Queue
      * pointer.
      */
     ptr_int_t Msg_Queue_Start_Addr;
+    /* The biggest message that can be stored in the message block itself */
+    size_t Msg_Inline_Size;
+    /* The size of a message block, including the inline message area */
+    size_t Msg_Block_Size;
 };
 
 /* The struct of the message itself */
 struct Msg_Block
 {
     struct List_Head Head;
+#if(MSGQ_TYPE_BUCKETS!=0)
+    /* This is inserted into the list of the message type bucket */
+    struct List_Head Type_Head;
+#endif
     u32 Msg_Block_List_ID;
     msgqid_t Msg_Queue_ID;
     msgqbid_t Msg_Block_ID;
     msgtyp_t Msg_Type;
+    /* The priority of the message */
+    prio_t Msg_Prio;
     /* This pointer points to the start address of the immediate message */
     ptr_int_t Msg_Addr_Ptr;
     pid_t Msg_Send_PID;
     pid_t Msg_Recv_PID;
 };
+
+/* The struct of a process receiving with "Sys_Recv_Msg_Wait" */
+struct Msg_Recv_Wait
+{
+    /* The queue it is receiving from. If it is not receiving, -1 */
+    msgqid_t Msg_Queue_ID;
+    /* The type of the message it wants */
+    msgtyp_t Msg_Type;
+    /* The block handed to it by the sender. If nothing is handed to it yet, -1 */
+    msgqbid_t Msg_Block_ID;
+};
 /*****************************************************************************/
 
 /* __MSGQUEUE_H_STRUCTS__ */
@@ -123,6 +168,8 @@ struct List_Head Msg_CB_List_Head;
 struct List_Head Empty_Msg_CB_List_Head;
 /* The message queue control block */
 struct Msg_Queue Msg_CB[MAX_MSG_QUEUES];
+/* The processes blocked in "Sys_Recv_Msg_Wait" */
+struct Msg_Recv_Wait Msg_Recv_Wait_CB[MAX_PROC_NUM];
 /* Statistic variable */
 size_t Msg_Queue_In_Sys;
 /*****************************************************************************/
@@ -131,7 +178,17 @@ size_t Msg_Queue_In_Sys;
 
 /* Private C Function Prototypes *********************************************/
 /*****************************************************************************/
-
+#if(ENABLE_MSGQ==TRUE)
+static void _Sys_Msg_Ins_Recver(msgqid_t Msg_Queue_ID,struct Msg_Block* Msg_Block_Ptr);
+static void _Sys_Msg_Del_Recver(msgqid_t Msg_Queue_ID,struct Msg_Block* Msg_Block_Ptr);
+static struct Msg_Block* _Sys_Msg_Find(msgqid_t Msg_Queue_ID,pid_t Recver_PID,msgtyp_t Msg_Type);
+static size_t _Sys_Msg_Count(msgqid_t Msg_Queue_ID,pid_t Recver_PID,msgtyp_t Msg_Type);
+static retval_t _Sys_Msg_Enqueue(pid_t Recver_PID,msgqid_t Msg_Queue_ID,msgqbid_t Msg_Block_ID,prio_t Msg_Prio);
+static void _Sys_Msg_Dequeue(msgqid_t Msg_Queue_ID,struct Msg_Block* Msg_Block_Ptr);
+static void _Sys_Msg_Wake_Recver(pid_t Recver_PID,msgqid_t Msg_Queue_ID);
+static void _Sys_Msg_Wake_Allocer(msgqid_t Msg_Queue_ID);
+static void _Sys_Msg_Put_Block(msgqid_t Msg_Queue_ID,struct Msg_Block* Msg_Block_Ptr);
+#endif
 /*****************************************************************************/
 #define __EXTERN__
 /* End Private C Function Prototypes *****************************************/
@@ -155,22 +212,37 @@ __EXTERN__ void _Sys_Queue_Init(void);
 #if (ENABLE_MSGQ==TRUE)
 /*****************************************************************************/
 __EXTERN__ msgqid_t Sys_Create_Queue(s8* Msg_Queue_Name,size_t Msg_Number);
+__EXTERN__ msgqid_t Sys_Create_Queue_Inline(s8* Msg_Queue_Name,size_t Msg_Number,size_t Inline_Size);
 __EXTERN__ retval_t Sys_Destroy_Queue(msgqid_t Msg_Queue_ID);
 __EXTERN__ msgqid_t Sys_Get_Queue_ID(s8* Msg_Queue_Name);
 
 __EXTERN__ msgqbid_t Sys_Alloc_Msg(msgqid_t Msg_Queue_ID,msgtyp_t Msg_Type,size_t Msg_Size,void** Msg_Buffer_Ptr);
 __EXTERN__ msgqbid_t _Sys_Alloc_Msg(pid_t Sender_PID,msgqid_t Msg_Queue_ID,msgtyp_t Msg_Type,size_t Msg_Size,void** Msg_Buffer_Ptr);
+__EXTERN__ msgqbid_t Sys_Alloc_Msg_Wait(msgqid_t Msg_Queue_ID,msgtyp_t Msg_Type,size_t Msg_Size,
+                                       void** Msg_Buffer_Ptr,time_t Time);
 __EXTERN__ retval_t Sys_Send_Msg(pid_t Recver_PID,msgqid_t Msg_Queue_ID,msgqbid_t Msg_Block_ID);
+__EXTERN__ retval_t Sys_Send_Msg_Prio(pid_t Recver_PID,msgqid_t Msg_Queue_ID,msgqbid_t Msg_Block_ID,prio_t Msg_Prio);
+__EXTERN__ cnt_t Sys_Send_Msg_Batch(pid_t Recver_PID,msgqid_t Msg_Queue_ID,msgqbid_t* Msg_Block_ID,cnt_t Msg_Number,
+                                    prio_t Msg_Prio);
 
 __EXTERN__ msgqbid_t Sys_Recv_Msg(msgqid_t Msg_Queue_ID,msgtyp_t Msg_Type,void** Msg_Buffer_Ptr);
 __EXTERN__ msgqbid_t _Sys_Recv_Msg(pid_t Recver_PID,msgqid_t Msg_Queue_ID,msgtyp_t Msg_Type,void** Msg_Buffer_Ptr);
+__EXTERN__ msgqbid_t Sys_Recv_Msg_Wait(msgqid_t Msg_Queue_ID,msgtyp_t Msg_Type,void** Msg_Buffer_Ptr,time_t Time);
+__EXTERN__ cnt_t Sys_Recv_Msg_Batch(msgqid_t Msg_Queue_ID,msgtyp_t Msg_Type,msgqbid_t* Msg_Block_ID,
+                                    void** Msg_Buffer_Ptr,cnt_t Msg_Number);
+__EXTERN__ cnt_t _Sys_Recv_Msg_Batch(pid_t Recver_PID,msgqid_t Msg_Queue_ID,msgtyp_t Msg_Type,
+                                     msgqbid_t* Msg_Block_ID,void** Msg_Buffer_Ptr,cnt_t Msg_Number);
 __EXTERN__ retval_t Sys_Destroy_Msg(msgqid_t Msg_Queue_ID,msgqbid_t Msg_Block_ID);
+__EXTERN__ msgqbid_t Sys_Forward_Msg(msgqid_t Src_Queue_ID,msgqbid_t Src_Block_ID,
+                                    msgqid_t Dst_Queue_ID,pid_t Recver_PID);
 
 __EXTERN__ size_t Sys_Query_Msg_To_Recver(pid_t PID,msgqid_t Msg_Queue_ID,msgtyp_t Msg_Type);
 __EXTERN__ size_t Sys_Query_Msg_Number(msgqid_t Msg_Queue_ID);
 __EXTERN__ size_t Sys_Query_Msg_Queue_Number(msgqid_t Msg_Queue_ID);
 __EXTERN__ retval_t _Sys_Wait_Msg_Queue_Reg(pid_t PID,msgqid_t Msg_Queue_ID,
                                             struct Wait_Object_Struct* Wait_Block_Ptr);
+__EXTERN__ retval_t _Sys_Wait_Msg_Block_Reg(pid_t PID,msgqid_t Msg_Queue_ID,
+                                            struct Wait_Object_Struct* Wait_Block_Ptr);
 /*****************************************************************************/
 #endif
 
@@ -17,6 +17,42 @@ Description : The (named) pipe module for the OS.
 /*****************************************************************************/
 /* The identifier for unopened pipe side */
 #define PIPECLOSE          -1
+
+/* The pipe modes */
+/* Both sides are processes, and every access takes the scheduler lock */
+#define PIPE_MODE_NORMAL   0x00
+/* The writer is an interrupt handler, and the reader is a process. The writer
+ * takes no lock at all */
+#define PIPE_MODE_ISR      0x01
+/* One writer, and each of the other openers reads all the data at its own pace.
+ * When the slowest reader is behind, the writer waits for it */
+#define PIPE_MODE_BCAST_BLOCK 0x02
+/* The same as above, but when a reader is behind, the oldest data is dropped for
+ * it and the writer never waits */
+#define PIPE_MODE_BCAST_DROP  0x03
+
+/* The pipe buffer holds one byte more than the pipe size, so that a full pipe
+ * and an empty pipe can be told apart by the cursors alone */
+#define PIPE_RING_SIZE(PIPE_ID)      (Pipe_CB[(PIPE_ID)].Pipe_Buffer_Size+1)
+/* The number of bytes in the pipe */
+#define PIPE_DATA_SIZE(PIPE_ID) \
+((Pipe_CB[(PIPE_ID)].Pipe_Head+PIPE_RING_SIZE(PIPE_ID)-Pipe_CB[(PIPE_ID)].Pipe_Tail)%PIPE_RING_SIZE(PIPE_ID))
+/* The number of free bytes in the pipe */
+#define PIPE_FREE_SIZE(PIPE_ID)      (Pipe_CB[(PIPE_ID)].Pipe_Buffer_Size-PIPE_DATA_SIZE(PIPE_ID))
+/* Whether a process has opened a side of the pipe, or is a reader of it */
+#define PIPE_OPENED_BY(PIPE_ID,PID) \
+((Pipe_CB[(PIPE_ID)].Opener_PID[0]==(PID))||(Pipe_CB[(PIPE_ID)].Opener_PID[1]==(PID))|| \
+ (Pipe_CB[(PIPE_ID)].Reader[(PID)].Open_Flag!=0))
+/* Whether the pipe is a broadcast one */
+#define PIPE_BCAST(PIPE_ID) \
+((Pipe_CB[(PIPE_ID)].Pipe_Mode==PIPE_MODE_BCAST_BLOCK)||(Pipe_CB[(PIPE_ID)].Pipe_Mode==PIPE_MODE_BCAST_DROP))
+/* The number of bytes that a reader of a broadcast pipe has not read */
+#define PIPE_READER_SIZE(PIPE_ID,PID) \
+((Pipe_CB[(PIPE_ID)].Pipe_Head+PIPE_RING_SIZE(PIPE_ID)-Pipe_CB[(PIPE_ID)].Reader[(PID)].Tail)%PIPE_RING_SIZE(PIPE_ID))
+/* The number of bytes that a process can read from the pipe */
+#define PIPE_READ_SIZE(PIPE_ID,PID) \
+(PIPE_BCAST(PIPE_ID)?PIPE_READER_SIZE(PIPE_ID,PID):PIPE_DATA_SIZE(PIPE_ID))
+
 /* There's no enough space for the pipe */
 #define ENOEPIPE           0x01
 /* The pipe parameter is invalid */
@@ -27,6 +63,14 @@ Description : The (named) pipe module for the OS.
 #define EPIPEEXIST         0x04
 /* The pipe does not exist */
 #define ENOPIPE            0x05
+/* There is not enough data in the pipe */
+#define EPIPEEMPTY         0x06
+/* There is not enough free space in the pipe */
+#define EPIPEFULL          0x07
+/* The operation is not allowed in the mode of the pipe */
+#define EPIPEMODE          0x08
+/* The other side of the pipe is closed */
+#define EPIPECLOSED        0x09
 /*****************************************************************************/
 
 /* __PIPE_H_DEFS__ */
@@ -47,6 +91,17 @@ Description : The (named) pipe module for the OS.
 #include "Syslib\syslib.h"
 #undef __HDR_DEFS__
 /*****************************************************************************/
+/* The struct of a reader of a broadcast pipe */
+struct Pipe_Reader
+{
+    /* Whether the process is a reader */
+    cnt_t Open_Flag;
+    /* The read cursor of it */
+    size_t Tail;
+    /* The number of bytes dropped for it */
+    size_t Drop_Number;
+};
+
 /* The struct of the pipe header */
 struct Pipe
 {
@@ -56,6 +111,42 @@ struct Pipe
     pid_t Opener_PID[2];
     size_t Pipe_Buffer_Size;
     ptr_int_t Pipe_Buffer_Addr;
+    /* The ring buffer cursors. The data is written at the head, and read from
+     * the tail. Each of them is only changed by its own side, so that an
+     * interrupt handler can write without taking any lock */
+    volatile size_t Pipe_Head;
+    volatile size_t Pipe_Tail;
+    /* A blocked reader is woken when there are this many bytes in the pipe */
+    size_t Read_Trigger;
+    /* A blocked writer is woken when there are this many free bytes in the pipe */
+    size_t Write_Trigger;
+    /* The processes waiting for the pipe */
+    struct List_Head Wait_Object_Head;
+    /* The bytes reserved for the writer but not committed yet, and the writer */
+    size_t Write_Reserved;
+    pid_t Write_Reserver;
+    /* The bytes peeked by the reader but not released yet, and the reader */
+    size_t Read_Peeked;
+    pid_t Read_Peeker;
+    /* The mode of the pipe */
+    cnt_t Pipe_Mode;
+    /* The interrupt handler set this when the reader needs waking up */
+    volatile cnt_t ISR_Wake_Pend;
+    /* Set when a side is closed, so that the other side does not wait for the
+     * data or the space that will never come. Cleared when the side is opened */
+    cnt_t Peer_Closed;
+    /* The readers of a broadcast pipe, one for each process. The writer is
+     * "Opener_PID[0]", and "Pipe_Tail" always follows the slowest reader */
+    struct Pipe_Reader Reader[MAX_PROC_NUM];
+    cnt_t Reader_Number;
+};
+
+/* A contiguous span in the pipe buffer. When the data goes across the end of
+ * the buffer, it is described by two spans */
+struct Pipe_Span
+{
+    void* Addr;
+    size_t Size;
 };
 /*****************************************************************************/
 
@@ -75,6 +166,7 @@ struct Pipe
 #undef __HDR_DEFS__
 #define __HDR_STRUCTS__
 #include "ExtIPC\pipe.h"
+#include "ExtIPC\wait.h"
 #undef __HDR_STRUCTS__
 
 /* If the header is not used in the public mode */
@@ -87,6 +179,8 @@ struct List_Head Pipe_List_Head;
 struct List_Head Pipe_Empty_List_Head;
 /* Statistic variable: The number of pipes in the system */
 size_t Pipe_In_Sys;
+/* Set by the interrupt handlers when any of the pipes has a reader to wake up */
+volatile cnt_t Pipe_ISR_Wake_Pend;
 /* The pipe control block */
 /* Here we use a pipe control block to control the pipe. We don't place the pipe
  * control information alongside with the pipe buffer. As such, the dynamic memory
@@ -99,7 +193,15 @@ struct Pipe Pipe_CB[MAX_PIPES];
 
 /* Private C Function Prototypes *********************************************/
 /*****************************************************************************/
-
+#if(ENABLE_PIPE==TRUE)
+static void _Sys_Pipe_Wake(pipeid_t Pipe_ID,cnt_t Type);
+static void _Sys_Pipe_Wake_All(pipeid_t Pipe_ID);
+static void _Sys_Pipe_Copy_In(pipeid_t Pipe_ID,void* Buffer,size_t Size);
+static void _Sys_Pipe_Copy_Out(pipeid_t Pipe_ID,volatile size_t* Tail_Ptr,void* Buffer,size_t Size);
+static void _Sys_Pipe_Get_Span(pipeid_t Pipe_ID,size_t Start,size_t Size,struct Pipe_Span* Span);
+static void _Sys_Pipe_Bcast_Sync(pipeid_t Pipe_ID);
+static void _Sys_Pipe_Bcast_Drop(pipeid_t Pipe_ID,size_t Size);
+#endif
 /*****************************************************************************/
 #define __EXTERN__
 /* End Private C Function Prototypes *****************************************/
@@ -134,7 +236,25 @@ __EXTERN__ retval_t _Sys_Close_Pipe(pid_t Closer_PID,pipeid_t Pipe_ID);
 __EXTERN__ void Sys_Close_All_Pipes(void);
 __EXTERN__ void _Sys_Close_All_Pipes(pid_t PID);
 
+__EXTERN__ retval_t Sys_Pipe_Set_Trigger(pipeid_t Pipe_ID,size_t Read_Trigger,size_t Write_Trigger);
+__EXTERN__ retval_t Sys_Pipe_Set_Mode(pipeid_t Pipe_ID,cnt_t Mode);
+__EXTERN__ size_t Sys_Pipe_Write(pipeid_t Pipe_ID,void* Buffer,size_t Size,time_t Time);
+__EXTERN__ size_t Sys_Pipe_Read(pipeid_t Pipe_ID,void* Buffer,size_t Size,time_t Time);
+
+__EXTERN__ size_t Sys_Pipe_Write_Reserve(pipeid_t Pipe_ID,size_t Size,struct Pipe_Span* Span);
+__EXTERN__ retval_t Sys_Pipe_Write_Commit(pipeid_t Pipe_ID,size_t Size);
+__EXTERN__ size_t Sys_Pipe_Read_Peek(pipeid_t Pipe_ID,size_t Size,struct Pipe_Span* Span);
+__EXTERN__ retval_t Sys_Pipe_Read_Release(pipeid_t Pipe_ID,size_t Size);
+
+__EXTERN__ size_t Sys_Pipe_Write_ISR(pipeid_t Pipe_ID,void* Buffer,size_t Size);
+__EXTERN__ void _Sys_Pipe_Wake_Deferred(void);
+
 __EXTERN__ size_t Sys_Query_Pipe_Number(void);
+__EXTERN__ size_t Sys_Query_Pipe_Data(pipeid_t Pipe_ID);
+__EXTERN__ size_t Sys_Query_Pipe_Readable(pipeid_t Pipe_ID);
+__EXTERN__ size_t Sys_Query_Pipe_Drop(pipeid_t Pipe_ID);
+
+__EXTERN__ retval_t _Sys_Wait_Pipe_Reg(pid_t PID,pipeid_t Pipe_ID,cnt_t Type,struct Wait_Object_Struct* Wait_Block_Ptr);
 /*****************************************************************************/
 #endif
 
@@ -26,6 +26,8 @@ Description : The shared memory module for the OS.
 #define ESHMEXIST           0x03
 /* When deleting the memory region, it is still being used by some process */
 #define ESHMINUSE           0x04
+/* A write is already in progress when beginning one, or is not when ending one */
+#define ESHMWRITE           0x05
 /*****************************************************************************/
 
 /* __SHMEM_H_DEFS__ */
@@ -55,6 +57,12 @@ struct Shared_Mem
     size_t Shm_Attach_Cnt;
     size_t Shm_Size;
     ptr_int_t Shm_Addr;
+    /* The version of the data. It is odd when a write is in progress */
+    volatile u32 Shm_Seq;
+    /* The version each process began to read last time */
+    u32 Read_Seq[MAX_PROC_NUM];
+    /* The processes waiting for a new version */
+    struct List_Head Wait_Object_Head;
 };
 /*****************************************************************************/
 
@@ -74,6 +82,7 @@ struct Shared_Mem
 #undef __HDR_DEFS__
 #define __HDR_STRUCTS__
 #include "ExtIPC\sharemem.h"
+#include "ExtIPC\wait.h"
 #undef __HDR_STRUCTS__
 
 /* If the header is not used in the public mode */
@@ -94,7 +103,9 @@ size_t Shm_In_Sys;
 
 /* Private C Function Prototypes *********************************************/
 /*****************************************************************************/
-
+#if(ENABLE_SHMEM==TRUE)
+static void _Sys_Shm_Wake_All(shmid_t Shm_ID);
+#endif
 /*****************************************************************************/
 #define __EXTERN__
 /* End Private C Function Prototypes *****************************************/
@@ -122,6 +133,13 @@ __EXTERN__ retval_t Sys_Shm_Destroy(shmid_t Shm_ID);
 __EXTERN__ shmid_t Sys_Shm_Get_ID(s8* Shm_Name);
 __EXTERN__ retval_t Sys_Shm_Attach(shmid_t Shm_ID,size_t* Shm_Size,void** Shm_Addr);
 __EXTERN__ retval_t Sys_Shm_Detach(shmid_t Shm_ID);
+
+__EXTERN__ retval_t Sys_Shm_Write_Begin(shmid_t Shm_ID);
+__EXTERN__ retval_t Sys_Shm_Write_End(shmid_t Shm_ID);
+__EXTERN__ u32 Sys_Shm_Read_Begin(shmid_t Shm_ID);
+__EXTERN__ retval_t Sys_Shm_Read_Retry(shmid_t Shm_ID,u32 Seq);
+
+__EXTERN__ retval_t _Sys_Wait_Shm_Reg(pid_t PID,shmid_t Shm_ID,struct Wait_Object_Struct* Wait_Block_Ptr);
 /*****************************************************************************/
 #endif
 
@@ -0,0 +1,184 @@
+/******************************************************************************
+Filename    : topic.h
+Author      : pry
+Date        : 19/10/2013
+Description : The publish/subscribe topic module for the OS.
+******************************************************************************/
+
+/* Config Includes ***********************************************************/
+#include "Config\MP_config.h"
+#include "Platform\MP_platform.h"
+/* End Config Includes *******************************************************/
+
+/* Defines *******************************************************************/
+#ifdef __HDR_DEFS__
+#ifndef __TOPIC_H_DEFS__
+#define __TOPIC_H_DEFS__
+/*****************************************************************************/
+#if((ENABLE_TOPIC==TRUE)&&(ENABLE_MSGQ!=TRUE))
+#error "The topics are built on the message queues. Enable ENABLE_MSGQ first."
+#endif
+
+/* When the queue of a subscriber is full, drop the oldest sample in it */
+#define TOPIC_DROP_OLDEST   0x00
+/* When the queue of a subscriber is full, drop the sample being published */
+#define TOPIC_DROP_NEWEST   0x01
+
+/* The sample header of a sample buffer */
+#define TOPIC_SAMPLE_PTR(BUFFER)     (((struct Topic_Sample*)(BUFFER))-1)
+
+/* Errors */
+/* Such topic is not existent in the system */
+#define ENOTOPIC            0x00
+/* Invalid topic (parameters) */
+#define EINVTOPIC           0x01
+/* No empty topic control blocks, or no enough memory for the topic */
+#define ENOETOPIC           0x02
+/* The topic with the same name already exists */
+#define ETOPICEXIST         0x03
+/*****************************************************************************/
+
+/* __TOPIC_H_DEFS__ */
+#endif
+/* __HDR_DEFS__ */
+#endif
+/* End Defines ***************************************************************/
+
+/* Structs *******************************************************************/
+#ifdef __HDR_STRUCTS__
+#ifndef __TOPIC_H_STRUCTS__
+#define __TOPIC_H_STRUCTS__
+/* We used structs in the header */
+#include "Syslib\syslib.h"
+
+/* Use defines in these headers */
+#define __HDR_DEFS__
+#include "Syslib\syslib.h"
+#undef __HDR_DEFS__
+/*****************************************************************************/
+/* The struct of a subscriber of a topic */
+struct Topic_Sub
+{
+    /* The most samples that can wait in its queue. If not subscribed, 0 */
+    size_t Sub_Depth;
+    /* The type of the samples it wants. "ALL_TYPE_MSG" for all types */
+    msgtyp_t Sub_Type;
+    /* What to drop when its queue is full */
+    u32 Sub_Policy;
+    /* The number of samples dropped for it */
+    size_t Sub_Drop_Number;
+};
+
+/* The struct of the topic */
+struct Topic
+{
+    struct List_Head Head;
+    s8* Topic_Name;
+    topicid_t Topic_ID;
+    /* The message queue that carries the references to the samples */
+    msgqid_t Msg_Queue_ID;
+    /* The subscribers, one for each process */
+    struct Topic_Sub Sub[MAX_PROC_NUM];
+};
+
+/* The header of a sample. The sample buffer follows it */
+struct Topic_Sample
+{
+    /* The number of subscribers that have not released the sample */
+    cnt_t Ref_Cnt;
+    /* The publisher, in whose name the sample is allocated */
+    pid_t Pub_PID;
+    msgtyp_t Msg_Type;
+    size_t Size;
+};
+/*****************************************************************************/
+
+/* __TOPIC_H_STRUCTS__ */
+#endif
+/* __HDR_STRUCTS__ */
+#endif
+/* End Structs ***************************************************************/
+
+/* Private Global Variables **************************************************/
+#if(!(defined __HDR_DEFS__||defined __HDR_STRUCTS__))
+#ifndef __TOPIC_MEMBERS__
+#define __TOPIC_MEMBERS__
+/* In this way we can use the data structures in the headers */
+#define __HDR_DEFS__
+#include "ExtIPC\topic.h"
+#undef __HDR_DEFS__
+#define __HDR_STRUCTS__
+#include "ExtIPC\topic.h"
+#undef __HDR_STRUCTS__
+
+/* If the header is not used in the public mode */
+#ifndef __HDR_PUBLIC_MEMBERS__
+
+/*****************************************************************************/
+/* Topic control block list header */
+struct List_Head Topic_List_Head;
+/* Empty block list header */
+struct List_Head Topic_Empty_List_Head;
+/* Topic control block */
+struct Topic Topic_CB[MAX_TOPICS];
+/* Topic number counter */
+size_t Topic_In_Sys;
+/*****************************************************************************/
+
+/* End Private Global Variables **********************************************/
+
+/* Private C Function Prototypes *********************************************/
+/*****************************************************************************/
+#if(ENABLE_TOPIC==TRUE)
+static void _Sys_Topic_Put_Sample(struct Topic_Sample* Sample_Ptr);
+static retval_t _Sys_Topic_Drop_Oldest(topicid_t Topic_ID,pid_t Sub_PID);
+#endif
+/*****************************************************************************/
+#define __EXTERN__
+/* End Private C Function Prototypes *****************************************/
+
+/* Public Global Variables ***************************************************/
+/* __HDR_PUBLIC_MEMBERS__ */
+#else
+#define __EXTERN__ EXTERN
+/* __HDR_PUBLIC_MEMBERS__ */
+#endif
+
+#if(ENABLE_TOPIC==TRUE)
+/*****************************************************************************/
+
+/*****************************************************************************/
+#endif
+/* End Public Global Variables ***********************************************/
+
+/* Public C Function Prototypes **********************************************/
+__EXTERN__ void _Sys_Topic_Init(void);
+#if(ENABLE_TOPIC==TRUE)
+/*****************************************************************************/
+__EXTERN__ topicid_t Sys_Create_Topic(s8* Topic_Name,size_t Msg_Number);
+__EXTERN__ retval_t Sys_Destroy_Topic(topicid_t Topic_ID);
+__EXTERN__ topicid_t Sys_Get_Topic_ID(s8* Topic_Name);
+
+__EXTERN__ retval_t Sys_Topic_Subscribe(topicid_t Topic_ID,msgtyp_t Msg_Type,size_t Depth,u32 Policy);
+__EXTERN__ retval_t Sys_Topic_Unsubscribe(topicid_t Topic_ID);
+
+__EXTERN__ void* Sys_Topic_Alloc(topicid_t Topic_ID,msgtyp_t Msg_Type,size_t Size);
+__EXTERN__ cnt_t Sys_Topic_Publish(topicid_t Topic_ID,void* Sample);
+__EXTERN__ void* Sys_Topic_Recv(topicid_t Topic_ID,msgtyp_t* Msg_Type,time_t Time);
+__EXTERN__ retval_t Sys_Topic_Release(void* Sample);
+
+__EXTERN__ size_t Sys_Query_Topic_Drop(topicid_t Topic_ID);
+/*****************************************************************************/
+#endif
+
+/* Undefine "__EXTERN__" to avoid redefinition */
+#undef __EXTERN__
+/* __TOPIC_MEMBERS__ */
+#endif
+/* !(defined __HDR_DEFS__||defined __HDR_STRUCTS__) */
+#endif
+/* End Public C Function Prototypes ******************************************/
+
+/*End Of File*****************************************************************/
+
+/*Copyright (C) 2011-2013 pry. All rights reserved.***************************/
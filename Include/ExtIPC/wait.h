@@ -22,6 +22,12 @@ Description : The wait kernel object module for the RMV RTOS.
 #define  MUTEX                    0x00
 #define  SEMAPHORE                0x01
 #define  MSGQUEUE                 0x02
+#define  MEMORY                   0x03
+#define  MSGBLOCK                 0x04
+#define  MAILBOX                  0x05
+#define  PIPEREAD                 0x06
+#define  PIPEWRITE                0x07
+#define  SHMEM                    0x08
 /* Errno identifier */
 #define  ENOOBJTYPE               0x00
 #define  ENOWAITBLK               0x01
@@ -113,6 +113,10 @@ EXTERN void ENABLE_ALL_INTS(void);
 EXTERN void DISABLE_SYSTICK(void);  
 /* Enable the systick timer */                                       
 EXTERN void ENABLE_SYSTICK(void); 				                       
+/* Order the memory accesses before and after it */
+EXTERN void MEMORY_BARRIER(void);
+/* Store the new value if the word still has the old value, atomically */
+EXTERN retval_t COMPARE_AND_SWAP(volatile ptr_int_t* Addr,ptr_int_t Old_Val,ptr_int_t New_Val);
 
 /* __INTERRUPT_MEMBERS__ */
 #endif
@@ -20,9 +20,69 @@ Description : The memory managing module for the OS.
 /* Memory is not available */
 #define ENOMEM          ((void*)0x00)
 
+/* The TLSF constants derived from the SLI and the minimum block size */
+#if(MM_SLI==4)
+#define MM_SLI_ORDER    2
+#define MM_BITMAP_TYPE  u8
+#elif(MM_SLI==8)
+#define MM_SLI_ORDER    3
+#define MM_BITMAP_TYPE  u8
+#elif(MM_SLI==16)
+#define MM_SLI_ORDER    4
+#define MM_BITMAP_TYPE  u16
+#elif(MM_SLI==32)
+#define MM_SLI_ORDER    5
+#define MM_BITMAP_TYPE  u32
+#else
+#error "MM_SLI must be 4, 8, 16 or 32."
+#endif
+
+#if(MM_MIN_ORDER<MM_SLI_ORDER)
+#error "MM_MIN_ORDER must not be smaller than log2(MM_SLI)."
+#endif
+
+/* The biggest block is the whole heap, and its FLI is log2(DMEM_SIZE)-MM_MIN_ORDER */
+#if(DMEM_SIZE>=(1<<(MM_MIN_ORDER+MM_FLI)))
+#error "MM_FLI is too small: 2^(MM_MIN_ORDER+MM_FLI) must be bigger than DMEM_SIZE."
+#endif
+
+/* SLI=(Size>>(FLI+MM_SLI_SHIFT))&MM_SLI_MASK */
+#define MM_SLI_SHIFT    (MM_MIN_ORDER-MM_SLI_ORDER)
+#define MM_SLI_MASK     (MM_SLI-1)
+/* The smallest block that can be allocated */
+#define MM_MIN_BLOCK    ((1<<MM_MIN_ORDER)+8)
+
 /* For "_Sys_Mfree"'s use */
 #define DMEM_START_ADDR ((u32)(DMEM_Heap))
-#define DMEM_END_ADDR   (((u32)(DMEM_Heap))+DMEM_SIZE-sizeof(struct Mem_Tail)-64-8)
+#define DMEM_END_ADDR   (((u32)(DMEM_Heap))+DMEM_SIZE-sizeof(struct Mem_Tail)-MM_MIN_BLOCK)
+
+/* For "_Sys_Malloc_Aligned"'s use - The biggest alignment allowed */
+#define MAX_MEM_ALIGN   1024
+
+/* The "Occupy_Flag" of the blocks that belong to handles. The handle number is
+ * kept above the flag, so that freeing the block needs not look for the handle.
+ */
+#define MEM_HANDLE_FLAG             0x02
+#define MEM_HANDLE_SHIFT            8
+#define MEM_HANDLE_OCCUPY(HANDLE)   (MEM_HANDLE_FLAG|(((u32)(HANDLE))<<MEM_HANDLE_SHIFT))
+#define MEM_HANDLE_OF(FLAG)         ((memhid_t)((FLAG)>>MEM_HANDLE_SHIFT))
+/* Added to the "Occupy_Flag" of the blocks in the deferred free list */
+#define MEM_DEFER_FLAG              0x04
+
+/* The memory trace operations */
+#define MEM_TRACE_MALLOC            0x00
+#define MEM_TRACE_MFREE             0x01
+#define MEM_TRACE_REALLOC           0x02
+#if(ENABLE_MEM_TRACE==TRUE)
+/* The record number wraps around, so the depth must be a power of 2 */
+#if((MEM_TRACE_DEPTH<=0)||((MEM_TRACE_DEPTH&(MEM_TRACE_DEPTH-1))!=0))
+#error "MEM_TRACE_DEPTH must be a power of 2."
+#endif
+/* The return address of the current function - This is an ARM compiler intrinsic */
+#define MEM_TRACE_CALLER_ADDR()     ((ptr_int_t)__return_address())
+#else
+#define MEM_TRACE_CALLER_ADDR()     ((ptr_int_t)0)
+#endif
 
 /* __MEMORY_H_DEFS__ */
 #endif
@@ -50,8 +110,10 @@ struct Mem_Head
     /* This is for freeing all memory of a process */
     struct List_Head Proc_Mem_Head;
     struct Mem_Tail* Tail_Ptr;
-    /* We need an flag because even the 0 process will allocate some memory */  
-    u32 Occupy_Flag;
+    /* We need an flag because even the 0 process will allocate some memory. It
+     * is as wide as a pointer, so that "COMPARE_AND_SWAP" can mark it.
+     */
+    ptr_int_t Occupy_Flag;
     u32 Occupy_PID;
     /* The pointer to the start of the memory block address */
     ptr_int_t Mem_Start_Addr;
@@ -73,6 +135,46 @@ struct PCB_Memory
 {
     struct List_Head Head;
     cnt_t Memory_In_Use;
+    /* The most memory that the process can use. 0 means no limit */
+    size_t Memory_Quota;
+    /* The signal to send when the memory pressure changes. "NOSIG" means none */
+    signal_t Pressure_Signal;
+};
+
+/* The memory arena header, at the start of the arena block */
+struct Mem_Arena
+{
+    /* The start address of the allocatable memory */
+    ptr_int_t Arena_Start_Addr;
+    /* The end address of the allocatable memory */
+    ptr_int_t Arena_End_Addr;
+    /* The address that the next allocation will start at */
+    ptr_int_t Arena_Cur_Addr;
+};
+
+/* The relocatable memory handle */
+struct Mem_Handle
+{
+    /* The start address of the memory. 0 means the handle is not used */
+    ptr_int_t Mem_Addr;
+    /* Only the memory whose handle is not locked can be moved */
+    cnt_t Lock_Cnt;
+};
+
+/* The memory trace record */
+struct Mem_Trace
+{
+    /* The low bits of the total ticks when it is recorded */
+    time_t Timestamp;
+    /* "MEM_TRACE_MALLOC", "MEM_TRACE_MFREE" or "MEM_TRACE_REALLOC" */
+    u32 Operation;
+    pid_t PID;
+    /* Who called the allocator */
+    ptr_int_t Caller_Addr;
+    /* The size asked for, or the size freed */
+    size_t Size;
+    /* The memory address. For a failed allocation it is 0 */
+    ptr_int_t Mem_Addr;
 };
 /*****************************************************************************/
 
@@ -92,15 +194,18 @@ struct PCB_Memory
 #undef __HDR_DEFS__
 #define __HDR_STRUCTS__
 #include "Memmgr\memory.h"
+#include "ExtIPC\wait.h"
 #undef __HDR_STRUCTS__
 
 /* If the header is not used in the public mode */
 #ifndef __HDR_PUBLIC_MEMBERS__
 
 /*****************************************************************************/
-/* The TLSF registry table. We fix SLI as 8, so it is one byte. */
-static struct List_Head Mem_CB[MM_FLI][8];
-static u8 Mem_Bitmap[MM_FLI];
+/* The TLSF registry table. The bitmap is as wide as the SLI. */
+static struct List_Head Mem_CB[MM_FLI][MM_SLI];
+static MM_BITMAP_TYPE Mem_Bitmap[MM_FLI];
+/* The number of free blocks in each FLI and SLI class */
+static cnt_t Mem_Block_Cnt[MM_FLI][MM_SLI];
 /* The PCB_Mem table */
 static struct PCB_Memory PCB_Mem[MAX_PROC_NUM];
 /* The memory for allocation. This part is the continuous memory to allocate */
@@ -110,6 +215,31 @@ static struct List_Head Mem_Allocated_List_Head;
 /* The statistic variables */
 static cnt_t Free_Mem_Amount;
 static cnt_t Used_Mem_Amount;
+static cnt_t Peak_Used_Mem_Amount;
+/* Whether the free memory is below the low watermark */
+static retval_t Mem_Pressure_Flag;
+/* The number of failed allocations in each FLI class */
+static cnt_t Mem_Failed_Cnt[MM_FLI];
+/* The processes waiting for memory, in the ascending order of the size they need */
+static struct List_Head Mem_Wait_List_Head;
+/* The memory freed by the interrupt handlers, to be freed later */
+static volatile ptr_int_t Mem_Deferred_List;
+#if(MEM_ISR_BLOCKS!=0)
+/* The interrupt reserve and its free blocks */
+static ptr_int_t Mem_ISR_Start_Addr;
+static ptr_int_t Mem_ISR_End_Addr;
+static volatile ptr_int_t Mem_ISR_Free_List;
+#endif
+#if(ENABLE_MEM_HANDLE==TRUE)
+/* The handle table, and where the compactor stopped last time */
+static struct Mem_Handle Mem_Handle[MAX_MEM_HANDLES];
+static memhid_t Mem_Compact_Cursor;
+#endif
+#if(ENABLE_MEM_TRACE==TRUE)
+/* The trace ring buffer and the total number of records */
+static struct Mem_Trace Mem_Trace_Buf[MEM_TRACE_DEPTH];
+static u32 Mem_Trace_Cnt;
+#endif
 /*****************************************************************************/
 
 /* End Private Global Variables **********************************************/
@@ -119,8 +249,32 @@ static void _Sys_Mem_Ins_TLSF(struct Mem_Head* Mem_Head_Ptr);
 static void _Sys_Mem_Del_TLSF(struct Mem_Head* Mem_Head_Ptr);
 static void _Sys_Mem_Init_Block(ptr_int_t Mem_Start_Addr,size_t Mem_Size);
 static retval_t Sys_Mem_TLSF_Bitmap_Search(size_t Mem_Size,s32* FLI_Level,s32* SLI_Level);
+static void _Sys_Mem_Split_Block(struct Mem_Head* Mem_Head_Ptr,size_t Size);
 static void _Sys_Mem_Ins_Allocated(pid_t PID,struct Mem_Head* Mem_Head_Ptr);
 static void _Sys_Mem_Del_Allocated(struct Mem_Head* Mem_Head_Ptr);
+static void _Sys_Mem_Free_Block(struct Mem_Head* Mem_Head_Ptr);
+static void _Sys_Mem_Push_Deferred(ptr_int_t First_Addr,ptr_int_t Last_Addr);
+static ptr_int_t _Sys_Mem_Take_Deferred(void);
+static void _Sys_Mem_Reg_Failure(size_t Mem_Size);
+static retval_t _Sys_Mem_Check_Quota(pid_t PID,size_t Mem_Size);
+static retval_t _Sys_Mem_Check_Malloc(pid_t PID,size_t Size);
+static void _Sys_Mem_Wake_Waiter(void);
+static void* _Sys_Malloc_Aligned_Caller(pid_t PID,size_t Size,size_t Align,ptr_int_t Caller_Addr);
+static void* _Sys_Realloc_Caller(pid_t PID,void* Mem_Ptr,size_t Size,ptr_int_t Caller_Addr);
+static struct Mem_Arena* _Sys_Arena_Create_Caller(pid_t PID,size_t Size,ptr_int_t Caller_Addr);
+static retval_t _Sys_Arena_Check(pid_t PID,struct Mem_Arena* Arena_Ptr);
+static void _Sys_Arena_Destroy_Caller(pid_t PID,struct Mem_Arena* Arena_Ptr,ptr_int_t Caller_Addr);
+#if(ENABLE_MEM_HANDLE==TRUE)
+static memhid_t _Sys_Malloc_Handle_Caller(pid_t PID,size_t Size,ptr_int_t Caller_Addr);
+static void _Sys_Mfree_Handle_Caller(pid_t PID,memhid_t Handle,ptr_int_t Caller_Addr);
+static void _Sys_Mem_Del_Handle(memhid_t Handle);
+#endif
+#if(MEM_LOW_WATERMARK!=0)
+static void _Sys_Mem_Check_Pressure(void);
+#endif
+#if(ENABLE_MEM_TRACE==TRUE)
+static void _Sys_Mem_Trace(u32 Operation,pid_t PID,ptr_int_t Caller_Addr,size_t Size,ptr_int_t Mem_Addr);
+#endif
 #define __EXTERN__
 /* End Private C Function Prototypes *****************************************/
 
@@ -138,13 +292,60 @@ __EXTERN__ void _Sys_Mem_Init(void);
 #if(ENABLE_MEMM==TRUE)
 __EXTERN__ void* Sys_Malloc(size_t Size);
 __EXTERN__ void* _Sys_Malloc(pid_t PID,size_t Size);
+__EXTERN__ void* _Sys_Malloc_Caller(pid_t PID,size_t Size,ptr_int_t Caller_Addr);
+__EXTERN__ void* Sys_Malloc_Aligned(size_t Size,size_t Align);
+__EXTERN__ void* _Sys_Malloc_Aligned(pid_t PID,size_t Size,size_t Align);
 __EXTERN__ void Sys_Mfree(void* Mem_Ptr);    
 __EXTERN__ void _Sys_Mfree(pid_t PID,void* Mem_Ptr);
+__EXTERN__ void _Sys_Mfree_Caller(pid_t PID,void* Mem_Ptr,ptr_int_t Caller_Addr);
 __EXTERN__ void Sys_Mfree_All(void);	                                   
 __EXTERN__ void _Sys_Mfree_All(pid_t PID);
+__EXTERN__ void* Sys_Malloc_Wait(size_t Size,time_t Time);
+__EXTERN__ retval_t _Sys_Wait_Mem_Reg(pid_t PID,size_t Size,struct Wait_Object_Struct* Wait_Block_Ptr);
+#if(MEM_ISR_BLOCKS!=0)
+__EXTERN__ void* Sys_Malloc_ISR(size_t Size);
+#endif
+__EXTERN__ void Sys_Mfree_ISR(void* Mem_Ptr);
+__EXTERN__ void _Sys_Mem_Free_Deferred(void);
+__EXTERN__ void* Sys_Realloc(void* Mem_Ptr,size_t Size);
+__EXTERN__ void* _Sys_Realloc(pid_t PID,void* Mem_Ptr,size_t Size);
+__EXTERN__ retval_t Sys_Mem_Transfer(void* Mem_Ptr,pid_t New_PID);
+__EXTERN__ retval_t _Sys_Mem_Transfer(pid_t PID,void* Mem_Ptr,pid_t New_PID);
+#if(ENABLE_MEM_HANDLE==TRUE)
+__EXTERN__ memhid_t Sys_Malloc_Handle(size_t Size);
+__EXTERN__ memhid_t _Sys_Malloc_Handle(pid_t PID,size_t Size);
+__EXTERN__ void* Sys_Lock_Handle(memhid_t Handle);
+__EXTERN__ retval_t Sys_Unlock_Handle(memhid_t Handle);
+__EXTERN__ void Sys_Mfree_Handle(memhid_t Handle);
+__EXTERN__ void _Sys_Mfree_Handle(pid_t PID,memhid_t Handle);
+__EXTERN__ cnt_t _Sys_Mem_Compact(cnt_t Steps);
+#endif
+__EXTERN__ struct Mem_Arena* Sys_Arena_Create(size_t Size);
+__EXTERN__ struct Mem_Arena* _Sys_Arena_Create(pid_t PID,size_t Size);
+__EXTERN__ void* Sys_Arena_Alloc(struct Mem_Arena* Arena_Ptr,size_t Size);
+__EXTERN__ void Sys_Arena_Reset(struct Mem_Arena* Arena_Ptr);
+__EXTERN__ void Sys_Arena_Destroy(struct Mem_Arena* Arena_Ptr);
+__EXTERN__ void _Sys_Arena_Destroy(pid_t PID,struct Mem_Arena* Arena_Ptr);
+__EXTERN__ size_t Sys_Arena_Query_Free(struct Mem_Arena* Arena_Ptr);
 __EXTERN__ size_t Sys_Query_Proc_Mem(pid_t PID);
 __EXTERN__ size_t Sys_Query_Used_Memory(void);
 __EXTERN__ size_t Sys_Query_Free_Mem(void);
+__EXTERN__ size_t Sys_Query_Peak_Used_Mem(void);
+__EXTERN__ size_t Sys_Query_Max_Free_Block(void);
+__EXTERN__ cnt_t Sys_Query_Free_Blocks(s32 FLI_Level,s32 SLI_Level);
+__EXTERN__ cnt_t Sys_Query_Mem_Frag(void);
+__EXTERN__ cnt_t Sys_Query_Failed_Malloc(s32 FLI_Level);
+__EXTERN__ retval_t Sys_Set_Mem_Quota(pid_t PID,size_t Quota);
+__EXTERN__ size_t Sys_Query_Mem_Quota(pid_t PID);
+#if(MEM_LOW_WATERMARK!=0)
+__EXTERN__ retval_t Sys_Mem_Pressure_Reg(signal_t Signal);
+__EXTERN__ retval_t _Sys_Mem_Pressure_Reg(pid_t PID,signal_t Signal);
+__EXTERN__ retval_t Sys_Query_Mem_Pressure(void);
+#endif
+#if(ENABLE_MEM_TRACE==TRUE)
+__EXTERN__ u32 Sys_Query_Mem_Trace_Cnt(void);
+__EXTERN__ retval_t Sys_Read_Mem_Trace(u32 Trace_Num,struct Mem_Trace* Trace_Ptr);
+#endif
 #endif
 
 /* Undefine "__EXTERN__" to avoid redefinition */
@@ -137,6 +137,18 @@ typedef s32 msgqbid_t;
 typedef u32 msgtyp_t;
 #endif
 
+#ifndef __TOPICID_T__
+#define __TOPICID_T__
+/* The publish/subscribe topic identifier type */
+typedef s32 topicid_t;
+#endif
+
+#ifndef __MBOXID_T__
+#define __MBOXID_T__
+/* The latest-value mailbox identifier type */
+typedef s32 mboxid_t;
+#endif
+
 #ifndef __PIPEID_T__
 #define __PIPEID_T__
 /* The pipe module's type identifier */
@@ -155,6 +167,12 @@ typedef s32 shmid_t;
 typedef s32 timid_t;
 #endif
 
+#ifndef __MEMHID_T__
+#define __MEMHID_T__
+/* The relocatable memory handle type */
+typedef s32 memhid_t;
+#endif
+
 #ifndef __TIME_T__
 #define __TIME_T__
 /* The time type */
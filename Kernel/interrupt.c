@@ -32,6 +32,8 @@ Description : The system interrupt management module.
 #include "Kernel\scheduler.h"
 #include "Kernel\error.h"
 #include "Syslib\syslib.h"
+#include "Memmgr\memory.h"
+#include "ExtIPC\pipe.h"
 #include "Kernel\interrupt.h"
 #undef __HDR_PUBLIC_MEMBERS__
 /* End Includes **************************************************************/
@@ -152,6 +154,18 @@ void Sys_Unlock_Scheduler(void)
 {
     if(Scheduler_Lock_Cnt==1)
     {
+#if(ENABLE_MEMM==TRUE)
+        /* Free the memory that the interrupt handlers gave back, while we still 
+         * hold the lock. This can't be done in an interrupt handler.
+         */
+        if(Int_Nest_Cnt==0)
+            _Sys_Mem_Free_Deferred();
+#endif
+#if(ENABLE_PIPE==TRUE)
+        /* Wake up the pipe readers that the interrupt handlers asked for */
+        if(Int_Nest_Cnt==0)
+            _Sys_Pipe_Wake_Deferred();
+#endif
         /* Clear the count before enabling, or it will cause fault in the same
          * sense as above.
          */
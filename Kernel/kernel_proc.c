@@ -81,6 +81,9 @@ void _Sys_Arch(void)
     while(1)
     {
         _Sys_Timer_Reload();
+#if((ENABLE_MEMM==TRUE)&&(ENABLE_MEM_HANDLE==TRUE))
+        _Sys_Mem_Compact(MEM_COMPACT_STEPS);
+#endif
         Sys_Arch_Always();
         Sys_Switch_Now();
     }
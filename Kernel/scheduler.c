@@ -55,6 +55,8 @@ Description : The kernel for the Mutate(TM)-prokaryote operating system.
 #include "ExtIPC\pipe.h"
 #include "ExtIPC\sharemem.h"
 #include "ExtIPC\msgqueue.h"
+#include "ExtIPC\topic.h"
+#include "ExtIPC\mailbox.h"
 #include "ExtIPC\mutex.h"
 
 #include "Syssvc\timer.h"
@@ -626,6 +628,18 @@ void _Sys_Systick_Routine(void)
     /* Process the signals again here, because the process may receive signals from ISR */
     _Sys_Signal_Handler(Current_PID);
     
+#if(ENABLE_PIPE==TRUE)
+    /* Wake up the pipe readers that the interrupt handlers asked for, if the
+     * process context is not changing the kernel objects now. We are in an
+     * interrupt, so the unlock in it must not do the deferred memory frees */
+    if(Scheduler_Locked==0)
+    {
+        Sys_Enter_Int_Handler();
+        _Sys_Pipe_Wake_Deferred();
+        Sys_Exit_Int_Handler();
+    }
+#endif
+    
     /* Process the timers here - see if any of them is expired */
     _Sys_Timer_Handler(); 
     /* Process the system process delay here - see if any of them is expired */
@@ -1132,6 +1146,12 @@ int main(void)
     /* Initialize the message queue */
     _Sys_Queue_Init();
     
+    /* Initialize the publish/subscribe topics, which are built on the message queues */
+    _Sys_Topic_Init();
+    
+    /* Initialize the latest-value mailboxes */
+    _Sys_Mbox_Init();
+    
     /* Initialize the system timer */
     _Sys_Timer_Init();
     
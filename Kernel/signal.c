@@ -196,6 +196,15 @@ void _Sys_Kill_The_Process(pid_t PID)
         _Sys_Del_Proc_From_Cur_Prio(PID);
     }	
     
+#if(ENABLE_MEMM==TRUE)
+    /* The next process with this PID starts without the memory quota and the
+     * memory pressure notifications of this one */
+    Sys_Set_Mem_Quota(PID,0);
+#if(MEM_LOW_WATERMARK!=0)
+    _Sys_Mem_Pressure_Reg(PID,NOSIG);
+#endif
+#endif
+    
     /* Clear its PCB - except for the PID itself */
     Sys_Memset((ptr_int_t)(&PCB[PID]),0,sizeof(struct PCB_Struct));  
     PCB[PID].Info.PID=PID;
@@ -18,9 +18,11 @@ Description : The DSA module for the OS. The module utilize TLSF method to
               When we free memory, then the memory blocks will be automatically
               merge.
               
-              In the system, the FLI is variable and the SLI is fixed to 8.
-              The FLI has a miniumum block size of 64 Byte(If the allocated size
-              is always smaller than 64 bits, then there's no need to use DSA.)
+              In the system, the FLI and the SLI(4, 8, 16 or 32) are both set
+              in the configuration file, and so is the minimum block size, 
+              2^MM_MIN_ORDER. The figures below are for the default, SLI=8 and
+              a minumum block size of 64 Byte(If the allocated size is always 
+              smaller than 64 bits, then there's no need to use DSA.) 
               To make sure that it is like this, we set the smallest allocatable
               size to 64B. In addition, we set the alignment to 8.
               [FLI]:
@@ -41,8 +43,10 @@ Description : The DSA module for the OS. The module utilize TLSF method to
 /* Definition includes */
 #define __HDR_DEFS__
 #include "Kernel\scheduler.h"
+#include "Kernel\signal.h"
 #include "Kernel\error.h"
 #include "Memmgr\memory.h"
+#include "ExtIPC\wait.h"
 #undef __HDR_DEFS__
 
 /* Structure includes */
@@ -50,6 +54,7 @@ Description : The DSA module for the OS. The module utilize TLSF method to
 #include "Syslib\syslib.h"
 #include "Kernel\scheduler.h"
 #include "Memmgr\memory.h"
+#include "ExtIPC\wait.h"
 #undef __HDR_STRUCTS__
 
 /* Private includes */
@@ -58,9 +63,12 @@ Description : The DSA module for the OS. The module utilize TLSF method to
 /* Public includes */
 #define __HDR_PUBLIC_MEMBERS__
 #include "Kernel\scheduler.h"
+#include "Kernel\signal.h"
 #include "Kernel\interrupt.h"
 #include "Syslib\syslib.h"
 #include "Memmgr\memory.h"
+#include "ExtIPC\wait.h"
+#include "Syssvc\timer.h"
 #undef __HDR_PUBLIC_MEMBERS__
 /* End Includes **************************************************************/
 
@@ -79,15 +87,18 @@ void _Sys_Mem_Init(void)
     /* Initialize the TLSF allocation table first */
     for(X_Cnt=0;X_Cnt<MM_FLI;X_Cnt++)
     {
-        for(Y_Cnt=0;Y_Cnt<8;Y_Cnt++)
+        for(Y_Cnt=0;Y_Cnt<MM_SLI;Y_Cnt++)
         {
             Sys_Create_List(&(Mem_CB[X_Cnt][Y_Cnt]));
+            Mem_Block_Cnt[X_Cnt][Y_Cnt]=0;
         }
         Mem_Bitmap[X_Cnt]=0;
+        Mem_Failed_Cnt[X_Cnt]=0;
     }
     
-    /* Initialize the allocated memory block list */
+    /* Initialize the allocated memory block list and the wait list */
     Sys_Create_List(&Mem_Allocated_List_Head);
+    Sys_Create_List(&Mem_Wait_List_Head);
     
     /* Initialize the only big memory block */
     _Sys_Mem_Init_Block((ptr_int_t)DMEM_Heap,DMEM_SIZE);
@@ -100,11 +111,47 @@ void _Sys_Mem_Init(void)
     {
         Sys_Create_List(&(PCB_Mem[X_Cnt].Head)); 
         PCB_Mem[X_Cnt].Memory_In_Use=0;
+        PCB_Mem[X_Cnt].Memory_Quota=0;
+        PCB_Mem[X_Cnt].Pressure_Signal=NOSIG;
     }
     
     /* Clear the statistic variables */
     Free_Mem_Amount=DMEM_SIZE;
     Used_Mem_Amount=0;
+    Peak_Used_Mem_Amount=0;
+    Mem_Pressure_Flag=0;
+    
+#if(ENABLE_MEM_TRACE==TRUE)
+    /* Clear the trace ring buffer */
+    Mem_Trace_Cnt=0;
+#endif
+
+    /* The deferred free list is empty */
+    Mem_Deferred_List=(ptr_int_t)ENOMEM;
+    
+#if(ENABLE_MEM_HANDLE==TRUE)
+    /* No handles are in use */
+    for(X_Cnt=0;X_Cnt<MAX_MEM_HANDLES;X_Cnt++)
+    {
+        Mem_Handle[X_Cnt].Mem_Addr=(ptr_int_t)ENOMEM;
+        Mem_Handle[X_Cnt].Lock_Cnt=0;
+    }
+    Mem_Compact_Cursor=0;
+#endif
+    
+#if(MEM_ISR_BLOCKS!=0)
+    /* Carve the interrupt reserve out of the heap in the name of "Init", and chain 
+     * the blocks up. The first word of each free block points to the next one.
+     */
+    Mem_ISR_Start_Addr=(ptr_int_t)_Sys_Malloc(0,MEM_ISR_BLOCKS*MEM_ISR_BLOCK_SIZE);
+    Mem_ISR_End_Addr=Mem_ISR_Start_Addr+MEM_ISR_BLOCKS*MEM_ISR_BLOCK_SIZE-1;
+    Mem_ISR_Free_List=(ptr_int_t)ENOMEM;
+    for(X_Cnt=MEM_ISR_BLOCKS-1;X_Cnt>=0;X_Cnt--)
+    {
+        *((ptr_int_t*)(Mem_ISR_Start_Addr+X_Cnt*MEM_ISR_BLOCK_SIZE))=Mem_ISR_Free_List;
+        Mem_ISR_Free_List=Mem_ISR_Start_Addr+X_Cnt*MEM_ISR_BLOCK_SIZE;
+    }
+#endif
 #endif    
 }
 /* End Function:_Sys_Mem_Init ************************************************/
@@ -157,12 +204,12 @@ void _Sys_Mem_Ins_TLSF(struct Mem_Head* Mem_Head_Ptr)
 
     Sys_Lock_Scheduler();
     
-    /* Guarantee the Mem_Size is bigger than 64 or a failure will surely 
-     * occur here.
+    /* Guarantee the Mem_Size is bigger than the minimum block or a failure will
+     * surely occur here.
      */
-    FLI_Level=Sys_Calc_MSB_Pos(Mem_Size)-6;
+    FLI_Level=Sys_Calc_MSB_Pos(Mem_Size)-MM_MIN_ORDER;
     /* Decide the SLI level directly from the FLI level */
-    SLI_Level=(Mem_Size>>(FLI_Level+3))&0x07;
+    SLI_Level=(Mem_Size>>(FLI_Level+MM_SLI_SHIFT))&MM_SLI_MASK;
     
     /* See if there are any blocks in the level, equal means no. So
      * what we inserted is the first block.
@@ -170,13 +217,14 @@ void _Sys_Mem_Ins_TLSF(struct Mem_Head* Mem_Head_Ptr)
     if(&(Mem_CB[FLI_Level][SLI_Level])==Mem_CB[FLI_Level][SLI_Level].Next)
     {
         /* Set the corresponding bit in the TLSF bitmap */
-        Mem_Bitmap[FLI_Level]|=1<<SLI_Level;
+        Mem_Bitmap[FLI_Level]|=((u32)1)<<SLI_Level;
     }
     
     /* Insert the node now */
     Sys_List_Insert_Node(&(Mem_Head_Ptr->Head),
                          &Mem_CB[FLI_Level][SLI_Level],
                          Mem_CB[FLI_Level][SLI_Level].Next);
+    Mem_Block_Cnt[FLI_Level][SLI_Level]++;
 
     Sys_Unlock_Scheduler();
 }
@@ -199,16 +247,17 @@ void _Sys_Mem_Del_TLSF(struct Mem_Head* Mem_Head_Ptr)
     s32 SLI_Level;
     size_t Mem_Size=(Mem_Head_Ptr->Mem_End_Addr)-(Mem_Head_Ptr->Mem_Start_Addr);
     
-    /* Guarantee the Mem_Size is bigger than 64 or a failure will surely 
-     * occur here.
+    /* Guarantee the Mem_Size is bigger than the minimum block or a failure will
+     * surely occur here.
      */
-    FLI_Level=Sys_Calc_MSB_Pos(Mem_Size)-6;
+    FLI_Level=Sys_Calc_MSB_Pos(Mem_Size)-MM_MIN_ORDER;
     /* Decide the SLI level directly from the FLI level */
-    SLI_Level=(Mem_Size>>(FLI_Level+3))&0x07;
+    SLI_Level=(Mem_Size>>(FLI_Level+MM_SLI_SHIFT))&MM_SLI_MASK;
     
     Sys_Lock_Scheduler();
     
     Sys_List_Delete_Node(Mem_Head_Ptr->Head.Prev,Mem_Head_Ptr->Head.Next);
+    Mem_Block_Cnt[FLI_Level][SLI_Level]--;
     
     /* See if there are any blocks in the level, equal means no. So
      * what we deleted is the last block.
@@ -216,7 +265,7 @@ void _Sys_Mem_Del_TLSF(struct Mem_Head* Mem_Head_Ptr)
     if(&(Mem_CB[FLI_Level][SLI_Level])==Mem_CB[FLI_Level][SLI_Level].Next)
     {
         /* Clear the corresponding bit in the TLSF bitmap */
-        Mem_Bitmap[FLI_Level]&=~(1<<SLI_Level);
+        Mem_Bitmap[FLI_Level]&=~(((u32)1)<<SLI_Level);
     }
     
     Sys_Unlock_Scheduler();
@@ -226,7 +275,7 @@ void _Sys_Mem_Del_TLSF(struct Mem_Head* Mem_Head_Ptr)
 
 /* Begin Function:Sys_Mem_TLSF_Bitmap_Search **********************************
 Description : The TLSF memory searcher. 
-Input       : size_t Mem_Size - The memory size, must be bigger than 64. This must 
+Input       : size_t Mem_Size - The memory size, must be bigger than 2^MM_MIN_ORDER. This must 
                              be guatanteed before calling this function or an 
                              error will unavoidably occur.
 Output      : s32* FLI_Level - The FLI level found.
@@ -240,17 +289,17 @@ retval_t Sys_Mem_TLSF_Bitmap_Search(size_t Mem_Size,s32* FLI_Level,s32* SLI_Leve
     s32 SLI_Level_Temp;
     Sys_Lock_Scheduler();
     
-    /* Make sure that it is bigger than 64. 64=2^6 */
-    FLI_Level_Temp=Sys_Calc_MSB_Pos(Mem_Size)-6;
+    /* Make sure that it is bigger than 2^MM_MIN_ORDER */
+    FLI_Level_Temp=Sys_Calc_MSB_Pos(Mem_Size)-MM_MIN_ORDER;
     /* Decide the SLI level directly from the FLI level. However, we plus 
      * the number by one here so that we can avoid the list search.
      */
-    SLI_Level_Temp=((Mem_Size>>(FLI_Level_Temp+3))&0x07)+1;
+    SLI_Level_Temp=((Mem_Size>>(FLI_Level_Temp+MM_SLI_SHIFT))&MM_SLI_MASK)+1;
     
     /* If the SLI level is the largest of the FLI level, then jump to the next 
      * FLI level.
      */
-    if(SLI_Level_Temp==8)
+    if(SLI_Level_Temp==MM_SLI)
     {
         FLI_Level_Temp+=1;
         SLI_Level_Temp=0;
@@ -266,7 +315,7 @@ retval_t Sys_Mem_TLSF_Bitmap_Search(size_t Mem_Size,s32* FLI_Level,s32* SLI_Leve
     /* If there's at least one block that matches the query, return the
      * level.
      */
-    if((Mem_Bitmap[FLI_Level_Temp]&(1<<SLI_Level_Temp))!=0)
+    if((Mem_Bitmap[FLI_Level_Temp]&(((u32)1)<<SLI_Level_Temp))!=0)
     {
         *FLI_Level=FLI_Level_Temp;
         *SLI_Level=SLI_Level_Temp;
@@ -296,7 +345,7 @@ retval_t Sys_Mem_TLSF_Bitmap_Search(size_t Mem_Size,s32* FLI_Level,s32* SLI_Leve
             for(FLI_Level_Temp+=1;FLI_Level_Temp<MM_FLI;FLI_Level_Temp++)
             {
                 /* if the level has blocks of one SLI level */
-                if((Mem_Bitmap[FLI_Level_Temp]&0xFF)!=0)
+                if(Mem_Bitmap[FLI_Level_Temp]!=0)
                 {
                     /* Find the SLI level */ 
                     SLI_Level_Temp=Sys_Calc_LSB_Pos(Mem_Bitmap[FLI_Level_Temp]);
@@ -318,6 +367,186 @@ retval_t Sys_Mem_TLSF_Bitmap_Search(size_t Mem_Size,s32* FLI_Level,s32* SLI_Leve
 #endif
 /* End Function:Sys_Mem_TLSF_Bitmap_Search ***********************************/
 
+/* Begin Function:_Sys_Mem_Split_Block ****************************************
+Description : Cut a memory block that has just been taken out of the TLSF table
+              to the size needed. If the space left is big enough to be a new 
+              block, it will be made a block and put back into the TLSF table;
+              else the whole block is kept.
+Input       : struct Mem_Head* Mem_Head_Ptr - The pointer to the memory block.
+              size_t Size - The rounded-up size that is needed.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void _Sys_Mem_Split_Block(struct Mem_Head* Mem_Head_Ptr,size_t Size)
+{
+    ptr_int_t Old_Start_Addr;
+    size_t Old_Block_Size;
+    ptr_int_t New_Start_Addr;
+    size_t New_Block_Size;
+    
+    /* See if the space left could be big enough to be a new block */
+    if((Mem_Head_Ptr->Mem_End_Addr)+1-Size-(Mem_Head_Ptr->Mem_Start_Addr)>=
+       sizeof(struct Mem_Head)+MM_MIN_BLOCK+sizeof(struct Mem_Tail))
+    {
+        /* There is enough space */
+        Old_Start_Addr=(Mem_Head_Ptr->Mem_Start_Addr)-sizeof(struct Mem_Head);
+        Old_Block_Size=Size+sizeof(struct Mem_Tail)+sizeof(struct Mem_Head);
+        New_Start_Addr=(Mem_Head_Ptr->Mem_Start_Addr)+Size+sizeof(struct Mem_Tail);
+        New_Block_Size=(Mem_Head_Ptr->Mem_End_Addr)+1-(Mem_Head_Ptr->Mem_Start_Addr)-Size;
+
+        _Sys_Mem_Init_Block(Old_Start_Addr,Old_Block_Size);
+        _Sys_Mem_Init_Block(New_Start_Addr,New_Block_Size);
+        
+        /* Put the extra block back */
+        _Sys_Mem_Ins_TLSF((struct Mem_Head*)New_Start_Addr);
+    }
+}
+#endif
+/* End Function:_Sys_Mem_Split_Block *****************************************/
+
+/* Begin Function:_Sys_Mem_Reg_Failure ***************************************
+Description : Register a failed allocation into the failure counters. The failure
+              is counted in the FLI class of the size; sizes bigger than the 
+              biggest FLI class are counted in the biggest one.
+Input       : size_t Mem_Size - The rounded-up size that failed to be allocated.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void _Sys_Mem_Reg_Failure(size_t Mem_Size)
+{
+    s32 FLI_Level;
+    
+    FLI_Level=Sys_Calc_MSB_Pos(Mem_Size)-MM_MIN_ORDER;
+    if(FLI_Level>=MM_FLI)
+        FLI_Level=MM_FLI-1;
+    
+    Mem_Failed_Cnt[FLI_Level]++;
+}
+#endif
+/* End Function:_Sys_Mem_Reg_Failure *****************************************/
+
+/* Begin Function:_Sys_Mem_Trace *********************************************
+Description : Record a memory operation into the trace ring buffer. The record 
+              is always put at the position decided by the total record number,
+              and the oldest record is overwritten when the buffer is full. The
+              callers have locked the scheduler, so there's only one writer.
+Input       : u32 Operation - The operation, "MEM_TRACE_MALLOC", "MEM_TRACE_MFREE"
+                              or "MEM_TRACE_REALLOC".
+              pid_t PID - The process ID.
+              ptr_int_t Caller_Addr - The return address of the caller.
+              size_t Size - The size of the memory.
+              ptr_int_t Mem_Addr - The memory address. For a failed allocation 
+                                   it is 0.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if((ENABLE_MEMM==TRUE)&&(ENABLE_MEM_TRACE==TRUE))
+void _Sys_Mem_Trace(u32 Operation,pid_t PID,ptr_int_t Caller_Addr,size_t Size,ptr_int_t Mem_Addr)
+{
+    struct Mem_Trace* Trace_Ptr;
+    
+    Trace_Ptr=&Mem_Trace_Buf[Mem_Trace_Cnt&(MEM_TRACE_DEPTH-1)];
+    Trace_Ptr->Timestamp=System_Status.Time.OS_Total_Ticks.Low_Bits;
+    Trace_Ptr->Operation=Operation;
+    Trace_Ptr->PID=PID;
+    Trace_Ptr->Caller_Addr=Caller_Addr;
+    Trace_Ptr->Size=Size;
+    Trace_Ptr->Mem_Addr=Mem_Addr;
+    
+    /* The record is complete, now make it visible */
+    Mem_Trace_Cnt++;
+}
+#endif
+/* End Function:_Sys_Mem_Trace ***********************************************/
+
+/* Begin Function:_Sys_Mem_Check_Quota ***************************************
+Description : See if a process can have some more memory under its quota. "Init"
+              has no quota, and a quota of 0 means no limit.
+              The size checked is the rounded-up size asked for; the block 
+              actually given may be bigger than it by less than a smallest block.
+Input       : pid_t PID - The process ID.
+              size_t Mem_Size - The size of the more memory needed.
+Output      : None.
+Return      : retval_t - If allowed, 0; else -1.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+retval_t _Sys_Mem_Check_Quota(pid_t PID,size_t Mem_Size)
+{
+    if((PID==0)||(PCB_Mem[PID].Memory_Quota==0))
+        return 0;
+    
+    if((PCB_Mem[PID].Memory_In_Use+Mem_Size)>PCB_Mem[PID].Memory_Quota)
+        return -1;
+    
+    return 0;
+}
+#endif
+/* End Function:_Sys_Mem_Check_Quota *****************************************/
+
+/* Begin Function:_Sys_Mem_Check_Malloc ***************************************
+Description : See if an allocation will succeed now, without doing it. This does
+              not count as a failed allocation. This should be called with the 
+              scheduler locked.
+Input       : pid_t PID - The process ID.
+              size_t Size - The size asked for.
+Output      : None.
+Return      : retval_t - If it will succeed, 0; else -1.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+retval_t _Sys_Mem_Check_Malloc(pid_t PID,size_t Size)
+{
+    s32 FLI_Level_Found;
+    s32 SLI_Level_Found;
+    size_t Temp_Size;
+    
+    /* Round up the size as "_Sys_Malloc" does */
+    Temp_Size=((Size>>3)+1)<<3;
+    Temp_Size=(Temp_Size>MM_MIN_BLOCK)?Temp_Size:MM_MIN_BLOCK;
+    
+    if((_Sys_Mem_Check_Quota(PID,Temp_Size)!=0)||
+       (Sys_Mem_TLSF_Bitmap_Search(Temp_Size,&FLI_Level_Found,&SLI_Level_Found)!=0))
+        return -1;
+    
+    return 0;
+}
+#endif
+/* End Function:_Sys_Mem_Check_Malloc ****************************************/
+
+/* Begin Function:_Sys_Mem_Check_Pressure *************************************
+Description : See if the free memory has crossed a watermark. When the free memory
+              drops below "MEM_LOW_WATERMARK", or rises back to "MEM_HIGH_WATERMARK",
+              each subscribed process will get its signal once. The subscribers 
+              can then call "Sys_Query_Mem_Pressure" to know which is the case.
+              Called at the end of the allocations and frees only, not when a 
+              block is taken out and put back inside an operation.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if((ENABLE_MEMM==TRUE)&&(MEM_LOW_WATERMARK!=0))
+void _Sys_Mem_Check_Pressure(void)
+{
+    pid_t PID;
+    
+    if((Mem_Pressure_Flag==0)&&(Free_Mem_Amount<MEM_LOW_WATERMARK))
+        Mem_Pressure_Flag=1;
+    else if((Mem_Pressure_Flag!=0)&&(Free_Mem_Amount>=MEM_HIGH_WATERMARK))
+        Mem_Pressure_Flag=0;
+    else
+        return;
+    
+    /* The "Init" process cannot receive signals */
+    for(PID=1;PID<MAX_PROC_NUM;PID++)
+    {
+        if((PCB_Mem[PID].Pressure_Signal!=NOSIG)&&((PCB[PID].Status.Running_Status&OCCUPY)!=0))
+            Sys_Send_Signal(PID,PCB_Mem[PID].Pressure_Signal);
+    }
+}
+#endif
+/* End Function:_Sys_Mem_Check_Pressure **************************************/
+
 /* Begin Function:_Sys_Mem_Ins_Allocated **************************************
 Description : The memory insertion function, to insert a certain memory block
               into the corresponding process's memory PCB registry and the "allocated"
@@ -356,6 +585,8 @@ void _Sys_Mem_Ins_Allocated(pid_t PID,struct Mem_Head* Mem_Head_Ptr)
     /* Fill statistical variables */
     Free_Mem_Amount-=((ptr_int_t)(Mem_Head_Ptr->Tail_Ptr))+sizeof(struct Mem_Tail)-((ptr_int_t)Mem_Head_Ptr);
     Used_Mem_Amount+=((ptr_int_t)(Mem_Head_Ptr->Tail_Ptr))+sizeof(struct Mem_Tail)-((ptr_int_t)Mem_Head_Ptr);
+    if(Used_Mem_Amount>Peak_Used_Mem_Amount)
+        Peak_Used_Mem_Amount=Used_Mem_Amount;
     
     Sys_Unlock_Scheduler();
 }
@@ -415,7 +646,7 @@ Output      : void* - The pointer to the memory. If no memory is allocatable,
 #if(ENABLE_MEMM==TRUE)
 void* Sys_Malloc(size_t Size)									                   
 {	
-    return(_Sys_Malloc(Current_PID,Size));
+    return(_Sys_Malloc_Caller(Current_PID,Size,MEM_TRACE_CALLER_ADDR()));
 }
 #endif
 /* End Function:Sys_Malloc ***************************************************/
@@ -430,30 +661,49 @@ Return      : void* - The pointer to the memory. If no memory is allocatable,
               then "ENOMEM"(0x00) is returned.
 ******************************************************************************/
 #if(ENABLE_MEMM==TRUE)
-void* _Sys_Malloc(pid_t PID,size_t Size)									                   
-{	
+void* _Sys_Malloc(pid_t PID,size_t Size)
+{
+    return(_Sys_Malloc_Caller(PID,Size,MEM_TRACE_CALLER_ADDR()));
+}
+#endif
+/* End Function:_Sys_Malloc **************************************************/
+
+/* Begin Function:_Sys_Malloc_Caller ******************************************
+Description : The body of "_Sys_Malloc" and "Sys_Malloc". The return address
+              got by the function called is passed in, so that the trace names
+              the real caller rather than the wrappers.
+Input       : pid_t PID - The PID you want.
+              size_t Size - The size of the RAM needed to allocate.
+              ptr_int_t Caller_Addr - The return address for the trace.
+Output      : None.
+Return      : void* - The pointer to the memory. If no memory is allocatable,
+              then "ENOMEM"(0x00) is returned.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void* _Sys_Malloc_Caller(pid_t PID,size_t Size,ptr_int_t Caller_Addr)
+{
     s32 FLI_Level_Found=0;
     s32 SLI_Level_Found=0;
     struct Mem_Head* Mem_Ptr;
     size_t Temp_Size;
-    
-    ptr_int_t Old_Start_Addr;
-    size_t Old_Block_Size;
-    ptr_int_t New_Start_Addr;
-    size_t New_Block_Size;
 
-    /* Round up the size:a multiple of 8 and bigger than 64B. In fact, we will add
+    /* Round up the size:a multiple of 8 and bigger than the minimum block. In fact, we will add
      * extra 8 bytes at the end if the size is a multiple of 8 for safety. 
      */
     Temp_Size=((Size>>3)+1)<<3;
     /* See if it is smaller than the smallest block */
-    Temp_Size=(Temp_Size>64+8)?Temp_Size:64+8;
+    Temp_Size=(Temp_Size>MM_MIN_BLOCK)?Temp_Size:MM_MIN_BLOCK;
     
     Sys_Lock_Scheduler();
     
-    /* See if such block exists, if not, abort */
-    if(Sys_Mem_TLSF_Bitmap_Search(Temp_Size,&FLI_Level_Found,&SLI_Level_Found)!=0)
+    /* See if the quota allows it and such block exists, if not, abort */
+    if((_Sys_Mem_Check_Quota(PID,Temp_Size)!=0)||
+       (Sys_Mem_TLSF_Bitmap_Search(Temp_Size,&FLI_Level_Found,&SLI_Level_Found)!=0))
     {
+        _Sys_Mem_Reg_Failure(Temp_Size);
+#if(ENABLE_MEM_TRACE==TRUE)
+        _Sys_Mem_Trace(MEM_TRACE_MALLOC,PID,Caller_Addr,Size,(ptr_int_t)ENOMEM);
+#endif
         Sys_Unlock_Scheduler();
         return ENOMEM;
     }
@@ -465,32 +715,157 @@ void* _Sys_Malloc(pid_t PID,size_t Size)
     /* Allocate and calculate if the space left could be big enough to be a new 
      * block. If so, we will put the block back into the TLSF table
      */
-    if((Mem_Ptr->Mem_End_Addr)+1-Temp_Size-(Mem_Ptr->Mem_Start_Addr)>=
-       sizeof(struct Mem_Head)+64+8+sizeof(struct Mem_Tail))
-    {
-        /* There is enough space */
-        Old_Start_Addr=(Mem_Ptr->Mem_Start_Addr)-sizeof(struct Mem_Head);
-        Old_Block_Size=Temp_Size+sizeof(struct Mem_Tail)+sizeof(struct Mem_Head);
-        New_Start_Addr=(Mem_Ptr->Mem_Start_Addr)+Temp_Size+sizeof(struct Mem_Tail);
-        New_Block_Size=(Mem_Ptr->Mem_End_Addr)+1-(Mem_Ptr->Mem_Start_Addr)-Temp_Size;
+    _Sys_Mem_Split_Block(Mem_Ptr,Temp_Size);
 
-        _Sys_Mem_Init_Block(Old_Start_Addr,Old_Block_Size);
-        _Sys_Mem_Init_Block(New_Start_Addr,New_Block_Size);
+    /* Insert the allocated block into the lists */
+    _Sys_Mem_Ins_Allocated(PID,Mem_Ptr);
+#if(ENABLE_MEM_TRACE==TRUE)
+    _Sys_Mem_Trace(MEM_TRACE_MALLOC,PID,Caller_Addr,Size,Mem_Ptr->Mem_Start_Addr);
+#endif
+#if(MEM_LOW_WATERMARK!=0)
+    _Sys_Mem_Check_Pressure();
+#endif
+    
+    /* Finally, return the start address */
+    Sys_Unlock_Scheduler();
+    return(void*)(Mem_Ptr->Mem_Start_Addr);
+}
+#endif
+/* End Function:_Sys_Malloc_Caller *******************************************/
+
+/* Begin Function:Sys_Malloc_Aligned ******************************************
+Description : Allocate some memory whose start address is aligned to a certain
+              power of 2. For application use. The PID variable is automatically
+              the "Current_PID".
+Input       : size_t Size - The size of the RAM needed to allocate.
+              size_t Align - The alignment needed. Must be a power of 2 and not
+                             bigger than "MAX_MEM_ALIGN".
+Output      : None.
+Return      : void* - The pointer to the memory. If no memory is allocatable,
+              then "ENOMEM"(0x00) is returned.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void* Sys_Malloc_Aligned(size_t Size,size_t Align)
+{
+    return(_Sys_Malloc_Aligned_Caller(Current_PID,Size,Align,MEM_TRACE_CALLER_ADDR()));
+}
+#endif
+/* End Function:Sys_Malloc_Aligned *******************************************/
+
+/* Begin Function:_Sys_Malloc_Aligned *****************************************
+Description : Allocate some aligned memory. For system use, or where you need to
+              specify the PID of the allocator.
+              We ask the TLSF table for a block that is big enough to hold the 
+              needed size plus the alignment plus a smallest block. If the start
+              address of the block found is not aligned, we will move the start 
+              address forward until it is aligned and the space skipped can be 
+              made a free block, which will be put back into the TLSF table. Thus
+              the memory returned is a normal block, and can be freed by "Sys_Mfree".
+Input       : pid_t PID - The PID you want.
+              size_t Size - The size of the RAM needed to allocate.
+              size_t Align - The alignment needed. Must be a power of 2 and not
+                             bigger than "MAX_MEM_ALIGN".
+Output      : None.
+Return      : void* - The pointer to the memory. If no memory is allocatable or the
+              alignment is invalid, then "ENOMEM"(0x00) is returned.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void* _Sys_Malloc_Aligned(pid_t PID,size_t Size,size_t Align)
+{
+    return(_Sys_Malloc_Aligned_Caller(PID,Size,Align,MEM_TRACE_CALLER_ADDR()));
+}
+#endif
+/* End Function:_Sys_Malloc_Aligned ******************************************/
+
+/* Begin Function:_Sys_Malloc_Aligned_Caller **********************************
+Description : The body of "_Sys_Malloc_Aligned" and "Sys_Malloc_Aligned". The
+              return address got by the function called is passed in, so that
+              the trace names the real caller rather than the wrappers.
+Input       : pid_t PID - The PID you want.
+              size_t Size - The size of the RAM needed to allocate.
+              size_t Align - The alignment needed. Must be a power of 2 and not
+                             bigger than "MAX_MEM_ALIGN".
+              ptr_int_t Caller_Addr - The return address for the trace.
+Output      : None.
+Return      : void* - The pointer to the memory. If no memory is allocatable or the
+              alignment is invalid, then "ENOMEM"(0x00) is returned.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void* _Sys_Malloc_Aligned_Caller(pid_t PID,size_t Size,size_t Align,ptr_int_t Caller_Addr)
+{
+    s32 FLI_Level_Found=0;
+    s32 SLI_Level_Found=0;
+    struct Mem_Head* Mem_Ptr;
+    size_t Temp_Size;
+    size_t Pad_Size;
+    ptr_int_t Aligned_Addr;
+    ptr_int_t Block_End_Addr;
+    
+    /* The alignment must be a power of 2 and within the boundary */
+    if((Align==0)||((Align&(Align-1))!=0)||(Align>MAX_MEM_ALIGN))
+        return ENOMEM;
+    
+    /* Round up the size as "_Sys_Malloc" does */
+    Temp_Size=((Size>>3)+1)<<3;
+    Temp_Size=(Temp_Size>MM_MIN_BLOCK)?Temp_Size:MM_MIN_BLOCK;
+    
+    /* The smallest space that can be made a free block before the aligned one */
+    Pad_Size=sizeof(struct Mem_Head)+MM_MIN_BLOCK+sizeof(struct Mem_Tail);
+    
+    Sys_Lock_Scheduler();
+    
+    /* See if the quota allows it and such block exists, if not, abort */
+    if((_Sys_Mem_Check_Quota(PID,Temp_Size)!=0)||
+       (Sys_Mem_TLSF_Bitmap_Search(Temp_Size+Pad_Size+Align,&FLI_Level_Found,&SLI_Level_Found)!=0))
+    {
+        _Sys_Mem_Reg_Failure(Temp_Size);
+#if(ENABLE_MEM_TRACE==TRUE)
+        _Sys_Mem_Trace(MEM_TRACE_MALLOC,PID,Caller_Addr,Size,(ptr_int_t)ENOMEM);
+#endif
+        Sys_Unlock_Scheduler();
+        return ENOMEM;
+    }
+    
+    /* There is such block. Get it and delete it from the TLSF list. */
+    Mem_Ptr=(struct Mem_Head*)Mem_CB[FLI_Level_Found][SLI_Level_Found].Next;
+    _Sys_Mem_Del_TLSF(Mem_Ptr);
+    
+    /* If the start address is not aligned, move it forward. The space skipped 
+     * must be big enough to be a block.
+     */
+    if(((Mem_Ptr->Mem_Start_Addr)&(Align-1))!=0)
+    {
+        Aligned_Addr=((Mem_Ptr->Mem_Start_Addr)+Pad_Size+Align-1)&(~((ptr_int_t)(Align-1)));
+        Block_End_Addr=((ptr_int_t)(Mem_Ptr->Tail_Ptr))+sizeof(struct Mem_Tail);
         
-        /* Put the extra block back */
-        _Sys_Mem_Ins_TLSF((struct Mem_Head*)New_Start_Addr);
-        /* Register the block just allocated into the allocated list and the corresponding*/
+        /* Make the aligned block first, then the block before it */
+        _Sys_Mem_Init_Block(Aligned_Addr-sizeof(struct Mem_Head),
+                            Block_End_Addr-(Aligned_Addr-sizeof(struct Mem_Head)));
+        _Sys_Mem_Init_Block((ptr_int_t)Mem_Ptr,
+                            Aligned_Addr-sizeof(struct Mem_Head)-((ptr_int_t)Mem_Ptr));
+        
+        /* Put the block before it back */
+        _Sys_Mem_Ins_TLSF(Mem_Ptr);
+        Mem_Ptr=(struct Mem_Head*)(Aligned_Addr-sizeof(struct Mem_Head));
     }
-
+    
+    /* Cut the space after it if possible */
+    _Sys_Mem_Split_Block(Mem_Ptr,Temp_Size);
+    
     /* Insert the allocated block into the lists */
     _Sys_Mem_Ins_Allocated(PID,Mem_Ptr);
+#if(ENABLE_MEM_TRACE==TRUE)
+    _Sys_Mem_Trace(MEM_TRACE_MALLOC,PID,Caller_Addr,Size,Mem_Ptr->Mem_Start_Addr);
+#endif
+#if(MEM_LOW_WATERMARK!=0)
+    _Sys_Mem_Check_Pressure();
+#endif
     
-    /* Finally, return the start address */
     Sys_Unlock_Scheduler();
     return(void*)(Mem_Ptr->Mem_Start_Addr);
 }
 #endif
-/* End Function:_Sys_Malloc **************************************************/
+/* End Function:_Sys_Malloc_Aligned_Caller ***********************************/
 
 /* Begin Function:Sys_Mfree ***************************************************
 Description : Free allocated memory, for both system and application use.
@@ -501,7 +876,7 @@ Return      : None.
 #if(ENABLE_MEMM==TRUE)
 void Sys_Mfree(void* Mem_Ptr)
 {	 															               
-    _Sys_Mfree(Current_PID,Mem_Ptr);
+    _Sys_Mfree_Caller(Current_PID,Mem_Ptr,MEM_TRACE_CALLER_ADDR());
 }
 #endif
 /* End Function:Sys_Mfree ****************************************************/
@@ -516,12 +891,37 @@ Return      : None.
 ******************************************************************************/
 #if(ENABLE_MEMM==TRUE)
 void _Sys_Mfree(pid_t PID,void* Mem_Ptr)
+{
+    _Sys_Mfree_Caller(PID,Mem_Ptr,MEM_TRACE_CALLER_ADDR());
+}
+#endif
+/* End Function:_Sys_Mfree ***************************************************/
+
+/* Begin Function:_Sys_Mfree_Caller *******************************************
+Description : The body of "_Sys_Mfree" and "Sys_Mfree". The return address got
+              by the function called is passed in, so that the trace names the
+              real caller rather than the wrappers.
+Input       : pid_t PID - The process ID.
+              void* Mem_Ptr - The pointer returned by "Sys_Malloc".
+              ptr_int_t Caller_Addr - The return address for the trace.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void _Sys_Mfree_Caller(pid_t PID,void* Mem_Ptr,ptr_int_t Caller_Addr)
 {	 					
     struct Mem_Head* Mem_Head_Ptr=(struct Mem_Head*)(((ptr_int_t)Mem_Ptr)-sizeof(struct Mem_Head));
-    struct Mem_Head* Left_Mem_Head_Ptr;
-    struct Mem_Head* Right_Mem_Head_Ptr;
-    s32 Merge_Left_Flag=0;
+    ptr_int_t Occupy_Flag;
     
+#if(MEM_ISR_BLOCKS!=0)
+    /* The blocks of the interrupt reserve go back to the reserve */
+    if(((ptr_int_t)Mem_Ptr>=Mem_ISR_Start_Addr)&&((ptr_int_t)Mem_Ptr<=Mem_ISR_End_Addr))
+    {
+        Sys_Mfree_ISR(Mem_Ptr);
+        return;
+    }
+#endif
+
     /* See if the address is within the allocatable address range. If not, abort directly. */
     if(((ptr_int_t)Mem_Ptr<DMEM_START_ADDR)||((ptr_int_t)Mem_Ptr>DMEM_END_ADDR))
         return;
@@ -541,8 +941,56 @@ void _Sys_Mfree(pid_t PID,void* Mem_Ptr)
         Sys_Unlock_Scheduler();
         return;
     }
+    
+    /* An interrupt handler may be freeing it at the same time. Whoever marks it
+     * first frees it, and if it is already in the deferred free list, this is a
+     * double free. If the swap fails, an interrupt handler has just marked it.
+     */
+    Occupy_Flag=Mem_Head_Ptr->Occupy_Flag;
+    if(((Occupy_Flag&MEM_DEFER_FLAG)!=0)||
+       (COMPARE_AND_SWAP(&(Mem_Head_Ptr->Occupy_Flag),Occupy_Flag,0)!=0))
+    {
+        Sys_Unlock_Scheduler();
+        return;
+    }
+
+#if(ENABLE_MEM_HANDLE==TRUE)
+    /* If the block belongs to a handle, the handle is gone as well */
+    if((Occupy_Flag&MEM_HANDLE_FLAG)!=0)
+        _Sys_Mem_Del_Handle(MEM_HANDLE_OF(Occupy_Flag));
+#endif
+
+    /* Now we are sure that it can be freed */
+#if(ENABLE_MEM_TRACE==TRUE)
+    _Sys_Mem_Trace(MEM_TRACE_MFREE,PID,Caller_Addr,
+                   (Mem_Head_Ptr->Mem_End_Addr)+1-(Mem_Head_Ptr->Mem_Start_Addr),(ptr_int_t)Mem_Ptr);
+#endif
+    _Sys_Mem_Free_Block(Mem_Head_Ptr);
+#if(MEM_LOW_WATERMARK!=0)
+    _Sys_Mem_Check_Pressure();
+#endif
+
+    Sys_Unlock_Scheduler();
+}
+#endif
+/* End Function:_Sys_Mfree_Caller ********************************************/
 
-    /* Now we are sure that it can be freed. Delete it from the allocated list now */
+/* Begin Function:_Sys_Mem_Free_Block *****************************************
+Description : Give an allocated block back to the TLSF table, merging it with the
+              free blocks around it. The caller has made sure that the block can 
+              be freed. This should be called with the scheduler locked.
+Input       : struct Mem_Head* Mem_Head_Ptr - The pointer to the block header.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void _Sys_Mem_Free_Block(struct Mem_Head* Mem_Head_Ptr)
+{
+    struct Mem_Head* Left_Mem_Head_Ptr;
+    struct Mem_Head* Right_Mem_Head_Ptr;
+    s32 Merge_Left_Flag=0;
+    
+    /* Delete it from the allocated list */
     _Sys_Mem_Del_Allocated(Mem_Head_Ptr);
     
     /* Now check if we can merge it with the on-the-right blocks. Take note that we must
@@ -550,7 +998,7 @@ void _Sys_Mfree(pid_t PID,void* Mem_Ptr)
      * Here left means lower address and right means higher address.
      * We may need some sort of assertion here.
      */
-    if((ptr_int_t)((Mem_Head_Ptr->Tail_Ptr)+sizeof(struct Mem_Tail))!=(ptr_int_t)(DMEM_Heap+DMEM_SIZE))
+    if(((ptr_int_t)(Mem_Head_Ptr->Tail_Ptr))+sizeof(struct Mem_Tail)!=(ptr_int_t)(DMEM_Heap+DMEM_SIZE))
     {
         Right_Mem_Head_Ptr=(struct Mem_Head*)(((ptr_int_t)(Mem_Head_Ptr->Tail_Ptr))+sizeof(struct Mem_Tail));
 
@@ -598,66 +1046,1344 @@ void _Sys_Mfree(pid_t PID,void* Mem_Ptr)
     {
         _Sys_Mem_Ins_TLSF(Left_Mem_Head_Ptr);
     }
-
-    Sys_Unlock_Scheduler();
-}
-#endif
-/* End Function:_Sys_Mfree ***************************************************/
-
-/* Begin Function:Sys_Mfree_All ***********************************************
-Description : Free all allocated memory. For application use.
-Input       : None.
-Output      : None.
-Return      : None.
-******************************************************************************/
-#if(ENABLE_MEMM==TRUE)
-void Sys_Mfree_All(void)									     
-{
-	_Sys_Mfree_All(Current_PID);
+    
+    /* The merged block may be what some process is waiting for */
+    _Sys_Mem_Wake_Waiter();
 }
 #endif
-/* End Function:Sys_Mfree_All ************************************************/
+/* End Function:_Sys_Mem_Free_Block ******************************************/
 
-/* Begin Function:_Sys_Mfree_All **********************************************
-Description : Free all allocated memory of a certain process. For system use,
-              or where you want to specify the PID.
-Input       : pid_t PID-The process's PID.
+/* Begin Function:Sys_Malloc_Wait *********************************************
+Description : Allocate some memory, and if there is not enough, wait until some 
+              is freed or the time is up. For application use. The PID variable
+              is automatically the "Current_PID".
+              The allocation is only tried when it will succeed, until the last
+              try when the time is up, so a request is counted as one failed
+              allocation at most however many times it waits.
+Input       : size_t Size - The size of the RAM needed to allocate.
+              time_t Time - The longest time to wait. If the time is "WAIT_INFINITE",
+                            then the process will wait until it gets the memory.
 Output      : None.
-Return      : None.
+Return      : void* - The pointer to the memory. If no memory is allocatable
+              before the time is up, then "ENOMEM"(0x00) is returned.
 ******************************************************************************/
 #if(ENABLE_MEMM==TRUE)
-void _Sys_Mfree_All(pid_t PID)									     
+void* Sys_Malloc_Wait(size_t Size,time_t Time)
 {
-    struct Mem_Head* Mem_Head_Ptr;
-    struct List_Head* Traverse_List_Ptr;
+    void* Mem_Ptr=ENOMEM;
+    ptr_int_t Caller_Addr;
+    time_t Start_Time;
+    time_t Passed_Time;
+    time_t Wait_Time;
     
-    /* See if the PID is valid in the system */
-    if(PID>=MAX_PROC_NUM)
+    Caller_Addr=MEM_TRACE_CALLER_ADDR();
+    Start_Time=System_Status.Time.OS_Total_Ticks.Low_Bits;
+    
+    while(1)
+    {
+        Sys_Lock_Scheduler();
+        if(_Sys_Mem_Check_Malloc(Current_PID,Size)==0)
+        {
+            Mem_Ptr=_Sys_Malloc_Caller(Current_PID,Size,Caller_Addr);
+            Sys_Unlock_Scheduler();
+            break;
+        }
+        Sys_Unlock_Scheduler();
+        
+        /* See how much time is left */
+        if(Time!=WAIT_INFINITE)
+        {
+            Passed_Time=System_Status.Time.OS_Total_Ticks.Low_Bits-Start_Time;
+            if(Passed_Time>=Time)
+                break;
+            
+            Wait_Time=Time-Passed_Time;
+        }
+        else
+            Wait_Time=WAIT_INFINITE;
+        
+        /* Wait for the memory. Being woken up does not guarantee that the block is still 
+         * there when we get to run, so we try again. If the wait failed, we stop.
+         */
+        if(Sys_Wait_Object((cnt_t)Size,MEMORY,Wait_Time)==-1)
+            break;
+    }
+    
+    /* The last try, which registers the failure if it fails */
+    if(Mem_Ptr==ENOMEM)
+        return(_Sys_Malloc_Caller(Current_PID,Size,Caller_Addr));
+    
+    /* What we left may still be enough for the next process in the wait list */
+    Sys_Lock_Scheduler();
+    _Sys_Mem_Wake_Waiter();
+    Sys_Unlock_Scheduler();
+    
+    return Mem_Ptr;
+}
+#endif
+/* End Function:Sys_Malloc_Wait **********************************************/
+
+/* Begin Function:_Sys_Wait_Mem_Reg *******************************************
+Description : When we decide to wait for memory, this function will be called.
+              The wait blocks are kept in the ascending order of the size needed.
+              Take note that when the wait is successful, the memory is not 
+              allocated for the process, and you need to allocate it by yourself.
+Input       : pid_t PID - The process waiting for the memory. We don't check whether 
+                          the PID is valid here.
+              size_t Size - The size of the memory needed.
+              struct Wait_Object_Struct* Wait_Block_Ptr - The pointer to the wait block.
+Output      : None.
+Return      : retval_t - If successful,0; if there's no need to wait, "NO_NEED_TO_WAIT(-2)";
+                         if the wait failed, "WAIT_FAILURE(-1)".
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+retval_t _Sys_Wait_Mem_Reg(pid_t PID,size_t Size,struct Wait_Object_Struct* Wait_Block_Ptr)
+{
+    s32 FLI_Level_Found;
+    s32 SLI_Level_Found;
+    size_t Temp_Size;
+    struct List_Head* Traverse_List_Ptr;
+    
+    /* Round up the size as "_Sys_Malloc" does */
+    Temp_Size=((Size>>3)+1)<<3;
+    Temp_Size=(Temp_Size>MM_MIN_BLOCK)?Temp_Size:MM_MIN_BLOCK;
+    
+    /* A block bigger than the heap will never be there */
+    if(Temp_Size>DMEM_SIZE)
+        return(WAIT_FAILURE);
+    
+    Sys_Lock_Scheduler();
+    
+    /* If the quota does not allow it, freeing memory of others won't help */
+    if(_Sys_Mem_Check_Quota(PID,Temp_Size)!=0)
+    {
+        Sys_Unlock_Scheduler();
+        return(WAIT_FAILURE);
+    }
+    
+    /* See if there is such a block now. If yes, return right away. */
+    if(Sys_Mem_TLSF_Bitmap_Search(Temp_Size,&FLI_Level_Found,&SLI_Level_Found)==0)
+    {
+        Sys_Unlock_Scheduler();
+        return(NO_NEED_TO_WAIT);
+    }
+    
+    /* Find the first waiter that needs more than us, and insert before it. Waiters
+     * of the same size are thus served first come first served.
+     */
+    Traverse_List_Ptr=Mem_Wait_List_Head.Next;
+    while(Traverse_List_Ptr!=&Mem_Wait_List_Head)
+    {
+        if((size_t)(((struct Wait_Object_Struct*)(Traverse_List_Ptr-1))->Obj_ID)>Size)
+            break;
+        
+        Traverse_List_Ptr=Traverse_List_Ptr->Next;
+    }
+    
+    Sys_List_Insert_Node(&(Wait_Block_Ptr->Object_Head),Traverse_List_Ptr->Prev,Traverse_List_Ptr);
+    
+    Wait_Block_Ptr->Obj_ID=(cnt_t)Size;
+    Wait_Block_Ptr->PID=PID;
+    Wait_Block_Ptr->Type=MEMORY;
+    
+    Sys_Unlock_Scheduler();
+    return 0;
+}
+#endif
+/* End Function:_Sys_Wait_Mem_Reg ********************************************/
+
+/* Begin Function:_Sys_Mem_Wake_Waiter ****************************************
+Description : Wake up the process that fits best in the free memory, that is, the 
+              one that needs the most among the ones that can be satisfied now. 
+              Only one process is woken up; when it gets the memory, it will try 
+              to wake up the next one. This should be called with the scheduler 
+              locked.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void _Sys_Mem_Wake_Waiter(void)
+{
+    s32 FLI_Level_Found;
+    s32 SLI_Level_Found;
+    size_t Temp_Size;
+    struct List_Head* Traverse_List_Ptr;
+    struct Wait_Object_Struct* Wait_Block_Ptr;
+    
+    /* If a size cannot be satisfied, the bigger ones cannot either. Thus the one
+     * before the first that cannot be satisfied is the best fit.
+     */
+    Wait_Block_Ptr=0;
+    Traverse_List_Ptr=Mem_Wait_List_Head.Next;
+    while(Traverse_List_Ptr!=&Mem_Wait_List_Head)
+    {
+        Temp_Size=((((size_t)(((struct Wait_Object_Struct*)(Traverse_List_Ptr-1))->Obj_ID))>>3)+1)<<3;
+        Temp_Size=(Temp_Size>MM_MIN_BLOCK)?Temp_Size:MM_MIN_BLOCK;
+        
+        if(Sys_Mem_TLSF_Bitmap_Search(Temp_Size,&FLI_Level_Found,&SLI_Level_Found)!=0)
+            break;
+        
+        Wait_Block_Ptr=(struct Wait_Object_Struct*)(Traverse_List_Ptr-1);
+        Traverse_List_Ptr=Traverse_List_Ptr->Next;
+    }
+    
+    if(Wait_Block_Ptr==0)
+        return;
+    
+    /* Mark that the wait is successful */
+    Wait_Block_Ptr->Succeed_Flag=1;
+    /* Delete the wait block from the memory wait list */
+    Sys_List_Delete_Node(Wait_Block_Ptr->Object_Head.Prev,Wait_Block_Ptr->Object_Head.Next);
+    /* Try to stop the timer if possible */
+    Sys_Proc_Delay_Cancel(Wait_Block_Ptr->PID);
+    /* Wake the process up */
+    _Sys_Set_Ready(Wait_Block_Ptr->PID);
+}
+#endif
+/* End Function:_Sys_Mem_Wake_Waiter *****************************************/
+
+/* Begin Function:Sys_Malloc_ISR **********************************************
+Description : Allocate some memory in an interrupt handler. The memory comes from
+              the interrupt reserve, which is a set of blocks of "MEM_ISR_BLOCK_SIZE"
+              carved from the heap on startup, and is never taken from the TLSF 
+              table. Thus the function can interrupt a process that is in the 
+              allocator. The reserve is protected by locking the interrupt for 
+              several instructions.
+Input       : size_t Size - The size of the RAM needed to allocate. Must not be
+                            bigger than "MEM_ISR_BLOCK_SIZE".
+Output      : None.
+Return      : void* - The pointer to the memory. If no memory is allocatable,
+              then "ENOMEM"(0x00) is returned.
+******************************************************************************/
+#if((ENABLE_MEMM==TRUE)&&(MEM_ISR_BLOCKS!=0))
+void* Sys_Malloc_ISR(size_t Size)
+{
+    ptr_int_t Mem_Addr;
+    
+    if(Size>MEM_ISR_BLOCK_SIZE)
+        return ENOMEM;
+    
+    Sys_Lock_Interrupt();
+    
+    Mem_Addr=Mem_ISR_Free_List;
+    if(Mem_Addr!=(ptr_int_t)ENOMEM)
+        Mem_ISR_Free_List=*((ptr_int_t*)Mem_Addr);
+    
+    Sys_Unlock_Interrupt();
+    
+    return (void*)Mem_Addr;
+}
+#endif
+/* End Function:Sys_Malloc_ISR ***********************************************/
+
+/* Begin Function:Sys_Mfree_ISR ***********************************************
+Description : Free some memory in an interrupt handler. 
+              (1) If the memory is from the interrupt reserve, it goes back to the
+                  reserve at once.
+              (2) If the memory is from "Sys_Malloc", it is marked and put into 
+                  the deferred free list, and will be freed in the name of its 
+                  owner when the kernel unlocks the scheduler in the process 
+                  context next time. The memory that is already freed or in the
+                  list, and the memory of handles, is ignored.
+              The deferred free list is lock-free: the block is marked and pushed
+              with "COMPARE_AND_SWAP", so the interrupts are never locked for it.
+              The reserve list is still changed with the interrupt locked for
+              several instructions, for a lock-free pop in "Sys_Malloc_ISR" could
+              take a block that a nested handler has just taken and put back. The
+              TLSF table is never touched.
+Input       : void* Mem_Ptr - The pointer returned by "Sys_Malloc_ISR" or "Sys_Malloc".
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void Sys_Mfree_ISR(void* Mem_Ptr)
+{
+    struct Mem_Head* Mem_Head_Ptr=(struct Mem_Head*)(((ptr_int_t)Mem_Ptr)-sizeof(struct Mem_Head));
+    
+#if(MEM_ISR_BLOCKS!=0)
+    if(((ptr_int_t)Mem_Ptr>=Mem_ISR_Start_Addr)&&((ptr_int_t)Mem_Ptr<=Mem_ISR_End_Addr))
+    {
+        Sys_Lock_Interrupt();
+        *((ptr_int_t*)Mem_Ptr)=Mem_ISR_Free_List;
+        Mem_ISR_Free_List=(ptr_int_t)Mem_Ptr;
+        Sys_Unlock_Interrupt();
+        return;
+    }
+#endif
+
+    /* See if the address is within the allocatable address range. If not, abort directly. */
+    if(((ptr_int_t)Mem_Ptr<DMEM_START_ADDR)||((ptr_int_t)Mem_Ptr>DMEM_END_ADDR))
         return;
     
-    /* The PID is within the boundary but the process is nonexistent in the
-     * system.
+    /* Only a block that is allocated and not in the list yet can go in. The mark
+     * also stops the process and the nested handlers from freeing it at the same
+     * time; only the one that marks it goes on.
+     */
+    if(COMPARE_AND_SWAP(&(Mem_Head_Ptr->Occupy_Flag),1,1|MEM_DEFER_FLAG)!=0)
+        return;
+    
+    _Sys_Mem_Push_Deferred((ptr_int_t)Mem_Ptr,(ptr_int_t)Mem_Ptr);
+}
+#endif
+/* End Function:Sys_Mfree_ISR ************************************************/
+
+/* Begin Function:_Sys_Mem_Push_Deferred **************************************
+Description : Put a chain of blocks into the deferred free list, without locking
+              the interrupt. The blocks are chained with their first words, and 
+              the first word of the last block is filled here. If an interrupt 
+              handler pushes in between, the head has changed, and we try again.
+              The chain only points to the old head, so the push is still right
+              if the head has changed and come back to the same block.
+Input       : ptr_int_t First_Addr - The first block of the chain.
+              ptr_int_t Last_Addr - The last block of the chain.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void _Sys_Mem_Push_Deferred(ptr_int_t First_Addr,ptr_int_t Last_Addr)
+{
+    ptr_int_t Head_Addr;
+    
+    do
+    {
+        Head_Addr=Mem_Deferred_List;
+        /* The block is at least a minimum block so this is safe */
+        *((ptr_int_t*)Last_Addr)=Head_Addr;
+    }
+    while(COMPARE_AND_SWAP(&Mem_Deferred_List,Head_Addr,First_Addr)!=0);
+}
+#endif
+/* End Function:_Sys_Mem_Push_Deferred ***************************************/
+
+/* Begin Function:_Sys_Mem_Take_Deferred **************************************
+Description : Take the whole deferred free list away, without locking the 
+              interrupt. The interrupt handlers can keep putting memory into the
+              list after this.
+Input       : None.
+Output      : None.
+Return      : ptr_int_t - The first block of the list taken away, or "ENOMEM" if 
+                          the list is empty.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+ptr_int_t _Sys_Mem_Take_Deferred(void)
+{
+    ptr_int_t Head_Addr;
+    
+    do
+        Head_Addr=Mem_Deferred_List;
+    while(COMPARE_AND_SWAP(&Mem_Deferred_List,Head_Addr,(ptr_int_t)ENOMEM)!=0);
+    
+    return Head_Addr;
+}
+#endif
+/* End Function:_Sys_Mem_Take_Deferred ***************************************/
+
+/* Begin Function:_Sys_Mem_Free_Deferred **************************************
+Description : Free all the memory in the deferred free list, in the name of their
+              owners. This is called by "Sys_Unlock_Scheduler" when the scheduler 
+              is about to be unlocked and we are not in an interrupt handler.
+              The whole list is taken away at once, so the interrupt handlers can
+              keep putting memory into it while we are freeing.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void _Sys_Mem_Free_Deferred(void)
+{
+    ptr_int_t Mem_Addr;
+    ptr_int_t Next_Mem_Addr;
+    struct Mem_Head* Mem_Head_Ptr;
+    
+    /* Most of the time it is empty */
+    if(Mem_Deferred_List==(ptr_int_t)ENOMEM)
+        return;
+    
+    Mem_Addr=_Sys_Mem_Take_Deferred();
+    
+    while(Mem_Addr!=(ptr_int_t)ENOMEM)
+    {
+        /* Get the next one first, the block will be destroyed soon. The block is
+         * marked, so it is freed directly rather than through "_Sys_Mfree".
+         */
+        Next_Mem_Addr=*((ptr_int_t*)Mem_Addr);
+        Mem_Head_Ptr=(struct Mem_Head*)(Mem_Addr-sizeof(struct Mem_Head));
+#if(ENABLE_MEM_TRACE==TRUE)
+        /* The interrupt handlers are not recorded as callers, so 0 goes into the trace */
+        _Sys_Mem_Trace(MEM_TRACE_MFREE,Mem_Head_Ptr->Occupy_PID,0,
+                       (Mem_Head_Ptr->Mem_End_Addr)+1-(Mem_Head_Ptr->Mem_Start_Addr),Mem_Addr);
+#endif
+        _Sys_Mem_Free_Block(Mem_Head_Ptr);
+        Mem_Addr=Next_Mem_Addr;
+    }
+    /* The watermarks are not checked here, for this is in the middle of unlocking
+     * the scheduler. The next allocation or free will see the memory freed.
+     */
+}
+#endif
+/* End Function:_Sys_Mem_Free_Deferred ***************************************/
+
+/* Begin Function:Sys_Mfree_All ***********************************************
+Description : Free all allocated memory. For application use.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void Sys_Mfree_All(void)									     
+{
+	_Sys_Mfree_All(Current_PID);
+}
+#endif
+/* End Function:Sys_Mfree_All ************************************************/
+
+/* Begin Function:_Sys_Mfree_All **********************************************
+Description : Free all allocated memory of a certain process. For system use,
+              or where you want to specify the PID.
+Input       : pid_t PID-The process's PID.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void _Sys_Mfree_All(pid_t PID)									     
+{
+    struct Mem_Head* Mem_Head_Ptr;
+    struct List_Head* Traverse_List_Ptr;
+    ptr_int_t Mem_Addr;
+    ptr_int_t Next_Mem_Addr;
+    ptr_int_t Keep_First_Addr;
+    ptr_int_t Keep_Last_Addr;
+    
+    /* See if the PID is valid in the system */
+    if(PID>=MAX_PROC_NUM)
+        return;
+    
+    /* The PID is within the boundary but the process is nonexistent in the
+     * system.
+     */
+    if(((PCB[PID].Status.Running_Status)&OCCUPY)==0)
+        return;
+    
+    Sys_Lock_Scheduler();
+    
+    /* Take the blocks of the process out of the deferred free list, or they will
+     * be freed again when the list is emptied. The list is short, for it is
+     * emptied every time the scheduler is unlocked. The whole list is taken 
+     * away, and the blocks of the other processes are put back at once. The 
+     * unmarked blocks are freed below; if an interrupt handler marks one of them
+     * again before that, it is left to the deferred free.
+     */
+    Mem_Addr=_Sys_Mem_Take_Deferred();
+    Keep_First_Addr=(ptr_int_t)ENOMEM;
+    Keep_Last_Addr=(ptr_int_t)ENOMEM;
+    while(Mem_Addr!=(ptr_int_t)ENOMEM)
+    {
+        Next_Mem_Addr=*((ptr_int_t*)Mem_Addr);
+        Mem_Head_Ptr=(struct Mem_Head*)(Mem_Addr-sizeof(struct Mem_Head));
+        if((Mem_Head_Ptr->Occupy_PID)==PID)
+            Mem_Head_Ptr->Occupy_Flag&=~MEM_DEFER_FLAG;
+        else
+        {
+            *((ptr_int_t*)Mem_Addr)=Keep_First_Addr;
+            if(Keep_First_Addr==(ptr_int_t)ENOMEM)
+                Keep_Last_Addr=Mem_Addr;
+            Keep_First_Addr=Mem_Addr;
+        }
+        
+        Mem_Addr=Next_Mem_Addr;
+    }
+    
+    if(Keep_First_Addr!=(ptr_int_t)ENOMEM)
+        _Sys_Mem_Push_Deferred(Keep_First_Addr,Keep_Last_Addr);
+    
+    Traverse_List_Ptr=PCB_Mem[PID].Head.Next;
+    
+    /* Traverse the list and free all memory */
+    while(Traverse_List_Ptr!=&(PCB_Mem[PID].Head))
+    {
+        Mem_Head_Ptr=(struct Mem_Head*)(((ptr_int_t)Traverse_List_Ptr)-sizeof(struct List_Head));
+        /* Move to the next node first. After deletion the list will be nonexistent */
+        Traverse_List_Ptr=Traverse_List_Ptr->Next;
+        _Sys_Mfree_Caller(PID,(void*)(Mem_Head_Ptr->Mem_Start_Addr),MEM_TRACE_CALLER_ADDR());
+    }
+
+    Sys_Unlock_Scheduler();
+}
+#endif
+/* End Function:_Sys_Mfree_All ***********************************************/
+
+/* Begin Function:Sys_Realloc *************************************************
+Description : Change the size of some allocated memory. For application use. The 
+              PID variable is automatically the "Current_PID".
+Input       : void* Mem_Ptr - The pointer returned by "Sys_Malloc".
+              size_t Size - The new size needed.
+Output      : None.
+Return      : void* - The pointer to the memory. If no memory is allocatable,
+              then "ENOMEM"(0x00) is returned and the old memory is untouched.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void* Sys_Realloc(void* Mem_Ptr,size_t Size)
+{
+    return(_Sys_Realloc_Caller(Current_PID,Mem_Ptr,Size,MEM_TRACE_CALLER_ADDR()));
+}
+#endif
+/* End Function:Sys_Realloc **************************************************/
+
+/* Begin Function:_Sys_Realloc ************************************************
+Description : Change the size of some allocated memory, in the name of a certain 
+              process. 
+              (1) If the block is to be shrinked, we will cut it in place.
+              (2) If the block is to be enlarged, we will first try to merge the 
+                  free block on its right side(found by the tail of this block),
+                  and then cut it in place.
+              (3) Only when (2) fails will we allocate a new block, copy the data
+                  and free the old one.
+              If the "Mem_Ptr" is "ENOMEM", this is the same as "_Sys_Malloc". The
+              memory from "Sys_Malloc_ISR" cannot be changed.
+Input       : pid_t PID - The process ID.
+              void* Mem_Ptr - The pointer returned by "Sys_Malloc".
+              size_t Size - The new size needed.
+Output      : None.
+Return      : void* - The pointer to the memory. If no memory is allocatable, or
+              the block cannot be changed by this PID, then "ENOMEM"(0x00) is 
+              returned and the old memory is untouched.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void* _Sys_Realloc(pid_t PID,void* Mem_Ptr,size_t Size)
+{
+    return(_Sys_Realloc_Caller(PID,Mem_Ptr,Size,MEM_TRACE_CALLER_ADDR()));
+}
+#endif
+/* End Function:_Sys_Realloc *************************************************/
+
+/* Begin Function:_Sys_Realloc_Caller *****************************************
+Description : The body of "_Sys_Realloc" and "Sys_Realloc". The return address
+              got by the function called is passed in, so that the trace names
+              the real caller rather than the wrappers.
+Input       : pid_t PID - The process ID.
+              void* Mem_Ptr - The pointer returned by "Sys_Malloc".
+              size_t Size - The new size needed.
+              ptr_int_t Caller_Addr - The return address for the trace.
+Output      : None.
+Return      : void* - The pointer to the memory. If no memory is allocatable, or
+              the block cannot be changed by this PID, then "ENOMEM"(0x00) is 
+              returned and the old memory is untouched.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void* _Sys_Realloc_Caller(pid_t PID,void* Mem_Ptr,size_t Size,ptr_int_t Caller_Addr)
+{
+    struct Mem_Head* Mem_Head_Ptr=(struct Mem_Head*)(((ptr_int_t)Mem_Ptr)-sizeof(struct Mem_Head));
+    struct Mem_Head* Right_Mem_Head_Ptr;
+    size_t Temp_Size;
+    size_t Old_Size;
+    void* New_Mem_Ptr;
+    
+    /* Nothing to change, just allocate */
+    if(Mem_Ptr==ENOMEM)
+        return(_Sys_Malloc_Caller(PID,Size,Caller_Addr));
+    
+#if(MEM_ISR_BLOCKS!=0)
+    /* The blocks of the interrupt reserve have no block headers, and their size is fixed */
+    if(((ptr_int_t)Mem_Ptr>=Mem_ISR_Start_Addr)&&((ptr_int_t)Mem_Ptr<=Mem_ISR_End_Addr))
+        return ENOMEM;
+#endif
+
+    /* See if the address is within the allocatable address range. If not, abort directly. */
+    if(((ptr_int_t)Mem_Ptr<DMEM_START_ADDR)||((ptr_int_t)Mem_Ptr>DMEM_END_ADDR))
+        return ENOMEM;
+    
+    /* Round up the size as "_Sys_Malloc" does */
+    Temp_Size=((Size>>3)+1)<<3;
+    Temp_Size=(Temp_Size>MM_MIN_BLOCK)?Temp_Size:MM_MIN_BLOCK;
+    
+    Sys_Lock_Scheduler();
+    
+    /* See if the block can really be changed by this PID. The blocks of handles
+     * can't be changed, or the handles will be lost.
+     */
+    if(((Mem_Head_Ptr->Occupy_Flag)!=1)||((Mem_Head_Ptr->Occupy_PID)!=PID))
+    {
+        Sys_Unlock_Scheduler();
+        return ENOMEM;
+    }
+    
+    Old_Size=(Mem_Head_Ptr->Mem_End_Addr)+1-(Mem_Head_Ptr->Mem_Start_Addr);
+    
+    /* If it is to be enlarged, see if the quota allows it */
+    if((Temp_Size>Old_Size)&&(_Sys_Mem_Check_Quota(PID,Temp_Size-Old_Size)!=0))
+    {
+        Sys_Unlock_Scheduler();
+        return ENOMEM;
+    }
+    
+    /* Take it out of the allocated list now, so that the accounting is right when
+     * we put it back.
+     */
+    _Sys_Mem_Del_Allocated(Mem_Head_Ptr);
+    
+    /* Merge the right-side block if it is free. When shrinking this will also let
+     * the space cut off be merged with it.
+     */
+    if(((ptr_int_t)(Mem_Head_Ptr->Tail_Ptr))+sizeof(struct Mem_Tail)!=(ptr_int_t)(DMEM_Heap+DMEM_SIZE))
+    {
+        Right_Mem_Head_Ptr=(struct Mem_Head*)(((ptr_int_t)(Mem_Head_Ptr->Tail_Ptr))+sizeof(struct Mem_Tail));
+
+        if((Right_Mem_Head_Ptr->Occupy_Flag)==0)
+        {
+            _Sys_Mem_Del_TLSF(Right_Mem_Head_Ptr);
+            _Sys_Mem_Init_Block((ptr_int_t)Mem_Head_Ptr,
+                                ((ptr_int_t)(Right_Mem_Head_Ptr->Tail_Ptr))+sizeof(struct Mem_Tail)-
+                                (ptr_int_t)Mem_Head_Ptr);
+        }
+    }
+    
+    /* Can we do it in place? */
+    if((Mem_Head_Ptr->Mem_End_Addr)+1-(Mem_Head_Ptr->Mem_Start_Addr)>=Temp_Size)
+    {
+        _Sys_Mem_Split_Block(Mem_Head_Ptr,Temp_Size);
+        _Sys_Mem_Ins_Allocated(PID,Mem_Head_Ptr);
+#if(ENABLE_MEM_TRACE==TRUE)
+        _Sys_Mem_Trace(MEM_TRACE_REALLOC,PID,Caller_Addr,Size,(ptr_int_t)Mem_Ptr);
+#endif
+        /* The space cut off may be what some process is waiting for */
+        if(Temp_Size<Old_Size)
+            _Sys_Mem_Wake_Waiter();
+#if(MEM_LOW_WATERMARK!=0)
+        _Sys_Mem_Check_Pressure();
+#endif
+        
+        Sys_Unlock_Scheduler();
+        return Mem_Ptr;
+    }
+    
+    /* No. Cut it back to the old size(this will recover the right-side block if
+     * we merged it) and register it again.
+     */
+    _Sys_Mem_Split_Block(Mem_Head_Ptr,Old_Size);
+    _Sys_Mem_Ins_Allocated(PID,Mem_Head_Ptr);
+    
+    /* Move it elsewhere. The quota check above has counted the old block in, so
+     * it is not charged while the new block is allocated, or a legal enlargement
+     * near the quota would fail.
+     */
+    PCB_Mem[PID].Memory_In_Use-=Old_Size;
+    New_Mem_Ptr=_Sys_Malloc_Caller(PID,Size,Caller_Addr);
+    PCB_Mem[PID].Memory_In_Use+=Old_Size;
+    if(New_Mem_Ptr==ENOMEM)
+    {
+        Sys_Unlock_Scheduler();
+        return ENOMEM;
+    }
+    
+    Sys_Memcpy((ptr_int_t)New_Mem_Ptr,(ptr_int_t)Mem_Ptr,Old_Size);
+    _Sys_Mfree_Caller(PID,Mem_Ptr,Caller_Addr);
+    
+    Sys_Unlock_Scheduler();
+    return New_Mem_Ptr;
+}
+#endif
+/* End Function:_Sys_Realloc_Caller ******************************************/
+
+/* Begin Function:Sys_Mem_Transfer *******************************************
+Description : Give some allocated memory to another process. For application use.
+              The memory must belong to the "Current_PID".
+Input       : void* Mem_Ptr - The pointer returned by "Sys_Malloc".
+              pid_t New_PID - The process that will own the memory.
+Output      : None.
+Return      : retval_t - If successful, 0; else -1.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+retval_t Sys_Mem_Transfer(void* Mem_Ptr,pid_t New_PID)
+{
+    return(_Sys_Mem_Transfer(Current_PID,Mem_Ptr,New_PID));
+}
+#endif
+/* End Function:Sys_Mem_Transfer *********************************************/
+
+/* Begin Function:_Sys_Mem_Transfer ******************************************
+Description : Give some allocated memory of a certain process to another process.
+              The block is moved from the PCB_Mem list of the old owner to that of
+              the new owner, and the memory consumption is moved as well. After 
+              this, only the new owner can free it, and "Sys_Mfree_All" of the 
+              new owner will free it. The quota of the new owner must allow it.
+Input       : pid_t PID - The process that owns the memory now.
+              void* Mem_Ptr - The pointer returned by "Sys_Malloc".
+              pid_t New_PID - The process that will own the memory.
+Output      : None.
+Return      : retval_t - If successful, 0; else -1.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+retval_t _Sys_Mem_Transfer(pid_t PID,void* Mem_Ptr,pid_t New_PID)
+{
+    struct Mem_Head* Mem_Head_Ptr=(struct Mem_Head*)(((ptr_int_t)Mem_Ptr)-sizeof(struct Mem_Head));
+    size_t Mem_Size;
+    
+#if(MEM_ISR_BLOCKS!=0)
+    /* The blocks of the interrupt reserve have no block headers and no owners */
+    if(((ptr_int_t)Mem_Ptr>=Mem_ISR_Start_Addr)&&((ptr_int_t)Mem_Ptr<=Mem_ISR_End_Addr))
+        return -1;
+#endif
+
+    /* See if the address is within the allocatable address range */
+    if(((ptr_int_t)Mem_Ptr<DMEM_START_ADDR)||((ptr_int_t)Mem_Ptr>DMEM_END_ADDR))
+        return -1;
+    
+    /* See if the new owner is valid in the system */
+    if((New_PID<0)||(New_PID>=MAX_PROC_NUM))
+        return -1;
+    
+    Sys_Lock_Scheduler();
+    
+    if((PCB[New_PID].Status.Running_Status&OCCUPY)==0)
+    {
+        Sys_Unlock_Scheduler();
+        return -1;
+    }
+    
+    /* See if the block really belongs to this PID, and is not freed by an interrupt
+     * handler already
+     */
+    if(((Mem_Head_Ptr->Occupy_Flag)==0)||((Mem_Head_Ptr->Occupy_PID)!=PID)||
+       (((Mem_Head_Ptr->Occupy_Flag)&MEM_DEFER_FLAG)!=0))
+    {
+        Sys_Unlock_Scheduler();
+        return -1;
+    }
+    
+    Mem_Size=(Mem_Head_Ptr->Mem_End_Addr)-(Mem_Head_Ptr->Mem_Start_Addr)+1;
+    
+    /* See if the quota of the new owner allows it */
+    if(_Sys_Mem_Check_Quota(New_PID,Mem_Size)!=0)
+    {
+        Sys_Unlock_Scheduler();
+        return -1;
+    }
+    
+    /* Move it to the new PCB_Mem list */
+    Sys_List_Delete_Node(Mem_Head_Ptr->Proc_Mem_Head.Prev,
+                         Mem_Head_Ptr->Proc_Mem_Head.Next);
+    Sys_List_Insert_Node(&(Mem_Head_Ptr->Proc_Mem_Head),
+                         &(PCB_Mem[New_PID].Head),PCB_Mem[New_PID].Head.Next);
+    
+    /* Move the memory consumption. The block headers and tailers stay with "Init" */
+    PCB_Mem[PID].Memory_In_Use-=Mem_Size;
+    PCB_Mem[New_PID].Memory_In_Use+=Mem_Size;
+    Mem_Head_Ptr->Occupy_PID=New_PID;
+    
+    Sys_Unlock_Scheduler();
+    return 0;
+}
+#endif
+/* End Function:_Sys_Mem_Transfer ********************************************/
+
+/* Begin Function:Sys_Malloc_Handle *******************************************
+Description : Allocate some relocatable memory. For application use. The PID 
+              variable is automatically the "Current_PID".
+Input       : size_t Size - The size of the RAM needed to allocate.
+Output      : None.
+Return      : memhid_t - The handle of the memory. If no memory or handle is 
+                         allocatable, then -1 is returned.
+******************************************************************************/
+#if((ENABLE_MEMM==TRUE)&&(ENABLE_MEM_HANDLE==TRUE))
+memhid_t Sys_Malloc_Handle(size_t Size)
+{
+    return(_Sys_Malloc_Handle_Caller(Current_PID,Size,MEM_TRACE_CALLER_ADDR()));
+}
+#endif
+/* End Function:Sys_Malloc_Handle ********************************************/
+
+/* Begin Function:_Sys_Malloc_Handle ******************************************
+Description : Allocate some relocatable memory in the name of a certain process.
+              The memory is a normal block, but it is reached through a handle.
+              Only when the handle is locked with "Sys_Lock_Handle" can the memory
+              be used; when it is unlocked, "_Sys_Mem_Compact" may move it to a 
+              lower address to merge the free blocks.
+Input       : pid_t PID - The PID you want.
+              size_t Size - The size of the RAM needed to allocate.
+Output      : None.
+Return      : memhid_t - The handle of the memory. If no memory or handle is 
+                         allocatable, then -1 is returned.
+******************************************************************************/
+#if((ENABLE_MEMM==TRUE)&&(ENABLE_MEM_HANDLE==TRUE))
+memhid_t _Sys_Malloc_Handle(pid_t PID,size_t Size)
+{
+    return(_Sys_Malloc_Handle_Caller(PID,Size,MEM_TRACE_CALLER_ADDR()));
+}
+#endif
+/* End Function:_Sys_Malloc_Handle *******************************************/
+
+/* Begin Function:_Sys_Malloc_Handle_Caller ***********************************
+Description : The body of "_Sys_Malloc_Handle" and "Sys_Malloc_Handle". The
+              return address got by the function called is passed in, so that
+              the trace names the real caller rather than the wrappers.
+Input       : pid_t PID - The PID you want.
+              size_t Size - The size of the RAM needed to allocate.
+              ptr_int_t Caller_Addr - The return address for the trace.
+Output      : None.
+Return      : memhid_t - The handle of the memory. If no memory or handle is 
+                         allocatable, then -1 is returned.
+******************************************************************************/
+#if((ENABLE_MEMM==TRUE)&&(ENABLE_MEM_HANDLE==TRUE))
+memhid_t _Sys_Malloc_Handle_Caller(pid_t PID,size_t Size,ptr_int_t Caller_Addr)
+{
+    memhid_t Handle;
+    void* Mem_Ptr;
+    struct Mem_Head* Mem_Head_Ptr;
+    
+    Sys_Lock_Scheduler();
+    
+    /* Find an empty handle */
+    for(Handle=0;Handle<MAX_MEM_HANDLES;Handle++)
+    {
+        if(Mem_Handle[Handle].Mem_Addr==(ptr_int_t)ENOMEM)
+            break;
+    }
+    
+    if(Handle>=MAX_MEM_HANDLES)
+    {
+        Sys_Unlock_Scheduler();
+        return -1;
+    }
+    
+    Mem_Ptr=_Sys_Malloc_Caller(PID,Size,Caller_Addr);
+    if(Mem_Ptr==ENOMEM)
+    {
+        Sys_Unlock_Scheduler();
+        return -1;
+    }
+    
+    /* Mark the block as a handle block */
+    Mem_Head_Ptr=(struct Mem_Head*)(((ptr_int_t)Mem_Ptr)-sizeof(struct Mem_Head));
+    Mem_Head_Ptr->Occupy_Flag=MEM_HANDLE_OCCUPY(Handle);
+    Mem_Head_Ptr->Tail_Ptr->Occupy_Flag=MEM_HANDLE_OCCUPY(Handle);
+    
+    Mem_Handle[Handle].Mem_Addr=(ptr_int_t)Mem_Ptr;
+    Mem_Handle[Handle].Lock_Cnt=0;
+    
+    Sys_Unlock_Scheduler();
+    return Handle;
+}
+#endif
+/* End Function:_Sys_Malloc_Handle_Caller ************************************/
+
+/* Begin Function:Sys_Lock_Handle *********************************************
+Description : Lock a handle so that its memory will not be moved, and get the 
+              address of the memory. The locking can be stacked. Only the owner of
+              the memory can lock the handle.
+Input       : memhid_t Handle - The handle.
+Output      : None.
+Return      : void* - The pointer to the memory. If the handle is invalid, then 
+                      "ENOMEM"(0x00) is returned.
+******************************************************************************/
+#if((ENABLE_MEMM==TRUE)&&(ENABLE_MEM_HANDLE==TRUE))
+void* Sys_Lock_Handle(memhid_t Handle)
+{
+    void* Mem_Ptr;
+    
+    if((Handle<0)||(Handle>=MAX_MEM_HANDLES))
+        return ENOMEM;
+    
+    Sys_Lock_Scheduler();
+    
+    Mem_Ptr=(void*)(Mem_Handle[Handle].Mem_Addr);
+    if(Mem_Ptr==ENOMEM)
+    {
+        Sys_Unlock_Scheduler();
+        return ENOMEM;
+    }
+    
+    /* Only the owner of the memory can use the handle */
+    if((((struct Mem_Head*)(((ptr_int_t)Mem_Ptr)-sizeof(struct Mem_Head)))->Occupy_PID)!=Current_PID)
+    {
+        Sys_Unlock_Scheduler();
+        return ENOMEM;
+    }
+    
+    Mem_Handle[Handle].Lock_Cnt++;
+    
+    Sys_Unlock_Scheduler();
+    return Mem_Ptr;
+}
+#endif
+/* End Function:Sys_Lock_Handle **********************************************/
+
+/* Begin Function:Sys_Unlock_Handle *******************************************
+Description : Unlock a handle. After the last unlocking the pointer got from 
+              "Sys_Lock_Handle" shall not be used any more. Only the owner of the
+              memory can unlock the handle.
+Input       : memhid_t Handle - The handle.
+Output      : None.
+Return      : retval_t - If successful, 0; else -1.
+******************************************************************************/
+#if((ENABLE_MEMM==TRUE)&&(ENABLE_MEM_HANDLE==TRUE))
+retval_t Sys_Unlock_Handle(memhid_t Handle)
+{
+    if((Handle<0)||(Handle>=MAX_MEM_HANDLES))
+        return -1;
+    
+    Sys_Lock_Scheduler();
+    
+    if((Mem_Handle[Handle].Mem_Addr==(ptr_int_t)ENOMEM)||(Mem_Handle[Handle].Lock_Cnt==0))
+    {
+        Sys_Unlock_Scheduler();
+        return -1;
+    }
+    
+    /* Only the owner of the memory can use the handle */
+    if((((struct Mem_Head*)(Mem_Handle[Handle].Mem_Addr-sizeof(struct Mem_Head)))->Occupy_PID)!=Current_PID)
+    {
+        Sys_Unlock_Scheduler();
+        return -1;
+    }
+    
+    Mem_Handle[Handle].Lock_Cnt--;
+    
+    Sys_Unlock_Scheduler();
+    return 0;
+}
+#endif
+/* End Function:Sys_Unlock_Handle ********************************************/
+
+/* Begin Function:Sys_Mfree_Handle ********************************************
+Description : Free the memory of a handle, and the handle as well. For application
+              use.
+Input       : memhid_t Handle - The handle.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if((ENABLE_MEMM==TRUE)&&(ENABLE_MEM_HANDLE==TRUE))
+void Sys_Mfree_Handle(memhid_t Handle)
+{
+    _Sys_Mfree_Handle_Caller(Current_PID,Handle,MEM_TRACE_CALLER_ADDR());
+}
+#endif
+/* End Function:Sys_Mfree_Handle *********************************************/
+
+/* Begin Function:_Sys_Mfree_Handle *******************************************
+Description : Free the memory of a handle in the name of a certain process. The
+              handle is released by "_Sys_Mfree" when the block is freed.
+Input       : pid_t PID - The process ID.
+              memhid_t Handle - The handle.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if((ENABLE_MEMM==TRUE)&&(ENABLE_MEM_HANDLE==TRUE))
+void _Sys_Mfree_Handle(pid_t PID,memhid_t Handle)
+{
+    _Sys_Mfree_Handle_Caller(PID,Handle,MEM_TRACE_CALLER_ADDR());
+}
+#endif
+/* End Function:_Sys_Mfree_Handle ********************************************/
+
+/* Begin Function:_Sys_Mfree_Handle_Caller ************************************
+Description : The body of "_Sys_Mfree_Handle" and "Sys_Mfree_Handle". The
+              return address got by the function called is passed in, so that
+              the trace names the real caller rather than the wrappers.
+Input       : pid_t PID - The process ID.
+              memhid_t Handle - The handle.
+              ptr_int_t Caller_Addr - The return address for the trace.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if((ENABLE_MEMM==TRUE)&&(ENABLE_MEM_HANDLE==TRUE))
+void _Sys_Mfree_Handle_Caller(pid_t PID,memhid_t Handle,ptr_int_t Caller_Addr)
+{
+    if((Handle<0)||(Handle>=MAX_MEM_HANDLES))
+        return;
+    
+    Sys_Lock_Scheduler();
+    
+    if(Mem_Handle[Handle].Mem_Addr!=(ptr_int_t)ENOMEM)
+        _Sys_Mfree_Caller(PID,(void*)(Mem_Handle[Handle].Mem_Addr),Caller_Addr);
+    
+    Sys_Unlock_Scheduler();
+}
+#endif
+/* End Function:_Sys_Mfree_Handle_Caller *************************************/
+
+/* Begin Function:_Sys_Mem_Del_Handle *****************************************
+Description : Release the handle of a block that is being freed.
+Input       : memhid_t Handle - The handle, kept in the "Occupy_Flag" of the block.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if((ENABLE_MEMM==TRUE)&&(ENABLE_MEM_HANDLE==TRUE))
+void _Sys_Mem_Del_Handle(memhid_t Handle)
+{
+    Mem_Handle[Handle].Mem_Addr=(ptr_int_t)ENOMEM;
+    Mem_Handle[Handle].Lock_Cnt=0;
+}
+#endif
+/* End Function:_Sys_Mem_Del_Handle ******************************************/
+
+/* Begin Function:_Sys_Mem_Compact ********************************************
+Description : Compact the heap step by step. In each step, an unlocked handle 
+              whose block has a free block on its left side is found, and its 
+              block is moved to the start of the free block. The free space goes
+              to the right side and is merged with the free block there if there
+              is one. Thus after enough steps the free space will be merged 
+              together. The handles are checked in turn from where the last call
+              stopped.
+              This is called by the "Arch" process. The work of each step is 
+              bounded by the size of the block moved.
+Input       : cnt_t Steps - The most blocks to move in this call.
+Output      : None.
+Return      : cnt_t - The number of blocks moved.
+******************************************************************************/
+#if((ENABLE_MEMM==TRUE)&&(ENABLE_MEM_HANDLE==TRUE))
+cnt_t _Sys_Mem_Compact(cnt_t Steps)
+{
+    cnt_t Handle_Cnt;
+    cnt_t Moved_Cnt=0;
+    pid_t PID;
+    size_t Mem_Size;
+    struct Mem_Head* Mem_Head_Ptr;
+    struct Mem_Head* Left_Mem_Head_Ptr;
+    struct Mem_Head* Right_Mem_Head_Ptr;
+    ptr_int_t Block_End_Addr;
+    ptr_int_t Free_Start_Addr;
+    
+    Sys_Lock_Scheduler();
+    
+    for(Handle_Cnt=0;(Handle_Cnt<MAX_MEM_HANDLES)&&(Moved_Cnt<Steps);Handle_Cnt++)
+    {
+        Mem_Compact_Cursor=(Mem_Compact_Cursor+1)%MAX_MEM_HANDLES;
+        
+        /* Only the unlocked ones can be moved */
+        if((Mem_Handle[Mem_Compact_Cursor].Mem_Addr==(ptr_int_t)ENOMEM)||
+           (Mem_Handle[Mem_Compact_Cursor].Lock_Cnt!=0))
+            continue;
+        
+        Mem_Head_Ptr=(struct Mem_Head*)(Mem_Handle[Mem_Compact_Cursor].Mem_Addr-sizeof(struct Mem_Head));
+        
+        /* See if there is a free block on its left */
+        if((ptr_int_t)Mem_Head_Ptr==(ptr_int_t)DMEM_Heap)
+            continue;
+        
+        Left_Mem_Head_Ptr=((struct Mem_Tail*)(((ptr_int_t)Mem_Head_Ptr)-sizeof(struct Mem_Tail)))->Head_Ptr;
+        if((Left_Mem_Head_Ptr->Occupy_Flag)!=0)
+            continue;
+        
+        /* Take both out of the lists */
+        PID=Mem_Head_Ptr->Occupy_PID;
+        Mem_Size=(Mem_Head_Ptr->Mem_End_Addr)+1-(Mem_Head_Ptr->Mem_Start_Addr);
+        Block_End_Addr=((ptr_int_t)(Mem_Head_Ptr->Tail_Ptr))+sizeof(struct Mem_Tail);
+        _Sys_Mem_Del_TLSF(Left_Mem_Head_Ptr);
+        _Sys_Mem_Del_Allocated(Mem_Head_Ptr);
+        
+        /* Move the data to the left. The copy goes from low address to high address,
+         * so the overlapping part is safe.
+         */
+        Sys_Memcpy(((ptr_int_t)Left_Mem_Head_Ptr)+sizeof(struct Mem_Head),
+                   (ptr_int_t)Mem_Handle[Mem_Compact_Cursor].Mem_Addr,Mem_Size);
+        _Sys_Mem_Init_Block((ptr_int_t)Left_Mem_Head_Ptr,
+                            sizeof(struct Mem_Head)+Mem_Size+sizeof(struct Mem_Tail));
+        
+        /* Make the space left a free block, and merge it with the right-side one */
+        Free_Start_Addr=((ptr_int_t)(Left_Mem_Head_Ptr->Tail_Ptr))+sizeof(struct Mem_Tail);
+        if(Block_End_Addr!=(ptr_int_t)(DMEM_Heap+DMEM_SIZE))
+        {
+            Right_Mem_Head_Ptr=(struct Mem_Head*)Block_End_Addr;
+            if((Right_Mem_Head_Ptr->Occupy_Flag)==0)
+            {
+                _Sys_Mem_Del_TLSF(Right_Mem_Head_Ptr);
+                Block_End_Addr=((ptr_int_t)(Right_Mem_Head_Ptr->Tail_Ptr))+sizeof(struct Mem_Tail);
+            }
+        }
+        _Sys_Mem_Init_Block(Free_Start_Addr,Block_End_Addr-Free_Start_Addr);
+        _Sys_Mem_Ins_TLSF((struct Mem_Head*)Free_Start_Addr);
+        
+        /* Register the moved block again */
+        _Sys_Mem_Ins_Allocated(PID,Left_Mem_Head_Ptr);
+        Left_Mem_Head_Ptr->Occupy_Flag=MEM_HANDLE_OCCUPY(Mem_Compact_Cursor);
+        Left_Mem_Head_Ptr->Tail_Ptr->Occupy_Flag=MEM_HANDLE_OCCUPY(Mem_Compact_Cursor);
+        Mem_Handle[Mem_Compact_Cursor].Mem_Addr=Left_Mem_Head_Ptr->Mem_Start_Addr;
+        
+        Moved_Cnt++;
+    }
+    
+    /* The free space merged may be what some process is waiting for */
+    if(Moved_Cnt!=0)
+        _Sys_Mem_Wake_Waiter();
+    
+    Sys_Unlock_Scheduler();
+    return Moved_Cnt;
+}
+#endif
+/* End Function:_Sys_Mem_Compact *********************************************/
+
+/* Begin Function:Sys_Arena_Create ********************************************
+Description : Create a memory arena. For application use. The PID variable is
+              automatically the "Current_PID".
+Input       : size_t Size - The size of the arena.
+Output      : None.
+Return      : struct Mem_Arena* - The pointer to the arena. If no memory is 
+              allocatable, then "ENOMEM"(0x00) is returned.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+struct Mem_Arena* Sys_Arena_Create(size_t Size)
+{
+    return(_Sys_Arena_Create_Caller(Current_PID,Size,MEM_TRACE_CALLER_ADDR()));
+}
+#endif
+/* End Function:Sys_Arena_Create *********************************************/
+
+/* Begin Function:_Sys_Arena_Create *******************************************
+Description : Create a memory arena in the name of a certain process. The arena 
+              is a normal memory block, with the arena header at its start. The
+              memory in it will be allocated one by one without any headers, and
+              can only be freed all together by "Sys_Arena_Reset" or 
+              "Sys_Arena_Destroy". Thus both allocation and freeing are O(1).
+              The arena is also freed by "Sys_Mfree_All" as other blocks.
+Input       : pid_t PID - The process ID.
+              size_t Size - The size of the arena.
+Output      : None.
+Return      : struct Mem_Arena* - The pointer to the arena. If no memory is 
+              allocatable, then "ENOMEM"(0x00) is returned.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+struct Mem_Arena* _Sys_Arena_Create(pid_t PID,size_t Size)
+{
+    return(_Sys_Arena_Create_Caller(PID,Size,MEM_TRACE_CALLER_ADDR()));
+}
+#endif
+/* End Function:_Sys_Arena_Create ********************************************/
+
+/* Begin Function:_Sys_Arena_Create_Caller ************************************
+Description : The body of "_Sys_Arena_Create" and "Sys_Arena_Create". The
+              return address got by the function called is passed in, so that
+              the trace names the real caller rather than the wrappers.
+Input       : pid_t PID - The process ID.
+              size_t Size - The size of the arena.
+              ptr_int_t Caller_Addr - The return address for the trace.
+Output      : None.
+Return      : struct Mem_Arena* - The pointer to the arena. If no memory is 
+              allocatable, then "ENOMEM"(0x00) is returned.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+struct Mem_Arena* _Sys_Arena_Create_Caller(pid_t PID,size_t Size,ptr_int_t Caller_Addr)
+{
+    struct Mem_Arena* Arena_Ptr;
+    
+    /* The arena can't be bigger than the whole heap. This also keeps the size
+     * with the header from overflowing.
      */
-    if((PCB[PID].Status.Running_Status)&OCCUPY==0)
-        return;
+    if(Size>DMEM_SIZE)
+        return ENOMEM;
+    
+    /* Leave some space for the header and its alignment */
+    Arena_Ptr=(struct Mem_Arena*)_Sys_Malloc_Caller(PID,sizeof(struct Mem_Arena)+8+Size,Caller_Addr);
+    if(Arena_Ptr==ENOMEM)
+        return ENOMEM;
+    
+    /* The memory after the header, aligned to 8 */
+    Arena_Ptr->Arena_Start_Addr=(((ptr_int_t)Arena_Ptr)+sizeof(struct Mem_Arena)+7)&(~((ptr_int_t)7));
+    /* Be careful with the 1 */
+    Arena_Ptr->Arena_End_Addr=Arena_Ptr->Arena_Start_Addr+Size-1;
+    Arena_Ptr->Arena_Cur_Addr=Arena_Ptr->Arena_Start_Addr;
+    
+    return Arena_Ptr;
+}
+#endif
+/* End Function:_Sys_Arena_Create_Caller *************************************/
+
+/* Begin Function:_Sys_Arena_Check ********************************************
+Description : See if a pointer is an arena that a certain process owns. The arena
+              must be an allocated block of that process, and its header must be
+              the one made by "_Sys_Arena_Create". This should be called with the 
+              scheduler locked.
+Input       : pid_t PID - The process ID.
+              struct Mem_Arena* Arena_Ptr - The pointer to the arena.
+Output      : None.
+Return      : retval_t - If the arena is valid, 0; else -1.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+retval_t _Sys_Arena_Check(pid_t PID,struct Mem_Arena* Arena_Ptr)
+{
+    struct Mem_Head* Mem_Head_Ptr=(struct Mem_Head*)(((ptr_int_t)Arena_Ptr)-sizeof(struct Mem_Head));
+    
+#if(MEM_ISR_BLOCKS!=0)
+    /* The blocks of the interrupt reserve are never arenas */
+    if(((ptr_int_t)Arena_Ptr>=Mem_ISR_Start_Addr)&&((ptr_int_t)Arena_Ptr<=Mem_ISR_End_Addr))
+        return -1;
+#endif
+
+    /* See if the address is within the allocatable address range */
+    if(((ptr_int_t)Arena_Ptr<DMEM_START_ADDR)||((ptr_int_t)Arena_Ptr>DMEM_END_ADDR))
+        return -1;
+    
+    /* See if the block really belongs to this PID, and is not freed by an interrupt
+     * handler already
+     */
+    if(((Mem_Head_Ptr->Occupy_Flag)==0)||((Mem_Head_Ptr->Occupy_PID)!=PID)||
+       (((Mem_Head_Ptr->Occupy_Flag)&MEM_DEFER_FLAG)!=0))
+        return -1;
+    
+    /* See if the header is an arena header that fits in the block */
+    if((Arena_Ptr->Arena_Start_Addr!=((((ptr_int_t)Arena_Ptr)+sizeof(struct Mem_Arena)+7)&(~((ptr_int_t)7))))||
+       (Arena_Ptr->Arena_End_Addr<Arena_Ptr->Arena_Start_Addr)||
+       (Arena_Ptr->Arena_End_Addr>Mem_Head_Ptr->Mem_End_Addr)||
+       (Arena_Ptr->Arena_Cur_Addr<Arena_Ptr->Arena_Start_Addr)||
+       (Arena_Ptr->Arena_Cur_Addr>Arena_Ptr->Arena_End_Addr+1))
+        return -1;
+    
+    return 0;
+}
+#endif
+/* End Function:_Sys_Arena_Check *********************************************/
+
+/* Begin Function:Sys_Arena_Alloc *********************************************
+Description : Allocate some memory from an arena. The size will be rounded up to
+              a multiple of 8. Only the owner of the arena can allocate from it.
+Input       : struct Mem_Arena* Arena_Ptr - The pointer to the arena.
+              size_t Size - The size of the memory needed.
+Output      : None.
+Return      : void* - The pointer to the memory. If the arena does not have enough
+              space or is not an arena of the caller, then "ENOMEM"(0x00) is 
+              returned.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void* Sys_Arena_Alloc(struct Mem_Arena* Arena_Ptr,size_t Size)
+{
+    ptr_int_t Mem_Addr;
+    size_t Free_Size;
     
     Sys_Lock_Scheduler();
     
-    Traverse_List_Ptr=PCB_Mem[PID].Head.Next;
+    if(_Sys_Arena_Check(Current_PID,Arena_Ptr)!=0)
+    {
+        Sys_Unlock_Scheduler();
+        return ENOMEM;
+    }
     
-    /* Traverse the list and free all memory */
-    while(Traverse_List_Ptr!=&(PCB_Mem[PID].Head))
+    /* See if there is enough space left. The size is checked before it is rounded
+     * up, so that rounding it up can't overflow.
+     */
+    Free_Size=(Arena_Ptr->Arena_End_Addr)+1-(Arena_Ptr->Arena_Cur_Addr);
+    if(Size>Free_Size)
     {
-        Mem_Head_Ptr=(struct Mem_Head*)(Traverse_List_Ptr-sizeof(struct List_Head));
-        /* Move to the next node first. After deletion the list will be nonexistent */
-        Traverse_List_Ptr=Traverse_List_Ptr->Next;
-        _Sys_Mfree(PID,(void*)(Mem_Head_Ptr->Mem_Start_Addr));
+        Sys_Unlock_Scheduler();
+        return ENOMEM;
+    }
+    
+    /* Round up the size to a multiple of 8 */
+    Size=(Size+7)&(~((size_t)7));
+    if(Size>Free_Size)
+    {
+        Sys_Unlock_Scheduler();
+        return ENOMEM;
+    }
+    
+    Mem_Addr=Arena_Ptr->Arena_Cur_Addr;
+    Arena_Ptr->Arena_Cur_Addr+=Size;
+    
+    Sys_Unlock_Scheduler();
+    return (void*)Mem_Addr;
+}
+#endif
+/* End Function:Sys_Arena_Alloc **********************************************/
+
+/* Begin Function:Sys_Arena_Reset *********************************************
+Description : Free all the memory allocated from an arena, and keep the arena for
+              later use. Only the owner of the arena can reset it.
+Input       : struct Mem_Arena* Arena_Ptr - The pointer to the arena.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void Sys_Arena_Reset(struct Mem_Arena* Arena_Ptr)
+{
+    Sys_Lock_Scheduler();
+    
+    if(_Sys_Arena_Check(Current_PID,Arena_Ptr)!=0)
+    {
+        Sys_Unlock_Scheduler();
+        return;
     }
+    
+    Arena_Ptr->Arena_Cur_Addr=Arena_Ptr->Arena_Start_Addr;
+    
+    Sys_Unlock_Scheduler();
+}
+#endif
+/* End Function:Sys_Arena_Reset **********************************************/
+
+/* Begin Function:Sys_Arena_Destroy *******************************************
+Description : Destroy an arena, and free all the memory allocated from it. For
+              application use.
+Input       : struct Mem_Arena* Arena_Ptr - The pointer to the arena.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void Sys_Arena_Destroy(struct Mem_Arena* Arena_Ptr)
+{
+    _Sys_Arena_Destroy_Caller(Current_PID,Arena_Ptr,MEM_TRACE_CALLER_ADDR());
+}
+#endif
+/* End Function:Sys_Arena_Destroy ********************************************/
+
+/* Begin Function:_Sys_Arena_Destroy ******************************************
+Description : Destroy an arena in the name of a certain process.
+Input       : pid_t PID - The process ID.
+              struct Mem_Arena* Arena_Ptr - The pointer to the arena.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void _Sys_Arena_Destroy(pid_t PID,struct Mem_Arena* Arena_Ptr)
+{
+    _Sys_Arena_Destroy_Caller(PID,Arena_Ptr,MEM_TRACE_CALLER_ADDR());
+}
+#endif
+/* End Function:_Sys_Arena_Destroy *******************************************/
+
+/* Begin Function:_Sys_Arena_Destroy_Caller ***********************************
+Description : The body of "_Sys_Arena_Destroy" and "Sys_Arena_Destroy". The
+              return address got by the function called is passed in, so that
+              the trace names the real caller rather than the wrappers.
+Input       : pid_t PID - The process ID.
+              struct Mem_Arena* Arena_Ptr - The pointer to the arena.
+              ptr_int_t Caller_Addr - The return address for the trace.
+Output      : None.
+Return      : None.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+void _Sys_Arena_Destroy_Caller(pid_t PID,struct Mem_Arena* Arena_Ptr,ptr_int_t Caller_Addr)
+{
+    _Sys_Mfree_Caller(PID,(void*)Arena_Ptr,Caller_Addr);
+}
+#endif
+/* End Function:_Sys_Arena_Destroy_Caller ************************************/
 
+/* Begin Function:Sys_Arena_Query_Free ****************************************
+Description : Query the amount of memory that is still free in an arena.
+Input       : struct Mem_Arena* Arena_Ptr - The pointer to the arena.
+Output      : None.
+Return      : size_t - The amount of memory that is still free. If the arena is not
+                       an arena of the caller, 0.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+size_t Sys_Arena_Query_Free(struct Mem_Arena* Arena_Ptr)
+{
+    size_t Free_Size;
+    
+    Sys_Lock_Scheduler();
+    
+    if(_Sys_Arena_Check(Current_PID,Arena_Ptr)!=0)
+    {
+        Sys_Unlock_Scheduler();
+        return 0;
+    }
+    
+    Free_Size=(Arena_Ptr->Arena_End_Addr)+1-(Arena_Ptr->Arena_Cur_Addr);
+    
     Sys_Unlock_Scheduler();
+    return Free_Size;
 }
 #endif
-/* End Function:_Sys_Mfree_All ***********************************************/
+/* End Function:Sys_Arena_Query_Free *****************************************/
 
 /* Begin Function:Sys_Query_Proc_Mem ******************************************
 Description : Query the memory that a certain process uses. This is mainly called
@@ -713,6 +2439,288 @@ size_t Sys_Query_Free_Mem(void)
 #endif
 /* End Function:Sys_Query_Free_Mem *******************************************/
 
+/* Begin Function:Sys_Query_Peak_Used_Mem *************************************
+Description : Query the peak amount of memory that have been allocated in the 
+              system since it started. This is the high-water mark of the heap.
+Input       : None.
+Output      : None.
+Return      : size_t - The peak amount of memory that have been allocated.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+size_t Sys_Query_Peak_Used_Mem(void)
+{
+    return(Peak_Used_Mem_Amount);
+}
+#endif
+/* End Function:Sys_Query_Peak_Used_Mem **************************************/
+
+/* Begin Function:Sys_Query_Max_Free_Block ************************************
+Description : Query the size of a biggest free block, which is about the biggest 
+              memory that can be allocated at the moment(Without considering 
+              the rounding of "Sys_Malloc"). The biggest class is found from the 
+              TLSF bitmap directly, and the block at the head of its list is taken,
+              so this is O(1). The blocks in a class are not sorted, thus the size
+              returned may be smaller than the real biggest one by less than the 
+              width of the class.
+Input       : None.
+Output      : None.
+Return      : size_t - The size of the free block. If there is no free block, 0
+                       will be returned.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+size_t Sys_Query_Max_Free_Block(void)
+{
+    s32 FLI_Level;
+    s32 SLI_Level;
+    struct Mem_Head* Mem_Head_Ptr;
+    size_t Max_Size;
+    
+    Sys_Lock_Scheduler();
+    
+    /* Find the biggest class that has blocks */
+    for(FLI_Level=MM_FLI-1;FLI_Level>=0;FLI_Level--)
+    {
+        if(Mem_Bitmap[FLI_Level]!=0)
+            break;
+    }
+    
+    if(FLI_Level<0)
+    {
+        Sys_Unlock_Scheduler();
+        return 0;
+    }
+    
+    SLI_Level=Sys_Calc_MSB_Pos(Mem_Bitmap[FLI_Level]);
+    
+    /* The class is not empty, so the head of it is a block */
+    Mem_Head_Ptr=(struct Mem_Head*)(Mem_CB[FLI_Level][SLI_Level].Next);
+    Max_Size=(Mem_Head_Ptr->Mem_End_Addr)+1-(Mem_Head_Ptr->Mem_Start_Addr);
+    
+    Sys_Unlock_Scheduler();
+    return Max_Size;
+}
+#endif
+/* End Function:Sys_Query_Max_Free_Block *************************************/
+
+/* Begin Function:Sys_Query_Free_Blocks ***************************************
+Description : Query the number of free blocks in a certain FLI and SLI class.
+Input       : s32 FLI_Level - The FLI level.
+              s32 SLI_Level - The SLI level.
+Output      : None.
+Return      : cnt_t - The number of free blocks. If the level is invalid, then
+                      -1 will be returned.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+cnt_t Sys_Query_Free_Blocks(s32 FLI_Level,s32 SLI_Level)
+{
+    if((FLI_Level<0)||(FLI_Level>=MM_FLI)||(SLI_Level<0)||(SLI_Level>=MM_SLI))
+        return -1;
+    
+    return(Mem_Block_Cnt[FLI_Level][SLI_Level]);
+}
+#endif
+/* End Function:Sys_Query_Free_Blocks ****************************************/
+
+/* Begin Function:Sys_Query_Mem_Frag ******************************************
+Description : Query the fragmentation index of the heap, which is the part of the
+              free memory that is not in the biggest free block, in percent. 0 
+              means all free memory is in one block.
+Input       : None.
+Output      : None.
+Return      : cnt_t - The fragmentation index, 0-100.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+cnt_t Sys_Query_Mem_Frag(void)
+{
+    size_t Max_Size;
+    cnt_t Frag_Index;
+    
+    Sys_Lock_Scheduler();
+    
+    if(Free_Mem_Amount==0)
+    {
+        Sys_Unlock_Scheduler();
+        return 0;
+    }
+    
+    /* Count the head and tail of the biggest block as well, as the free amount does */
+    Max_Size=Sys_Query_Max_Free_Block();
+    if(Max_Size!=0)
+        Max_Size+=sizeof(struct Mem_Head)+sizeof(struct Mem_Tail);
+    
+    Frag_Index=((Free_Mem_Amount-Max_Size)*100)/Free_Mem_Amount;
+    
+    Sys_Unlock_Scheduler();
+    return Frag_Index;
+}
+#endif
+/* End Function:Sys_Query_Mem_Frag *******************************************/
+
+/* Begin Function:Sys_Query_Failed_Malloc *************************************
+Description : Query the number of failed allocations in a certain FLI class. The
+              failures of sizes that are bigger than the biggest class are counted
+              in the biggest class.
+Input       : s32 FLI_Level - The FLI level.
+Output      : None.
+Return      : cnt_t - The number of failed allocations. If the level is invalid,
+                      then -1 will be returned.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+cnt_t Sys_Query_Failed_Malloc(s32 FLI_Level)
+{
+    if((FLI_Level<0)||(FLI_Level>=MM_FLI))
+        return -1;
+    
+    return(Mem_Failed_Cnt[FLI_Level]);
+}
+#endif
+/* End Function:Sys_Query_Failed_Malloc **************************************/
+
+/* Begin Function:Sys_Set_Mem_Quota *******************************************
+Description : Set the memory quota of a process. The allocations that would make 
+              the process use more memory than the quota will fail. The memory 
+              that the process is already using is not affected.
+Input       : pid_t PID - The process ID. "Init" cannot have a quota.
+              size_t Quota - The quota. 0 means no limit.
+Output      : None.
+Return      : retval_t - If successful, 0; else -1.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+retval_t Sys_Set_Mem_Quota(pid_t PID,size_t Quota)
+{
+    if((PID<=0)||(PID>=MAX_PROC_NUM))
+        return -1;
+    
+    Sys_Lock_Scheduler();
+    PCB_Mem[PID].Memory_Quota=Quota;
+    Sys_Unlock_Scheduler();
+    
+    return 0;
+}
+#endif
+/* End Function:Sys_Set_Mem_Quota ********************************************/
+
+/* Begin Function:Sys_Query_Mem_Quota *****************************************
+Description : Query the memory quota of a process.
+Input       : pid_t PID - The process ID.
+Output      : None.
+Return      : size_t - The quota. 0 means no limit, or the PID is invalid.
+******************************************************************************/
+#if(ENABLE_MEMM==TRUE)
+size_t Sys_Query_Mem_Quota(pid_t PID)
+{
+    if((PID<0)||(PID>=MAX_PROC_NUM))
+        return 0;
+    
+    return(PCB_Mem[PID].Memory_Quota);
+}
+#endif
+/* End Function:Sys_Query_Mem_Quota ******************************************/
+
+/* Begin Function:Sys_Mem_Pressure_Reg ****************************************
+Description : Subscribe to the memory pressure notifications. For application use.
+              The "Current_PID" will get the signal when the free memory drops
+              below "MEM_LOW_WATERMARK" or rises back to "MEM_HIGH_WATERMARK".
+Input       : signal_t Signal - The signal to get. "NOSIG" cancels the subscription.
+Output      : None.
+Return      : retval_t - If successful, 0; else -1.
+******************************************************************************/
+#if((ENABLE_MEMM==TRUE)&&(MEM_LOW_WATERMARK!=0))
+retval_t Sys_Mem_Pressure_Reg(signal_t Signal)
+{
+    return(_Sys_Mem_Pressure_Reg(Current_PID,Signal));
+}
+#endif
+/* End Function:Sys_Mem_Pressure_Reg *****************************************/
+
+/* Begin Function:_Sys_Mem_Pressure_Reg ***************************************
+Description : Subscribe to the memory pressure notifications in the name of a 
+              certain process.
+Input       : pid_t PID - The process ID. "Init" cannot subscribe.
+              signal_t Signal - The signal to get. "NOSIG" cancels the subscription.
+Output      : None.
+Return      : retval_t - If successful, 0; else -1.
+******************************************************************************/
+#if((ENABLE_MEMM==TRUE)&&(MEM_LOW_WATERMARK!=0))
+retval_t _Sys_Mem_Pressure_Reg(pid_t PID,signal_t Signal)
+{
+    if((PID<=0)||(PID>=MAX_PROC_NUM))
+        return -1;
+    
+    Sys_Lock_Scheduler();
+    PCB_Mem[PID].Pressure_Signal=Signal;
+    Sys_Unlock_Scheduler();
+    
+    return 0;
+}
+#endif
+/* End Function:_Sys_Mem_Pressure_Reg ****************************************/
+
+/* Begin Function:Sys_Query_Mem_Pressure **************************************
+Description : Query whether the system is short of memory, i.e. the free memory 
+              has dropped below "MEM_LOW_WATERMARK" and has not risen back to
+              "MEM_HIGH_WATERMARK" yet.
+Input       : None.
+Output      : None.
+Return      : retval_t - If short of memory, 1; else 0.
+******************************************************************************/
+#if((ENABLE_MEMM==TRUE)&&(MEM_LOW_WATERMARK!=0))
+retval_t Sys_Query_Mem_Pressure(void)
+{
+    return(Mem_Pressure_Flag);
+}
+#endif
+/* End Function:Sys_Query_Mem_Pressure ***************************************/
+
+/* Begin Function:Sys_Query_Mem_Trace_Cnt *************************************
+Description : Query the total number of memory operations that have been recorded
+              since the system started. Only the last "MEM_TRACE_DEPTH" records 
+              are kept in the trace ring buffer.
+Input       : None.
+Output      : None.
+Return      : u32 - The total number of records. It wraps around to 0 after 
+                    0xFFFFFFFF.
+******************************************************************************/
+#if((ENABLE_MEMM==TRUE)&&(ENABLE_MEM_TRACE==TRUE))
+u32 Sys_Query_Mem_Trace_Cnt(void)
+{
+    return(Mem_Trace_Cnt);
+}
+#endif
+/* End Function:Sys_Query_Mem_Trace_Cnt **************************************/
+
+/* Begin Function:Sys_Read_Mem_Trace ******************************************
+Description : Read a record from the trace ring buffer, for dumping. The records
+              are numbered from 0 in the order that they are recorded, and the 
+              number wraps around as "Sys_Query_Mem_Trace_Cnt" does.
+Input       : u32 Trace_Num - The number of the record.
+Output      : struct Mem_Trace* Trace_Ptr - The record read.
+Return      : retval_t - If successful, 0; if the record is not recorded yet or
+                         has already been overwritten, -1.
+******************************************************************************/
+#if((ENABLE_MEMM==TRUE)&&(ENABLE_MEM_TRACE==TRUE))
+retval_t Sys_Read_Mem_Trace(u32 Trace_Num,struct Mem_Trace* Trace_Ptr)
+{
+    Sys_Lock_Scheduler();
+    
+    /* Only the last "MEM_TRACE_DEPTH" records are there. The unsigned subtraction
+     * is right even when the number has wrapped around.
+     */
+    if(((Mem_Trace_Cnt-Trace_Num)==0)||((Mem_Trace_Cnt-Trace_Num)>MEM_TRACE_DEPTH))
+    {
+        Sys_Unlock_Scheduler();
+        return -1;
+    }
+    
+    Sys_Memcpy((ptr_int_t)Trace_Ptr,(ptr_int_t)(&Mem_Trace_Buf[Trace_Num&(MEM_TRACE_DEPTH-1)]),
+               sizeof(struct Mem_Trace));
+    
+    Sys_Unlock_Scheduler();
+    return 0;
+}
+#endif
+/* End Function:Sys_Read_Mem_Trace *******************************************/
+
 /* End Of File ***************************************************************/
 
 /* Copyright (C) 2011-2013 Evo-Devo Instrum. All rights reserved. ************/
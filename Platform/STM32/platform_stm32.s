@@ -37,6 +37,10 @@
 				EXPORT  		DISABLE_SYSTICK		       
                 ;Start the systick timer                
 				EXPORT 			ENABLE_SYSTICK
+                ;The memory barrier
+                EXPORT          MEMORY_BARRIER
+                ;The atomic compare-and-swap
+                EXPORT          COMPARE_AND_SWAP
                 ;The PendSV trigger
                 EXPORT          _Sys_Schedule_Trigger
                 ;The system pending service routine              
@@ -86,6 +90,54 @@ ENABLE_ALL_INTS
 				BX        LR
 ;/* End Function:DISABLE_ALL_INTS ********************************************/
 
+;/* Begin Function:MEMORY_BARRIER *********************************************
+;Description    : Make all the memory accesses before it complete before any
+;                 memory access after it. Being a function call, it also stops
+;                 the compiler from moving the memory accesses across it.
+;Input          : None.
+;Output         : None.	
+;Register Usage : None.								  
+;*****************************************************************************/
+MEMORY_BARRIER
+                ;Data memory barrier
+                DMB
+
+				BX        LR
+;/* End Function:MEMORY_BARRIER **********************************************/
+
+;/* Begin Function:COMPARE_AND_SWAP *******************************************
+;Description    : Store a new value to a word if the word still has the old value,
+;                 as a single atomic operation. Interrupts are not locked; if the
+;                 exclusive access is lost to an interrupt in the middle, it tries
+;                 again. It is also a memory barrier.
+;Input          : R0 - The address of the word.
+;                 R1 - The old value.
+;                 R2 - The new value.
+;Output         : R0 - 0 if the new value is stored; -1 if the word does not have
+;                      the old value.
+;Register Usage : R3.
+;*****************************************************************************/
+COMPARE_AND_SWAP
+                DMB
+COMPARE_AND_SWAP_RETRY
+                ;Load the word and take the exclusive access
+                LDREX     R3,[R0]
+                CMP       R3,R1
+                BNE       COMPARE_AND_SWAP_FAIL
+                ;Store the new value. R3 is 0 if the exclusive access is still ours
+                STREX     R3,R2,[R0]
+                CMP       R3,#0
+                BNE       COMPARE_AND_SWAP_RETRY
+                DMB
+                MOV       R0,#0
+                BX        LR
+COMPARE_AND_SWAP_FAIL
+                ;Give up the exclusive access
+                CLREX
+                MVN       R0,#0
+                BX        LR
+;/* End Function:COMPARE_AND_SWAP ********************************************/
+
 ;/* Begin Function:DISABLE_SYSTICK ********************************************
 ;Description    : The function for disabling(stopping) the systick timer.
 ;Input          : None.
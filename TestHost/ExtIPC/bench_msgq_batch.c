@@ -0,0 +1,184 @@
+/******************************************************************************
+Filename    : bench_msgq_batch.c
+Author      : pry
+Date        : 19/10/2013
+Version     : 0.01
+Description : The host-side benchmark of the batched message send and receive.
+              The sender allocates a batch of messages and sends them, and the
+              receiver receives them and destroys them. The throughput in messages
+              per second is printed for the single "Sys_Send_Msg"/"Sys_Recv_Msg"
+              calls, and for "Sys_Send_Msg_Batch"/"Sys_Recv_Msg_Batch" with batches
+              of 1, 8 and 64. There is no context switch on the host, so only the
+              cost of the locking, the checks and the wakeups is saved here; on the
+              target each wakeup may also be a switch. Build and run:
+                  TestHost/host_build.sh bench_msgq_batch TestHost/ExtIPC/bench_msgq_batch.c \
+                  ExtIPC/msgqueue.c Memmgr/memory.c
+                  ./bench_msgq_batch
+******************************************************************************/
+
+/* Includes ******************************************************************/
+#include "Config\MP_config.h"
+#include "Platform\MP_platform.h"
+
+/* Definition includes */
+#define __HDR_DEFS__
+#include "Kernel\scheduler.h"
+#include "ExtIPC\msgqueue.h"
+#include "Memmgr\memory.h"
+#undef __HDR_DEFS__
+
+/* Structure includes */
+#define __HDR_STRUCTS__
+#include "Syslib\syslib.h"
+#include "Kernel\scheduler.h"
+#include "ExtIPC\msgqueue.h"
+#include "Memmgr\memory.h"
+#undef __HDR_STRUCTS__
+
+/* Public includes */
+#define __HDR_PUBLIC_MEMBERS__
+#include "Kernel\scheduler.h"
+#include "ExtIPC\msgqueue.h"
+#include "Memmgr\memory.h"
+#undef __HDR_PUBLIC_MEMBERS__
+/* End Includes **************************************************************/
+
+/* Defines *******************************************************************/
+/* The biggest batch */
+#define BENCH_MAX_BATCH             64
+/* The messages to move in each run */
+#define BENCH_MSGS                  (1<<21)
+/* The sender and the receiver */
+#define BENCH_SENDER                1
+#define BENCH_RECVER                2
+/* End Defines ***************************************************************/
+
+/* Global Variables **********************************************************/
+static cnt_t Bench_Batch[3]={1,8,64};
+static msgqbid_t Bench_Block_ID[BENCH_MAX_BATCH];
+static void* Bench_Buffer_Ptr[BENCH_MAX_BATCH];
+/* End Global Variables ******************************************************/
+
+/* Begin Function:Bench_Alloc *************************************************
+Description : Allocate a batch of messages as the sender.
+Input       : msgqid_t Msg_Queue_ID - The queue.
+              cnt_t Batch - The number of messages.
+              cnt_t Base - The sequence number of the first message.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Bench_Alloc(msgqid_t Msg_Queue_ID,cnt_t Batch,cnt_t Base)
+{
+    cnt_t Count;
+
+    Current_PID=BENCH_SENDER;
+    for(Count=0;Count<Batch;Count++)
+    {
+        Bench_Block_ID[Count]=Sys_Alloc_Msg(Msg_Queue_ID,0,8,&Bench_Buffer_Ptr[Count]);
+        HOST_CHECK(Bench_Block_ID[Count]>=0);
+        *((u32*)Bench_Buffer_Ptr[Count])=Base+Count;
+    }
+}
+/* End Function:Bench_Alloc **************************************************/
+
+/* Begin Function:Bench_Destroy ***********************************************
+Description : Check and destroy a batch of messages as the receiver.
+Input       : msgqid_t Msg_Queue_ID - The queue.
+              cnt_t Batch - The number of messages.
+              cnt_t Base - The sequence number of the first message.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Bench_Destroy(msgqid_t Msg_Queue_ID,cnt_t Batch,cnt_t Base)
+{
+    cnt_t Count;
+
+    for(Count=0;Count<Batch;Count++)
+    {
+        HOST_CHECK(*((u32*)Bench_Buffer_Ptr[Count])==(u32)(Base+Count));
+        HOST_CHECK(Sys_Destroy_Msg(Msg_Queue_ID,Bench_Block_ID[Count])==0);
+    }
+}
+/* End Function:Bench_Destroy ************************************************/
+
+/* Begin Function:Bench_Report ************************************************
+Description : Print the throughput of a run.
+Input       : cnt_t Batch - The batch size; 0 for the single calls.
+              u64 Time - The time of the run in nanoseconds.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Bench_Report(cnt_t Batch,u64 Time)
+{
+    if(Batch==0)
+        Host_Print("single calls:  ");
+    else
+        Host_Print("batches of %2d: ",(int)Batch);
+
+    Host_Print("%6lu k messages/s  %4lu ns/message\n",
+               (unsigned long)(((u64)BENCH_MSGS*1000000)/Time),
+               (unsigned long)(Time/BENCH_MSGS));
+}
+/* End Function:Bench_Report *************************************************/
+
+/* Begin Function:main ********************************************************
+Description : The entry of the benchmark.
+Input       : None.
+Output      : None.
+Return      : int - 0 if successful.
+******************************************************************************/
+int main(void)
+{
+    msgqid_t Msg_Queue_ID;
+    cnt_t Batch;
+    cnt_t Count;
+    cnt_t Msg_Count;
+    u64 Start_Time;
+    u64 Single_Time;
+    u64 Batch_Time;
+
+    PCB[BENCH_SENDER].Status.Running_Status=OCCUPY;
+    PCB[BENCH_RECVER].Status.Running_Status=OCCUPY;
+
+    _Sys_Mem_Init();
+    _Sys_Queue_Init();
+    Msg_Queue_ID=Sys_Create_Queue_Inline((s8*)"Bench",BENCH_MAX_BATCH,8);
+    HOST_CHECK(Msg_Queue_ID>=0);
+
+    /* One call for each message */
+    Start_Time=Host_Time_NS();
+    for(Msg_Count=0;Msg_Count<BENCH_MSGS;Msg_Count++)
+    {
+        Bench_Alloc(Msg_Queue_ID,1,Msg_Count);
+        HOST_CHECK(Sys_Send_Msg(BENCH_RECVER,Msg_Queue_ID,Bench_Block_ID[0])==0);
+        Current_PID=BENCH_RECVER;
+        HOST_CHECK(Sys_Recv_Msg(Msg_Queue_ID,0,&Bench_Buffer_Ptr[0])==Bench_Block_ID[0]);
+        Bench_Destroy(Msg_Queue_ID,1,Msg_Count);
+    }
+    Single_Time=Host_Time_NS()-Start_Time;
+    Bench_Report(0,Single_Time);
+
+    for(Count=0;Count<3;Count++)
+    {
+        Batch=Bench_Batch[Count];
+        Start_Time=Host_Time_NS();
+        for(Msg_Count=0;Msg_Count<BENCH_MSGS;Msg_Count+=Batch)
+        {
+            Bench_Alloc(Msg_Queue_ID,Batch,Msg_Count);
+            HOST_CHECK(Sys_Send_Msg_Batch(BENCH_RECVER,Msg_Queue_ID,Bench_Block_ID,Batch,MSG_PRIO_LOWEST)==Batch);
+            Current_PID=BENCH_RECVER;
+            HOST_CHECK(Sys_Recv_Msg_Batch(Msg_Queue_ID,0,Bench_Block_ID,Bench_Buffer_Ptr,Batch)==Batch);
+            Bench_Destroy(Msg_Queue_ID,Batch,Msg_Count);
+        }
+        Batch_Time=Host_Time_NS()-Start_Time;
+        Bench_Report(Batch,Batch_Time);
+    }
+
+    HOST_CHECK(Sys_Query_Msg_Number(Msg_Queue_ID)==0);
+    return 0;
+}
+/* End Function:main *********************************************************/
+
+/* End Of File ***************************************************************/
+
+/* Copyright (C) 2011-2013 Evo-Devo Instrum. All rights reserved *************/
@@ -0,0 +1,170 @@
+/******************************************************************************
+Filename    : bench_msgq_recv.c
+Author      : pry
+Date        : 19/10/2013
+Version     : 0.01
+Description : The host-side benchmark of the message queue with many receivers.
+              One queue is shared by 1, 8 and 32 receivers, and each of them has
+              a backlog of messages of several types. The sender allocates and sends
+              a message to each receiver in turn, and the receiver receives a
+              message of a certain type and destroys it. The time of the
+              allocation-send-receive-destroy round, and of counting the messages
+              of a receiver, are printed. With the messages indexed by receiver,
+              both do not grow with the number of receivers. Build and run:
+                  CFLAGS="-DMAX_PROC_NUM=33 -DDMEM_SIZE=0x10000 -DMM_FLI=11" \
+                  TestHost/host_build.sh bench_msgq_recv TestHost/ExtIPC/bench_msgq_recv.c \
+                  ExtIPC/msgqueue.c Memmgr/memory.c
+                  ./bench_msgq_recv
+              Add "-DMSGQ_TYPE_BUCKETS=4" to "CFLAGS" to try the type buckets.
+******************************************************************************/
+
+/* Includes ******************************************************************/
+#include "Config\MP_config.h"
+#include "Platform\MP_platform.h"
+
+/* Definition includes */
+#define __HDR_DEFS__
+#include "Kernel\scheduler.h"
+#include "ExtIPC\msgqueue.h"
+#include "Memmgr\memory.h"
+#undef __HDR_DEFS__
+
+/* Structure includes */
+#define __HDR_STRUCTS__
+#include "Syslib\syslib.h"
+#include "Kernel\scheduler.h"
+#include "ExtIPC\msgqueue.h"
+#include "Memmgr\memory.h"
+#undef __HDR_STRUCTS__
+
+/* Public includes */
+#define __HDR_PUBLIC_MEMBERS__
+#include "Kernel\scheduler.h"
+#include "ExtIPC\msgqueue.h"
+#include "Memmgr\memory.h"
+#undef __HDR_PUBLIC_MEMBERS__
+/* End Includes **************************************************************/
+
+/* Defines *******************************************************************/
+/* The most receivers. The sender is PID 0 */
+#define BENCH_MAX_RECVER            32
+/* The messages queued to each receiver, and the types of them */
+#define BENCH_BACKLOG               8
+#define BENCH_TYPES                 4
+/* The rounds to time */
+#define BENCH_ROUNDS                200000
+
+#if(MAX_PROC_NUM<=BENCH_MAX_RECVER)
+#error "Build with -DMAX_PROC_NUM=33 or more."
+#endif
+/* End Defines ***************************************************************/
+
+/* Global Variables **********************************************************/
+static cnt_t Bench_Recver_Num[3]={1,8,32};
+/* End Global Variables ******************************************************/
+
+/* Begin Function:Bench_Send **************************************************
+Description : Allocate and send a message from the sender.
+Input       : msgqid_t Msg_Queue_ID - The queue.
+              pid_t Recver_PID - The receiver.
+              msgtyp_t Msg_Type - The type of the message.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Bench_Send(msgqid_t Msg_Queue_ID,pid_t Recver_PID,msgtyp_t Msg_Type)
+{
+    msgqbid_t Msg_Block_ID;
+    void* Msg_Buffer_Ptr;
+
+    Current_PID=0;
+    Msg_Block_ID=Sys_Alloc_Msg(Msg_Queue_ID,Msg_Type,8,&Msg_Buffer_Ptr);
+    HOST_CHECK(Msg_Block_ID>=0);
+    *((u32*)Msg_Buffer_Ptr)=Msg_Type;
+    HOST_CHECK(Sys_Send_Msg(Recver_PID,Msg_Queue_ID,Msg_Block_ID)==0);
+}
+/* End Function:Bench_Send ***************************************************/
+
+/* Begin Function:Bench_Run ***************************************************
+Description : Run the benchmark with a number of receivers.
+Input       : cnt_t Recver_Num - The number of receivers.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Bench_Run(cnt_t Recver_Num)
+{
+    msgqid_t Msg_Queue_ID;
+    msgqbid_t Msg_Block_ID;
+    void* Msg_Buffer_Ptr;
+    pid_t Recver_PID;
+    msgtyp_t Msg_Type;
+    cnt_t Count;
+    size_t Total;
+    u64 Start_Time;
+    u64 Round_Time;
+    u64 Query_Time;
+
+    _Sys_Mem_Init();
+    _Sys_Queue_Init();
+    Msg_Queue_ID=Sys_Create_Queue_Inline((s8*)"Bench",Recver_Num*BENCH_BACKLOG+1,8);
+    HOST_CHECK(Msg_Queue_ID>=0);
+
+    /* Every receiver has a backlog of all the types */
+    for(Recver_PID=1;Recver_PID<=Recver_Num;Recver_PID++)
+    {
+        for(Count=0;Count<BENCH_BACKLOG;Count++)
+            Bench_Send(Msg_Queue_ID,Recver_PID,Count%BENCH_TYPES);
+    }
+
+    /* Each round replaces a message of a receiver, so the backlog stays the same */
+    Start_Time=Host_Time_NS();
+    for(Count=0;Count<BENCH_ROUNDS;Count++)
+    {
+        Recver_PID=1+Count%Recver_Num;
+        Msg_Type=(Count/Recver_Num)%BENCH_TYPES;
+        Bench_Send(Msg_Queue_ID,Recver_PID,Msg_Type);
+
+        Current_PID=Recver_PID;
+        Msg_Block_ID=Sys_Recv_Msg(Msg_Queue_ID,Msg_Type,&Msg_Buffer_Ptr);
+        HOST_CHECK(Msg_Block_ID>=0);
+        HOST_CHECK(*((u32*)Msg_Buffer_Ptr)==Msg_Type);
+        HOST_CHECK(Sys_Destroy_Msg(Msg_Queue_ID,Msg_Block_ID)==0);
+    }
+    Round_Time=Host_Time_NS()-Start_Time;
+
+    Total=0;
+    Start_Time=Host_Time_NS();
+    for(Count=0;Count<BENCH_ROUNDS;Count++)
+        Total+=Sys_Query_Msg_To_Recver(1+Count%Recver_Num,Msg_Queue_ID,Count%BENCH_TYPES);
+    Query_Time=Host_Time_NS()-Start_Time;
+    HOST_CHECK(Total==BENCH_ROUNDS*BENCH_BACKLOG/BENCH_TYPES);
+
+    Host_Print("%2d receivers, %3d messages queued: %4lu ns/round  %4lu ns/query\n",
+               (int)Recver_Num,(int)(Recver_Num*BENCH_BACKLOG),
+               (unsigned long)(Round_Time/BENCH_ROUNDS),(unsigned long)(Query_Time/BENCH_ROUNDS));
+}
+/* End Function:Bench_Run ****************************************************/
+
+/* Begin Function:main ********************************************************
+Description : The entry of the benchmark.
+Input       : None.
+Output      : None.
+Return      : int - 0 if successful.
+******************************************************************************/
+int main(void)
+{
+    cnt_t Count;
+
+    for(Count=0;Count<=BENCH_MAX_RECVER;Count++)
+        PCB[Count].Status.Running_Status=OCCUPY;
+
+    Host_Print("MSGQ_TYPE_BUCKETS %d\n",MSGQ_TYPE_BUCKETS);
+    for(Count=0;Count<3;Count++)
+        Bench_Run(Bench_Recver_Num[Count]);
+
+    return 0;
+}
+/* End Function:main *********************************************************/
+
+/* End Of File ***************************************************************/
+
+/* Copyright (C) 2011-2013 Evo-Devo Instrum. All rights reserved *************/
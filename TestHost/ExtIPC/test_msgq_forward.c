@@ -0,0 +1,185 @@
+/******************************************************************************
+Filename    : test_msgq_forward.c
+Author      : pry
+Date        : 19/10/2013
+Version     : 0.01
+Description : The host-side test of forwarding the messages. Only the receiver
+              of a message can forward it:
+              (1) A message that is allocated but not sent yet can't be forwarded,
+                  neither by its sender nor by any other process.
+              (2) A message that is received can't be forwarded by a process that
+                  is not its receiver, and the receiver still owns it after that.
+              (3) The receiver forwards it to another queue and to the same queue,
+                  and the message arrives intact.
+              Build and run it on a POSIX host:
+                  TestHost/host_build.sh test_msgq_forward TestHost/ExtIPC/test_msgq_forward.c \
+                  ExtIPC/msgqueue.c Memmgr/memory.c
+                  ./test_msgq_forward
+******************************************************************************/
+
+/* Includes ******************************************************************/
+#include "Config\MP_config.h"
+#include "Platform\MP_platform.h"
+
+/* Definition includes */
+#define __HDR_DEFS__
+#include "Kernel\scheduler.h"
+#include "Kernel\error.h"
+#include "ExtIPC\msgqueue.h"
+#include "Memmgr\memory.h"
+#undef __HDR_DEFS__
+
+/* Structure includes */
+#define __HDR_STRUCTS__
+#include "Syslib\syslib.h"
+#include "Kernel\scheduler.h"
+#include "ExtIPC\msgqueue.h"
+#include "Memmgr\memory.h"
+#undef __HDR_STRUCTS__
+
+/* Public includes */
+#define __HDR_PUBLIC_MEMBERS__
+#include "Kernel\scheduler.h"
+#include "Kernel\error.h"
+#include "ExtIPC\msgqueue.h"
+#include "Memmgr\memory.h"
+#undef __HDR_PUBLIC_MEMBERS__
+/* End Includes **************************************************************/
+
+/* Defines *******************************************************************/
+/* The sender, the receiver, and the process that forwards to nobody */
+#define TEST_SENDER                 1
+#define TEST_RECVER                 2
+#define TEST_OTHER                  3
+/* The message is bigger than the inline area, so it is on the heap */
+#define TEST_INLINE_SIZE            8
+#define TEST_MSG_SIZE               32
+#define TEST_MSG_TYPE               5
+/* End Defines ***************************************************************/
+
+/* Begin Function:Test_Alloc **************************************************
+Description : Allocate a message as the sender and fill it.
+Input       : msgqid_t Msg_Queue_ID - The queue.
+Output      : None.
+Return      : msgqbid_t - The message block.
+******************************************************************************/
+static msgqbid_t Test_Alloc(msgqid_t Msg_Queue_ID)
+{
+    msgqbid_t Msg_Block_ID;
+    void* Msg_Buffer_Ptr;
+    cnt_t Count;
+
+    Current_PID=TEST_SENDER;
+    Msg_Block_ID=Sys_Alloc_Msg(Msg_Queue_ID,TEST_MSG_TYPE,TEST_MSG_SIZE,&Msg_Buffer_Ptr);
+    HOST_CHECK(Msg_Block_ID>=0);
+    for(Count=0;Count<TEST_MSG_SIZE;Count++)
+        ((u8*)Msg_Buffer_Ptr)[Count]=(u8)Count;
+
+    return Msg_Block_ID;
+}
+/* End Function:Test_Alloc ***************************************************/
+
+/* Begin Function:Test_Recv ***************************************************
+Description : Receive the message in the name of a process, check and destroy it.
+Input       : pid_t PID - The receiver.
+              msgqid_t Msg_Queue_ID - The queue.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Recv(pid_t PID,msgqid_t Msg_Queue_ID)
+{
+    msgqbid_t Msg_Block_ID;
+    void* Msg_Buffer_Ptr;
+    cnt_t Count;
+
+    Current_PID=PID;
+    Msg_Block_ID=Sys_Recv_Msg(Msg_Queue_ID,TEST_MSG_TYPE,&Msg_Buffer_Ptr);
+    HOST_CHECK(Msg_Block_ID>=0);
+    for(Count=0;Count<TEST_MSG_SIZE;Count++)
+        HOST_CHECK(((u8*)Msg_Buffer_Ptr)[Count]==(u8)Count);
+    HOST_CHECK(Sys_Destroy_Msg(Msg_Queue_ID,Msg_Block_ID)==0);
+}
+/* End Function:Test_Recv ****************************************************/
+
+/* Begin Function:Test_Forward_Fail *******************************************
+Description : Check that a process can't forward a message.
+Input       : pid_t PID - The process.
+              msgqid_t Msg_Queue_ID - The queue of the message.
+              msgqbid_t Msg_Block_ID - The message block.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Forward_Fail(pid_t PID,msgqid_t Msg_Queue_ID,msgqbid_t Msg_Block_ID)
+{
+    Current_PID=PID;
+    HOST_CHECK(Sys_Forward_Msg(Msg_Queue_ID,Msg_Block_ID,Msg_Queue_ID,PID)==-1);
+    HOST_CHECK(Sys_Get_Errno()==ENOMSGBLK);
+}
+/* End Function:Test_Forward_Fail ********************************************/
+
+/* Begin Function:main ********************************************************
+Description : The entry of the test.
+Input       : None.
+Output      : None.
+Return      : int - 0 if successful.
+******************************************************************************/
+int main(void)
+{
+    msgqid_t Src_Queue_ID;
+    msgqid_t Dst_Queue_ID;
+    msgqbid_t Msg_Block_ID;
+    void* Msg_Buffer_Ptr;
+
+    PCB[0].Status.Running_Status=OCCUPY;
+    PCB[TEST_SENDER].Status.Running_Status=OCCUPY;
+    PCB[TEST_RECVER].Status.Running_Status=OCCUPY;
+    PCB[TEST_OTHER].Status.Running_Status=OCCUPY;
+    _Sys_Mem_Init();
+    _Sys_Queue_Init();
+    Src_Queue_ID=Sys_Create_Queue_Inline((s8*)"Src",4,TEST_INLINE_SIZE);
+    HOST_CHECK(Src_Queue_ID>=0);
+    Dst_Queue_ID=Sys_Create_Queue_Inline((s8*)"Dst",4,TEST_INLINE_SIZE);
+    HOST_CHECK(Dst_Queue_ID>=0);
+
+    /* (1) A message not sent yet, even one of PID 0 */
+    Msg_Block_ID=Test_Alloc(Src_Queue_ID);
+    Test_Forward_Fail(TEST_SENDER,Src_Queue_ID,Msg_Block_ID);
+    Test_Forward_Fail(TEST_OTHER,Src_Queue_ID,Msg_Block_ID);
+    Current_PID=0;
+    HOST_CHECK(Sys_Destroy_Msg(Src_Queue_ID,Msg_Block_ID)==0);
+    Msg_Block_ID=Sys_Alloc_Msg(Src_Queue_ID,TEST_MSG_TYPE,TEST_MSG_SIZE,&Msg_Buffer_Ptr);
+    HOST_CHECK(Msg_Block_ID>=0);
+    Test_Forward_Fail(0,Src_Queue_ID,Msg_Block_ID);
+    HOST_CHECK(Sys_Destroy_Msg(Src_Queue_ID,Msg_Block_ID)==0);
+
+    /* (2) A message received by somebody else */
+    Msg_Block_ID=Test_Alloc(Src_Queue_ID);
+    HOST_CHECK(Sys_Send_Msg(TEST_RECVER,Src_Queue_ID,Msg_Block_ID)==0);
+    Current_PID=TEST_RECVER;
+    HOST_CHECK(Sys_Recv_Msg(Src_Queue_ID,TEST_MSG_TYPE,&Msg_Buffer_Ptr)==Msg_Block_ID);
+    Test_Forward_Fail(TEST_SENDER,Src_Queue_ID,Msg_Block_ID);
+    Test_Forward_Fail(TEST_OTHER,Src_Queue_ID,Msg_Block_ID);
+
+    /* (3) The receiver forwards it to the other queue, and back to the same queue */
+    Current_PID=TEST_RECVER;
+    Msg_Block_ID=Sys_Forward_Msg(Src_Queue_ID,Msg_Block_ID,Dst_Queue_ID,TEST_OTHER);
+    HOST_CHECK(Msg_Block_ID>=0);
+    HOST_CHECK(Sys_Query_Msg_Number(Src_Queue_ID)==0);
+    Current_PID=TEST_OTHER;
+    HOST_CHECK(Sys_Recv_Msg(Dst_Queue_ID,TEST_MSG_TYPE,&Msg_Buffer_Ptr)==Msg_Block_ID);
+    Test_Forward_Fail(TEST_RECVER,Dst_Queue_ID,Msg_Block_ID);
+    Current_PID=TEST_OTHER;
+    HOST_CHECK(Sys_Forward_Msg(Dst_Queue_ID,Msg_Block_ID,Dst_Queue_ID,TEST_RECVER)==Msg_Block_ID);
+    Test_Recv(TEST_RECVER,Dst_Queue_ID);
+
+    HOST_CHECK(Sys_Destroy_Queue(Src_Queue_ID)==0);
+    HOST_CHECK(Sys_Destroy_Queue(Dst_Queue_ID)==0);
+
+    Host_Print("OK\n");
+    return 0;
+}
+/* End Function:main *********************************************************/
+
+/* End Of File ***************************************************************/
+
+/* Copyright (C) 2011-2013 Evo-Devo Instrum. All rights reserved *************/
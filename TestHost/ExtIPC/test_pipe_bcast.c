@@ -0,0 +1,375 @@
+/******************************************************************************
+Filename    : test_pipe_bcast.c
+Author      : pry
+Date        : 19/10/2013
+Version     : 0.01
+Description : The host-side test of the broadcast pipes. The writer writes a
+              counting byte stream, and every byte a reader gets is checked.
+              (1) "PIPE_MODE_BCAST_BLOCK": the writer is not held up when there
+                  are no readers, so a reader that joins later does not find a
+                  full pipe. The writer is blocked by the slowest reader, and is
+                  woken up when the slowest reader reads or leaves.
+              (2) "PIPE_MODE_BCAST_DROP": the writer is never blocked, and the
+                  slow readers lose the oldest data and count it.
+              (3) The pipe leaves the broadcast modes when the readers are gone,
+                  and a new opener takes the place of a writer that left.
+              (4) The pipe cannot go into the broadcast modes when the other
+                  opener is a PID that can't be a reader.
+              Build and run it on a POSIX host:
+                  TestHost/host_build.sh test_pipe_bcast TestHost/ExtIPC/test_pipe_bcast.c \
+                  ExtIPC/pipe.c Memmgr/memory.c
+                  ./test_pipe_bcast
+******************************************************************************/
+
+/* Includes ******************************************************************/
+#include "Config\MP_config.h"
+#include "Platform\MP_platform.h"
+
+/* Definition includes */
+#define __HDR_DEFS__
+#include "Kernel\scheduler.h"
+#include "Kernel\error.h"
+#include "Memmgr\memory.h"
+#include "ExtIPC\wait.h"
+#include "ExtIPC\pipe.h"
+#undef __HDR_DEFS__
+
+/* Structure includes */
+#define __HDR_STRUCTS__
+#include "Syslib\syslib.h"
+#include "Kernel\scheduler.h"
+#include "Memmgr\memory.h"
+#include "ExtIPC\wait.h"
+#include "ExtIPC\pipe.h"
+#undef __HDR_STRUCTS__
+
+/* Public includes */
+#define __HDR_PUBLIC_MEMBERS__
+#include "Kernel\scheduler.h"
+#include "Kernel\error.h"
+#include "Syslib\syslib.h"
+#include "Memmgr\memory.h"
+#include "ExtIPC\wait.h"
+#include "ExtIPC\pipe.h"
+#undef __HDR_PUBLIC_MEMBERS__
+/* End Includes **************************************************************/
+
+/* Defines *******************************************************************/
+/* The writer and the readers */
+#define TEST_WRITER                 1
+#define TEST_READER_A               2
+#define TEST_READER_B               3
+#define TEST_NEW_WRITER             4
+/* The size of the pipe */
+#define TEST_PIPE_SIZE              64
+/* End Defines ***************************************************************/
+
+/* Global Variables **********************************************************/
+static pipeid_t Test_Pipe_ID;
+/* The next byte the writer writes */
+static u8 Writer_Seq;
+/* End Global Variables ******************************************************/
+
+/* Begin Function:Test_Open ***************************************************
+Description : Open the pipe in the name of a process.
+Input       : pid_t PID - The process.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Open(pid_t PID)
+{
+    void* Pipe_Buffer_Ptr;
+
+    Current_PID=PID;
+    HOST_CHECK(Sys_Open_Pipe(Test_Pipe_ID,0,&Pipe_Buffer_Ptr)==0);
+}
+/* End Function:Test_Open ****************************************************/
+
+/* Begin Function:Test_Create *************************************************
+Description : Create the pipe, open it as the writer, and go into a broadcast mode
+              with no readers.
+Input       : cnt_t Mode - The broadcast mode.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Create(cnt_t Mode)
+{
+    Test_Pipe_ID=Sys_Create_Pipe((s8*)"Test",TEST_PIPE_SIZE);
+    HOST_CHECK(Test_Pipe_ID>=0);
+    Test_Open(TEST_WRITER);
+    HOST_CHECK(Sys_Pipe_Set_Mode(Test_Pipe_ID,Mode)==0);
+    Writer_Seq=0;
+}
+/* End Function:Test_Create **************************************************/
+
+/* Begin Function:Test_Write **************************************************
+Description : Write the counting byte stream as the writer, without blocking.
+Input       : size_t Size - The number of bytes wanted.
+Output      : None.
+Return      : size_t - The number of bytes written.
+******************************************************************************/
+static size_t Test_Write(size_t Size)
+{
+    u8 Data[TEST_PIPE_SIZE*2];
+    size_t Write_Size;
+    size_t Count;
+
+    for(Count=0;Count<Size;Count++)
+        Data[Count]=(u8)(Writer_Seq+Count);
+
+    Current_PID=TEST_WRITER;
+    Write_Size=Sys_Pipe_Write(Test_Pipe_ID,Data,Size,0);
+    Writer_Seq+=(u8)Write_Size;
+    return Write_Size;
+}
+/* End Function:Test_Write ***************************************************/
+
+/* Begin Function:Test_Read ***************************************************
+Description : Read as a reader, and check the bytes.
+Input       : pid_t PID - The reader.
+              size_t Size - The most bytes to read.
+              u8 Seq - The first byte expected.
+Output      : None.
+Return      : size_t - The number of bytes read.
+******************************************************************************/
+static size_t Test_Read(pid_t PID,size_t Size,u8 Seq)
+{
+    u8 Buffer[TEST_PIPE_SIZE];
+    size_t Read_Size;
+    size_t Count;
+
+    Current_PID=PID;
+    Read_Size=Sys_Pipe_Read(Test_Pipe_ID,Buffer,Size,0);
+    for(Count=0;Count<Read_Size;Count++)
+        HOST_CHECK(Buffer[Count]==(u8)(Seq+Count));
+
+    return Read_Size;
+}
+/* End Function:Test_Read ****************************************************/
+
+/* Begin Function:Test_Wait_Write *********************************************
+Description : Wait for the free space as the writer, as "Sys_Wait_Object" does.
+Input       : struct Wait_Object_Struct* Wait - The wait block.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Wait_Write(struct Wait_Object_Struct* Wait)
+{
+    Wait->Succeed_Flag=0;
+    HOST_CHECK(_Sys_Wait_Pipe_Reg(TEST_WRITER,Test_Pipe_ID,PIPEWRITE,Wait)==0);
+}
+/* End Function:Test_Wait_Write **********************************************/
+
+/* Begin Function:Test_Bcast_Block *******************************************
+Description : The writer of a blocking broadcast pipe is held up only by the
+              slowest reader, and is woken up when that changes.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Bcast_Block(void)
+{
+    struct Wait_Object_Struct Wait;
+    u8 Seq_A;
+    u8 Seq_B;
+
+    Test_Create(PIPE_MODE_BCAST_BLOCK);
+
+    /* With no readers, nothing is kept, and the writer never blocks */
+    HOST_CHECK(Test_Write(TEST_PIPE_SIZE)==TEST_PIPE_SIZE);
+    HOST_CHECK(Test_Write(TEST_PIPE_SIZE)==TEST_PIPE_SIZE);
+    HOST_CHECK(Test_Write(TEST_PIPE_SIZE)==TEST_PIPE_SIZE);
+    HOST_CHECK(Sys_Query_Pipe_Data(Test_Pipe_ID)==0);
+
+    /* A reader joins, and gets only the data written after that */
+    Test_Open(TEST_READER_A);
+    Seq_A=Writer_Seq;
+    HOST_CHECK(Test_Read(TEST_READER_A,TEST_PIPE_SIZE,Seq_A)==0);
+    HOST_CHECK(Sys_Get_Errno()==EPIPEEMPTY);
+    HOST_CHECK(Test_Write(10)==10);
+    HOST_CHECK(Test_Read(TEST_READER_A,TEST_PIPE_SIZE,Seq_A)==10);
+    Seq_A+=10;
+
+    /* The reader does not read, so the writer fills the pipe and blocks */
+    HOST_CHECK(Test_Write(TEST_PIPE_SIZE)==TEST_PIPE_SIZE);
+    HOST_CHECK(Test_Write(1)==0);
+    HOST_CHECK(Sys_Get_Errno()==EPIPEFULL);
+    Test_Wait_Write(&Wait);
+
+    /* Another reader joins. It has nothing to read, so the writer still waits */
+    Test_Open(TEST_READER_B);
+    Seq_B=Writer_Seq;
+    HOST_CHECK(Wait.Succeed_Flag==0);
+
+    /* The slowest reader reads, and the writer is woken up */
+    HOST_CHECK(Test_Read(TEST_READER_A,16,Seq_A)==16);
+    Seq_A+=16;
+    HOST_CHECK(Wait.Succeed_Flag==1);
+    HOST_CHECK(Test_Write(TEST_PIPE_SIZE)==16);
+    HOST_CHECK(Test_Write(1)==0);
+
+    /* The slowest reader leaves, so the other one is the slowest now */
+    Test_Wait_Write(&Wait);
+    Current_PID=TEST_READER_A;
+    HOST_CHECK(Sys_Close_Pipe(Test_Pipe_ID)==0);
+    HOST_CHECK(Wait.Succeed_Flag==1);
+    HOST_CHECK(Test_Write(TEST_PIPE_SIZE)==TEST_PIPE_SIZE-16);
+    HOST_CHECK(Test_Read(TEST_READER_B,TEST_PIPE_SIZE,Seq_B)==TEST_PIPE_SIZE);
+    Seq_B+=TEST_PIPE_SIZE;
+
+    /* The last reader leaves with the pipe full, and the writer goes on */
+    HOST_CHECK(Test_Write(TEST_PIPE_SIZE)==TEST_PIPE_SIZE);
+    Test_Wait_Write(&Wait);
+    Current_PID=TEST_READER_B;
+    HOST_CHECK(Sys_Close_Pipe(Test_Pipe_ID)==0);
+    HOST_CHECK(Wait.Succeed_Flag==1);
+    HOST_CHECK(Sys_Query_Pipe_Data(Test_Pipe_ID)==0);
+    HOST_CHECK(Test_Write(TEST_PIPE_SIZE)==TEST_PIPE_SIZE);
+
+    /* With no readers, the pipe can leave the broadcast mode */
+    Current_PID=TEST_WRITER;
+    HOST_CHECK(Sys_Pipe_Set_Mode(Test_Pipe_ID,PIPE_MODE_NORMAL)==0);
+    HOST_CHECK(Sys_Close_Pipe(Test_Pipe_ID)==0);
+    HOST_CHECK(Sys_Destroy_Pipe(Test_Pipe_ID)==0);
+}
+/* End Function:Test_Bcast_Block *********************************************/
+
+/* Begin Function:Test_Bcast_Drop *********************************************
+Description : The writer of a dropping broadcast pipe is never blocked, and the
+              slow readers lose the oldest data.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Bcast_Drop(void)
+{
+    u8 Seq_A;
+    u8 Seq_B;
+
+    Test_Create(PIPE_MODE_BCAST_DROP);
+
+    HOST_CHECK(Test_Write(TEST_PIPE_SIZE)==TEST_PIPE_SIZE);
+    HOST_CHECK(Sys_Query_Pipe_Data(Test_Pipe_ID)==0);
+
+    Test_Open(TEST_READER_A);
+    Seq_A=Writer_Seq;
+    HOST_CHECK(Test_Write(TEST_PIPE_SIZE)==TEST_PIPE_SIZE);
+
+    /* A reader joins a full pipe, and the writer is not held up */
+    Test_Open(TEST_READER_B);
+    Seq_B=Writer_Seq;
+    HOST_CHECK(Test_Write(16)==16);
+
+    /* The first reader lost the oldest 16 bytes, and the second lost nothing */
+    Current_PID=TEST_READER_A;
+    HOST_CHECK(Sys_Query_Pipe_Drop(Test_Pipe_ID)==16);
+    Seq_A+=16;
+    HOST_CHECK(Test_Read(TEST_READER_A,TEST_PIPE_SIZE,Seq_A)==TEST_PIPE_SIZE);
+    Current_PID=TEST_READER_B;
+    HOST_CHECK(Sys_Query_Pipe_Drop(Test_Pipe_ID)==0);
+    HOST_CHECK(Test_Read(TEST_READER_B,TEST_PIPE_SIZE,Seq_B)==16);
+
+    /* Both leave, and the pipe leaves the broadcast mode */
+    Current_PID=TEST_READER_A;
+    HOST_CHECK(Sys_Close_Pipe(Test_Pipe_ID)==0);
+    Current_PID=TEST_READER_B;
+    HOST_CHECK(Sys_Close_Pipe(Test_Pipe_ID)==0);
+    HOST_CHECK(Test_Write(TEST_PIPE_SIZE)==TEST_PIPE_SIZE);
+    Current_PID=TEST_WRITER;
+    HOST_CHECK(Sys_Pipe_Set_Mode(Test_Pipe_ID,PIPE_MODE_NORMAL)==0);
+    HOST_CHECK(Sys_Close_Pipe(Test_Pipe_ID)==0);
+    HOST_CHECK(Sys_Destroy_Pipe(Test_Pipe_ID)==0);
+}
+/* End Function:Test_Bcast_Drop **********************************************/
+
+/* Begin Function:Test_Bcast_Writer *******************************************
+Description : The readers see the end of the pipe when the writer leaves, and a
+              new opener takes its place.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Bcast_Writer(void)
+{
+    u8 Seq_A;
+
+    Test_Create(PIPE_MODE_BCAST_BLOCK);
+    Test_Open(TEST_READER_A);
+    Seq_A=Writer_Seq;
+    HOST_CHECK(Test_Write(8)==8);
+
+    Current_PID=TEST_WRITER;
+    HOST_CHECK(Sys_Close_Pipe(Test_Pipe_ID)==0);
+    HOST_CHECK(Test_Read(TEST_READER_A,TEST_PIPE_SIZE,Seq_A)==8);
+    Seq_A+=8;
+    HOST_CHECK(Test_Read(TEST_READER_A,TEST_PIPE_SIZE,Seq_A)==0);
+    HOST_CHECK(Sys_Get_Errno()==EPIPECLOSED);
+
+    /* The new opener is the writer, not a reader */
+    Test_Open(TEST_NEW_WRITER);
+    Current_PID=TEST_NEW_WRITER;
+    HOST_CHECK(Sys_Pipe_Write(Test_Pipe_ID,&Seq_A,1,0)==1);
+    HOST_CHECK(Test_Read(TEST_READER_A,TEST_PIPE_SIZE,Seq_A)==1);
+
+    Current_PID=TEST_READER_A;
+    HOST_CHECK(Sys_Close_Pipe(Test_Pipe_ID)==0);
+    Current_PID=TEST_NEW_WRITER;
+    HOST_CHECK(Sys_Close_Pipe(Test_Pipe_ID)==0);
+    HOST_CHECK(Sys_Destroy_Pipe(Test_Pipe_ID)==0);
+}
+/* End Function:Test_Bcast_Writer ********************************************/
+
+/* Begin Function:Test_Bcast_Enter ******************************************
+Description : The other opener becomes a reader when the pipe goes into the
+              broadcast modes, so it must have a reader slot.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Bcast_Enter(void)
+{
+    void* Pipe_Buffer_Ptr;
+
+    Test_Pipe_ID=Sys_Create_Pipe((s8*)"Test",TEST_PIPE_SIZE);
+    HOST_CHECK(Test_Pipe_ID>=0);
+    Test_Open(TEST_WRITER);
+    HOST_CHECK(_Sys_Open_Pipe(MAX_PROC_NUM,Test_Pipe_ID,0,&Pipe_Buffer_Ptr)==0);
+
+    Current_PID=TEST_WRITER;
+    HOST_CHECK(Sys_Pipe_Set_Mode(Test_Pipe_ID,PIPE_MODE_BCAST_BLOCK)==-1);
+    HOST_CHECK(Sys_Get_Errno()==EINVPIPE);
+
+    HOST_CHECK(_Sys_Close_Pipe(MAX_PROC_NUM,Test_Pipe_ID)==0);
+    HOST_CHECK(Sys_Close_Pipe(Test_Pipe_ID)==0);
+    HOST_CHECK(Sys_Destroy_Pipe(Test_Pipe_ID)==0);
+}
+/* End Function:Test_Bcast_Enter *********************************************/
+
+/* Begin Function:main ********************************************************
+Description : The entry of the test.
+Input       : None.
+Output      : None.
+Return      : int - 0 if successful.
+******************************************************************************/
+int main(void)
+{
+    PCB[TEST_WRITER].Status.Running_Status=OCCUPY;
+    PCB[TEST_READER_A].Status.Running_Status=OCCUPY;
+    PCB[TEST_READER_B].Status.Running_Status=OCCUPY;
+    PCB[TEST_NEW_WRITER].Status.Running_Status=OCCUPY;
+    _Sys_Mem_Init();
+    _Sys_Pipe_Init();
+
+    Test_Bcast_Block();
+    Test_Bcast_Drop();
+    Test_Bcast_Writer();
+    Test_Bcast_Enter();
+
+    Host_Print("OK\n");
+    return 0;
+}
+/* End Function:main *********************************************************/
+
+/* End Of File ***************************************************************/
+
+/* Copyright (C) 2011-2013 Evo-Devo Instrum. All rights reserved *************/
@@ -0,0 +1,361 @@
+/******************************************************************************
+Filename    : test_pipe_isr.c
+Author      : pry
+Date        : 19/10/2013
+Version     : 0.01
+Description : The host-side test of writing a pipe from an interrupt handler.
+              (1) The deterministic part: the reader is woken only when the data
+                  written by "Sys_Pipe_Write_ISR" crosses the read trigger level,
+                  and only when the kernel runs next time, in the process context
+                  or in the systick routine.
+              (2) The stress part: a second thread writes a counting byte stream
+                  with "Sys_Pipe_Write_ISR" at the same time as the process reads
+                  it. When there is not enough data, the process waits for the pipe
+                  as "Sys_Wait_Object" does, and must be woken up within a second.
+                  Every byte is checked, so the data read before it is written,
+                  and the lost wakeups, are found. Run it on a weakly ordered host
+                  (e.g. ARM64) to find the missing memory barriers.
+              Build and run it on a POSIX host:
+                  TestHost/host_build.sh test_pipe_isr TestHost/ExtIPC/test_pipe_isr.c \
+                  ExtIPC/pipe.c Memmgr/memory.c
+                  ./test_pipe_isr [Seconds]
+******************************************************************************/
+
+/* Includes ******************************************************************/
+#include "Config\MP_config.h"
+#include "Platform\MP_platform.h"
+
+/* Definition includes */
+#define __HDR_DEFS__
+#include "Kernel\scheduler.h"
+#include "Memmgr\memory.h"
+#include "ExtIPC\wait.h"
+#include "ExtIPC\pipe.h"
+#undef __HDR_DEFS__
+
+/* Structure includes */
+#define __HDR_STRUCTS__
+#include "Syslib\syslib.h"
+#include "Kernel\scheduler.h"
+#include "Memmgr\memory.h"
+#include "ExtIPC\wait.h"
+#include "ExtIPC\pipe.h"
+#undef __HDR_STRUCTS__
+
+/* Public includes */
+#define __HDR_PUBLIC_MEMBERS__
+#include "Kernel\scheduler.h"
+#include "Kernel\interrupt.h"
+#include "Syslib\syslib.h"
+#include "Memmgr\memory.h"
+#include "ExtIPC\wait.h"
+#include "ExtIPC\pipe.h"
+#undef __HDR_PUBLIC_MEMBERS__
+/* End Includes **************************************************************/
+
+/* Defines *******************************************************************/
+/* The reader of the pipe */
+#define TEST_READER                 1
+/* The size and the read trigger level of the pipe in the stress part */
+#define TEST_PIPE_SIZE              256
+#define TEST_TRIGGER                16
+/* The biggest write of the thread */
+#define TEST_MAX_CHUNK              24
+/* The longest pause of the thread between two writes, in loops */
+#define TEST_MAX_PAUSE              2000
+/* The longest wait of the reader, in nanoseconds */
+#define TEST_WAIT_LIMIT             1000000000ULL
+/* End Defines ***************************************************************/
+
+/* Global Variables **********************************************************/
+static pipeid_t Test_Pipe_ID;
+/* The thread stops when this is set */
+static volatile cnt_t Writer_Stop;
+/* The bytes written by the thread */
+static volatile u32 Writer_Bytes;
+static u32 Writer_Rand_Seed=3;
+static u32 Reader_Rand_Seed=7;
+/* End Global Variables ******************************************************/
+
+/* Begin Function:Test_Rand ***************************************************
+Description : A small random number generator.
+Input       : u32* Seed - The state.
+Output      : u32* Seed - The new state.
+Return      : u32 - The random number, 15 bits.
+******************************************************************************/
+static u32 Test_Rand(u32* Seed)
+{
+    *Seed=(*Seed)*1103515245+12345;
+    return ((*Seed)>>16)&0x7FFF;
+}
+/* End Function:Test_Rand ****************************************************/
+
+/* Begin Function:Test_Open ***************************************************
+Description : Create a pipe in "PIPE_MODE_ISR", and open it as the reader.
+Input       : size_t Size - The size of the pipe.
+              size_t Read_Trigger - The read trigger level.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Open(size_t Size,size_t Read_Trigger)
+{
+    void* Pipe_Buffer_Ptr;
+
+    Current_PID=TEST_READER;
+    Test_Pipe_ID=Sys_Create_Pipe((s8*)"Test",Size);
+    HOST_CHECK(Test_Pipe_ID>=0);
+    HOST_CHECK(Sys_Open_Pipe(Test_Pipe_ID,0,&Pipe_Buffer_Ptr)==0);
+    HOST_CHECK(Sys_Pipe_Set_Mode(Test_Pipe_ID,PIPE_MODE_ISR)==0);
+    HOST_CHECK(Sys_Pipe_Set_Trigger(Test_Pipe_ID,Read_Trigger,1)==0);
+}
+/* End Function:Test_Open ****************************************************/
+
+/* Begin Function:Test_Close **************************************************
+Description : Close and destroy the pipe.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Close(void)
+{
+    HOST_CHECK(Sys_Close_Pipe(Test_Pipe_ID)==0);
+    HOST_CHECK(Sys_Destroy_Pipe(Test_Pipe_ID)==0);
+}
+/* End Function:Test_Close ***************************************************/
+
+/* Begin Function:Test_Write_ISR **********************************************
+Description : Write the pipe as an interrupt handler of the process thread.
+Input       : size_t Size - The number of bytes.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Write_ISR(size_t Size)
+{
+    u8 Data[TEST_MAX_CHUNK];
+
+    Sys_Memset((ptr_int_t)Data,0x5A,Size);
+    Sys_Enter_Int_Handler();
+    HOST_CHECK(Sys_Pipe_Write_ISR(Test_Pipe_ID,Data,Size)==Size);
+    Sys_Exit_Int_Handler();
+}
+/* End Function:Test_Write_ISR ***********************************************/
+
+/* Begin Function:Test_Kernel_Run *********************************************
+Description : Let the kernel run once in the process context.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Kernel_Run(void)
+{
+    Sys_Lock_Scheduler();
+    Sys_Unlock_Scheduler();
+}
+/* End Function:Test_Kernel_Run **********************************************/
+
+/* Begin Function:Test_Trigger ************************************************
+Description : The reader is woken up only when the trigger level is crossed, and
+              only when the kernel runs.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Trigger(void)
+{
+    struct Wait_Object_Struct Wait;
+    u8 Buffer[8];
+
+    Test_Open(64,4);
+
+    Wait.Succeed_Flag=0;
+    HOST_CHECK(_Sys_Wait_Pipe_Reg(TEST_READER,Test_Pipe_ID,PIPEREAD,&Wait)==0);
+    /* Nothing is asked for yet */
+    Test_Kernel_Run();
+    HOST_CHECK(Wait.Succeed_Flag==0);
+
+    /* Below the trigger level */
+    Test_Write_ISR(2);
+    Test_Kernel_Run();
+    HOST_CHECK(Wait.Succeed_Flag==0);
+
+    /* Crossing the trigger level; the kernel has not run yet */
+    Test_Write_ISR(2);
+    HOST_CHECK(Wait.Succeed_Flag==0);
+    Test_Kernel_Run();
+    HOST_CHECK(Wait.Succeed_Flag==1);
+    HOST_CHECK(Sys_Pipe_Read(Test_Pipe_ID,Buffer,8,0)==4);
+
+    /* An unlock in an interrupt handler does not wake it up, and the systick
+     * routine does, as an interrupt */
+    Wait.Succeed_Flag=0;
+    HOST_CHECK(_Sys_Wait_Pipe_Reg(TEST_READER,Test_Pipe_ID,PIPEREAD,&Wait)==0);
+    Test_Write_ISR(4);
+    Sys_Enter_Int_Handler();
+    Test_Kernel_Run();
+    HOST_CHECK(Wait.Succeed_Flag==0);
+    _Sys_Pipe_Wake_Deferred();
+    HOST_CHECK(Wait.Succeed_Flag==1);
+    Sys_Exit_Int_Handler();
+    HOST_CHECK(Sys_Pipe_Read(Test_Pipe_ID,Buffer,8,0)==4);
+
+    Test_Close();
+}
+/* End Function:Test_Trigger *************************************************/
+
+/* Begin Function:Test_Writer *************************************************
+Description : The second thread. It writes the counting byte stream in chunks of
+              random sizes, with random pauses, until it is asked to stop.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Writer(void)
+{
+    u8 Data[TEST_MAX_CHUNK];
+    volatile cnt_t Pause;
+    size_t Size;
+    size_t Count;
+    u8 Seq;
+
+    Seq=0;
+    while(Writer_Stop==0)
+    {
+        Size=1+Test_Rand(&Writer_Rand_Seed)%TEST_MAX_CHUNK;
+        for(Count=0;Count<Size;Count++)
+            Data[Count]=(u8)(Seq+Count);
+
+        /* Only a part may be written if the pipe is full */
+        Size=Sys_Pipe_Write_ISR(Test_Pipe_ID,Data,Size);
+        Seq+=(u8)Size;
+        Writer_Bytes+=Size;
+
+        for(Pause=Test_Rand(&Writer_Rand_Seed)%TEST_MAX_PAUSE;Pause>0;Pause--);
+    }
+}
+/* End Function:Test_Writer **************************************************/
+
+/* Begin Function:Test_Read **************************************************
+Description : Read the pipe without blocking, and check the bytes.
+Input       : size_t Size - The most bytes to read.
+              u8* Seq - The next byte expected.
+Output      : u8* Seq - The next byte expected.
+Return      : size_t - The number of bytes read.
+******************************************************************************/
+static size_t Test_Read(size_t Size,u8* Seq)
+{
+    u8 Buffer[TEST_PIPE_SIZE];
+    size_t Read_Size;
+    size_t Count;
+
+    Read_Size=Sys_Pipe_Read(Test_Pipe_ID,Buffer,Size,0);
+    for(Count=0;Count<Read_Size;Count++)
+    {
+        HOST_CHECK(Buffer[Count]==*Seq);
+        (*Seq)++;
+    }
+
+    return Read_Size;
+}
+/* End Function:Test_Read ****************************************************/
+
+/* Begin Function:Test_Stress *************************************************
+Description : The thread writes and the process reads at the same time.
+Input       : u32 Seconds - How long to run.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Stress(u32 Seconds)
+{
+    struct Wait_Object_Struct Wait;
+    u64 End_Time;
+    u64 Wait_End_Time;
+    u32 Read_Bytes;
+    size_t Read_Size;
+    cnt_t Wait_Cnt;
+    retval_t Retval;
+    u8 Seq;
+
+    Test_Open(TEST_PIPE_SIZE,TEST_TRIGGER);
+    Read_Bytes=0;
+    Wait_Cnt=0;
+    Seq=0;
+    Writer_Stop=0;
+    Writer_Bytes=0;
+    End_Time=Host_Time_NS()+((u64)Seconds)*1000000000ULL;
+    Host_Start_Thread(Test_Writer);
+
+    while(Host_Time_NS()<End_Time)
+    {
+        Read_Size=Test_Read(1+Test_Rand(&Reader_Rand_Seed)%(TEST_MAX_CHUNK*2),&Seq);
+        Read_Bytes+=Read_Size;
+        if(Read_Size!=0)
+            continue;
+
+        /* Not enough data. Wait for it as "Sys_Wait_Object" does, and let the
+         * kernel run until we are woken up */
+        Wait.Succeed_Flag=0;
+        Retval=_Sys_Wait_Pipe_Reg(TEST_READER,Test_Pipe_ID,PIPEREAD,&Wait);
+        if(Retval==NO_NEED_TO_WAIT)
+            continue;
+        HOST_CHECK(Retval==0);
+        Wait_Cnt++;
+
+        Wait_End_Time=Host_Time_NS()+TEST_WAIT_LIMIT;
+        while(Wait.Succeed_Flag==0)
+        {
+            /* The data is there, but nobody woke us up */
+            HOST_CHECK(Host_Time_NS()<Wait_End_Time);
+            Test_Kernel_Run();
+        }
+    }
+
+    Writer_Stop=1;
+    Host_Join_Thread();
+
+    /* Read what is left */
+    HOST_CHECK(Sys_Pipe_Set_Trigger(Test_Pipe_ID,1,1)==0);
+    while(Test_Read(TEST_PIPE_SIZE,&Seq)!=0);
+    HOST_CHECK(Read_Bytes<=Writer_Bytes);
+    HOST_CHECK(Sys_Query_Pipe_Data(Test_Pipe_ID)==0);
+
+    Host_Print("%lu bytes, %d waits\n",(unsigned long)Writer_Bytes,(int)Wait_Cnt);
+    Test_Close();
+}
+/* End Function:Test_Stress **************************************************/
+
+/* Begin Function:main ********************************************************
+Description : The entry of the test.
+Input       : int argc - The number of arguments.
+              char* argv[] - The arguments; the first is the seconds to run the
+                             stress part.
+Output      : None.
+Return      : int - 0 if successful.
+******************************************************************************/
+int main(int argc,char* argv[])
+{
+    u32 Seconds;
+    char* Arg_Ptr;
+
+    Seconds=2;
+    if(argc>1)
+    {
+        Seconds=0;
+        for(Arg_Ptr=argv[1];(*Arg_Ptr>='0')&&(*Arg_Ptr<='9');Arg_Ptr++)
+            Seconds=Seconds*10+(*Arg_Ptr-'0');
+    }
+
+    PCB[TEST_READER].Status.Running_Status=OCCUPY;
+    _Sys_Mem_Init();
+    _Sys_Pipe_Init();
+
+    Test_Trigger();
+    Test_Stress(Seconds);
+
+    Host_Print("OK\n");
+    return 0;
+}
+/* End Function:main *********************************************************/
+
+/* End Of File ***************************************************************/
+
+/* Copyright (C) 2011-2013 Evo-Devo Instrum. All rights reserved *************/
@@ -0,0 +1,421 @@
+/******************************************************************************
+Filename    : bench_mem_tlsf.c
+Author      : pry
+Date        : 19/10/2013
+Version     : 0.01
+Description : The host-side benchmark of the TLSF allocator. It replays an
+              allocation trace, and prints the time of each operation, the failed
+              allocations, the space lost to the rounding of the sizes, the peak
+              usage and the fragmentation index, for the "MM_SLI" and
+              "MM_MIN_ORDER" that it is built with. The trace is either a dump of
+              the memory trace ring buffer(see "mem_trace_decode.c"; only the
+              allocations made in the window are replayed), or the built-in one,
+              which mixes the small messages, the medium buffers and the big
+              blocks in a 8kB heap. Build and run one setting:
+                  CFLAGS="-DMM_SLI=16 -DMM_MIN_ORDER=5 -DMM_FLI=9" \
+                  TestHost/host_build.sh bench_mem_tlsf TestHost/Memmgr/bench_mem_tlsf.c Memmgr/memory.c
+                  ./bench_mem_tlsf [<Dump file> <Mem_Trace_Cnt>]
+              or all of them with "bench_mem_tlsf.sh".
+******************************************************************************/
+
+/* Includes ******************************************************************/
+#include "Config\MP_config.h"
+#include "Platform\MP_platform.h"
+
+/* Definition includes */
+#define __HDR_DEFS__
+#include "Kernel\scheduler.h"
+#include "Memmgr\memory.h"
+#undef __HDR_DEFS__
+
+/* Structure includes */
+#define __HDR_STRUCTS__
+#include "Syslib\syslib.h"
+#include "Kernel\scheduler.h"
+#include "Memmgr\memory.h"
+#undef __HDR_STRUCTS__
+
+/* Public includes */
+#define __HDR_PUBLIC_MEMBERS__
+#include "Kernel\scheduler.h"
+#include "Memmgr\memory.h"
+#undef __HDR_PUBLIC_MEMBERS__
+/* End Includes **************************************************************/
+
+/* Defines *******************************************************************/
+/* The most operations in a trace */
+#define BENCH_MAX_OPS               65536
+/* The most allocations alive at the same time */
+#define BENCH_MAX_LIVE              256
+/* The operations of the built-in trace, and the allocations alive in it */
+#define BENCH_GEN_OPS               20000
+#define BENCH_GEN_LIVE              32
+/* The times to replay for the timing */
+#define BENCH_REPEAT                20
+/* The size of one record in the dump: 6 little-endian words */
+#define BENCH_RECORD_SIZE           (6*4)
+/* End Defines ***************************************************************/
+
+/* Structs *******************************************************************/
+/* An operation of the trace. The allocations are numbered by the slots they use */
+struct Bench_Op
+{
+    /* "MEM_TRACE_MALLOC", "MEM_TRACE_MFREE" or "MEM_TRACE_REALLOC" */
+    u32 Operation;
+    u32 Slot;
+    size_t Size;
+};
+/* End Structs ***************************************************************/
+
+/* Global Variables **********************************************************/
+static struct Bench_Op Bench_Op[BENCH_MAX_OPS];
+static cnt_t Bench_Op_Num;
+/* The memory of each slot when replaying, and the address in the dump */
+static void* Bench_Ptr[BENCH_MAX_LIVE];
+static ptr_int_t Bench_Addr[BENCH_MAX_LIVE];
+static u32 Bench_Rand_Seed=1;
+/* End Global Variables ******************************************************/
+
+/* Begin Function:Bench_Rand **************************************************
+Description : A small random number generator, so that the trace is the same on
+              all hosts.
+Input       : None.
+Output      : None.
+Return      : u32 - The random number, 15 bits.
+******************************************************************************/
+static u32 Bench_Rand(void)
+{
+    Bench_Rand_Seed=Bench_Rand_Seed*1103515245+12345;
+    return (Bench_Rand_Seed>>16)&0x7FFF;
+}
+/* End Function:Bench_Rand ***************************************************/
+
+/* Begin Function:Bench_Gen_Size **********************************************
+Description : Get a size for the built-in trace: the small messages are the most,
+              and the big blocks are the fewest.
+Input       : None.
+Output      : None.
+Return      : size_t - The size.
+******************************************************************************/
+static size_t Bench_Gen_Size(void)
+{
+    u32 Class;
+
+    Class=Bench_Rand()%100;
+    if(Class<60)
+        return 8+Bench_Rand()%41;
+    if(Class<90)
+        return 64+Bench_Rand()%193;
+    return 512+Bench_Rand()%1025;
+}
+/* End Function:Bench_Gen_Size ***********************************************/
+
+/* Begin Function:Bench_Gen_Trace *********************************************
+Description : Make the built-in trace.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Bench_Gen_Trace(void)
+{
+    u32 Live[BENCH_GEN_LIVE];
+    cnt_t Live_Num;
+    cnt_t Count;
+    u32 Pick;
+
+    Live_Num=0;
+    for(Bench_Op_Num=0;Bench_Op_Num<BENCH_GEN_OPS;Bench_Op_Num++)
+    {
+        if((Live_Num==0)||((Live_Num<BENCH_GEN_LIVE)&&((Bench_Rand()%100)<55)))
+        {
+            /* The slots are used in turn, so the free ones are the ones not alive */
+            for(Count=0;;Count++)
+            {
+                for(Pick=0;Pick<(u32)Live_Num;Pick++)
+                {
+                    if(Live[Pick]==(u32)Count)
+                        break;
+                }
+                if(Pick==(u32)Live_Num)
+                    break;
+            }
+            Live[Live_Num++]=Count;
+            Bench_Op[Bench_Op_Num].Operation=MEM_TRACE_MALLOC;
+            Bench_Op[Bench_Op_Num].Slot=Count;
+            Bench_Op[Bench_Op_Num].Size=Bench_Gen_Size();
+        }
+        else
+        {
+            Pick=Bench_Rand()%Live_Num;
+            Bench_Op[Bench_Op_Num].Slot=Live[Pick];
+            if((Bench_Rand()%10)==0)
+            {
+                Bench_Op[Bench_Op_Num].Operation=MEM_TRACE_REALLOC;
+                Bench_Op[Bench_Op_Num].Size=Bench_Gen_Size();
+            }
+            else
+            {
+                Bench_Op[Bench_Op_Num].Operation=MEM_TRACE_MFREE;
+                Live[Pick]=Live[--Live_Num];
+            }
+        }
+    }
+}
+/* End Function:Bench_Gen_Trace **********************************************/
+
+/* Begin Function:Bench_Read_Word *********************************************
+Description : Read a little-endian 32-bit word.
+Input       : const u8* Buf - The bytes.
+Output      : None.
+Return      : u32 - The word.
+******************************************************************************/
+static u32 Bench_Read_Word(const u8* Buf)
+{
+    return ((u32)Buf[0])|(((u32)Buf[1])<<8)|(((u32)Buf[2])<<16)|(((u32)Buf[3])<<24);
+}
+/* End Function:Bench_Read_Word **********************************************/
+
+/* Begin Function:Bench_Find_Slot *********************************************
+Description : Find the slot of an address in the dump.
+Input       : ptr_int_t Mem_Addr - The address; 0 finds an empty slot.
+Output      : None.
+Return      : cnt_t - The slot, or -1 if not found.
+******************************************************************************/
+static cnt_t Bench_Find_Slot(ptr_int_t Mem_Addr)
+{
+    cnt_t Count;
+
+    for(Count=0;Count<BENCH_MAX_LIVE;Count++)
+    {
+        if(Bench_Addr[Count]==Mem_Addr)
+            return Count;
+    }
+    return -1;
+}
+/* End Function:Bench_Find_Slot **********************************************/
+
+/* Begin Function:Bench_Load_Trace ********************************************
+Description : Make the trace from a dump of the ring buffer. The records are put
+              in the order that they were recorded, and the addresses are turned
+              into slots. The frees of the memory allocated before the window, and
+              the failed allocations, are left out.
+Input       : const char* Path - The dump file.
+              u32 Trace_Cnt - The "Mem_Trace_Cnt" when it was dumped.
+Output      : None.
+Return      : retval_t - If successful, 0; else -1.
+******************************************************************************/
+static retval_t Bench_Load_Trace(const char* Path,u32 Trace_Cnt)
+{
+    u8* Buf;
+    u8* Record;
+    u32 File_Size;
+    u32 Depth;
+    u32 Start;
+    u32 Num;
+    u32 Count;
+    u32 Operation;
+    ptr_int_t Mem_Addr;
+    cnt_t Slot;
+
+    Buf=Host_Load_File(Path,&File_Size);
+    if(Buf==0)
+        return -1;
+
+    /* The depth is a power of 2 */
+    Depth=File_Size/BENCH_RECORD_SIZE;
+    if((Depth==0)||((Depth&(Depth-1))!=0))
+        return -1;
+
+    if(Trace_Cnt<=Depth)
+    {
+        Start=0;
+        Num=Trace_Cnt;
+    }
+    else
+    {
+        Start=Trace_Cnt&(Depth-1);
+        Num=Depth;
+    }
+
+    Bench_Op_Num=0;
+    for(Count=0;(Count<Num)&&(Bench_Op_Num<BENCH_MAX_OPS);Count++)
+    {
+        Record=Buf+((Start+Count)&(Depth-1))*BENCH_RECORD_SIZE;
+        Operation=Bench_Read_Word(Record+4);
+        Mem_Addr=Bench_Read_Word(Record+20);
+        if(Mem_Addr==0)
+            continue;
+
+        if(Operation==MEM_TRACE_MALLOC)
+        {
+            Slot=Bench_Find_Slot(0);
+            if(Slot<0)
+                return -1;
+            Bench_Addr[Slot]=Mem_Addr;
+        }
+        else
+        {
+            Slot=Bench_Find_Slot(Mem_Addr);
+            if(Slot<0)
+                continue;
+            if(Operation==MEM_TRACE_MFREE)
+                Bench_Addr[Slot]=0;
+        }
+
+        Bench_Op[Bench_Op_Num].Operation=Operation;
+        Bench_Op[Bench_Op_Num].Slot=Slot;
+        Bench_Op[Bench_Op_Num].Size=Bench_Read_Word(Record+16);
+        Bench_Op_Num++;
+    }
+
+    return 0;
+}
+/* End Function:Bench_Load_Trace *********************************************/
+
+/* Begin Function:Bench_Replay ************************************************
+Description : Replay the trace once on a fresh heap.
+Input       : u32 Stat - Whether to collect the statistics.
+Output      : cnt_t* Failed - The failed allocations.
+              u64* Asked - The sizes asked for.
+              u64* Given - The sizes of the blocks given.
+              cnt_t* Frag_Avg - The average fragmentation index.
+              cnt_t* Frag_Max - The worst fragmentation index.
+Return      : None.
+******************************************************************************/
+static void Bench_Replay(u32 Stat,cnt_t* Failed,u64* Asked,u64* Given,
+                         cnt_t* Frag_Avg,cnt_t* Frag_Max)
+{
+    cnt_t Count;
+    struct Bench_Op* Op;
+    void* Mem_Ptr;
+    size_t Proc_Mem;
+    u64 Frag_Sum;
+    cnt_t Frag;
+
+    _Sys_Mem_Init();
+    for(Count=0;Count<BENCH_MAX_LIVE;Count++)
+        Bench_Ptr[Count]=0;
+
+    Frag_Sum=0;
+    for(Count=0;Count<Bench_Op_Num;Count++)
+    {
+        Op=&Bench_Op[Count];
+        Proc_Mem=0;
+        if(Stat!=0)
+            Proc_Mem=Sys_Query_Proc_Mem(1);
+
+        if(Op->Operation==MEM_TRACE_MALLOC)
+        {
+            Mem_Ptr=_Sys_Malloc(1,Op->Size);
+            Bench_Ptr[Op->Slot]=Mem_Ptr;
+        }
+        else if(Bench_Ptr[Op->Slot]==0)
+            continue;
+        else if(Op->Operation==MEM_TRACE_MFREE)
+        {
+            _Sys_Mfree(1,Bench_Ptr[Op->Slot]);
+            Bench_Ptr[Op->Slot]=0;
+            Mem_Ptr=0;
+        }
+        else
+        {
+            Mem_Ptr=_Sys_Realloc(1,Bench_Ptr[Op->Slot],Op->Size);
+            if(Mem_Ptr!=0)
+                Bench_Ptr[Op->Slot]=Mem_Ptr;
+        }
+
+        if(Stat==0)
+            continue;
+
+        if(Op->Operation!=MEM_TRACE_MFREE)
+        {
+            if(Mem_Ptr==0)
+                (*Failed)++;
+            else if(Op->Operation==MEM_TRACE_MALLOC)
+            {
+                *Asked+=Op->Size;
+                *Given+=Sys_Query_Proc_Mem(1)-Proc_Mem;
+            }
+        }
+
+        Frag=Sys_Query_Mem_Frag();
+        Frag_Sum+=Frag;
+        if(Frag>*Frag_Max)
+            *Frag_Max=Frag;
+    }
+
+    if(Stat!=0)
+        *Frag_Avg=(cnt_t)(Frag_Sum/Bench_Op_Num);
+}
+/* End Function:Bench_Replay *************************************************/
+
+/* Begin Function:main ********************************************************
+Description : The entry of the benchmark.
+Input       : int argc - The number of arguments.
+              char* argv[] - The arguments: the dump file and "Mem_Trace_Cnt".
+Output      : None.
+Return      : int - 0 if successful.
+******************************************************************************/
+int main(int argc,char* argv[])
+{
+    cnt_t Failed;
+    u64 Asked;
+    u64 Given;
+    cnt_t Frag_Avg;
+    cnt_t Frag_Max;
+    cnt_t Count;
+    u64 Start_Time;
+    u64 Total_Time;
+    u32 Trace_Cnt;
+    char* Arg_Ptr;
+
+    PCB[1].Status.Running_Status=OCCUPY;
+
+    if(argc>2)
+    {
+        Trace_Cnt=0;
+        for(Arg_Ptr=argv[2];(*Arg_Ptr>='0')&&(*Arg_Ptr<='9');Arg_Ptr++)
+            Trace_Cnt=Trace_Cnt*10+(*Arg_Ptr-'0');
+        if(Bench_Load_Trace(argv[1],Trace_Cnt)!=0)
+        {
+            Host_Print("Cannot load the trace %s.\n",argv[1]);
+            return -1;
+        }
+    }
+    else
+        Bench_Gen_Trace();
+
+    if(Bench_Op_Num==0)
+    {
+        Host_Print("The trace is empty.\n");
+        return -1;
+    }
+
+    Failed=0;
+    Asked=0;
+    Given=0;
+    Frag_Avg=0;
+    Frag_Max=0;
+    Bench_Replay(1,&Failed,&Asked,&Given,&Frag_Avg,&Frag_Max);
+
+    Total_Time=0;
+    for(Count=0;Count<BENCH_REPEAT;Count++)
+    {
+        Start_Time=Host_Time_NS();
+        Bench_Replay(0,0,0,0,0,0);
+        Total_Time+=Host_Time_NS()-Start_Time;
+    }
+
+    Host_Print("SLI %2d min block %4d FLI %2d: %6d ops %5lu ns/op  failed %5d  "
+               "rounding %3lu%%  peak %5d  frag avg %3d%% max %3d%%\n",
+               MM_SLI,MM_MIN_BLOCK,MM_FLI,(int)Bench_Op_Num,
+               (unsigned long)(Total_Time/((u64)Bench_Op_Num*BENCH_REPEAT)),(int)Failed,
+               (unsigned long)((Asked==0)?0:((Given-Asked)*100/Asked)),
+               (int)Sys_Query_Peak_Used_Mem(),(int)Frag_Avg,(int)Frag_Max);
+    return 0;
+}
+/* End Function:main *********************************************************/
+
+/* End Of File ***************************************************************/
+
+/* Copyright (C) 2011-2013 Evo-Devo Instrum. All rights reserved *************/
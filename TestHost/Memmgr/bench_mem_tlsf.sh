@@ -0,0 +1,29 @@
+#!/bin/sh
+# Filename    : bench_mem_tlsf.sh
+# Author      : pry
+# Date        : 19/10/2013
+# Description : Build and run the TLSF benchmark for each "MM_SLI" and
+#               "MM_MIN_ORDER", one line each.
+#                   TestHost/Memmgr/bench_mem_tlsf.sh [<Dump file> <Mem_Trace_Cnt>]
+#               The settings where a second level is smaller than the minimum
+#               block are left out, and "MM_FLI" is made just big enough for the
+#               8kB heap of "MP_config.h". Set "DMEM_ORDER" for other heaps.
+
+set -e
+
+ROOT=$(cd "$(dirname "$0")/../.." && pwd)
+DMEM_ORDER=${DMEM_ORDER:-13}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+for SLI_ORDER in 2 3 4 5; do
+    for ORDER in 3 4 5 6; do
+        if [ $ORDER -lt $SLI_ORDER ]; then
+            continue
+        fi
+        FLI=$((DMEM_ORDER+1-ORDER))
+        CFLAGS="$CFLAGS -DDMEM_SIZE=$((1<<DMEM_ORDER)) -DMM_SLI=$((1<<SLI_ORDER)) -DMM_MIN_ORDER=$ORDER -DMM_FLI=$FLI" \
+            "$ROOT/TestHost/host_build.sh" "$OUT/bench" "$ROOT/TestHost/Memmgr/bench_mem_tlsf.c" "$ROOT/Memmgr/memory.c" || exit 1
+        "$OUT/bench" "$@"
+    done
+done
@@ -0,0 +1,415 @@
+/******************************************************************************
+Filename    : mem_trace_decode.c
+Author      : pry
+Date        : 19/10/2013
+Version     : 0.01
+Description : The host-side decoder of the memory trace ring buffer(Needs
+              "ENABLE_MEM_TRACE"). Dump the "Mem_Trace_Buf" array with the
+              debugger as a raw binary file, note down "Mem_Trace_Cnt", and run
+                  mem_trace_decode <Dump file> <Mem_Trace_Cnt> [Systick frequency]
+              The records are 6 little-endian 32-bit words each, as "struct
+              Mem_Trace" is laid out on the Cortex-M3. The decoder replays the
+              records from the oldest one and prints:
+              (1) The allocations still alive at the end of the window, by the
+                  call site(the caller address), and the allocation rate and the
+                  failed allocations of each call site;
+              (2) The lifetime histogram of the allocations freed in the window,
+                  in ticks, by the powers of 2.
+              Use "addr2line" or the map file to find the functions of the call
+              sites. The allocations made before the window are not known, so
+              the frees of them are only counted.
+              Build it with any host C compiler: cc -o mem_trace_decode mem_trace_decode.c
+******************************************************************************/
+
+/* Includes ******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+/* End Includes **************************************************************/
+
+/* Defines *******************************************************************/
+/* These are the same as "memory.h" */
+#define MEM_TRACE_MALLOC            0x00
+#define MEM_TRACE_MFREE             0x01
+#define MEM_TRACE_REALLOC           0x02
+/* The size of one record in the dump */
+#define TRACE_RECORD_SIZE           (6*4)
+/* The number of buckets in the lifetime histogram: <1, 1, 2-3, 4-7, ... ticks */
+#define LIFETIME_BUCKETS            33
+/* End Defines ***************************************************************/
+
+/* Structs *******************************************************************/
+/* A record, as "struct Mem_Trace" */
+struct Trace_Record
+{
+    unsigned long Timestamp;
+    unsigned long Operation;
+    unsigned long PID;
+    unsigned long Caller_Addr;
+    unsigned long Size;
+    unsigned long Mem_Addr;
+};
+
+/* An allocation that is alive */
+struct Live_Alloc
+{
+    unsigned long Mem_Addr;
+    unsigned long Caller_Addr;
+    unsigned long Size;
+    unsigned long Timestamp;
+};
+
+/* The statistics of a call site */
+struct Call_Site
+{
+    unsigned long Caller_Addr;
+    unsigned long Alloc_Cnt;
+    unsigned long Failed_Cnt;
+    unsigned long Live_Cnt;
+    unsigned long Live_Size;
+};
+/* End Structs ***************************************************************/
+
+/* Global Variables **********************************************************/
+static struct Trace_Record* Record;
+static unsigned long Record_Num;
+static struct Live_Alloc* Live;
+static unsigned long Live_Num;
+static struct Call_Site* Site;
+static unsigned long Site_Num;
+static unsigned long Lifetime_Hist[LIFETIME_BUCKETS];
+static unsigned long Unknown_Free_Cnt;
+/* End Global Variables ******************************************************/
+
+/* Begin Function:Read_Word ***************************************************
+Description : Read a little-endian 32-bit word.
+Input       : const unsigned char* Buf - The bytes.
+Output      : None.
+Return      : unsigned long - The word.
+******************************************************************************/
+static unsigned long Read_Word(const unsigned char* Buf)
+{
+    return ((unsigned long)Buf[0])|(((unsigned long)Buf[1])<<8)|
+           (((unsigned long)Buf[2])<<16)|(((unsigned long)Buf[3])<<24);
+}
+/* End Function:Read_Word ****************************************************/
+
+/* Begin Function:Load_Dump ***************************************************
+Description : Load the dump of the ring buffer, and put the records in the order
+              that they are recorded.
+Input       : const char* Path - The dump file.
+              unsigned long Trace_Cnt - The "Mem_Trace_Cnt" when it was dumped.
+Output      : None.
+Return      : int - If successful, 0; else -1.
+******************************************************************************/
+static int Load_Dump(const char* Path,unsigned long Trace_Cnt)
+{
+    FILE* File;
+    long File_Size;
+    unsigned long Depth;
+    unsigned long Start;
+    unsigned long Count;
+    unsigned char* Buf;
+    unsigned char* Ptr;
+
+    File=fopen(Path,"rb");
+    if(File==0)
+        return -1;
+
+    fseek(File,0,SEEK_END);
+    File_Size=ftell(File);
+    fseek(File,0,SEEK_SET);
+
+    /* The depth is a power of 2 */
+    Depth=(unsigned long)File_Size/TRACE_RECORD_SIZE;
+    if((Depth==0)||((Depth&(Depth-1))!=0))
+    {
+        fclose(File);
+        return -1;
+    }
+
+    Buf=malloc(Depth*TRACE_RECORD_SIZE);
+    if(fread(Buf,TRACE_RECORD_SIZE,Depth,File)!=Depth)
+    {
+        free(Buf);
+        fclose(File);
+        return -1;
+    }
+    fclose(File);
+
+    /* Only the last "Depth" records are kept, and the oldest is where the next
+     * one will be put. Before the buffer is full, the records start from 0.
+     */
+    Trace_Cnt&=0xFFFFFFFFUL;
+    if(Trace_Cnt<Depth)
+    {
+        Record_Num=Trace_Cnt;
+        Start=0;
+    }
+    else
+    {
+        Record_Num=Depth;
+        Start=Trace_Cnt&(Depth-1);
+    }
+
+    Record=malloc((Record_Num+1)*sizeof(struct Trace_Record));
+    for(Count=0;Count<Record_Num;Count++)
+    {
+        Ptr=Buf+((Start+Count)&(Depth-1))*TRACE_RECORD_SIZE;
+        Record[Count].Timestamp=Read_Word(Ptr);
+        Record[Count].Operation=Read_Word(Ptr+4);
+        Record[Count].PID=Read_Word(Ptr+8);
+        Record[Count].Caller_Addr=Read_Word(Ptr+12);
+        Record[Count].Size=Read_Word(Ptr+16);
+        Record[Count].Mem_Addr=Read_Word(Ptr+20);
+    }
+
+    free(Buf);
+    return 0;
+}
+/* End Function:Load_Dump ****************************************************/
+
+/* Begin Function:Get_Site ****************************************************
+Description : Find the statistics of a call site, and add it if it is not there.
+Input       : unsigned long Caller_Addr - The caller address.
+Output      : None.
+Return      : struct Call_Site* - The statistics.
+******************************************************************************/
+static struct Call_Site* Get_Site(unsigned long Caller_Addr)
+{
+    unsigned long Count;
+
+    for(Count=0;Count<Site_Num;Count++)
+    {
+        if(Site[Count].Caller_Addr==Caller_Addr)
+            return &Site[Count];
+    }
+
+    Site[Site_Num].Caller_Addr=Caller_Addr;
+    Site[Site_Num].Alloc_Cnt=0;
+    Site[Site_Num].Failed_Cnt=0;
+    Site[Site_Num].Live_Cnt=0;
+    Site[Site_Num].Live_Size=0;
+    return &Site[Site_Num++];
+}
+/* End Function:Get_Site *****************************************************/
+
+/* Begin Function:Find_Live ***************************************************
+Description : Find a live allocation by its address.
+Input       : unsigned long Mem_Addr - The memory address.
+Output      : None.
+Return      : long - The position in the live table. If not found, -1.
+******************************************************************************/
+static long Find_Live(unsigned long Mem_Addr)
+{
+    unsigned long Count;
+
+    for(Count=0;Count<Live_Num;Count++)
+    {
+        if(Live[Count].Mem_Addr==Mem_Addr)
+            return (long)Count;
+    }
+
+    return -1;
+}
+/* End Function:Find_Live ****************************************************/
+
+/* Begin Function:Lifetime_Bucket *********************************************
+Description : Get the histogram bucket of a lifetime. Bucket 0 is less than one
+              tick, and bucket N is 2^(N-1) to 2^N-1 ticks.
+Input       : unsigned long Ticks - The lifetime.
+Output      : None.
+Return      : int - The bucket.
+******************************************************************************/
+static int Lifetime_Bucket(unsigned long Ticks)
+{
+    int Bucket=0;
+
+    while(Ticks!=0)
+    {
+        Bucket++;
+        Ticks>>=1;
+    }
+
+    return Bucket;
+}
+/* End Function:Lifetime_Bucket **********************************************/
+
+/* Begin Function:Replay ******************************************************
+Description : Replay the records to get the live allocations, the call site
+              statistics and the lifetime histogram.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Replay(void)
+{
+    unsigned long Count;
+    long Pos;
+    struct Trace_Record* Rec;
+    struct Call_Site* Site_Ptr;
+
+    /* There can't be more live allocations or call sites than the records */
+    Live=malloc((Record_Num+1)*sizeof(struct Live_Alloc));
+    Site=malloc((Record_Num+1)*sizeof(struct Call_Site));
+
+    for(Count=0;Count<Record_Num;Count++)
+    {
+        Rec=&Record[Count];
+        switch(Rec->Operation)
+        {
+            case MEM_TRACE_MALLOC:
+            {
+                Site_Ptr=Get_Site(Rec->Caller_Addr);
+                Site_Ptr->Alloc_Cnt++;
+                if(Rec->Mem_Addr==0)
+                {
+                    Site_Ptr->Failed_Cnt++;
+                    break;
+                }
+                Live[Live_Num].Mem_Addr=Rec->Mem_Addr;
+                Live[Live_Num].Caller_Addr=Rec->Caller_Addr;
+                Live[Live_Num].Size=Rec->Size;
+                Live[Live_Num].Timestamp=Rec->Timestamp;
+                Live_Num++;
+                break;
+            }
+            case MEM_TRACE_MFREE:
+            {
+                Pos=Find_Live(Rec->Mem_Addr);
+                if(Pos<0)
+                {
+                    Unknown_Free_Cnt++;
+                    break;
+                }
+                /* The timestamps are the low bits of the ticks, so they wrap around */
+                Lifetime_Hist[Lifetime_Bucket((Rec->Timestamp-Live[Pos].Timestamp)&0xFFFFFFFFUL)]++;
+                Live[Pos]=Live[--Live_Num];
+                break;
+            }
+            case MEM_TRACE_REALLOC:
+            {
+                /* Only the in-place ones are recorded like this. The moved ones are
+                 * recorded as an allocation and a free.
+                 */
+                Pos=Find_Live(Rec->Mem_Addr);
+                if(Pos>=0)
+                    Live[Pos].Size=Rec->Size;
+                break;
+            }
+            default:break;
+        }
+    }
+
+    for(Count=0;Count<Live_Num;Count++)
+    {
+        Site_Ptr=Get_Site(Live[Count].Caller_Addr);
+        Site_Ptr->Live_Cnt++;
+        Site_Ptr->Live_Size+=Live[Count].Size;
+    }
+}
+/* End Function:Replay *******************************************************/
+
+/* Begin Function:Compare_Site ************************************************
+Description : Sort the call sites by the live size, the biggest first.
+Input       : const void* Left - The left one.
+              const void* Right - The right one.
+Output      : None.
+Return      : int - The order.
+******************************************************************************/
+static int Compare_Site(const void* Left,const void* Right)
+{
+    const struct Call_Site* Left_Site=Left;
+    const struct Call_Site* Right_Site=Right;
+
+    if(Left_Site->Live_Size!=Right_Site->Live_Size)
+        return (Left_Site->Live_Size<Right_Site->Live_Size)?1:-1;
+    if(Left_Site->Alloc_Cnt!=Right_Site->Alloc_Cnt)
+        return (Left_Site->Alloc_Cnt<Right_Site->Alloc_Cnt)?1:-1;
+    return 0;
+}
+/* End Function:Compare_Site *************************************************/
+
+/* Begin Function:Print_Report ************************************************
+Description : Print the call site table and the lifetime histogram.
+Input       : unsigned long Tick_Freq - The systick frequency, in Hz.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Print_Report(unsigned long Tick_Freq)
+{
+    unsigned long Count;
+    unsigned long Window;
+    double Seconds;
+
+    if(Record_Num==0)
+    {
+        printf("No records.\n");
+        return;
+    }
+
+    Window=(Record[Record_Num-1].Timestamp-Record[0].Timestamp)&0xFFFFFFFFUL;
+    /* At least one tick, or the rates can't be told */
+    Seconds=((double)((Window==0)?1:Window))/Tick_Freq;
+    printf("Records: %lu, window: %lu ticks(%.3f s), live: %lu, frees of older allocations: %lu\n\n",
+           Record_Num,Window,Seconds,Live_Num,Unknown_Free_Cnt);
+
+    qsort(Site,Site_Num,sizeof(struct Call_Site),Compare_Site);
+    printf("Caller      Allocs     Rate(/s)   Failed     Live       Live bytes\n");
+    for(Count=0;Count<Site_Num;Count++)
+    {
+        printf("0x%08lX  %-10lu %-10.1f %-10lu %-10lu %lu\n",Site[Count].Caller_Addr,
+               Site[Count].Alloc_Cnt,Site[Count].Alloc_Cnt/Seconds,Site[Count].Failed_Cnt,
+               Site[Count].Live_Cnt,Site[Count].Live_Size);
+    }
+
+    printf("\nLifetime(ticks)         Frees\n");
+    for(Count=0;Count<LIFETIME_BUCKETS;Count++)
+    {
+        if(Lifetime_Hist[Count]==0)
+            continue;
+        if(Count==0)
+            printf("0                       %lu\n",Lifetime_Hist[Count]);
+        else
+            printf("%-10lu-%-10lu   %lu\n",1UL<<(Count-1),(1UL<<(Count-1))*2-1,Lifetime_Hist[Count]);
+    }
+}
+/* End Function:Print_Report *************************************************/
+
+/* Begin Function:main ********************************************************
+Description : The entry of the decoder.
+Input       : int argc - The number of arguments.
+              char* argv[] - The dump file, the "Mem_Trace_Cnt", and the systick
+                             frequency(1000 if not given).
+Output      : None.
+Return      : int - If successful, 0; else 1.
+******************************************************************************/
+int main(int argc,char* argv[])
+{
+    unsigned long Tick_Freq=1000;
+
+    if((argc<3)||(argc>4))
+    {
+        printf("Usage: %s <Dump file> <Mem_Trace_Cnt> [Systick frequency]\n",argv[0]);
+        return 1;
+    }
+
+    if(argc==4)
+        Tick_Freq=strtoul(argv[3],0,0);
+    if(Tick_Freq==0)
+        Tick_Freq=1000;
+
+    if(Load_Dump(argv[1],strtoul(argv[2],0,0))!=0)
+    {
+        printf("The dump is not a power-of-2 number of records.\n");
+        return 1;
+    }
+
+    Replay();
+    Print_Report(Tick_Freq);
+    return 0;
+}
+/* End Function:main *********************************************************/
+
+/* End Of File ***************************************************************/
+
+/* Copyright (C) 2011-2013 Evo-Devo Instrum. All rights reserved *************/
@@ -0,0 +1,240 @@
+/******************************************************************************
+Filename    : test_mem_arena.c
+Author      : pry
+Date        : 19/10/2013
+Version     : 0.01
+Description : The host-side test of the memory arenas.
+              (1) The allocations are 8-byte aligned, rounded up to a multiple of 8,
+                  and follow each other in the arena.
+              (2) The reset gives all the memory of the arena back.
+              (3) The allocations fail when the arena is used up, and the sizes 
+                  near the top of "size_t" fail instead of wrapping around.
+              (4) A process can't use the arena of another process, and a block
+                  or an address that is not an arena is not used as one.
+              Build and run it on a POSIX host:
+                  TestHost/host_build.sh test_mem_arena TestHost/Memmgr/test_mem_arena.c Memmgr/memory.c
+                  ./test_mem_arena
+******************************************************************************/
+
+/* Includes ******************************************************************/
+#include "Config\MP_config.h"
+#include "Platform\MP_platform.h"
+
+/* Definition includes */
+#define __HDR_DEFS__
+#include "Kernel\scheduler.h"
+#include "Memmgr\memory.h"
+#undef __HDR_DEFS__
+
+/* Structure includes */
+#define __HDR_STRUCTS__
+#include "Syslib\syslib.h"
+#include "Kernel\scheduler.h"
+#include "Memmgr\memory.h"
+#undef __HDR_STRUCTS__
+
+/* Public includes */
+#define __HDR_PUBLIC_MEMBERS__
+#include "Kernel\scheduler.h"
+#include "Syslib\syslib.h"
+#include "Memmgr\memory.h"
+#undef __HDR_PUBLIC_MEMBERS__
+/* End Includes **************************************************************/
+
+/* Defines *******************************************************************/
+/* The owner of the arenas, and the other process */
+#define TEST_OWNER                  1
+#define TEST_OTHER                  2
+/* The size of the arena */
+#define TEST_ARENA_SIZE             256
+/* The biggest "size_t" */
+#define TEST_SIZE_MAX               ((size_t)(-1))
+/* End Defines ***************************************************************/
+
+/* Global Variables **********************************************************/
+/* An address out of the heap */
+static struct Mem_Arena Test_Fake_Arena;
+/* End Global Variables ******************************************************/
+
+/* Begin Function:Test_Alloc **************************************************
+Description : Allocate from an arena and check the alignment and the order.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Alloc(void)
+{
+    struct Mem_Arena* Arena_Ptr;
+    u8* Mem1_Ptr;
+    u8* Mem2_Ptr;
+    u8* Mem3_Ptr;
+
+    Current_PID=TEST_OWNER;
+    Arena_Ptr=Sys_Arena_Create(TEST_ARENA_SIZE);
+    HOST_CHECK(Arena_Ptr!=ENOMEM);
+    HOST_CHECK(Sys_Arena_Query_Free(Arena_Ptr)==TEST_ARENA_SIZE);
+
+    Mem1_Ptr=Sys_Arena_Alloc(Arena_Ptr,1);
+    Mem2_Ptr=Sys_Arena_Alloc(Arena_Ptr,10);
+    Mem3_Ptr=Sys_Arena_Alloc(Arena_Ptr,16);
+    HOST_CHECK((Mem1_Ptr!=ENOMEM)&&(Mem2_Ptr!=ENOMEM)&&(Mem3_Ptr!=ENOMEM));
+    HOST_CHECK((((ptr_int_t)Mem1_Ptr)&7)==0);
+    HOST_CHECK(Mem2_Ptr==Mem1_Ptr+8);
+    HOST_CHECK(Mem3_Ptr==Mem2_Ptr+16);
+    HOST_CHECK(Sys_Arena_Query_Free(Arena_Ptr)==TEST_ARENA_SIZE-40);
+
+    /* The memory is really there */
+    Sys_Memset((ptr_int_t)Mem1_Ptr,0x5A,40);
+    HOST_CHECK(Sys_Arena_Query_Free(Arena_Ptr)==TEST_ARENA_SIZE-40);
+
+    Sys_Arena_Destroy(Arena_Ptr);
+}
+/* End Function:Test_Alloc ***************************************************/
+
+/* Begin Function:Test_Reset **************************************************
+Description : Reset an arena and allocate from it again.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Reset(void)
+{
+    struct Mem_Arena* Arena_Ptr;
+    u8* Mem_Ptr;
+
+    Current_PID=TEST_OWNER;
+    Arena_Ptr=Sys_Arena_Create(TEST_ARENA_SIZE);
+    HOST_CHECK(Arena_Ptr!=ENOMEM);
+
+    Mem_Ptr=Sys_Arena_Alloc(Arena_Ptr,100);
+    HOST_CHECK(Mem_Ptr!=ENOMEM);
+    HOST_CHECK(Sys_Arena_Alloc(Arena_Ptr,100)!=ENOMEM);
+    HOST_CHECK(Sys_Arena_Query_Free(Arena_Ptr)==TEST_ARENA_SIZE-208);
+
+    Sys_Arena_Reset(Arena_Ptr);
+    HOST_CHECK(Sys_Arena_Query_Free(Arena_Ptr)==TEST_ARENA_SIZE);
+    HOST_CHECK(Sys_Arena_Alloc(Arena_Ptr,TEST_ARENA_SIZE)==Mem_Ptr);
+    HOST_CHECK(Sys_Arena_Query_Free(Arena_Ptr)==0);
+
+    Sys_Arena_Destroy(Arena_Ptr);
+}
+/* End Function:Test_Reset ***************************************************/
+
+/* Begin Function:Test_Exhaust ************************************************
+Description : Use up an arena, and ask for the sizes that can't be rounded up.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Exhaust(void)
+{
+    struct Mem_Arena* Arena_Ptr;
+
+    Current_PID=TEST_OWNER;
+    /* The arena can't be bigger than the heap, however big the size is */
+    HOST_CHECK(Sys_Arena_Create(TEST_SIZE_MAX)==ENOMEM);
+    HOST_CHECK(Sys_Arena_Create(TEST_SIZE_MAX-sizeof(struct Mem_Arena))==ENOMEM);
+
+    /* The size is not a multiple of 8, so the last bytes can't be allocated */
+    Arena_Ptr=Sys_Arena_Create(20);
+    HOST_CHECK(Arena_Ptr!=ENOMEM);
+    HOST_CHECK(Sys_Arena_Alloc(Arena_Ptr,16)!=ENOMEM);
+    HOST_CHECK(Sys_Arena_Query_Free(Arena_Ptr)==4);
+    HOST_CHECK(Sys_Arena_Alloc(Arena_Ptr,4)==ENOMEM);
+    HOST_CHECK(Sys_Arena_Alloc(Arena_Ptr,5)==ENOMEM);
+
+    /* These would be rounded up to 0 */
+    Sys_Arena_Reset(Arena_Ptr);
+    HOST_CHECK(Sys_Arena_Alloc(Arena_Ptr,TEST_SIZE_MAX)==ENOMEM);
+    HOST_CHECK(Sys_Arena_Alloc(Arena_Ptr,TEST_SIZE_MAX-3)==ENOMEM);
+    HOST_CHECK(Sys_Arena_Query_Free(Arena_Ptr)==20);
+
+    /* Use it up with the smallest allocations */
+    HOST_CHECK(Sys_Arena_Alloc(Arena_Ptr,1)!=ENOMEM);
+    HOST_CHECK(Sys_Arena_Alloc(Arena_Ptr,1)!=ENOMEM);
+    HOST_CHECK(Sys_Arena_Alloc(Arena_Ptr,1)==ENOMEM);
+    HOST_CHECK(Sys_Arena_Alloc(Arena_Ptr,0)!=ENOMEM);
+
+    Sys_Arena_Destroy(Arena_Ptr);
+}
+/* End Function:Test_Exhaust *************************************************/
+
+/* Begin Function:Test_Foreign ************************************************
+Description : Use an arena of another process, and the pointers that are not 
+              arenas.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Foreign(void)
+{
+    struct Mem_Arena* Arena_Ptr;
+    struct Mem_Arena* Block_Ptr;
+
+    Current_PID=TEST_OWNER;
+    Arena_Ptr=Sys_Arena_Create(TEST_ARENA_SIZE);
+    HOST_CHECK(Arena_Ptr!=ENOMEM);
+    HOST_CHECK(Sys_Arena_Alloc(Arena_Ptr,64)!=ENOMEM);
+
+    /* The other process can't allocate, reset or query */
+    Current_PID=TEST_OTHER;
+    HOST_CHECK(Sys_Arena_Alloc(Arena_Ptr,8)==ENOMEM);
+    Sys_Arena_Reset(Arena_Ptr);
+    HOST_CHECK(Sys_Arena_Query_Free(Arena_Ptr)==0);
+    Current_PID=TEST_OWNER;
+    HOST_CHECK(Sys_Arena_Query_Free(Arena_Ptr)==TEST_ARENA_SIZE-64);
+
+    /* A normal block, even if it looks like an arena header */
+    Block_Ptr=(struct Mem_Arena*)Sys_Malloc(TEST_ARENA_SIZE);
+    HOST_CHECK(Block_Ptr!=ENOMEM);
+    Block_Ptr->Arena_Start_Addr=(ptr_int_t)Block_Ptr;
+    Block_Ptr->Arena_End_Addr=TEST_SIZE_MAX;
+    Block_Ptr->Arena_Cur_Addr=(ptr_int_t)Block_Ptr;
+    HOST_CHECK(Sys_Arena_Alloc(Block_Ptr,8)==ENOMEM);
+    HOST_CHECK(Sys_Arena_Query_Free(Block_Ptr)==0);
+    Sys_Mfree(Block_Ptr);
+
+    /* The addresses out of the heap, and the arena already destroyed */
+    Test_Fake_Arena.Arena_Start_Addr=(ptr_int_t)(&Test_Fake_Arena+1);
+    Test_Fake_Arena.Arena_End_Addr=Test_Fake_Arena.Arena_Start_Addr+TEST_ARENA_SIZE-1;
+    Test_Fake_Arena.Arena_Cur_Addr=Test_Fake_Arena.Arena_Start_Addr;
+    HOST_CHECK(Sys_Arena_Alloc(&Test_Fake_Arena,8)==ENOMEM);
+    HOST_CHECK(Sys_Arena_Alloc(ENOMEM,8)==ENOMEM);
+    Sys_Arena_Reset(ENOMEM);
+    Sys_Arena_Destroy(Arena_Ptr);
+    HOST_CHECK(Sys_Arena_Alloc(Arena_Ptr,8)==ENOMEM);
+    Sys_Arena_Reset(Arena_Ptr);
+}
+/* End Function:Test_Foreign *************************************************/
+
+/* Begin Function:main ********************************************************
+Description : The entry of the test.
+Input       : None.
+Output      : None.
+Return      : int - 0 if successful.
+******************************************************************************/
+int main(void)
+{
+    size_t Free;
+
+    PCB[TEST_OWNER].Status.Running_Status=OCCUPY;
+    PCB[TEST_OTHER].Status.Running_Status=OCCUPY;
+    _Sys_Mem_Init();
+    Free=Sys_Query_Free_Mem();
+
+    Test_Alloc();
+    Test_Reset();
+    Test_Exhaust();
+    Test_Foreign();
+
+    /* Everything is given back */
+    HOST_CHECK(Sys_Query_Free_Mem()==Free);
+
+    Host_Print("OK\n");
+    return 0;
+}
+/* End Function:main *********************************************************/
+
+/* End Of File ***************************************************************/
+
+/* Copyright (C) 2011-2013 Evo-Devo Instrum. All rights reserved *************/
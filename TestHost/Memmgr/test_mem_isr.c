@@ -0,0 +1,476 @@
+/******************************************************************************
+Filename    : test_mem_isr.c
+Author      : pry
+Date        : 19/10/2013
+Version     : 0.01
+Description : The host-side test of freeing memory in the interrupt handlers.
+              (1) The deterministic part: the double frees through "Sys_Mfree_ISR"
+                  and "Sys_Mfree", the deferred frees pending when the owner is
+                  killed, and the transfer of the memory that is being freed.
+              (2) The stress part: the process allocates and frees for two PIDs
+                  while a simulated interrupt frees the same blocks with
+                  "Sys_Mfree_ISR", twice each, and uses the interrupt reserve.
+                  Each block is filled with its own tag and checked before it is
+                  freed, so the blocks given out twice are found; at last the
+                  heap must be the same as at the beginning.
+              Build and run it on a POSIX host:
+                  TestHost/host_build.sh test_mem_isr TestHost/Memmgr/test_mem_isr.c Memmgr/memory.c
+                  ./test_mem_isr [Seconds]
+******************************************************************************/
+
+/* Includes ******************************************************************/
+#include "Config\MP_config.h"
+#include "Platform\MP_platform.h"
+
+/* Definition includes */
+#define __HDR_DEFS__
+#include "Kernel\scheduler.h"
+#include "Memmgr\memory.h"
+#undef __HDR_DEFS__
+
+/* Structure includes */
+#define __HDR_STRUCTS__
+#include "Syslib\syslib.h"
+#include "Kernel\scheduler.h"
+#include "Memmgr\memory.h"
+#undef __HDR_STRUCTS__
+
+/* Public includes */
+#define __HDR_PUBLIC_MEMBERS__
+#include "Kernel\scheduler.h"
+#include "Kernel\interrupt.h"
+#include "Syslib\syslib.h"
+#include "Memmgr\memory.h"
+#undef __HDR_PUBLIC_MEMBERS__
+/* End Includes **************************************************************/
+
+/* Defines *******************************************************************/
+/* The blocks shared by the process and the interrupt */
+#define TEST_SLOTS                  32
+/* The interrupt reserve blocks held by the interrupt; more than the reserve */
+#define TEST_ISR_SLOTS              (MEM_ISR_BLOCKS*2)
+/* The biggest block that the process allocates */
+#define TEST_MAX_SIZE               200
+/* The period of the simulated interrupt in microseconds */
+#define TEST_INT_PERIOD             20
+/* End Defines ***************************************************************/
+
+/* Global Variables **********************************************************/
+/* The blocks published to the interrupt, and their owners, sizes and tags */
+static void* volatile Slot[TEST_SLOTS];
+static pid_t Slot_PID[TEST_SLOTS];
+static size_t Slot_Size[TEST_SLOTS];
+static u8 Slot_Tag[TEST_SLOTS];
+/* The interrupt reserve blocks that the interrupt holds */
+static void* ISR_Slot[TEST_ISR_SLOTS];
+static u8 ISR_Slot_Tag[TEST_ISR_SLOTS];
+/* The statistics of the interrupt */
+static volatile cnt_t Int_Cnt;
+static volatile cnt_t Int_Free_Cnt;
+static volatile cnt_t Int_Reserve_Fail_Cnt;
+static volatile cnt_t Int_Error_Cnt;
+static u32 Int_Rand_Seed=1;
+static u32 Proc_Rand_Seed=7;
+/* End Global Variables ******************************************************/
+
+/* Begin Function:Test_Rand ***************************************************
+Description : A small random number generator.
+Input       : u32* Seed - The state.
+Output      : u32* Seed - The new state.
+Return      : u32 - The random number, 15 bits.
+******************************************************************************/
+static u32 Test_Rand(u32* Seed)
+{
+    *Seed=(*Seed)*1103515245+12345;
+    return ((*Seed)>>16)&0x7FFF;
+}
+/* End Function:Test_Rand ****************************************************/
+
+/* Begin Function:Test_Fill ***************************************************
+Description : Fill a block with its tag.
+Input       : void* Mem_Ptr - The block.
+              size_t Size - The size.
+              u8 Tag - The tag.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Fill(void* Mem_Ptr,size_t Size,u8 Tag)
+{
+    Sys_Memset((ptr_int_t)Mem_Ptr,Tag,Size);
+}
+/* End Function:Test_Fill ****************************************************/
+
+/* Begin Function:Test_Check ***************************************************
+Description : Check the tag of a block. The first word may have been used by the
+              deferred free list, so it is not checked.
+Input       : void* Mem_Ptr - The block.
+              size_t Size - The size.
+              u8 Tag - The tag.
+Output      : None.
+Return      : retval_t - If the tag is intact, 0; else -1.
+******************************************************************************/
+static retval_t Test_Check(void* Mem_Ptr,size_t Size,u8 Tag)
+{
+    size_t Count;
+
+    for(Count=sizeof(ptr_int_t);Count<Size;Count++)
+    {
+        if(((u8*)Mem_Ptr)[Count]!=Tag)
+            return -1;
+    }
+    return 0;
+}
+/* End Function:Test_Check ***************************************************/
+
+/* Begin Function:Test_Int_Handler ********************************************
+Description : The simulated interrupt. It frees a published block twice, and
+              allocates or frees an interrupt reserve block.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Int_Handler(void)
+{
+    cnt_t Count;
+    void* Mem_Ptr;
+
+    Int_Cnt++;
+
+    Count=Test_Rand(&Int_Rand_Seed)%TEST_SLOTS;
+    Mem_Ptr=Slot[Count];
+    if(Mem_Ptr!=0)
+    {
+        /* The process may have freed it already, but it cannot be allocated
+         * again before the process takes it out of the slot. Check the last
+         * byte only, for the freed block may be a part of a bigger one now.
+         */
+        if(((u8*)Mem_Ptr)[Slot_Size[Count]-1]!=Slot_Tag[Count])
+            Int_Error_Cnt++;
+        Sys_Mfree_ISR(Mem_Ptr);
+        /* The second time must be ignored */
+        Sys_Mfree_ISR(Mem_Ptr);
+        Slot[Count]=0;
+        Int_Free_Cnt++;
+    }
+
+    Count=Test_Rand(&Int_Rand_Seed)%TEST_ISR_SLOTS;
+    if(ISR_Slot[Count]!=0)
+    {
+        if(Test_Check(ISR_Slot[Count],MEM_ISR_BLOCK_SIZE,ISR_Slot_Tag[Count])!=0)
+            Int_Error_Cnt++;
+        Sys_Mfree_ISR(ISR_Slot[Count]);
+        ISR_Slot[Count]=0;
+    }
+    else
+    {
+        ISR_Slot[Count]=Sys_Malloc_ISR(Test_Rand(&Int_Rand_Seed)%(MEM_ISR_BLOCK_SIZE+1));
+        if(ISR_Slot[Count]==0)
+            Int_Reserve_Fail_Cnt++;
+        else
+        {
+            ISR_Slot_Tag[Count]=(u8)(Int_Cnt+Count);
+            Test_Fill(ISR_Slot[Count],MEM_ISR_BLOCK_SIZE,ISR_Slot_Tag[Count]);
+        }
+    }
+}
+/* End Function:Test_Int_Handler *********************************************/
+
+/* Begin Function:Test_Check_Reserve ******************************************
+Description : Check that all the interrupt reserve blocks are free.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Check_Reserve(void)
+{
+    void* Reserve[MEM_ISR_BLOCKS];
+    cnt_t Count;
+
+    for(Count=0;Count<MEM_ISR_BLOCKS;Count++)
+    {
+        Reserve[Count]=Sys_Malloc_ISR(MEM_ISR_BLOCK_SIZE);
+        HOST_CHECK(Reserve[Count]!=0);
+    }
+    HOST_CHECK(Sys_Malloc_ISR(1)==0);
+
+    for(Count=0;Count<MEM_ISR_BLOCKS;Count++)
+        Sys_Mfree_ISR(Reserve[Count]);
+}
+/* End Function:Test_Check_Reserve *******************************************/
+
+/* Begin Function:Test_Double_Free ********************************************
+Description : A block freed twice by an interrupt handler, and then by the owner,
+              is freed once.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Double_Free(void)
+{
+    void* Mem_Ptr;
+    size_t Used;
+
+    Used=Sys_Query_Used_Memory();
+    Mem_Ptr=_Sys_Malloc(1,64);
+    HOST_CHECK(Mem_Ptr!=0);
+
+    Sys_Enter_Int_Handler();
+    Sys_Mfree_ISR(Mem_Ptr);
+    Sys_Mfree_ISR(Mem_Ptr);
+    Sys_Exit_Int_Handler();
+
+    /* Not freed yet; the owner cannot free it again, and the deferred free
+     * happens when "_Sys_Mfree" unlocks the scheduler.
+     */
+    HOST_CHECK(Sys_Query_Proc_Mem(1)!=0);
+    _Sys_Mfree(1,Mem_Ptr);
+    HOST_CHECK(Sys_Query_Proc_Mem(1)==0);
+    HOST_CHECK(Sys_Query_Used_Memory()==Used);
+
+    /* Freeing it again now is ignored as well */
+    Sys_Enter_Int_Handler();
+    Sys_Mfree_ISR(Mem_Ptr);
+    Sys_Exit_Int_Handler();
+    _Sys_Mfree(1,Mem_Ptr);
+    HOST_CHECK(Sys_Query_Used_Memory()==Used);
+    HOST_CHECK(Sys_Query_Mem_Frag()==0);
+}
+/* End Function:Test_Double_Free *********************************************/
+
+/* Begin Function:Test_Free_All ***********************************************
+Description : The deferred frees of a process that is killed before they happen
+              must not free the blocks again when they are allocated to others.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Free_All(void)
+{
+    void* Mem_Ptr[4];
+    void* New_Ptr[4];
+    void* Guard_Ptr;
+    size_t Guard_Size;
+    size_t Proc_Mem;
+    size_t Used;
+    cnt_t Count;
+
+    Used=Sys_Query_Used_Memory();
+    for(Count=0;Count<4;Count++)
+    {
+        Mem_Ptr[Count]=_Sys_Malloc(2,48);
+        HOST_CHECK(Mem_Ptr[Count]!=0);
+    }
+    Guard_Ptr=_Sys_Malloc(1,48);
+    HOST_CHECK(Guard_Ptr!=0);
+    Guard_Size=Sys_Query_Proc_Mem(1);
+
+    Sys_Lock_Scheduler();
+
+    Sys_Enter_Int_Handler();
+    Sys_Mfree_ISR(Mem_Ptr[0]);
+    Sys_Mfree_ISR(Guard_Ptr);
+    Sys_Mfree_ISR(Mem_Ptr[2]);
+    Sys_Exit_Int_Handler();
+
+    /* Kill PID 2, and give its blocks to PID 1 at once */
+    _Sys_Mfree_All(2);
+    HOST_CHECK(Sys_Query_Proc_Mem(2)==0);
+    for(Count=0;Count<4;Count++)
+    {
+        New_Ptr[Count]=_Sys_Malloc(1,48);
+        HOST_CHECK(New_Ptr[Count]!=0);
+        Test_Fill(New_Ptr[Count],48,(u8)(0xA0+Count));
+    }
+
+    Proc_Mem=Sys_Query_Proc_Mem(1);
+
+    /* Now the deferred frees happen. Only the guard block goes */
+    Sys_Unlock_Scheduler();
+
+    HOST_CHECK(Sys_Query_Proc_Mem(1)==Proc_Mem-Guard_Size);
+    for(Count=0;Count<4;Count++)
+    {
+        HOST_CHECK(Test_Check(New_Ptr[Count],48,(u8)(0xA0+Count))==0);
+        _Sys_Mfree(1,New_Ptr[Count]);
+    }
+    HOST_CHECK(Sys_Query_Used_Memory()==Used);
+    HOST_CHECK(Sys_Query_Mem_Frag()==0);
+}
+/* End Function:Test_Free_All ************************************************/
+
+/* Begin Function:Test_Transfer ***********************************************
+Description : The memory that is being freed by an interrupt handler, and the
+              interrupt reserve blocks, cannot be transferred.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Transfer(void)
+{
+    void* Mem_Ptr;
+    size_t Used;
+
+    Used=Sys_Query_Used_Memory();
+    Mem_Ptr=_Sys_Malloc(1,32);
+    HOST_CHECK(Mem_Ptr!=0);
+
+    Sys_Lock_Scheduler();
+    Sys_Enter_Int_Handler();
+    Sys_Mfree_ISR(Mem_Ptr);
+    Sys_Exit_Int_Handler();
+    HOST_CHECK(_Sys_Mem_Transfer(1,Mem_Ptr,2)==-1);
+    Sys_Unlock_Scheduler();
+
+    HOST_CHECK(Sys_Query_Proc_Mem(1)==0);
+    HOST_CHECK(Sys_Query_Proc_Mem(2)==0);
+    HOST_CHECK(Sys_Query_Used_Memory()==Used);
+
+    Mem_Ptr=Sys_Malloc_ISR(16);
+    HOST_CHECK(Mem_Ptr!=0);
+    HOST_CHECK(_Sys_Mem_Transfer(1,Mem_Ptr,2)==-1);
+    Sys_Mfree_ISR(Mem_Ptr);
+    Test_Check_Reserve();
+}
+/* End Function:Test_Transfer ************************************************/
+
+/* Begin Function:Test_Stress *************************************************
+Description : The process and the interrupt free the same blocks at random.
+Input       : u32 Seconds - How long to run.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Test_Stress(u32 Seconds)
+{
+    u64 End_Time;
+    cnt_t Count;
+    cnt_t Round;
+    cnt_t Proc_Free_Cnt;
+    cnt_t Fail_Cnt;
+    void* Mem_Ptr;
+    u8 Tag;
+
+    Proc_Free_Cnt=0;
+    Fail_Cnt=0;
+    Tag=0;
+    End_Time=Host_Time_NS()+((u64)Seconds)*1000000000ULL;
+    Host_Start_Int(Test_Int_Handler,TEST_INT_PERIOD);
+
+    for(Round=0;Host_Time_NS()<End_Time;Round++)
+    {
+        Count=Test_Rand(&Proc_Rand_Seed)%TEST_SLOTS;
+
+        Sys_Lock_Interrupt();
+        Mem_Ptr=Slot[Count];
+        Sys_Unlock_Interrupt();
+
+        if(Mem_Ptr==0)
+        {
+            Slot_PID[Count]=1+(Test_Rand(&Proc_Rand_Seed)&1);
+            /* The last byte is checked, so it must not be in the first word */
+            Slot_Size[Count]=sizeof(ptr_int_t)+1+Test_Rand(&Proc_Rand_Seed)%TEST_MAX_SIZE;
+            Mem_Ptr=_Sys_Malloc(Slot_PID[Count],Slot_Size[Count]);
+            if(Mem_Ptr==0)
+            {
+                Fail_Cnt++;
+                continue;
+            }
+            Slot_Tag[Count]=++Tag;
+            Test_Fill(Mem_Ptr,Slot_Size[Count],Slot_Tag[Count]);
+
+            /* Publish it to the interrupt */
+            Sys_Lock_Interrupt();
+            Slot[Count]=Mem_Ptr;
+            Sys_Unlock_Interrupt();
+        }
+        else
+        {
+            /* Race the interrupt for it. Whoever is first frees it, and it cannot
+             * be allocated again before it is out of the slot.
+             */
+            HOST_CHECK(((u8*)Mem_Ptr)[Slot_Size[Count]-1]==Slot_Tag[Count]);
+            _Sys_Mfree(Slot_PID[Count],Mem_Ptr);
+            Sys_Lock_Interrupt();
+            Slot[Count]=0;
+            Sys_Unlock_Interrupt();
+            Proc_Free_Cnt++;
+        }
+    }
+
+    Host_Stop_Int();
+
+    /* Give everything back */
+    for(Count=0;Count<TEST_SLOTS;Count++)
+    {
+        if(Slot[Count]!=0)
+            _Sys_Mfree(Slot_PID[Count],Slot[Count]);
+        Slot[Count]=0;
+    }
+    for(Count=0;Count<TEST_ISR_SLOTS;Count++)
+    {
+        if(ISR_Slot[Count]!=0)
+            Sys_Mfree_ISR(ISR_Slot[Count]);
+        ISR_Slot[Count]=0;
+    }
+    Sys_Lock_Scheduler();
+    Sys_Unlock_Scheduler();
+
+    Host_Print("stress: %d rounds, %d interrupts, %d interrupt frees, %d process frees, "
+               "%d failed allocations, %d reserve exhaustions\n",
+               (int)Round,(int)Int_Cnt,(int)Int_Free_Cnt,(int)Proc_Free_Cnt,
+               (int)Fail_Cnt,(int)Int_Reserve_Fail_Cnt);
+    HOST_CHECK(Int_Error_Cnt==0);
+    HOST_CHECK(Int_Free_Cnt>0);
+}
+/* End Function:Test_Stress **************************************************/
+
+/* Begin Function:main ********************************************************
+Description : The entry of the test.
+Input       : int argc - The number of arguments.
+              char* argv[] - The arguments: the seconds of the stress part.
+Output      : None.
+Return      : int - 0 if passed.
+******************************************************************************/
+int main(int argc,char* argv[])
+{
+    size_t Free;
+    size_t Used;
+    cnt_t Free_Blocks;
+    u32 Seconds;
+    char* Arg_Ptr;
+
+    Seconds=2;
+    if(argc>1)
+    {
+        Seconds=0;
+        for(Arg_Ptr=argv[1];(*Arg_Ptr>='0')&&(*Arg_Ptr<='9');Arg_Ptr++)
+            Seconds=Seconds*10+(*Arg_Ptr-'0');
+    }
+
+    PCB[1].Status.Running_Status=OCCUPY;
+    PCB[2].Status.Running_Status=OCCUPY;
+    _Sys_Mem_Init();
+    Free=Sys_Query_Free_Mem();
+    Used=Sys_Query_Used_Memory();
+    Free_Blocks=Sys_Query_Mem_Frag();
+
+    Test_Double_Free();
+    Test_Free_All();
+    Test_Transfer();
+    Test_Stress(Seconds);
+
+    /* The heap must be just as it was */
+    HOST_CHECK(Sys_Query_Proc_Mem(1)==0);
+    HOST_CHECK(Sys_Query_Proc_Mem(2)==0);
+    HOST_CHECK(Sys_Query_Free_Mem()==Free);
+    HOST_CHECK(Sys_Query_Used_Memory()==Used);
+    HOST_CHECK(Sys_Query_Mem_Frag()==Free_Blocks);
+    Test_Check_Reserve();
+
+    Host_Print("OK\n");
+    return 0;
+}
+/* End Function:main *********************************************************/
+
+/* End Of File ***************************************************************/
+
+/* Copyright (C) 2011-2013 Evo-Devo Instrum. All rights reserved *************/
@@ -0,0 +1,37 @@
+#!/bin/sh
+# Filename    : host_build.sh
+# Author      : pry
+# Date        : 19/10/2013
+# Description : Build a host-side test or benchmark with gcc on a POSIX host,
+#               together with the host port and the kernel files it needs.
+#                   TestHost/host_build.sh <Output> <Source files...>
+#               The kernel includes its headers as "Dir\file.h", which is a path
+#               only on Windows. Here a directory of links with those names is
+#               made instead. Extra compiler options(for example the overridden
+#               configurations, "-DMM_SLI=16") go in "CFLAGS".
+
+set -e
+
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 <Output> <Source files...>" >&2
+    exit 1
+fi
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+INC=$(mktemp -d)
+trap 'rm -rf "$INC"' EXIT
+
+for HDR in "$ROOT"/Include/*/*.h; do
+    ln -s "$HDR" "$INC/$(basename "$(dirname "$HDR")")\\$(basename "$HDR")"
+done
+# The host port takes the place of the chip library
+ln -s "$ROOT/TestHost/host_port.h" "$INC/STM32\\stm32f10x_conf.h"
+
+OUT=$1
+shift
+
+# The heap addresses are cast to "u32" by the kernel, so keep them low
+${CC:-gcc} -g -O2 -pthread -no-pie -fno-pie -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast -include "$ROOT/TestHost/host_port.h" -I"$INC" $CFLAGS \
+    -o "$OUT" "$@" \
+    "$ROOT/TestHost/host_int.c" "$ROOT/TestHost/host_kernel.c" \
+    "$ROOT/Kernel/interrupt.c" "$ROOT/Kernel/error.c" "$ROOT/Syslib/syslib.c"
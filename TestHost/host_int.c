@@ -0,0 +1,300 @@
+/******************************************************************************
+Filename    : host_int.c
+Author      : pry
+Date        : 19/10/2013
+Version     : 0.01
+Description : The host stand-in of the assembly part of the kernel, for the host
+              -side tests. The interrupt is simulated with "SIGALRM", which 
+              preempts the process(main) thread just as a real interrupt does on
+              the single-core chip: "DISABLE_ALL_INTS" blocks the signal, and the
+              handler is bracketed by "Sys_Enter_Int_Handler" and 
+              "Sys_Exit_Int_Handler" as in "platform_stm32.s". A second thread
+              can also be started, to run an interrupt handler really at the same
+              time as the process, which finds the missing memory barriers on a
+              weakly ordered host. The C library services of the tests are here
+              as well. The kernel headers are not included, for their types
+              clash with the C library's.
+******************************************************************************/
+
+/* Includes ******************************************************************/
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/time.h>
+/* End Includes **************************************************************/
+
+/* Imports *******************************************************************/
+/* In "Kernel\interrupt.c" */
+extern volatile s32 Int_Nest_Cnt;
+void Sys_Enter_Int_Handler(void);
+void Sys_Exit_Int_Handler(void);
+/* End Imports ***************************************************************/
+
+/* Global Variables **********************************************************/
+/* The simulated interrupt handler */
+static void (*Host_Int_Handler)(void);
+static sigset_t Host_Int_Set;
+/* The second thread and its function */
+static pthread_t Host_Thread;
+static void (*Host_Thread_Func)(void);
+/* End Global Variables ******************************************************/
+
+/* Begin Function:Host_Int_Entry **********************************************
+Description : The signal handler, which does what "SysTick_Handler" does.
+Input       : int Signal - The signal number.
+Output      : None.
+Return      : None.
+******************************************************************************/
+static void Host_Int_Entry(int Signal)
+{
+    (void)Signal;
+
+    Sys_Enter_Int_Handler();
+    Host_Int_Handler();
+    Sys_Exit_Int_Handler();
+}
+/* End Function:Host_Int_Entry ***********************************************/
+
+/* Begin Function:Host_Start_Int **********************************************
+Description : Start the simulated interrupt.
+Input       : void (*Handler)(void) - The interrupt handler.
+              u32 Period_US - The period in microseconds.
+Output      : None.
+Return      : None.
+******************************************************************************/
+void Host_Start_Int(void (*Handler)(void),u32 Period_US)
+{
+    struct sigaction Action;
+    struct itimerval Timer;
+
+    Host_Int_Handler=Handler;
+    sigemptyset(&Host_Int_Set);
+    sigaddset(&Host_Int_Set,SIGALRM);
+
+    Action.sa_handler=Host_Int_Entry;
+    Action.sa_flags=SA_RESTART;
+    /* An interrupt does not preempt itself */
+    Action.sa_mask=Host_Int_Set;
+    sigaction(SIGALRM,&Action,0);
+
+    Timer.it_interval.tv_sec=0;
+    Timer.it_interval.tv_usec=Period_US;
+    Timer.it_value=Timer.it_interval;
+    setitimer(ITIMER_REAL,&Timer,0);
+}
+/* End Function:Host_Start_Int ***********************************************/
+
+/* Begin Function:Host_Stop_Int ***********************************************
+Description : Stop the simulated interrupt.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+void Host_Stop_Int(void)
+{
+    struct itimerval Timer;
+
+    Timer.it_interval.tv_sec=0;
+    Timer.it_interval.tv_usec=0;
+    Timer.it_value=Timer.it_interval;
+    setitimer(ITIMER_REAL,&Timer,0);
+    signal(SIGALRM,SIG_IGN);
+}
+/* End Function:Host_Stop_Int ************************************************/
+
+/* Begin Function:Host_Thread_Entry *******************************************
+Description : The entry of the second thread.
+Input       : void* Arg - Not used.
+Output      : None.
+Return      : void* - Always 0.
+******************************************************************************/
+static void* Host_Thread_Entry(void* Arg)
+{
+    (void)Arg;
+
+    Host_Thread_Func();
+    return 0;
+}
+/* End Function:Host_Thread_Entry ********************************************/
+
+/* Begin Function:Host_Start_Thread *******************************************
+Description : Start the second thread. It is not an interrupt of the process
+              thread: "DISABLE_ALL_INTS" does not stop it, and it does not touch
+              the interrupt nesting count. Only one can run at a time.
+Input       : void (*Func)(void) - The function to run in the thread.
+Output      : None.
+Return      : None.
+******************************************************************************/
+void Host_Start_Thread(void (*Func)(void))
+{
+    Host_Thread_Func=Func;
+    if(pthread_create(&Host_Thread,0,Host_Thread_Entry,0)!=0)
+        Host_Fail("pthread_create",__FILE__,__LINE__);
+}
+/* End Function:Host_Start_Thread ********************************************/
+
+/* Begin Function:Host_Join_Thread ********************************************
+Description : Wait for the second thread to return.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+void Host_Join_Thread(void)
+{
+    pthread_join(Host_Thread,0);
+}
+/* End Function:Host_Join_Thread *********************************************/
+
+/* Begin Function:DISABLE_ALL_INTS ********************************************
+Description : Disable the simulated interrupt.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+void DISABLE_ALL_INTS(void)
+{
+    sigprocmask(SIG_BLOCK,&Host_Int_Set,0);
+}
+/* End Function:DISABLE_ALL_INTS *********************************************/
+
+/* Begin Function:ENABLE_ALL_INTS *********************************************
+Description : Enable the simulated interrupt. In the handler, the signal stays
+              blocked until the handler returns.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+void ENABLE_ALL_INTS(void)
+{
+    if(Int_Nest_Cnt==0)
+        sigprocmask(SIG_UNBLOCK,&Host_Int_Set,0);
+}
+/* End Function:ENABLE_ALL_INTS **********************************************/
+
+/* Begin Function:MEMORY_BARRIER **********************************************
+Description : The memory barrier.
+Input       : None.
+Output      : None.
+Return      : None.
+******************************************************************************/
+void MEMORY_BARRIER(void)
+{
+    __sync_synchronize();
+}
+/* End Function:MEMORY_BARRIER ***********************************************/
+
+/* Begin Function:COMPARE_AND_SWAP ********************************************
+Description : The atomic compare-and-swap, which is also a memory barrier.
+Input       : volatile ptr_int_t* Addr - The address of the word.
+              ptr_int_t Old_Val - The old value.
+              ptr_int_t New_Val - The new value.
+Output      : None.
+Return      : s32 - 0 if the new value is stored; -1 if the word does not have the
+                    old value.
+******************************************************************************/
+s32 COMPARE_AND_SWAP(volatile ptr_int_t* Addr,ptr_int_t Old_Val,ptr_int_t New_Val)
+{
+    if(__sync_bool_compare_and_swap(Addr,Old_Val,New_Val))
+        return 0;
+
+    return -1;
+}
+/* End Function:COMPARE_AND_SWAP *********************************************/
+
+/* Begin Function:Host_Print **************************************************
+Description : Print to the standard output at once.
+Input       : const char* Format - The format, as "printf".
+Output      : None.
+Return      : None.
+******************************************************************************/
+void Host_Print(const char* Format,...)
+{
+    va_list Args;
+
+    va_start(Args,Format);
+    vprintf(Format,Args);
+    va_end(Args);
+    fflush(stdout);
+}
+/* End Function:Host_Print ***************************************************/
+
+/* Begin Function:Host_Fail ***************************************************
+Description : Report a failed check and stop the test.
+Input       : const char* Expr - The condition that is false.
+              const char* File - The file of the check.
+              s32 Line - The line of the check.
+Output      : None.
+Return      : None.
+******************************************************************************/
+void Host_Fail(const char* Expr,const char* File,s32 Line)
+{
+    Host_Stop_Int();
+    printf("FAIL %s:%d: %s\n",File,(int)Line,Expr);
+    fflush(stdout);
+    exit(1);
+}
+/* End Function:Host_Fail ****************************************************/
+
+/* Begin Function:Host_Time_NS ************************************************
+Description : Get the monotonic time, for the benchmarks.
+Input       : None.
+Output      : None.
+Return      : u64 - The time in nanoseconds.
+******************************************************************************/
+u64 Host_Time_NS(void)
+{
+    struct timespec Time;
+
+    clock_gettime(CLOCK_MONOTONIC,&Time);
+    return ((u64)Time.tv_sec)*1000000000ULL+(u64)Time.tv_nsec;
+}
+/* End Function:Host_Time_NS *************************************************/
+
+/* Begin Function:Host_Load_File **********************************************
+Description : Load a whole file into the memory.
+Input       : const char* Path - The file.
+Output      : u32* Size - The size of the file.
+Return      : void* - The contents, or 0 if the file cannot be read.
+******************************************************************************/
+void* Host_Load_File(const char* Path,u32* Size)
+{
+    FILE* File;
+    long File_Size;
+    void* Buf;
+
+    File=fopen(Path,"rb");
+    if(File==0)
+        return 0;
+
+    fseek(File,0,SEEK_END);
+    File_Size=ftell(File);
+    fseek(File,0,SEEK_SET);
+
+    Buf=malloc(File_Size+1);
+    if((Buf==0)||(fread(Buf,1,File_Size,File)!=(size_t)File_Size))
+    {
+        free(Buf);
+        fclose(File);
+        return 0;
+    }
+
+    fclose(File);
+    *Size=(u32)File_Size;
+    return Buf;
+}
+/* End Function:Host_Load_File ***********************************************/
+
+/* Begin Function:Host_Stubs **************************************************
+Description : The rest of the assembly part. These do nothing on the host.
+******************************************************************************/
+void DISABLE_SYSTICK(void){}
+void ENABLE_SYSTICK(void){}
+void _Sys_Schedule_Trigger(void){}
+/* End Function:Host_Stubs ***************************************************/
+
+/* End Of File ***************************************************************/
+
+/* Copyright (C) 2011-2013 Evo-Devo Instrum. All rights reserved *************/
@@ -0,0 +1,68 @@
+/******************************************************************************
+Filename    : host_kernel.c
+Author      : pry
+Date        : 19/10/2013
+Version     : 0.01
+Description : The host stand-in of the scheduler, for the host-side tests. Link
+              it with "host_int.c", "Kernel\interrupt.c", "Kernel\error.c" and
+              "Syslib\syslib.c". There is only one process thread on the host, 
+              and no real scheduler: "Sys_Wait_Object" times out at once unless a
+              test provides its own.
+******************************************************************************/
+
+/* Includes ******************************************************************/
+#include "Config\MP_config.h"
+#include "Platform\MP_platform.h"
+
+/* Definition includes */
+#define __HDR_DEFS__
+#include "Kernel\scheduler.h"
+#undef __HDR_DEFS__
+
+/* Structure includes */
+#define __HDR_STRUCTS__
+#include "Syslib\syslib.h"
+#include "Kernel\scheduler.h"
+#undef __HDR_STRUCTS__
+/* End Includes **************************************************************/
+
+/* Global Variables **********************************************************/
+volatile struct Sys_Status_Struct System_Status;
+volatile pid_t Current_PID;
+volatile prio_t Current_Prio;
+volatile cnt_t Pend_Sched_Cnt;
+volatile ptr_int_t PCB_Cur_SP[MAX_PROC_NUM];
+volatile struct PCB_Struct PCB[MAX_PROC_NUM];
+/* End Global Variables ******************************************************/
+
+/* Begin Function:Host_Stubs **************************************************
+Description : The rest of the scheduler. These do nothing on the host. The weak
+              ones may be replaced by the tests or by the modules linked in.
+******************************************************************************/
+void Sys_Switch_Now(void){}
+retval_t _Sys_Set_Ready(pid_t PID){(void)PID;return 0;}
+retval_t _Sys_Clr_Ready(pid_t PID){(void)PID;return 0;}
+void Sys_Proc_Delay_Cancel(pid_t PID){(void)PID;}
+void Sys_Proc_Delay_Tick(time_t Ticks){(void)Ticks;}
+
+__attribute__((weak)) retval_t Sys_Send_Signal(pid_t PID,signal_t Signal)
+{
+    (void)PID;
+    (void)Signal;
+    return 0;
+}
+
+__attribute__((weak)) cnt_t Sys_Wait_Object(cnt_t Object_ID,cnt_t Object_Type,time_t Time)
+{
+    (void)Object_ID;
+    (void)Object_Type;
+    (void)Time;
+    return -1;
+}
+
+__attribute__((weak)) void _Sys_Pipe_Wake_Deferred(void){}
+/* End Function:Host_Stubs ***************************************************/
+
+/* End Of File ***************************************************************/
+
+/* Copyright (C) 2011-2013 Evo-Devo Instrum. All rights reserved *************/
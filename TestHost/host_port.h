@@ -0,0 +1,74 @@
+/******************************************************************************
+Filename    : host_port.h
+Author      : pry
+Date        : 19/10/2013
+Version     : 0.01
+Description : The host port of the kernel for the host-side tests. It takes the
+              place of "STM32\stm32f10x_conf.h": force-include it into every file
+              (gcc "-include"), and the chip library is left out. The basic types
+              are those of the Cortex-M3, and the pointers are as wide as on the
+              host. The interrupt and the C library are reached through 
+              "host_int.c".
+******************************************************************************/
+
+/* Preprocessor Control ******************************************************/
+#ifndef __HOST_PORT_H__
+#define __HOST_PORT_H__
+
+/* Leave out the chip library headers included by "MP_platform.h" */
+#define __STM32F10x_CONF_H
+
+/* Basic Types ***************************************************************/
+typedef signed int  s32;
+typedef signed short s16;
+typedef signed char  s8;
+
+typedef unsigned long long u64;
+typedef unsigned int  u32;
+typedef unsigned short u16;
+typedef unsigned char  u8;
+
+typedef volatile unsigned int  vu32;
+typedef volatile unsigned short vu16;
+typedef volatile unsigned char  vu8;
+
+/* The pointers are 64 bits on most hosts */
+#define __PTR_INT_T__
+typedef unsigned long ptr_int_t;
+/* End Basic Types ***********************************************************/
+
+/* Chip Library **************************************************************/
+/* Only used by the kernel startup, which is not run on the host */
+#define NVIC_VectTab_FLASH          0
+#define SysTick_IRQn                (-1)
+#define PendSV_IRQn                 (-2)
+void NVIC_SetVectorTable(u32 Vect_Tab,u32 Offset);
+u32 SysTick_Config(u32 Ticks);
+void NVIC_SetPriority(s32 IRQn,u32 Priority);
+
+/* The ARM compiler intrinsic used by the memory trace */
+#define __return_address()          __builtin_return_address(0)
+/* End Chip Library **********************************************************/
+
+/* Host Services *************************************************************/
+/* Call the handler periodically as an interrupt of the process(main) thread */
+void Host_Start_Int(void (*Handler)(void),u32 Period_US);
+void Host_Stop_Int(void);
+/* Run a function in a second thread, at the same time as the process thread */
+void Host_Start_Thread(void (*Func)(void));
+void Host_Join_Thread(void);
+/* The C library is not included with the kernel headers, for the types clash */
+void Host_Print(const char* Format,...);
+void Host_Fail(const char* Expr,const char* File,s32 Line);
+u64 Host_Time_NS(void);
+void* Host_Load_File(const char* Path,u32* Size);
+/* Stop the test at once if the condition is false */
+#define HOST_CHECK(X)               do{if(!(X)) Host_Fail(#X,__FILE__,__LINE__);}while(0)
+/* End Host Services *********************************************************/
+
+#endif
+/* End Preprocessor Control **************************************************/
+
+/* End Of File ***************************************************************/
+
+/* Copyright (C) 2011-2013 Evo-Devo Instrum. All rights reserved *************/